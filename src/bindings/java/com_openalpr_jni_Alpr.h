@@ -55,6 +55,22 @@ JNIEXPORT jstring JNICALL Java_com_openalpr_jni_Alpr_native_1recognize___3B
 JNIEXPORT jstring JNICALL Java_com_openalpr_jni_Alpr_native_1recognize__JIII
   (JNIEnv *, jobject, jlong, jint, jint, jint);
 
+/*
+ * Class:     com_openalpr_jni_Alpr
+ * Method:    native_recognize_binary
+ * Signature: (Ljava/nio/ByteBuffer;IIIII)[B
+ */
+JNIEXPORT jbyteArray JNICALL Java_com_openalpr_jni_Alpr_native_1recognize_1binary
+  (JNIEnv *, jobject, jobject, jint, jint, jint, jint, jint);
+
+/*
+ * Class:     com_openalpr_jni_Alpr
+ * Method:    native_recognize_batch
+ * Signature: ([Ljava/nio/ByteBuffer;[I[IIII)[B
+ */
+JNIEXPORT jbyteArray JNICALL Java_com_openalpr_jni_Alpr_native_1recognize_1batch
+  (JNIEnv *, jobject, jobjectArray, jintArray, jintArray, jint, jint, jint);
+
 /*
  * Class:     com_openalpr_jni_Alpr
  * Method:    set_default_region
@@ -1,4 +1,6 @@
 #include <alpr.h>
+#include <stdint.h>
+#include <string.h>
  
 #include "com_openalpr_jni_Alpr.h"
 
@@ -7,6 +9,61 @@ using namespace alpr;
 bool initialized = false;
 static Alpr* nativeAlpr;
 
+static void throwIllegalArgument(JNIEnv *env, const char* message)
+{
+  jclass exceptionClass = env->FindClass("java/lang/IllegalArgumentException");
+  if (exceptionClass != NULL)
+    env->ThrowNew(exceptionClass, message);
+}
+
+// Points at length bytes starting at offset inside a direct ByteBuffer, or throws
+// (and returns NULL) if the buffer is not direct or too small
+static unsigned char* directBufferRange(JNIEnv *env, jobject buffer, jint offset, jint length)
+{
+  unsigned char* address = (unsigned char*) env->GetDirectBufferAddress(buffer);
+  if (address == NULL)
+  {
+    throwIllegalArgument(env, "Image data must be in a direct ByteBuffer");
+    return NULL;
+  }
+
+  jlong capacity = env->GetDirectBufferCapacity(buffer);
+  if (offset < 0 || length < 0 || (jlong) offset + length > capacity)
+  {
+    throwIllegalArgument(env, "Image data range is outside of the ByteBuffer");
+    return NULL;
+  }
+
+  return address + offset;
+}
+
+// Encoded images (bytesPerPixel == 0) are decoded in place; raw pixels are wrapped, not copied
+static bool recognizeRange(JNIEnv *env, unsigned char* data, jint length, jint bytesPerPixel, jint width, jint height, AlprResults& results)
+{
+  if (bytesPerPixel == 0)
+  {
+    results = nativeAlpr->recognize(data, (size_t) length, std::vector<AlprRegionOfInterest>());
+    return true;
+  }
+
+  if (bytesPerPixel < 0 || width <= 0 || height <= 0 || (jlong) width * height * bytesPerPixel > length)
+  {
+    throwIllegalArgument(env, "Raw image dimensions do not match the image data");
+    return false;
+  }
+
+  results = nativeAlpr->recognize(data, bytesPerPixel, width, height, std::vector<AlprRegionOfInterest>());
+  return true;
+}
+
+static jbyteArray toByteArray(JNIEnv *env, const std::string& data)
+{
+  jbyteArray array = env->NewByteArray(data.size());
+  if (array != NULL)
+    env->SetByteArrayRegion(array, 0, data.size(), reinterpret_cast<const jbyte*>(data.data()));
+  return array;
+}
+
 JNIEXPORT void JNICALL Java_com_openalpr_jni_Alpr_initialize
   (JNIEnv *env, jobject thisObj, jstring jcountry, jstring jconfigFile, jstring jruntimeDir)
   {
@@ -77,15 +134,13 @@ JNIEXPORT jstring JNICALL Java_com_openalpr_jni_Alpr_native_1recognize___3B
     //printf("Recognize byte array");
 
     int len = env->GetArrayLength (jimageBytes);
-    unsigned char* buf = new unsigned char[len];
-    env->GetByteArrayRegion (jimageBytes, 0, len, reinterpret_cast<jbyte*>(buf));
-
-    std::vector<char> cvec(buf, buf+len);
+    std::vector<char> cvec(len);
+    if (len > 0)
+      env->GetByteArrayRegion (jimageBytes, 0, len, reinterpret_cast<jbyte*>(&cvec[0]));
 
     AlprResults results = nativeAlpr->recognize(cvec);
     std::string json = Alpr::toJson(results);
 
-    delete buf;
     return env->NewStringUTF(json.c_str());
   }
 
@@ -107,6 +162,64 @@ JNIEXPORT jstring JNICALL Java_com_openalpr_jni_Alpr_native_1recognize__JIII
   }
 
 
+JNIEXPORT jbyteArray JNICALL Java_com_openalpr_jni_Alpr_native_1recognize_1binary
+  (JNIEnv *env, jobject thisObj, jobject jimageData, jint offset, jint length, jint bytesPerPixel, jint width, jint height)
+  {
+    unsigned char* data = directBufferRange(env, jimageData, offset, length);
+    if (data == NULL)
+      return NULL;
+
+    AlprResults results;
+    if (!recognizeRange(env, data, length, bytesPerPixel, width, height, results))
+      return NULL;
+
+    return toByteArray(env, Alpr::toBinary(results));
+  }
+
+JNIEXPORT jbyteArray JNICALL Java_com_openalpr_jni_Alpr_native_1recognize_1batch
+  (JNIEnv *env, jobject thisObj, jobjectArray jframes, jintArray joffsets, jintArray jlengths, jint bytesPerPixel, jint width, jint height)
+  {
+    jsize frameCount = env->GetArrayLength(jframes);
+    if (env->GetArrayLength(joffsets) != frameCount || env->GetArrayLength(jlengths) != frameCount)
+    {
+      throwIllegalArgument(env, "One offset and length is required per frame");
+      return NULL;
+    }
+
+    std::vector<jint> offsets(frameCount);
+    std::vector<jint> lengths(frameCount);
+    if (frameCount > 0)
+    {
+      env->GetIntArrayRegion(joffsets, 0, frameCount, &offsets[0]);
+      env->GetIntArrayRegion(jlengths, 0, frameCount, &lengths[0]);
+    }
+
+    // [int32 frame count] then, per frame, [int32 size][binary results]
+    std::string batch;
+    int32_t count = frameCount;
+    batch.append(reinterpret_cast<const char*>(&count), sizeof(count));
+
+    for (jsize i = 0; i < frameCount; i++)
+    {
+      jobject frame = env->GetObjectArrayElement(jframes, i);
+      unsigned char* data = directBufferRange(env, frame, offsets[i], lengths[i]);
+      env->DeleteLocalRef(frame);
+      if (data == NULL)
+        return NULL;
+
+      AlprResults results;
+      if (!recognizeRange(env, data, lengths[i], bytesPerPixel, width, height, results))
+        return NULL;
+
+      std::string binary = Alpr::toBinary(results);
+      int32_t size = binary.size();
+      batch.append(reinterpret_cast<const char*>(&size), sizeof(size));
+      batch.append(binary);
+    }
+
+    return toByteArray(env, batch);
+  }
+
 JNIEXPORT void JNICALL Java_com_openalpr_jni_Alpr_set_1default_1region
   (JNIEnv *env, jobject thisObj, jstring jdefault_region)
   {
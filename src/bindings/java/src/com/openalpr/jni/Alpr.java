@@ -2,6 +2,9 @@ package com.openalpr.jni;
 
 import com.openalpr.jni.json.JSONException;
 
+import java.nio.ByteBuffer;
+import java.util.List;
+
 public class Alpr {
     static {
         // Load the OpenALPR library at runtime
@@ -16,6 +19,9 @@ public class Alpr {
     private native String native_recognize(String imageFile);
     private native String native_recognize(byte[] imageBytes);
     private native String native_recognize(long imageData, int bytesPerPixel, int imgWidth, int imgHeight);
+    // bytesPerPixel == 0 means the buffer holds an encoded image
+    private native byte[] native_recognize_binary(ByteBuffer imageData, int offset, int length, int bytesPerPixel, int imgWidth, int imgHeight);
+    private native byte[] native_recognize_batch(ByteBuffer[] frames, int[] offsets, int[] lengths, int bytesPerPixel, int imgWidth, int imgHeight);
 
     private native void set_default_region(String region);
     private native void detect_region(boolean detectRegion);
@@ -75,6 +81,48 @@ public class Alpr {
     }
 
 
+    /**
+     * Recognizes raw pixels (e.g., BGR, 3 bytes per pixel) read in place from a direct
+     * ByteBuffer, between its position and limit.  Results are returned in a compact binary
+     * form rather than JSON.
+     */
+    public AlprResults recognize(ByteBuffer imageData, int bytesPerPixel, int imgWidth, int imgHeight) throws AlprException
+    {
+        if (bytesPerPixel <= 0)
+            throw new IllegalArgumentException("bytesPerPixel must be positive");
+        byte[] binary = native_recognize_binary(imageData, imageData.position(), imageData.remaining(), bytesPerPixel, imgWidth, imgHeight);
+        return BinaryResults.decode(binary);
+    }
+
+    /**
+     * Recognizes an encoded image (JPEG, PNG, ...) held between the position and limit of a
+     * direct ByteBuffer.  The bytes are decoded in place.
+     */
+    public AlprResults recognizeEncoded(ByteBuffer encodedImage) throws AlprException
+    {
+        byte[] binary = native_recognize_binary(encodedImage, encodedImage.position(), encodedImage.remaining(), 0, 0, 0);
+        return BinaryResults.decode(binary);
+    }
+
+    /**
+     * Recognizes several frames with a single native call.  Every frame is a direct
+     * ByteBuffer of raw pixels with the given dimensions or, when bytesPerPixel is 0, an
+     * encoded image.  Results are in frame order.
+     */
+    public List<AlprResults> recognizeBatch(ByteBuffer[] frames, int bytesPerPixel, int imgWidth, int imgHeight) throws AlprException
+    {
+        int[] offsets = new int[frames.length];
+        int[] lengths = new int[frames.length];
+        for (int i = 0; i < frames.length; i++)
+        {
+            offsets[i] = frames[i].position();
+            lengths[i] = frames[i].remaining();
+        }
+
+        byte[] binary = native_recognize_batch(frames, offsets, lengths, bytesPerPixel, imgWidth, imgHeight);
+        return BinaryResults.decodeBatch(binary);
+    }
+
     public void setTopN(int topN)
     {
         set_top_n(topN);
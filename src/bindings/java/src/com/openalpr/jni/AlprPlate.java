@@ -5,6 +5,7 @@ import com.openalpr.jni.json.JSONException;
 import com.openalpr.jni.json.JSONObject;
 import com.openalpr.jni.json.JSONArray;
 
+import java.nio.ByteBuffer;
 import java.util.ArrayList;
 import java.util.List;
 
@@ -30,6 +31,18 @@ public class AlprPlate {
         }
     }
 
+    AlprPlate(ByteBuffer data, int imgWidth, int imgHeight)
+    {
+        characters = BinaryResults.getString(data);
+        overall_confidence = data.getFloat();
+        matches_template = data.get() != 0;
+
+        int numChars = BinaryResults.getCount(data, 40);
+        charactersDetailed = new ArrayList<CharacterResult>(numChars);
+        for (int i = 0; i < numChars; i++)
+            charactersDetailed.add(new CharacterResult(data, imgWidth, imgHeight));
+    }
+
     public String getCharacters() {
         return characters;
     }
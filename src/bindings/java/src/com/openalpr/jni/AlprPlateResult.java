@@ -5,6 +5,7 @@ import com.openalpr.jni.json.JSONArray;
 import com.openalpr.jni.json.JSONException;
 import com.openalpr.jni.json.JSONObject;
 
+import java.nio.ByteBuffer;
 import java.util.List;
 import java.util.ArrayList;
 import java.util.Arrays;
@@ -70,6 +71,40 @@ public class AlprPlateResult {
 
     }
 
+    AlprPlateResult(ByteBuffer data, int imgWidth, int imgHeight)
+    {
+        requested_topn = data.getInt();
+        BinaryResults.getString(data); // country
+        processing_time_ms = data.getFloat();
+
+        plate_points = new ArrayList<Point2D>(4);
+        for (int i = 0; i < 4; i++)
+        {
+            int x = data.getInt();
+            int y = data.getInt();
+            plate_points.add(new Point2D(x, y).clamp(imgWidth, imgHeight));
+        }
+        plate_rect = Rect2D.fromPoints(getPlatePointsArray()).clamp(imgWidth, imgHeight);
+
+        plate_index = data.getInt();
+        regionConfidence = data.getInt();
+        region = BinaryResults.getString(data);
+
+        // Crop quality (score, sharpness, char_height, contrast, clipped) is not exposed here
+        for (int i = 0; i < 5; i++)
+            data.getFloat();
+
+        // Like the JSON path, the best plate is the first candidate
+        new AlprPlate(data, imgWidth, imgHeight);
+
+        int numCandidates = BinaryResults.getCount(data, 4);
+        topNPlates = new ArrayList<AlprPlate>(numCandidates);
+        for (int i = 0; i < numCandidates; i++)
+            topNPlates.add(new AlprPlate(data, imgWidth, imgHeight));
+
+        bestPlate = topNPlates.size() > 0 ? topNPlates.get(0) : null;
+    }
+
     public int getRequestedTopn() {
         return requested_topn;
     }
@@ -3,6 +3,8 @@ package com.openalpr.jni;
 import com.openalpr.jni.json.JSONException;
 import com.openalpr.jni.json.JSONObject;
 
+import java.nio.ByteBuffer;
+
 
 public class AlprRegionOfInterest {
     private final int x;
@@ -18,6 +20,14 @@ public class AlprRegionOfInterest {
         height = roiObj.getInt("height");
     }
 
+    AlprRegionOfInterest(ByteBuffer data)
+    {
+        x = data.getInt();
+        y = data.getInt();
+        width = data.getInt();
+        height = data.getInt();
+    }
+
     public int getX() {
         return x;
     }
@@ -4,6 +4,7 @@ import com.openalpr.jni.json.JSONArray;
 import com.openalpr.jni.json.JSONException;
 import com.openalpr.jni.json.JSONObject;
 
+import java.nio.ByteBuffer;
 import java.util.ArrayList;
 import java.util.List;
 
@@ -45,6 +46,35 @@ public class AlprResults {
         }
     }
 
+    // Reads the binary layout written by Alpr::toBinary (after the magic number)
+    AlprResults(ByteBuffer data)
+    {
+        epoch_time = data.getLong();
+        data.getLong(); // frame_number
+        img_width = data.getInt();
+        img_height = data.getInt();
+        total_processing_time_ms = data.getFloat();
+
+        // Pipeline diagnostics (profile, OCR pass, vote and quality counters) are not exposed here
+        BinaryResults.getString(data);
+        data.getInt();
+        data.getInt();
+        BinaryResults.getString(data);
+        BinaryResults.getString(data);
+        for (int i = 0; i < 8; i++)
+            data.getInt();
+
+        int numRois = BinaryResults.getCount(data, 16);
+        regionsOfInterest = new ArrayList<AlprRegionOfInterest>(numRois);
+        for (int i = 0; i < numRois; i++)
+            regionsOfInterest.add(new AlprRegionOfInterest(data));
+
+        int numPlates = BinaryResults.getCount(data, 4);
+        plates = new ArrayList<AlprPlateResult>(numPlates);
+        for (int i = 0; i < numPlates; i++)
+            plates.add(new AlprPlateResult(data, img_width, img_height));
+    }
+
     public long getEpochTime() {
         return epoch_time;
     }
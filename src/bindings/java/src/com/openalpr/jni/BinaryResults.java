@@ -0,0 +1,81 @@
+package com.openalpr.jni;
+
+import java.nio.BufferUnderflowException;
+import java.nio.ByteBuffer;
+import java.nio.ByteOrder;
+import java.nio.charset.StandardCharsets;
+import java.util.ArrayList;
+import java.util.List;
+
+// Decodes the compact binary results written by the native library (Alpr::toBinary),
+// so no JSON text is built or parsed.  Values are in the native byte order.
+class BinaryResults {
+    private static final int MAGIC = 0x41524232; // "ARB2"
+
+    static AlprResults decode(byte[] data) throws AlprException
+    {
+        return decode(ByteBuffer.wrap(data).order(ByteOrder.nativeOrder()));
+    }
+
+    static AlprResults decode(ByteBuffer buffer) throws AlprException
+    {
+        try {
+            if (buffer.getInt() != MAGIC)
+                throw new AlprException("Unable to parse ALPR results");
+            return new AlprResults(buffer);
+        } catch (BufferUnderflowException e)
+        {
+            throw new AlprException("Unable to parse ALPR results");
+        }
+    }
+
+    // A batch is [int32 frame count] followed by [int32 size][results] per frame
+    static List<AlprResults> decodeBatch(byte[] data) throws AlprException
+    {
+        ByteBuffer buffer = ByteBuffer.wrap(data).order(ByteOrder.nativeOrder());
+        try {
+            int count = buffer.getInt();
+            List<AlprResults> batch = new ArrayList<AlprResults>(count);
+            for (int i = 0; i < count; i++)
+            {
+                int size = buffer.getInt();
+                ByteBuffer frame = buffer.slice().order(ByteOrder.nativeOrder());
+                frame.limit(size);
+                batch.add(decode(frame));
+                buffer.position(buffer.position() + size);
+            }
+            return batch;
+        } catch (BufferUnderflowException | IllegalArgumentException e)
+        {
+            throw new AlprException("Unable to parse ALPR results");
+        }
+    }
+
+    static String getString(ByteBuffer buffer)
+    {
+        int length = buffer.getInt();
+        if (length < 0 || length > buffer.remaining())
+            throw new BufferUnderflowException();
+
+        String value;
+        if (buffer.hasArray())
+            value = new String(buffer.array(), buffer.arrayOffset() + buffer.position(), length, StandardCharsets.UTF_8);
+        else
+        {
+            byte[] bytes = new byte[length];
+            buffer.duplicate().get(bytes);
+            value = new String(bytes, StandardCharsets.UTF_8);
+        }
+        buffer.position(buffer.position() + length);
+        return value;
+    }
+
+    // Element counts come from the buffer, so bound them before allocating
+    static int getCount(ByteBuffer buffer, int minElementSize)
+    {
+        int count = buffer.getInt();
+        if (count < 0 || (long) count * minElementSize > buffer.remaining())
+            throw new BufferUnderflowException();
+        return count;
+    }
+}
@@ -4,6 +4,8 @@ import com.openalpr.jni.json.JSONArray;
 import com.openalpr.jni.json.JSONException;
 import com.openalpr.jni.json.JSONObject;
 
+import java.nio.ByteBuffer;
+
 public class CharacterResult {
     private final String character;
     private final double confidence;
@@ -24,6 +26,18 @@ public class CharacterResult {
         rect = Rect2D.fromPoints(points).clamp(imgWidth, imgHeight);
     }
 
+    CharacterResult(ByteBuffer data, int imgWidth, int imgHeight) {
+        character = BinaryResults.getString(data);
+        confidence = data.getFloat();
+        points = new Point2D[4];
+        for (int i = 0; i < 4; i++) {
+            int x = data.getInt();
+            int y = data.getInt();
+            points[i] = new Point2D(x, y).clamp(imgWidth, imgHeight);
+        }
+        rect = Rect2D.fromPoints(points).clamp(imgWidth, imgHeight);
+    }
+
     public String getCharacter() {
         return character;
     }
@@ -0,0 +1,60 @@
+from openalpr import Alpr
+from argparse import ArgumentParser
+import timeit
+
+parser = ArgumentParser(description='OpenALPR Python binding benchmark: JSON results vs. record arrays')
+
+parser.add_argument("-c", "--country", dest="country", action="store", default="us",
+                  help="License plate Country" )
+
+parser.add_argument("--config", dest="config", action="store", default="/etc/openalpr/openalpr.conf",
+                  help="Path to openalpr.conf config file" )
+
+parser.add_argument("--runtime_data", dest="runtime_data", action="store", default="/usr/share/openalpr/runtime_data",
+                  help="Path to OpenALPR runtime_data directory" )
+
+parser.add_argument("-n", "--iterations", dest="iterations", action="store", type=int, default=50,
+                  help="Recognitions per method" )
+
+parser.add_argument('plate_image', help='License plate image file')
+
+options = parser.parse_args()
+
+
+def report(name, seconds):
+    print("  %-34s %10.3f ms/image" % (name, seconds * 1000.0 / options.iterations))
+
+
+alpr = None
+try:
+    alpr = Alpr(options.country, options.config, options.runtime_data)
+
+    if not alpr.is_loaded():
+        print("Error loading OpenALPR")
+    else:
+        print("Using OpenALPR " + alpr.get_version())
+        alpr.set_top_n(10)
+
+        jpeg_bytes = open(options.plate_image, "rb").read()
+
+        # Warm up, and make sure both paths agree
+        json_results = alpr.recognize_array(jpeg_bytes)
+        records = alpr.recognize_buffer(jpeg_bytes)
+        assert len(json_results['results']) == len(records.plates)
+
+        print("%d plate(s), %d iterations" % (len(records.plates), options.iterations))
+
+        report("recognize_array (JSON)", timeit.timeit(lambda: alpr.recognize_array(jpeg_bytes), number=options.iterations))
+        report("recognize_buffer (records)", timeit.timeit(lambda: alpr.recognize_buffer(jpeg_bytes), number=options.iterations))
+
+        try:
+            import cv2
+            pixels = cv2.imread(options.plate_image)
+            report("recognize_ndarray (JSON)", timeit.timeit(lambda: alpr.recognize_ndarray(pixels), number=options.iterations))
+            report("recognize_buffer (ndarray, records)", timeit.timeit(lambda: alpr.recognize_buffer(pixels), number=options.iterations))
+        except ImportError:
+            print("  (cv2 not installed; skipping raw pixel input)")
+
+finally:
+    if alpr:
+        alpr.unload()
@@ -32,6 +32,50 @@ def _convert_from_charp(charp):
         return charp
 
 
+def _struct_dtypes(np):
+    # Mirrors the AlprPy* structs in openalprpy.cpp
+    header = np.dtype([
+        ('version', 'i4'), ('header_size', 'i4'), ('plate_size', 'i4'), ('candidate_size', 'i4'),
+        ('epoch_time', 'i8'), ('img_width', 'i4'), ('img_height', 'i4'),
+        ('total_processing_time_ms', 'f4'), ('plate_count', 'i4'), ('candidate_count', 'i4'),
+        ('reserved', 'i4')])
+    plate = np.dtype([
+        ('plate_index', 'i4'), ('requested_topn', 'i4'), ('processing_time_ms', 'f4'),
+        ('region_confidence', 'i4'), ('points_x', 'i4', (4,)), ('points_y', 'i4', (4,)),
+        ('first_candidate', 'i4'), ('candidate_count', 'i4'), ('region', 'S16'), ('country', 'S16')])
+    candidate = np.dtype([
+        ('plate_index', 'i4'), ('confidence', 'f4'), ('matches_template', 'i4'), ('reserved', 'i4'),
+        ('characters', 'S32')])
+    return header, plate, candidate
+
+
+class AlprRecords:
+    """
+    Recognition results as numpy record arrays, returned by Alpr.recognize_buffer().
+
+    plates has one record per plate (plate_index, processing_time_ms, points_x, points_y,
+    region, country, ...).  candidates holds the top N candidates of every plate (plate_index,
+    characters, confidence, matches_template), grouped by plate in plate order.  String
+    fields are UTF-8 bytes.
+    """
+
+    def __init__(self, header, plates, candidates):
+        self.epoch_time = int(header['epoch_time'])
+        self.img_width = int(header['img_width'])
+        self.img_height = int(header['img_height'])
+        self.processing_time_ms = float(header['total_processing_time_ms'])
+        self.plates = plates
+        self.candidates = candidates
+
+    def candidates_for(self, plate):
+        """
+        :param plate: A record from plates
+        :return: The candidates for that plate, best first
+        """
+        first = int(plate['first_candidate'])
+        return self.candidates[first:first + int(plate['candidate_count'])]
+
+
 class Alpr:
     def __init__(self, country, config_file, runtime_dir):
         """
@@ -87,8 +131,24 @@ class Alpr:
             array_1_uint8 = npct.ndpointer(dtype=np.uint8, ndim=1, flags='CONTIGUOUS')
             self._recognize_raw_image_func.argtypes = [
                 ctypes.c_void_p, array_1_uint8, ctypes.c_uint, ctypes.c_uint, ctypes.c_uint]
+
+            self._recognize_encoded_struct_func = self._openalprpy_lib.recognizeEncodedStruct
+            self._recognize_encoded_struct_func.restype = ctypes.c_void_p
+            self._recognize_encoded_struct_func.argtypes = [ctypes.c_void_p, ctypes.c_void_p, ctypes.c_int]
+
+            self._recognize_raw_image_struct_func = self._openalprpy_lib.recognizeRawImageStruct
+            self._recognize_raw_image_struct_func.restype = ctypes.c_void_p
+            self._recognize_raw_image_struct_func.argtypes = [
+                ctypes.c_void_p, ctypes.c_void_p, ctypes.c_int, ctypes.c_int, ctypes.c_int]
+
+            self._free_struct_results_func = self._openalprpy_lib.freeStructResults
+            self._free_struct_results_func.argtypes = [ctypes.c_void_p]
+
+            self._np = np
+            self._header_dtype, self._plate_dtype, self._candidate_dtype = _struct_dtypes(np)
         except ImportError:
             self._recognize_raw_image_func = None
+            self._np = None
 
         self._free_json_mem_func = self._openalprpy_lib.freeJsonMem
 
@@ -181,13 +241,65 @@ class Alpr:
             raise RuntimeError('NumPy missing')
         height, width = ndarray.shape[:2]
         bpp = ndarray.shape[2] if len(ndarray.shape) > 2 else 1
-        ptr = self._recognize_raw_image_func(self.alpr_pointer, ndarray.flatten(), bpp, width, height)
+        # reshape only copies when the array isn't already contiguous (e.g., a slice)
+        pixels = self._np.ascontiguousarray(ndarray).reshape(-1)
+        ptr = self._recognize_raw_image_func(self.alpr_pointer, pixels, bpp, width, height)
         json_data = ctypes.cast(ptr, ctypes.c_char_p).value
         json_data = _convert_from_charp(json_data)
         response_obj = json.loads(json_data)
         self._free_json_mem_func(ctypes.c_void_p(ptr))
         return response_obj
 
+    def recognize_buffer(self, buffer):
+        """
+        Recognizes an image without copying it in and returns the results as numpy record
+        arrays instead of a JSON dictionary.  Requires NumPy.
+
+        :param buffer: Either a uint8 numpy array of pixels (height x width [x channels], as
+            used by cv2), or any object supporting the buffer protocol (bytes, bytearray,
+            memoryview, mmap, 1-D uint8 array...) holding an encoded image such as a JPEG
+        :return: An AlprRecords instance
+        """
+        np = self._np
+        if np is None:
+            raise RuntimeError('NumPy missing')
+
+        if isinstance(buffer, np.ndarray) and buffer.ndim >= 2:
+            if buffer.dtype != np.uint8:
+                raise TypeError("Expected a uint8 image array. Got: %r" % buffer.dtype)
+            height, width = buffer.shape[:2]
+            bpp = buffer.shape[2] if buffer.ndim > 2 else 1
+            pixels = np.ascontiguousarray(buffer)
+            ptr = self._recognize_raw_image_struct_func(self.alpr_pointer, pixels.ctypes.data, bpp, width, height)
+        else:
+            # frombuffer wraps the caller's memory; nothing is copied
+            encoded = np.frombuffer(buffer, dtype=np.uint8)
+            ptr = self._recognize_encoded_struct_func(self.alpr_pointer, encoded.ctypes.data, len(encoded))
+
+        if not ptr:
+            raise MemoryError("Unable to allocate OpenALPR results")
+
+        try:
+            header = np.frombuffer(ctypes.string_at(ptr, self._header_dtype.itemsize), dtype=self._header_dtype)[0]
+            if header['plate_size'] != self._plate_dtype.itemsize or \
+                    header['candidate_size'] != self._candidate_dtype.itemsize:
+                raise RuntimeError("libopenalprpy result layout does not match this module")
+
+            plate_count = int(header['plate_count'])
+            candidate_count = int(header['candidate_count'])
+            plates_offset = int(header['header_size'])
+            candidates_offset = plates_offset + plate_count * self._plate_dtype.itemsize
+            total_size = candidates_offset + candidate_count * self._candidate_dtype.itemsize
+
+            # One small copy of the packed records out of the native block before it is freed
+            block = ctypes.string_at(ptr, total_size)
+            plates = np.frombuffer(block, dtype=self._plate_dtype, count=plate_count, offset=plates_offset)
+            candidates = np.frombuffer(block, dtype=self._candidate_dtype, count=candidate_count,
+                                       offset=candidates_offset)
+            return AlprRecords(header, plates, candidates)
+        finally:
+            self._free_struct_results_func(ctypes.c_void_p(ptr))
+
     def get_version(self):
         """
         This gets the version of OpenALPR
@@ -1,4 +1,5 @@
 #include <stdlib.h>
+#include <stdint.h>
 #include <string>
 #include <string.h>
 
@@ -16,6 +17,118 @@ extern "C" {
 
   using namespace alpr;
 
+  // Results as plain C structs, so Python can read them directly (e.g., as numpy record
+  // arrays) instead of parsing JSON.  One malloc'd block holds the header, then
+  // plate_count plates, then candidate_count candidates.  Every field is 4 or 8 bytes
+  // wide and 8-byte aligned groups keep the layout free of padding.
+  // Keep in sync with the dtypes in openalpr/openalpr.py.
+  #define ALPRPY_RESULTS_VERSION 1
+  #define ALPRPY_MAX_CHARS 32
+  #define ALPRPY_MAX_REGION 16
+
+  struct AlprPyResultsHeader
+  {
+    int32_t version;
+    int32_t header_size;
+    int32_t plate_size;
+    int32_t candidate_size;
+    int64_t epoch_time;
+    int32_t img_width;
+    int32_t img_height;
+    float total_processing_time_ms;
+    int32_t plate_count;
+    int32_t candidate_count;
+    int32_t reserved;
+  };
+
+  struct AlprPyPlate
+  {
+    int32_t plate_index;
+    int32_t requested_topn;
+    float processing_time_ms;
+    int32_t region_confidence;
+    int32_t points_x[4];
+    int32_t points_y[4];
+    // Candidates for this plate are candidates[first_candidate .. first_candidate + candidate_count)
+    int32_t first_candidate;
+    int32_t candidate_count;
+    char region[ALPRPY_MAX_REGION];
+    char country[ALPRPY_MAX_REGION];
+  };
+
+  struct AlprPyCandidate
+  {
+    int32_t plate_index;
+    float confidence;
+    int32_t matches_template;
+    int32_t reserved;
+    // UTF-8, NUL padded.  Longer strings are truncated.
+    char characters[ALPRPY_MAX_CHARS];
+  };
+
+  static void copyField(char* dest, const std::string& src, size_t size)
+  {
+    memset(dest, 0, size);
+    strncpy(dest, src.c_str(), size - 1);
+  }
+
+  static AlprPyResultsHeader* packResults(const AlprResults& results)
+  {
+    int candidateCount = 0;
+    for (unsigned int i = 0; i < results.plates.size(); i++)
+      candidateCount += results.plates[i].topNPlates.size();
+
+    size_t totalSize = sizeof(AlprPyResultsHeader) + results.plates.size() * sizeof(AlprPyPlate) + candidateCount * sizeof(AlprPyCandidate);
+    char* block = (char*) calloc(1, totalSize);
+    if (block == NULL)
+      return NULL;
+
+    AlprPyResultsHeader* header = (AlprPyResultsHeader*) block;
+    header->version = ALPRPY_RESULTS_VERSION;
+    header->header_size = sizeof(AlprPyResultsHeader);
+    header->plate_size = sizeof(AlprPyPlate);
+    header->candidate_size = sizeof(AlprPyCandidate);
+    header->epoch_time = results.epoch_time;
+    header->img_width = results.img_width;
+    header->img_height = results.img_height;
+    header->total_processing_time_ms = results.total_processing_time_ms;
+    header->plate_count = results.plates.size();
+    header->candidate_count = candidateCount;
+
+    AlprPyPlate* plates = (AlprPyPlate*) (block + sizeof(AlprPyResultsHeader));
+    AlprPyCandidate* candidates = (AlprPyCandidate*) (plates + results.plates.size());
+
+    int nextCandidate = 0;
+    for (unsigned int i = 0; i < results.plates.size(); i++)
+    {
+      const AlprPlateResult& plate = results.plates[i];
+      plates[i].plate_index = plate.plate_index;
+      plates[i].requested_topn = plate.requested_topn;
+      plates[i].processing_time_ms = plate.processing_time_ms;
+      plates[i].region_confidence = plate.regionConfidence;
+      for (int p = 0; p < 4; p++)
+      {
+        plates[i].points_x[p] = plate.plate_points[p].x;
+        plates[i].points_y[p] = plate.plate_points[p].y;
+      }
+      plates[i].first_candidate = nextCandidate;
+      plates[i].candidate_count = plate.topNPlates.size();
+      copyField(plates[i].region, plate.region, ALPRPY_MAX_REGION);
+      copyField(plates[i].country, plate.country, ALPRPY_MAX_REGION);
+
+      for (unsigned int c = 0; c < plate.topNPlates.size(); c++)
+      {
+        AlprPyCandidate& candidate = candidates[nextCandidate++];
+        candidate.plate_index = i;
+        candidate.confidence = plate.topNPlates[c].overall_confidence;
+        candidate.matches_template = plate.topNPlates[c].matches_template ? 1 : 0;
+        copyField(candidate.characters, plate.topNPlates[c].characters, ALPRPY_MAX_CHARS);
+      }
+    }
+
+    return header;
+  }
+
 
   OPENALPR_EXPORT Alpr* initialize(char* ccountry, char* cconfigFile, char* cruntimeDir)
   {
@@ -83,9 +196,8 @@ extern "C" {
 
       //std::cout << "Using instance: " << nativeAlpr << std::endl;
 
-      std::vector<char> cvec(buf, buf+len);
-
-      AlprResults results = nativeAlpr->recognize(cvec);
+      std::vector<AlprRegionOfInterest> regionsOfInterest;
+      AlprResults results = nativeAlpr->recognize(buf, len, regionsOfInterest);
       std::string json = Alpr::toJson(results);
 
       int strsize = sizeof(char) * (strlen(json.c_str()) + 1);
@@ -96,6 +208,26 @@ extern "C" {
       return membuffer;
     }
 
+  // The caller's buffer is decoded in place and must stay alive for the duration of the call
+  OPENALPR_EXPORT AlprPyResultsHeader* recognizeEncodedStruct(Alpr* nativeAlpr, unsigned char* buf, int len)
+    {
+      std::vector<AlprRegionOfInterest> regionsOfInterest;
+      AlprResults results = nativeAlpr->recognize(buf, len, regionsOfInterest);
+      return packResults(results);
+    }
+
+  OPENALPR_EXPORT AlprPyResultsHeader* recognizeRawImageStruct(Alpr* nativeAlpr, unsigned char* buf, int bytesPerPixel, int imgWidth, int imgHeight)
+    {
+      std::vector<AlprRegionOfInterest> regionsOfInterest;
+      AlprResults results = nativeAlpr->recognize(buf, bytesPerPixel, imgWidth, imgHeight, regionsOfInterest);
+      return packResults(results);
+    }
+
+  OPENALPR_EXPORT void freeStructResults(AlprPyResultsHeader* ptr)
+  {
+    free( ptr );
+  }
+
   // AlprResults recognize(unsigned char* pixelData,
   // int bytesPerPixel, int imgWidth, int imgHeight,
   // std::vector<AlprRegionOfInterest> regionsOfInterest);
@@ -0,0 +1,240 @@
+#include "image_prefetcher.h"
+
+#include <cstdio>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#if OPENCV_MAJOR_VERSION >= 3
+#include <opencv2/imgcodecs/imgcodecs.hpp>
+#else
+#include <opencv2/highgui/highgui.hpp>
+#endif
+
+namespace {
+
+const size_t STDIN_CHUNK = 64 * 1024;
+
+bool isJpeg(const unsigned char* data, size_t length)
+{
+  return length >= 3 && data[0] == 0xFF && data[1] == 0xD8 && data[2] == 0xFF;
+}
+
+ImagePrefetcher::Item::Status decodeBytes(const unsigned char* data, size_t length, cv::Mat& frame, std::vector<unsigned char>* jpegBytes)
+{
+  if (length == 0)
+    return ImagePrefetcher::Item::DECODE_FAILED;
+
+  if (jpegBytes != NULL && isJpeg(data, length))
+  {
+    jpegBytes->assign(data, data + length);
+    return ImagePrefetcher::Item::OK;
+  }
+
+  // Wraps the bytes where they are; imdecode only reads them
+  cv::Mat encoded(1, static_cast<int>(length), CV_8UC1, const_cast<unsigned char*>(data));
+  frame = cv::imdecode(encoded, cv::IMREAD_COLOR);
+  return frame.empty() ? ImagePrefetcher::Item::DECODE_FAILED : ImagePrefetcher::Item::OK;
+}
+
+} // namespace
+
+ImagePrefetcher::ImagePrefetcher(int decodeThreads, int capacity, bool keepJpegBytes)
+  : decodeThreads_(decodeThreads < 0 ? 0 : decodeThreads), capacity_(capacity < 1 ? 1 : capacity),
+    keepJpegBytes_(keepJpegBytes)
+{
+}
+
+ImagePrefetcher::~ImagePrefetcher()
+{
+  mtx_.lock();
+  stopping_ = true;
+  spaceAvailable_.notify_all();
+  jobsAvailable_.notify_all();
+  itemReady_.notify_all();
+  mtx_.unlock();
+
+  if (reader_ != nullptr)
+  {
+    reader_->join();
+    delete reader_;
+  }
+  for (size_t i = 0; i < decoders_.size(); i++)
+  {
+    decoders_[i]->join();
+    delete decoders_[i];
+  }
+}
+
+void ImagePrefetcher::start(const std::vector<std::string>& paths)
+{
+  paths_ = paths;
+  launch();
+}
+
+void ImagePrefetcher::start(std::istream& input)
+{
+  input_ = &input;
+  launch();
+}
+
+void ImagePrefetcher::launch()
+{
+  if (decodeThreads_ == 0)
+    return;
+
+  reader_ = new tthread::thread(readerThread, (void*) this);
+  for (int i = 0; i < decodeThreads_; i++)
+    decoders_.push_back(new tthread::thread(decodeThread, (void*) this));
+}
+
+bool ImagePrefetcher::nextPath(std::string& path)
+{
+  if (input_ != nullptr)
+    return static_cast<bool>(std::getline(*input_, path));
+
+  if (nextPath_ >= paths_.size())
+    return false;
+  path = paths_[nextPath_++];
+  return true;
+}
+
+bool ImagePrefetcher::next(Item& item)
+{
+  if (decodeThreads_ == 0)
+  {
+    if (!nextPath(item.path))
+      return false;
+    item.status = readImage(item.path, item.frame, keepJpegBytes_ ? &item.jpegBytes : NULL);
+    return true;
+  }
+
+  tthread::lock_guard<tthread::mutex> guard(mtx_);
+  while (finished_.count(returned_) == 0 && !(sourceDone_ && returned_ == assigned_))
+    itemReady_.wait(mtx_);
+
+  std::map<size_t, Item>::iterator it = finished_.find(returned_);
+  if (it == finished_.end())
+    return false;
+
+  item = it->second;
+  finished_.erase(it);
+  returned_++;
+  spaceAvailable_.notify_one();
+  return true;
+}
+
+void ImagePrefetcher::readerThread(void* arg)
+{
+  ((ImagePrefetcher*) arg)->readPaths();
+}
+
+void ImagePrefetcher::decodeThread(void* arg)
+{
+  ((ImagePrefetcher*) arg)->decodeJobs();
+}
+
+void ImagePrefetcher::readPaths()
+{
+  while (true)
+  {
+    // Only this thread touches the path source, so it is read outside the lock
+    std::string path;
+    bool more = nextPath(path);
+
+    tthread::lock_guard<tthread::mutex> guard(mtx_);
+    while (more && !stopping_ && assigned_ - returned_ >= (size_t) capacity_)
+      spaceAvailable_.wait(mtx_);
+
+    if (!more || stopping_)
+    {
+      sourceDone_ = true;
+      jobsAvailable_.notify_all();
+      itemReady_.notify_all();
+      return;
+    }
+
+    Job job;
+    job.seq = assigned_++;
+    job.path = path;
+    jobs_.push_back(job);
+    jobsAvailable_.notify_one();
+  }
+}
+
+void ImagePrefetcher::decodeJobs()
+{
+  mtx_.lock();
+  while (true)
+  {
+    while (jobs_.empty() && !sourceDone_ && !stopping_)
+      jobsAvailable_.wait(mtx_);
+    if (jobs_.empty() || stopping_)
+      break;
+
+    Job job = jobs_.front();
+    jobs_.pop_front();
+    mtx_.unlock();
+
+    Item item;
+    item.path = job.path;
+    item.status = readImage(job.path, item.frame, keepJpegBytes_ ? &item.jpegBytes : NULL);
+
+    mtx_.lock();
+    finished_[job.seq] = item;
+    itemReady_.notify_all();
+  }
+  mtx_.unlock();
+}
+
+ImagePrefetcher::Item::Status ImagePrefetcher::readImage(const std::string& path, cv::Mat& frame, std::vector<unsigned char>* jpegBytes)
+{
+  frame.release();
+  if (jpegBytes != NULL)
+    jpegBytes->clear();
+
+  if (path == "-")
+  {
+    std::vector<unsigned char> data;
+    size_t total = 0;
+    while (true)
+    {
+      data.resize(total + STDIN_CHUNK);
+      size_t got = fread(&data[total], 1, STDIN_CHUNK, stdin);
+      total += got;
+      if (got < STDIN_CHUNK)
+        break;
+    }
+
+    return decodeBytes(data.data(), total, frame, jpegBytes);
+  }
+
+  int fd = ::open(path.c_str(), O_RDONLY);
+  if (fd < 0)
+    return Item::NOT_FOUND;
+
+  struct stat st;
+  if (::fstat(fd, &st) != 0 || !S_ISREG(st.st_mode))
+  {
+    ::close(fd);
+    return Item::NOT_FOUND;
+  }
+
+  // Decoding straight out of the page cache saves copying the file into a buffer first
+  Item::Status status = Item::DECODE_FAILED;
+  size_t length = static_cast<size_t>(st.st_size);
+  if (length > 0)
+  {
+    void* mapping = ::mmap(NULL, length, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (mapping != MAP_FAILED)
+    {
+      ::madvise(mapping, length, MADV_SEQUENTIAL);
+      status = decodeBytes(static_cast<const unsigned char*>(mapping), length, frame, jpegBytes);
+      ::munmap(mapping, length);
+    }
+  }
+  ::close(fd);
+
+  return status;
+}
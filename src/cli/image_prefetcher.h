@@ -0,0 +1,96 @@
+/*
+ * Reads and decodes images ahead of the recognizer for the CLI's directory
+ * and stdin path-list modes.  A reader thread hands paths to a few decode
+ * threads; decoded frames come back out of next() in input order, and at
+ * most `capacity` of them are held at once.
+ */
+
+#pragma once
+
+#include <deque>
+#include <istream>
+#include <map>
+#include <string>
+#include <vector>
+#include <opencv2/core/core.hpp>
+
+#include "support/tinythread.h"
+
+class ImagePrefetcher
+{
+public:
+  struct Item
+  {
+    enum Status
+    {
+      OK,
+      NOT_FOUND,
+      DECODE_FAILED
+    };
+
+    std::string path;
+    Status status;
+    cv::Mat frame;
+    // A JPEG's encoded bytes, when the prefetcher keeps them.  frame is then left
+    // empty for the library to decode (at reduced size, with reduced_decode).
+    std::vector<unsigned char> jpegBytes;
+  };
+
+  // With zero decode threads nothing runs in the background; next() reads and
+  // decodes each image itself.  With keepJpegBytes, JPEGs are read but not decoded.
+  ImagePrefetcher(int decodeThreads, int capacity, bool keepJpegBytes = false);
+  ~ImagePrefetcher();
+
+  // Decode these files, in this order
+  void start(const std::vector<std::string>& paths);
+  // Decode the files named by each line of input, until it ends
+  void start(std::istream& input);
+
+  // Blocks until the next image in input order is ready.  Returns false once
+  // every image has been returned.
+  bool next(Item& item);
+
+  // Reads a whole file (or stdin, if path is "-") and decodes it as a color image.
+  // If jpegBytes is given and the file is a JPEG, its bytes go there instead and
+  // frame is left empty.
+  static Item::Status readImage(const std::string& path, cv::Mat& frame, std::vector<unsigned char>* jpegBytes = NULL);
+
+private:
+  struct Job
+  {
+    size_t seq;
+    std::string path;
+  };
+
+  int decodeThreads_;
+  int capacity_;
+  bool keepJpegBytes_;
+
+  std::vector<std::string> paths_;
+  std::istream* input_ = nullptr;
+  size_t nextPath_ = 0;
+
+  tthread::mutex mtx_;
+  tthread::condition_variable spaceAvailable_;
+  tthread::condition_variable jobsAvailable_;
+  tthread::condition_variable itemReady_;
+
+  std::deque<Job> jobs_;
+  std::map<size_t, Item> finished_;
+  // Paths handed out so far, and how many of them next() has returned
+  size_t assigned_ = 0;
+  size_t returned_ = 0;
+  bool sourceDone_ = false;
+  bool stopping_ = false;
+
+  tthread::thread* reader_ = nullptr;
+  std::vector<tthread::thread*> decoders_;
+
+  void launch();
+  bool nextPath(std::string& path);
+
+  static void readerThread(void* arg);
+  static void decodeThread(void* arg);
+  void readPaths();
+  void decodeJobs();
+};
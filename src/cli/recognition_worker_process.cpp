@@ -5,14 +5,31 @@
 #include <sys/types.h>
 #include <fcntl.h>
 #include <signal.h>
+#include <errno.h>
+#include <string.h>
 
-#include <opencv2/imgcodecs/imgcodecs.hpp>
 
 #include "alpr.h"
+#include "binary_results.h"
 #include "config.h"
+#include "image_prefetcher.h"
 
 namespace {
 
+// Every message in either direction: this header, then `length` bytes.  Jobs carry
+// the image path; results carry binary-encoded AlprResults, or nothing if the image
+// could not be read.
+struct FrameHeader
+{
+  uint32_t jobId;
+  uint32_t length;
+};
+
+const uint32_t QUIT_JOB_ID = 0xFFFFFFFF;
+
+// Large enough that a read usually picks up every result that is waiting
+const size_t READ_CHUNK = 64 * 1024;
+
 // Write the full buffer, handling partial writes.
 bool writeAll(int fd, const void* buf, size_t len)
 {
@@ -21,24 +38,63 @@ bool writeAll(int fd, const void* buf, size_t len)
   while (written < len)
   {
     ssize_t w = ::write(fd, cbuf + written, len - written);
+    if (w < 0 && errno == EINTR) continue;
     if (w <= 0) return false;
     written += static_cast<size_t>(w);
   }
   return true;
 }
 
-// Reads a single line (delimited by '\n') from fd.
-bool readLine(int fd, std::string& out)
+void appendFrame(std::string& out, uint32_t jobId, const char* data, size_t length)
 {
-  out.clear();
-  char ch;
-  while (true)
+  FrameHeader header;
+  header.jobId = jobId;
+  header.length = static_cast<uint32_t>(length);
+  out.append(reinterpret_cast<const char*>(&header), sizeof(header));
+  out.append(data, length);
+}
+
+// Appends one read() worth of data to buf.  Returns false on EOF or error.
+bool fillBuffer(int fd, std::string& buf)
+{
+  char chunk[READ_CHUNK];
+  ssize_t r;
+  do
   {
-    ssize_t r = ::read(fd, &ch, 1);
-    if (r == 0) return false;      // EOF
-    if (r < 0) return false;       // error
-    if (ch == '\n') break;
-    out.push_back(ch);
+    r = ::read(fd, chunk, READ_CHUNK);
+  } while (r < 0 && errno == EINTR);
+
+  if (r <= 0)
+    return false;
+  buf.append(chunk, r);
+  return true;
+}
+
+// Takes the next complete frame starting at buf[start], if there is one
+bool takeFrame(std::string& buf, size_t& start, uint32_t& jobId, std::string& payload)
+{
+  if (buf.size() - start < sizeof(FrameHeader))
+    return false;
+
+  FrameHeader header;
+  memcpy(&header, buf.data() + start, sizeof(header));
+  if (buf.size() - start - sizeof(header) < header.length)
+    return false;
+
+  jobId = header.jobId;
+  payload.assign(buf, start + sizeof(header), header.length);
+  start += sizeof(header) + header.length;
+
+  // Drop consumed frames once they make up most of the buffer
+  if (start == buf.size())
+  {
+    buf.clear();
+    start = 0;
+  }
+  else if (start > buf.size() / 2)
+  {
+    buf.erase(0, start);
+    start = 0;
   }
   return true;
 }
@@ -46,7 +102,7 @@ bool readLine(int fd, std::string& out)
 } // namespace
 
 RecognitionWorkerProcess::RecognitionWorkerProcess(const Params& params)
-  : params_(params), childPid_(0), writeFd_(-1), readFd_(-1)
+  : params_(params), childPid_(0), writeFd_(-1), readFd_(-1), incomingStart_(0)
 {
 }
 
@@ -79,85 +135,121 @@ bool RecognitionWorkerProcess::start()
     // Child
     ::close(toChild[1]);
     ::close(fromChild[0]);
+    runWorker(toChild[0], fromChild[1]);
+    _exit(0);
+  }
 
-    int readFd = toChild[0];
-    int writeFd = fromChild[1];
+  // Parent
+  ::close(toChild[0]);
+  ::close(fromChild[1]);
+  writeFd_ = toChild[1];
+  readFd_ = fromChild[0];
+  return true;
+}
 
-    alpr::Alpr alpr(params_.country, params_.configFile);
-    alpr.setTopN(params_.topn);
-    if (params_.detectRegion) alpr.setDetectRegion(true);
-    if (!params_.templatePattern.empty()) alpr.setDefaultRegion(params_.templatePattern);
-    if (params_.debug) alpr.getConfig()->setDebug(true);
+void RecognitionWorkerProcess::runWorker(int readFd, int writeFd)
+{
+  alpr::Alpr* instance = params_.preloaded;
+  if (instance != nullptr)
+  {
+    instance->afterFork();
+  }
+  else
+  {
+    instance = new alpr::Alpr(params_.country, params_.configFile);
+    instance->setTopN(params_.topn);
+    if (params_.detectRegion) instance->setDetectRegion(true);
+    if (!params_.templatePattern.empty()) instance->setDefaultRegion(params_.templatePattern);
+    if (params_.debug) instance->getConfig()->setDebug(true);
+  }
+  // Left for _exit() to reclaim
+  alpr::Alpr& alpr = *instance;
 
-    while (true)
+  std::string incoming;
+  size_t incomingStart = 0;
+  std::string encoded;
+  std::string reply;
+  // As in the CLI, JPEGs stay encoded for the library's reduced decode
+  bool keepJpegBytes = alpr.getConfig()->reducedDecode;
+  std::vector<unsigned char> jpegBytes;
+  while (true)
+  {
+    uint32_t jobId;
+    std::string path;
+    if (!takeFrame(incoming, incomingStart, jobId, path))
     {
-      std::string path;
-      if (!readLine(readFd, path))
-      {
-        break;
-      }
-      if (path == "__quit")
-      {
+      if (!fillBuffer(readFd, incoming))
         break;
-      }
-
-      cv::Mat frame = cv::imread(path);
-      if (frame.empty())
-      {
-        std::string msg = path + "\t{}\n";
-        writeAll(writeFd, msg.data(), msg.size());
-        continue;
-      }
+      continue;
+    }
+    if (jobId == QUIT_JOB_ID)
+      break;
 
+    reply.clear();
+    cv::Mat frame;
+    if (ImagePrefetcher::readImage(path, frame, keepJpegBytes ? &jpegBytes : NULL) != ImagePrefetcher::Item::OK)
+    {
+      appendFrame(reply, jobId, "", 0);
+    }
+    else if (!jpegBytes.empty())
+    {
+      alpr::AlprResults results = alpr.recognize(jpegBytes.data(), jpegBytes.size(), std::vector<alpr::AlprRegionOfInterest>());
+      alpr::writeBinaryResults(results, encoded);
+      appendFrame(reply, jobId, encoded.data(), encoded.size());
+    }
+    else
+    {
       std::vector<alpr::AlprRegionOfInterest> rois;
       rois.push_back(alpr::AlprRegionOfInterest(0, 0, frame.cols, frame.rows));
 
       alpr::AlprResults results = alpr.recognize(frame.data, frame.elemSize(), frame.cols, frame.rows, rois);
-      std::string json = alpr.toJson(results);
-
-      if (params_.measureProcessingTime && results.total_processing_time_ms > 0)
-      {
-        // Attach processing time as part of the JSON pipeline without altering schema.
-      }
-
-      std::string line = path + "\t" + json + "\n";
-      writeAll(writeFd, line.data(), line.size());
+      alpr::writeBinaryResults(results, encoded);
+      appendFrame(reply, jobId, encoded.data(), encoded.size());
     }
 
-    ::close(readFd);
-    ::close(writeFd);
-    _exit(0);
+    // Header and body go out in a single write
+    if (!writeAll(writeFd, reply.data(), reply.size()))
+      break;
   }
 
-  // Parent
-  ::close(toChild[0]);
-  ::close(fromChild[1]);
-  writeFd_ = toChild[1];
-  readFd_ = fromChild[0];
-  return true;
+  ::close(readFd);
+  ::close(writeFd);
 }
 
-bool RecognitionWorkerProcess::sendJob(const std::string& imagePath)
+void RecognitionWorkerProcess::queueJob(uint32_t jobId, const std::string& imagePath)
+{
+  appendFrame(outgoing_, jobId, imagePath.data(), imagePath.size());
+  inFlight_.push_back(jobId);
+}
+
+bool RecognitionWorkerProcess::flush()
 {
   if (writeFd_ < 0) return false;
-  std::string line = imagePath + "\n";
-  return writeAll(writeFd_, line.data(), line.size());
+  if (outgoing_.empty()) return true;
+
+  bool ok = writeAll(writeFd_, outgoing_.data(), outgoing_.size());
+  outgoing_.clear();
+  return ok;
 }
 
-bool RecognitionWorkerProcess::readResult(std::string& imagePath, std::string& jsonResult)
+bool RecognitionWorkerProcess::readResults(std::vector<Result>& results)
 {
   if (readFd_ < 0) return false;
-  std::string line;
-  if (!readLine(readFd_, line)) return false;
-  size_t tab = line.find('\t');
-  if (tab == std::string::npos)
+  if (!fillBuffer(readFd_, incoming_)) return false;
+
+  uint32_t jobId;
+  std::string payload;
+  while (takeFrame(incoming_, incomingStart_, jobId, payload))
   {
-    imagePath.clear();
-    jsonResult = "{}";
-    return true;
+    Result result;
+    result.jobId = jobId;
+    result.ok = !payload.empty() && alpr::readBinaryResults(payload.data(), payload.size(), result.results);
+    result.lost = false;
+    results.push_back(result);
+
+    if (!inFlight_.empty() && inFlight_.front() == jobId)
+      inFlight_.pop_front();
   }
-  imagePath = line.substr(0, tab);
-  jsonResult = line.substr(tab + 1);
   return true;
 }
 
@@ -167,8 +259,10 @@ void RecognitionWorkerProcess::stop()
 
   if (writeFd_ >= 0)
   {
-    std::string quit = "__quit\n";
-    writeAll(writeFd_, quit.data(), quit.size());
+    outgoing_.clear();
+    appendFrame(outgoing_, QUIT_JOB_ID, "", 0);
+    writeAll(writeFd_, outgoing_.data(), outgoing_.size());
+    outgoing_.clear();
     ::close(writeFd_);
     writeFd_ = -1;
   }
@@ -182,4 +276,3 @@ void RecognitionWorkerProcess::stop()
   waitpid(childPid_, &status, 0);
   childPid_ = 0;
 }
-
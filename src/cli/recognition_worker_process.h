@@ -1,18 +1,19 @@
 /*
  * Lightweight process-based worker used by the CLI to parallelize
  * image recognition without sharing Alpr instances across threads.
+ * Jobs and results cross the pipes as length-prefixed frames; a worker
+ * can hold several jobs at once so it never waits on the parent between them.
  */
 
 #pragma once
 
+#include <deque>
 #include <string>
 #include <vector>
+#include <stdint.h>
 #include <sys/types.h>
 
-namespace alpr
-{
-  class Alpr;
-}
+#include "alpr.h"
 
 class RecognitionWorkerProcess
 {
@@ -26,6 +27,19 @@ public:
     bool detectRegion = false;
     bool debug = false;
     bool measureProcessingTime = false;
+    // Fully loaded instance to recognize with instead of loading one after the fork.
+    // The worker gets a copy-on-write view of it.  Not owned.
+    alpr::Alpr* preloaded = nullptr;
+  };
+
+  struct Result
+  {
+    uint32_t jobId;
+    // False if the worker could not read the image
+    bool ok;
+    // True if the worker exited before answering, so the image was never processed
+    bool lost;
+    alpr::AlprResults results;
   };
 
   explicit RecognitionWorkerProcess(const Params& params);
@@ -34,11 +48,16 @@ public:
   // Forks the worker process and initializes IPC pipes.
   bool start();
 
-  // Sends a single image path to the worker. Returns false on IPC error.
-  bool sendJob(const std::string& imagePath);
+  // Queues an image path for the worker.  Nothing is written until flush().
+  void queueJob(uint32_t jobId, const std::string& imagePath);
+
+  // Writes every queued job in one go. Returns false on IPC error.
+  bool flush();
 
-  // Reads one result from the worker. Returns false on EOF or error.
-  bool readResult(std::string& imagePath, std::string& jsonResult);
+  // Reads whatever the worker has sent and appends the complete results, oldest first.
+  // Blocks until at least some data arrives; poll readFd() first to avoid that.
+  // Returns false on EOF or error.
+  bool readResults(std::vector<Result>& results);
 
   // Gracefully stops the worker (sends quit signal and waits).
   void stop();
@@ -46,10 +65,20 @@ public:
   bool isRunning() const { return childPid_ > 0; }
   int readFd() const { return readFd_; }
 
+  // Jobs sent or queued whose results have not been read yet, oldest first.
+  // The worker handles its jobs in order.
+  const std::deque<uint32_t>& jobsInFlight() const { return inFlight_; }
+
 private:
   Params params_;
   pid_t childPid_;
   int writeFd_; // parent -> child
   int readFd_;  // child -> parent
-};
 
+  std::string outgoing_;
+  std::string incoming_;
+  size_t incomingStart_;
+  std::deque<uint32_t> inFlight_;
+
+  void runWorker(int readFd, int writeFd);
+};
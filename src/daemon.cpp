@@ -2,6 +2,8 @@
 
 #include <unistd.h>
 #include <sstream>
+#include <fstream>
+#include <cstdio>
 #include <execinfo.h>
 
 #include "daemon/beanstalk.hpp"
@@ -11,10 +13,12 @@
 
 #include "tclap/CmdLine.h"
 #include "alpr.h"
+#include "config.h"
+#include "motiondetector.h"
 #include "openalpr/cjson.h"
 #include "support/tinythread.h"
 #include "daemon/process_worker_pool.h"
-#include <curl/curl.h>
+#include "daemon/result_publisher.h"
 #include "support/timing.h"
 
 #include <log4cplus/logger.h>
@@ -26,13 +30,20 @@
 using namespace alpr;
 
 // Variables
-SafeQueue<cv::Mat> framesQueue;
+// One per stream process, shared by all of its recognition threads
+ResultPublisher* resultPublisher = NULL;
+
+// With process workers the recognitions, and their stage stats, live in the workers.
+// The stream thread copies the pool's combined stats here for writeMetricsFile.
+bool usingProcessWorkers = false;
+std::vector<AlprStageStats> processWorkerStats;
+tthread::mutex processWorkerStatsMutex;
 
 // Prototypes
 void streamRecognitionThread(void* arg);
-bool writeToQueue(std::string jsonResult);
-bool uploadPost(CURL* curl, std::string url, std::string data);
-void dataUploadThread(void* arg);
+void writeToQueue(const std::string& jsonResult);
+void writeMetricsFile(const std::string& metricsDir, int cameraId);
+void logResultMessage(ResultLogLevel level, const std::string& message);
 
 // Constants
 const std::string ALPRD_CONFIG_FILE_NAME="alprd.conf";
@@ -44,6 +55,13 @@ const int BEANSTALK_PORT=11300;
 const std::string BEANSTALK_TUBE_NAME="alprd";
 
 
+// A frame waiting for an analysis thread, and the parts of it to search
+struct QueuedFrame
+{
+  cv::Mat frame;
+  std::vector<AlprRegionOfInterest> regionsOfInterest;
+};
+
 struct CaptureThreadData
 {
   std::string company_id;
@@ -52,6 +70,9 @@ struct CaptureThreadData
   int camera_id;
   int analysis_threads;
   int process_workers;
+  bool prefork_workers;
+  int frame_queue_depth;
+  bool frame_queue_drop_newest;
   
   bool clock_on;
   
@@ -61,11 +82,14 @@ struct CaptureThreadData
   bool output_images;
   std::string output_image_folder;
   int top_n;
-};
-
-struct UploadThreadData
-{
-  std::string upload_url;
+  bool plate_tracking;
+  bool motion_detection;
+  // How often stage stats are gathered for the metrics file; 0 when it is not written
+  int metrics_interval_ms;
+
+  // Shared by every processing thread of this stream
+  AlprEngine* engine;
+  SafeQueue<QueuedFrame>* frames;
 };
 
 void segfault_handler(int sig) {
@@ -87,12 +111,15 @@ static log4cplus::Logger logger;
 int main( int argc, const char** argv )
 {
   signal(SIGSEGV, segfault_handler);   // install our segfault handler
+  // Writes to a beanstalkd or HTTP peer that went away must fail, not kill the process
+  signal(SIGPIPE, SIG_IGN);
   daemon_active = true;
 
   bool noDaemon = false;
   bool clockOn = false;
   std::string logFile;
   int process_workers = 0;
+  bool preforkWorkers = false;
   
   std::string configDir;
 
@@ -104,6 +131,7 @@ int main( int argc, const char** argv )
 
   TCLAP::SwitchArg daemonOffSwitch("f","foreground","Set this flag for debugging.  Disables forking the process as a daemon and runs in the foreground.  Default=off", cmd, false);
   TCLAP::SwitchArg clockSwitch("","clock","Display timing information to log.  Default=off", cmd, false);
+  TCLAP::SwitchArg preforkSwitch("","prefork","Load OpenALPR once per stream and fork the --proc-workers from it, sharing its memory.  Default=off", cmd, false);
 
   try
   {
@@ -128,6 +156,7 @@ int main( int argc, const char** argv )
     noDaemon = daemonOffSwitch.getValue();
     clockOn = clockSwitch.getValue();
     process_workers = processWorkersArg.getValue();
+    preforkWorkers = preforkSwitch.getValue();
   }
   catch (TCLAP::ArgException &e)    // catch any exceptions
   {
@@ -195,6 +224,8 @@ int main( int argc, const char** argv )
   pid_t pid;
   
   std::vector<tthread::thread*> threads;
+  ResultUploader* uploader = NULL;
+  int cameraId = 0;
 
   for (int i = 0; i < daemon_config.stream_urls.size(); i++)
   {
@@ -205,6 +236,7 @@ int main( int argc, const char** argv )
       CaptureThreadData* tdata = new CaptureThreadData();
       tdata->stream_url = daemon_config.stream_urls[i];
       tdata->camera_id = i + 1;
+      cameraId = tdata->camera_id;
       tdata->config_file = openAlprConfigFile;
       tdata->output_images = daemon_config.storePlates;
       tdata->output_image_folder = daemon_config.imageFolder;
@@ -212,10 +244,30 @@ int main( int argc, const char** argv )
       tdata->company_id = daemon_config.company_id;
       tdata->site_id = daemon_config.site_id;
       tdata->analysis_threads = daemon_config.analysis_threads;
+      tdata->frame_queue_depth = daemon_config.frame_queue_depth > 0 ? daemon_config.frame_queue_depth : daemon_config.analysis_threads;
+      tdata->frame_queue_drop_newest = (daemon_config.frame_queue_drop == "newest");
       tdata->process_workers = process_workers;
+      tdata->prefork_workers = preforkWorkers;
       tdata->top_n = daemon_config.topn;
+      tdata->plate_tracking = daemon_config.trackPlates(process_workers > 0 ? process_workers : daemon_config.analysis_threads);
+      if (daemon_config.plate_tracking_auto && !tdata->plate_tracking)
+        LOG4CPLUS_INFO(logger, "Plate tracking is off: several analysis threads or workers share each stream (set plate_tracking = 1 to track anyway)");
+      tdata->motion_detection = daemon_config.motion_detection;
+      tdata->metrics_interval_ms = daemon_config.metrics_dir.length() > 0 ? daemon_config.metrics_interval_seconds * 1000 : 0;
+      tdata->engine = NULL;
+      tdata->frames = NULL;
       tdata->pattern = daemon_config.pattern;
       tdata->clock_on = clockOn;
+
+      ResultPublisherParams publisherParams;
+      publisherParams.host = BEANSTALK_QUEUE_HOST;
+      publisherParams.port = BEANSTALK_PORT;
+      publisherParams.tube = BEANSTALK_TUBE_NAME;
+      publisherParams.batchSize = daemon_config.queue_batch_size;
+      publisherParams.maxPending = daemon_config.queue_max_pending;
+      publisherParams.log = logResultMessage;
+      resultPublisher = new ResultPublisher(publisherParams);
+      resultPublisher->start();
       
       tthread::thread* thread_recognize = new tthread::thread(streamRecognitionThread, (void*) tdata);
       threads.push_back(thread_recognize);
@@ -223,11 +275,15 @@ int main( int argc, const char** argv )
       if (daemon_config.uploadData)
       {
         // Kick off the data upload thread
-	      UploadThreadData* udata = new UploadThreadData();
-        udata->upload_url = daemon_config.upload_url;
-        tthread::thread* thread_upload = new tthread::thread(dataUploadThread, (void*) udata );
-
-        threads.push_back(thread_upload);
+        ResultUploaderParams uploaderParams;
+        uploaderParams.host = BEANSTALK_QUEUE_HOST;
+        uploaderParams.port = BEANSTALK_PORT;
+        uploaderParams.tube = BEANSTALK_TUBE_NAME;
+        uploaderParams.url = daemon_config.upload_url;
+        uploaderParams.batchSize = daemon_config.upload_batch_size;
+        uploaderParams.log = logResultMessage;
+        uploader = new ResultUploader(uploaderParams);
+        uploader->start();
       }
       
       break;
@@ -235,11 +291,37 @@ int main( int argc, const char** argv )
     // Parent process will continue and spawn more children
   }
 
+  uint64_t droppedResults = 0;
+  int64_t lastStatsCheck = getEpochTimeMs();
+  int64_t lastMetricsWrite = getEpochTimeMs();
   while (daemon_active)
+  {
     alpr::sleep_ms(30);
 
+    if (cameraId > 0 && daemon_config.metrics_dir.length() > 0 &&
+        getEpochTimeMs() - lastMetricsWrite >= daemon_config.metrics_interval_seconds * 1000)
+    {
+      lastMetricsWrite = getEpochTimeMs();
+      writeMetricsFile(daemon_config.metrics_dir, cameraId);
+    }
+
+    if (resultPublisher != NULL && getEpochTimeMs() - lastStatsCheck >= 1000)
+    {
+      lastStatsCheck = getEpochTimeMs();
+      ResultPublisher::Stats stats = resultPublisher->stats();
+      if (stats.dropped > droppedResults)
+      {
+        LOG4CPLUS_WARN(logger, "Beanstalk unavailable: " << (stats.dropped - droppedResults) << " results dropped (" << stats.published << " published in " << stats.jobsPut << " jobs over " << stats.connects << " connections)");
+        droppedResults = stats.dropped;
+      }
+    }
+  }
+
   for (uint16_t i = 0; i < threads.size(); i++)
     delete threads[i];
+
+  delete uploader;
+  delete resultPublisher;
   
   return 0;
 }
@@ -248,23 +330,26 @@ int main( int argc, const char** argv )
 void processingThread(void* arg)
 {
   CaptureThreadData* tdata = (CaptureThreadData*) arg;
-  Alpr alpr(tdata->country_code, tdata->config_file);
-  alpr.setTopN(tdata->top_n);
-  alpr.setDefaultRegion(tdata->pattern);
 
-  while (daemon_active) {
+  // The detectors and config live in the shared engine; the context holds this
+  // thread's OCR instances and options
+  RecognitionContext context;
+  context.topN = tdata->top_n;
+  context.defaultRegion = tdata->pattern;
+  context.trackPlates = tdata->plate_tracking;
 
-    // Wait for a new frame
-    cv::Mat frame = framesQueue.pop();
+  // Blocks until a frame is queued; ends when the stream closes the queue
+  QueuedFrame queued;
+  while (tdata->frames->pop(queued)) {
+    cv::Mat& frame = queued.frame;
 
     // Process new frame
     timespec startTime;
     getTimeMonotonic(&startTime);
 
-    std::vector<AlprRegionOfInterest> regionsOfInterest;
-    regionsOfInterest.push_back(AlprRegionOfInterest(0,0, frame.cols, frame.rows));
+    const std::vector<AlprRegionOfInterest>& regionsOfInterest = queued.regionsOfInterest;
 
-    AlprResults results = alpr.recognize(frame.data, frame.elemSize(), frame.cols, frame.rows, regionsOfInterest);
+    AlprResults results = tdata->engine->recognize(context, frame.data, frame.elemSize(), frame.cols, frame.rows, regionsOfInterest);
 
     timespec endTime;
     getTimeMonotonic(&endTime);
@@ -288,7 +373,7 @@ void processingThread(void* arg)
       }
 
       // Update the JSON content to include UUID and camera ID
-      std::string json = alpr.toJson(results);
+      std::string json = Alpr::toJson(results);
       cJSON *root = cJSON_Parse(json.c_str());
       cJSON_AddStringToObject(root,	"uuid",		uuid.c_str());
       cJSON_AddNumberToObject(root,	"camera_id",	tdata->camera_id);
@@ -316,11 +401,56 @@ void processingThread(void* arg)
 
       writeToQueue(response);
     }
-    usleep(10000);
   }
 }
 
 
+struct StreamLogState
+{
+  int64_t lastLogTime;
+  int64_t lastSkipped;
+  uint64_t lastQueueDrops;
+};
+
+// Reports how many captured frames were superseded before the stream loop picked them
+// up and, in threaded mode, the analysis queue's depth and drops.  Every 10 seconds with
+// --clock, otherwise once a minute when the analysis queue had to drop frames.
+void logStreamStats(CaptureThreadData* tdata, VideoBuffer& videoBuffer, SafeQueue<QueuedFrame>* queue, StreamLogState& state)
+{
+  int64_t now = getEpochTimeMs();
+  int64_t elapsed = now - state.lastLogTime;
+  if (elapsed < (tdata->clock_on ? 10000 : 60000))
+    return;
+
+  int64_t skipped = videoBuffer.getDroppedFrameCount();
+  uint64_t queueDrops = queue != NULL ? queue->dropped() : 0;
+
+  if (tdata->clock_on || queueDrops > state.lastQueueDrops)
+  {
+    std::stringstream ss;
+    ss << "Camera " << tdata->camera_id << " in the last " << elapsed / 1000 << " s: " << (skipped - state.lastSkipped) << " captured frames skipped";
+    if (queue != NULL)
+      ss << ", analysis queue at " << queue->size() << "/" << queue->capacity() << " with " << (queueDrops - state.lastQueueDrops) << " frames dropped";
+    LOG4CPLUS_INFO(logger, ss.str());
+  }
+
+  state.lastLogTime = now;
+  state.lastSkipped = skipped;
+  state.lastQueueDrops = queueDrops;
+}
+
+// Where to look for plates in a frame: with motion detection, the areas that moved
+// (none if nothing did); otherwise the whole frame
+std::vector<AlprRegionOfInterest> frameRegions(MotionDetector* motion, const cv::Mat& frame)
+{
+  if (motion != NULL)
+    return MotionDetector::toRegionsOfInterest(motion->detect(frame));
+
+  std::vector<AlprRegionOfInterest> regions;
+  regions.push_back(AlprRegionOfInterest(0, 0, frame.cols, frame.rows));
+  return regions;
+}
+
 void streamRecognitionThread(void* arg)
 {
   CaptureThreadData* tdata = (CaptureThreadData*) arg;
@@ -338,7 +468,11 @@ void streamRecognitionThread(void* arg)
     params.topn = tdata->top_n;
     params.detectRegion = false;
     params.debug = false;
+    params.prefork = tdata->prefork_workers;
+    params.trackPlates = tdata->plate_tracking;
+    params.statsIntervalMs = tdata->metrics_interval_ms;
 
+    int64_t poolStartTime = getEpochTimeMs();
     ProcessWorkerPool pool(params, tdata->process_workers);
     if (!pool.start())
     {
@@ -346,24 +480,42 @@ void streamRecognitionThread(void* arg)
       delete tdata;
       return;
     }
+    usingProcessWorkers = true;
+    LOG4CPLUS_INFO(logger, "Camera " << tdata->camera_id << " started " << tdata->process_workers << " process workers" << (params.prefork ? " (prefork)" : "") << " in " << (getEpochTimeMs() - poolStartTime) << " ms.");
+
+    // The workers hold the engine, so the motion settings are read from a config of our own
+    Config* motionConfig = NULL;
+    MotionDetector* motion = NULL;
+    if (tdata->motion_detection)
+    {
+      motionConfig = new Config(tdata->country_code, tdata->config_file);
+      motion = new MotionDetector(motionConfig);
+    }
 
     cv::Mat frame;
     LoggingVideoBuffer videoBuffer(logger);
     videoBuffer.connect(tdata->stream_url, 5);
     LOG4CPLUS_INFO(logger, "Starting camera (process pool) " << tdata->camera_id);
 
+    StreamLogState logState = { getEpochTimeMs(), 0, 0 };
     while (daemon_active)
     {
       std::vector<cv::Rect> regionsOfInterest;
       int response = videoBuffer.getLatestFrame(&frame, regionsOfInterest);
+      logStreamStats(tdata, videoBuffer, NULL, logState);
 
+      // Frames without motion have nothing new to read
+      std::vector<AlprRegionOfInterest> frameRois;
       if (response != -1)
+        frameRois = frameRegions(motion, frame);
+
+      if (!frameRois.empty())
       {
         std::stringstream uuid_ss;
         uuid_ss << tdata->site_id << "-cam" << tdata->camera_id << "-" << getEpochTimeMs();
         std::string uuid = uuid_ss.str();
 
-        if (!pool.dispatch(frame, uuid))
+        if (!pool.dispatch(frame, uuid, frameRois))
         {
           // Pool busy; drop frame to avoid backlog
           usleep(5000);
@@ -371,11 +523,17 @@ void streamRecognitionThread(void* arg)
       }
 
       std::vector<ProcessWorkerPool::CompletedJob> completed = pool.poll(0);
+      if (!completed.empty())
+      {
+        tthread::lock_guard<tthread::mutex> guard(processWorkerStatsMutex);
+        processWorkerStats = pool.stageStats();
+      }
+
       for (size_t i = 0; i < completed.size(); i++)
       {
-        if (completed[i].json.size() == 0)
+        if (!completed[i].ok)
           continue;
-        AlprResults results = Alpr::fromJson(completed[i].json);
+        const AlprResults& results = completed[i].results;
         if (results.plates.size() == 0)
           continue;
 
@@ -390,7 +548,9 @@ void streamRecognitionThread(void* arg)
           cv::imwrite(ss.str(), completed[i].frame);
         }
 
-        cJSON *root = cJSON_Parse(completed[i].json.c_str());
+        // Only frames with plates are serialized to JSON
+        std::string json = Alpr::toJson(results);
+        cJSON *root = cJSON_Parse(json.c_str());
         cJSON_AddStringToObject(root,	"uuid",		completed[i].jobId.c_str());
         cJSON_AddNumberToObject(root,	"camera_id",	tdata->camera_id);
         cJSON_AddStringToObject(root, 	"site_id", 	tdata->site_id.c_str());
@@ -414,13 +574,24 @@ void streamRecognitionThread(void* arg)
     }
 
     pool.stop();
+    LOG4CPLUS_INFO(logger, "Video processing ended (" << videoBuffer.getDroppedFrameCount() << " frames skipped by the capture handoff)");
     videoBuffer.disconnect();
-    LOG4CPLUS_INFO(logger, "Video processing ended");
+    delete motion;
+    delete motionConfig;
     delete tdata;
   }
   else
   {
   /* Create processing threads */
+  AlprEngine engine(tdata->country_code, tdata->config_file);
+  tdata->engine = &engine;
+
+  // Holds up to frame_queue_depth frames waiting for a free analysis thread
+  SafeQueue<QueuedFrame> framesQueue(tdata->frame_queue_depth,
+                                     tdata->frame_queue_drop_newest ? SafeQueue<QueuedFrame>::DROP_NEWEST : SafeQueue<QueuedFrame>::DROP_OLDEST);
+  tdata->frames = &framesQueue;
+  LOG4CPLUS_INFO(logger, "Analysis queue depth " << framesQueue.capacity() << ", dropping the " << (tdata->frame_queue_drop_newest ? "newest" : "oldest") << " frame when full");
+
   const int num_threads = tdata->analysis_threads;
   tthread::thread* threads[num_threads];
 
@@ -430,164 +601,108 @@ void streamRecognitionThread(void* arg)
       threads[i] = t;
   }
   
+  // Runs here rather than in the analysis threads so it sees every frame, in order
+  MotionDetector* motion = tdata->motion_detection ? new MotionDetector(engine.getConfig()) : NULL;
+
   cv::Mat frame;
   LoggingVideoBuffer videoBuffer(logger);
   videoBuffer.connect(tdata->stream_url, 5);
   LOG4CPLUS_INFO(logger, "Starting camera " << tdata->camera_id);
   
+  StreamLogState logState = { getEpochTimeMs(), 0, 0 };
   while (daemon_active)
   {
+    // Wakes as soon as the capture thread publishes a frame
     std::vector<cv::Rect> regionsOfInterest;
-    int response = videoBuffer.getLatestFrame(&frame, regionsOfInterest);
-    
-    if (response != -1) {
-      if (framesQueue.empty()) {
-        framesQueue.push(frame.clone());
-      }
-    }
-    
-    usleep(10000);
+    int response = videoBuffer.waitForLatestFrame(&frame, regionsOfInterest);
+    if (response == -1)
+      break;
+
+    // The frame shares the video buffer's pixels, which are not reused while referenced
+    QueuedFrame queued;
+    queued.frame = frame;
+    queued.regionsOfInterest = frameRegions(motion, frame);
+
+    // Frames without motion have nothing new to read
+    if (!queued.regionsOfInterest.empty())
+      framesQueue.push(queued);
+    logStreamStats(tdata, videoBuffer, &framesQueue, logState);
   }
   
+  LOG4CPLUS_INFO(logger, "Video processing ended (" << videoBuffer.getDroppedFrameCount() << " frames skipped by the capture handoff, "
+                 << framesQueue.dropped() << " dropped by the analysis queue)");
   videoBuffer.disconnect();
-  LOG4CPLUS_INFO(logger, "Video processing ended");
-  delete tdata;
+  framesQueue.close();
   for (int i = 0; i < num_threads; i++) {
+    threads[i]->join();
     delete threads[i];
     }
+  delete motion;
+  delete tdata;
   }
 }
 
 
-bool writeToQueue(std::string jsonResult)
+void writeToQueue(const std::string& jsonResult)
 {
-  try
-  {
-    Beanstalk::Client client(BEANSTALK_QUEUE_HOST, BEANSTALK_PORT);
-    client.use(BEANSTALK_TUBE_NAME);
-
-    int id = client.put(jsonResult);
-    
-    if (id <= 0)
-    {
-      LOG4CPLUS_ERROR(logger, "Failed to write data to queue");
-      return false;
-    }
-    
-    LOG4CPLUS_DEBUG(logger, "put job id: " << id );
-
-  }
-  catch (const std::runtime_error& error)
-  {
-    LOG4CPLUS_WARN(logger, "Error connecting to Beanstalk.  Result has not been saved.");
-    return false;
-  }
-  return true;
+  // Returns immediately; the publisher keeps the connection and retries on its own thread
+  resultPublisher->publish(jsonResult);
 }
 
+// Publisher and uploader messages; they run on their own threads, which log4cplus allows
+void logResultMessage(ResultLogLevel level, const std::string& message)
+{
+  if (level == RESULT_LOG_WARN)
+    LOG4CPLUS_WARN(logger, message);
+  else
+    LOG4CPLUS_INFO(logger, message);
+}
 
-
-void dataUploadThread(void* arg)
+// Writes this stream's stage latency histograms and publisher counters as a Prometheus
+// text file (e.g., for node_exporter's textfile collector).  The file is replaced
+// atomically so a scrape never sees a partial write.
+void writeMetricsFile(const std::string& metricsDir, int cameraId)
 {
-  CURL *curl;
+  std::stringstream labels;
+  labels << "camera=\"" << cameraId << "\"";
 
-  
-  /* In windows, this will init the winsock stuff */ 
-  curl_global_init(CURL_GLOBAL_ALL);
-  
-  
-  UploadThreadData* udata = (UploadThreadData*) arg;
-  
+  std::stringstream path;
+  path << metricsDir << "/alprd_camera" << cameraId << ".prom";
+  std::string tmpPath = path.str() + ".tmp";
 
-  
-  
-  while(daemon_active)
+  std::ofstream out(tmpPath.c_str());
+  if (!out)
   {
-    try
-    {
-      /* get a curl handle */ 
-      curl = curl_easy_init();
-      Beanstalk::Client client(BEANSTALK_QUEUE_HOST, BEANSTALK_PORT);
-      
-      client.watch(BEANSTALK_TUBE_NAME);
-    
-      while (daemon_active)
-      {
-	Beanstalk::Job job;
-	
-	client.reserve(job);
-	
-	if (job.id() > 0)
-	{
-	  //LOG4CPLUS_DEBUG(logger, job.body() );
-	  if (uploadPost(curl, udata->upload_url, job.body()))
-	  {
-	    client.del(job.id());
-	    LOG4CPLUS_INFO(logger, "Job: " << job.id() << " successfully uploaded" );
-	    // Wait 10ms
-	    sleep_ms(10);
-	  }
-	  else
-	  {
-	    client.release(job);
-	    LOG4CPLUS_WARN(logger, "Job: " << job.id() << " failed to upload.  Will retry." );
-	    // Wait 2 seconds
-	    sleep_ms(2000);
-	  }
-	}
-	
-      }
-      
-      /* always cleanup */ 
-      curl_easy_cleanup(curl);
-    }
-    catch (const std::runtime_error& error)
-    {
-      LOG4CPLUS_WARN(logger, "Error connecting to Beanstalk.  Will retry." );
-    }
-    // wait 5 seconds
-    usleep(5000000);
+    LOG4CPLUS_WARN(logger, "Unable to write metrics to " << tmpPath);
+    return;
   }
-  
-  curl_global_cleanup();
-}
 
+  std::vector<AlprStageStats> stageStats;
+  if (usingProcessWorkers)
+  {
+    tthread::lock_guard<tthread::mutex> guard(processWorkerStatsMutex);
+    stageStats = processWorkerStats;
+  }
+  else
+  {
+    stageStats = Alpr::getStats();
+  }
+  out << Alpr::statsToPrometheus(stageStats, labels.str());
 
-bool uploadPost(CURL* curl, std::string url, std::string data)
-{
-  bool success = true;
-  CURLcode res;
-  struct curl_slist *headers=NULL; // init to NULL is important
-
-  /* Add the required headers */ 
-  headers = curl_slist_append(headers,  "Accept: application/json");
-  headers = curl_slist_append( headers, "Content-Type: application/json");
-  headers = curl_slist_append( headers, "charsets: utf-8");
- 
-  if(curl) {
-	/* Add the headers */
-    curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
-   
-    /* First set the URL that is about to receive our POST. This URL can
-       just as well be a https:// URL if that is what should receive the
-       data. */ 
-    curl_easy_setopt(curl, CURLOPT_URL, url.c_str());
-    /* Now specify the POST data */ 
-    //char* escaped_data = curl_easy_escape(curl, data.c_str(), data.length());
-    curl_easy_setopt(curl, CURLOPT_POSTFIELDS, data.c_str());
-    //curl_free(escaped_data);
- 
-    /* Perform the request, res will get the return code */ 
-    res = curl_easy_perform(curl);
-    /* Check for errors */ 
-    if(res != CURLE_OK)
-    {
-      success = false;
-    }
- 
+  if (resultPublisher != NULL)
+  {
+    ResultPublisher::Stats stats = resultPublisher->stats();
+    out << "# TYPE alprd_results_published_total counter\n";
+    out << "alprd_results_published_total{" << labels.str() << "} " << stats.published << "\n";
+    out << "# TYPE alprd_results_dropped_total counter\n";
+    out << "alprd_results_dropped_total{" << labels.str() << "} " << stats.dropped << "\n";
+    out << "# TYPE alprd_queue_jobs_total counter\n";
+    out << "alprd_queue_jobs_total{" << labels.str() << "} " << stats.jobsPut << "\n";
+    out << "# TYPE alprd_queue_connects_total counter\n";
+    out << "alprd_queue_connects_total{" << labels.str() << "} " << stats.connects << "\n";
   }
-  
-  return success;
+  out.close();
 
-  
+  if (std::rename(tmpPath.c_str(), path.str().c_str()) != 0)
+    LOG4CPLUS_WARN(logger, "Unable to replace metrics file " << path.str());
 }
@@ -31,7 +31,8 @@ const char *bs_status_verbose[] = {
     "Not found",
     "Deadline soon",
     "Buried",
-    "Not ignored"
+    "Not ignored",
+    "Bad format"
 };
 
 const char bs_resp_using[]          = "USING";
@@ -52,6 +53,7 @@ const char bs_resp_not_ignored[]    = "NOT_IGNORED";
 const char bs_resp_found[]          = "FOUND";
 const char bs_resp_kicked[]         = "KICKED";
 const char bs_resp_ok[]             = "OK";
+const char bs_resp_bad_format[]     = "BAD_FORMAT";
 
 const char* bs_status_text(int code) {
     unsigned int cindex = (unsigned int) abs(code);
@@ -414,6 +416,7 @@ int64_t bs_put(int fd, uint32_t priority, uint32_t delay, uint32_t ttr, char *da
     BS_RETURN_FAIL_WHEN(message, bs_resp_expected_crlf, BS_STATUS_EXPECTED_CRLF);
     BS_RETURN_FAIL_WHEN(message, bs_resp_job_too_big,   BS_STATUS_JOB_TOO_BIG);
     BS_RETURN_FAIL_WHEN(message, bs_resp_draining,      BS_STATUS_DRAINING);
+    BS_RETURN_FAIL_WHEN(message, bs_resp_bad_format,    BS_STATUS_BAD_FORMAT);
     BS_RETURN_INVALID(message);
 }
 
@@ -137,6 +137,10 @@ namespace Beanstalk {
         return (id > 0 ? id : 0);
     }
 
+    int64_t Client::try_put(const string& body, uint32_t priority, uint32_t delay, uint32_t ttr) {
+        return bs_put(handle, priority, delay, ttr, (char*)body.data(), body.size());
+    }
+
     bool Client::del(Job &job) {
         return bs_delete(handle, job.id()) == BS_STATUS_OK;
     }
@@ -24,6 +24,7 @@
 #define BS_STATUS_DEADLINE_SOON -7
 #define BS_STATUS_BURIED        -8
 #define BS_STATUS_NOT_IGNORED   -9
+#define BS_STATUS_BAD_FORMAT    -10
 
 #ifdef __cplusplus
     extern "C" {
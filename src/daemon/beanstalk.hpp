@@ -33,6 +33,8 @@ namespace Beanstalk {
             bool ignore(std::string);
             int64_t put(std::string, uint32_t priority = 0, uint32_t delay = 0, uint32_t ttr = 60);
             int64_t put(char *data, size_t bytes, uint32_t priority, uint32_t delay, uint32_t ttr);
+            // Like put(), but a failure returns bs_put's BS_STATUS_* code instead of 0
+            int64_t try_put(const std::string&, uint32_t priority = 0, uint32_t delay = 0, uint32_t ttr = 60);
             bool del(int64_t id);
             bool del(Job&);
             bool reserve(Job &);
@@ -47,16 +47,35 @@ DaemonConfig::DaemonConfig(std::string config_file, std::string config_defaults_
   country = getString(&ini, &defaultIni, "daemon", "country", "us");
   topn = getInt(&ini, &defaultIni, "daemon", "topn", 20);
   analysis_threads = getInt(&ini, &defaultIni, "daemon", "analysis_threads", 1);
+  frame_queue_depth = getInt(&ini, &defaultIni, "daemon", "frame_queue_depth", 0);
+  frame_queue_drop = getString(&ini, &defaultIni, "daemon", "frame_queue_drop", "oldest");
+  // "auto" tracks only when one analysis thread or worker sees all of a stream's frames
+  plate_tracking_auto = (getString(&ini, &defaultIni, "daemon", "plate_tracking", "auto") == "auto");
+  plate_tracking = plate_tracking_auto || getBoolean(&ini, &defaultIni, "daemon", "plate_tracking", true);
+  motion_detection = getBoolean(&ini, &defaultIni, "daemon", "motion_detection", false);
   
   storePlates = getBoolean(&ini, &defaultIni, "daemon", "store_plates", false);
   imageFolder = getString(&ini, &defaultIni, "daemon", "store_plates_location", "/tmp/");
   uploadData = getBoolean(&ini, &defaultIni, "daemon", "upload_data", false);
   upload_url = getString(&ini, &defaultIni, "daemon", "upload_address", "");
+  upload_batch_size = getInt(&ini, &defaultIni, "daemon", "upload_batch_size", 1);
+  queue_batch_size = getInt(&ini, &defaultIni, "daemon", "queue_batch_size", 1);
+  queue_max_pending = getInt(&ini, &defaultIni, "daemon", "queue_max_pending", 1000);
   company_id = getString(&ini, &defaultIni, "daemon", "company_id", "");
   site_id = getString(&ini, &defaultIni, "daemon", "site_id", "");
   pattern = getString(&ini, &defaultIni, "daemon", "pattern", "");
+  metrics_dir = getString(&ini, &defaultIni, "daemon", "metrics_dir", "");
+  metrics_interval_seconds = getInt(&ini, &defaultIni, "daemon", "metrics_interval_seconds", 15);
+  if (metrics_interval_seconds < 1)
+    metrics_interval_seconds = 1;
 }
 
 DaemonConfig::~DaemonConfig() {
 }
 
+bool DaemonConfig::trackPlates(int workersPerStream) const {
+  if (plate_tracking_auto)
+    return workersPerStream <= 1;
+  return plate_tracking;
+}
+
@@ -17,13 +17,29 @@ public:
   
   int topn;
   int analysis_threads;
+  int frame_queue_depth;
+  std::string frame_queue_drop;
+  bool plate_tracking;
+  // plate_tracking was left to decide for itself; see trackPlates()
+  bool plate_tracking_auto;
+  bool motion_detection;
   bool storePlates;
   std::string imageFolder;
   bool uploadData;
   std::string upload_url;
+  int upload_batch_size;
+  int queue_batch_size;
+  int queue_max_pending;
   std::string company_id;
   std::string site_id;
   std::string pattern;
+  std::string metrics_dir;
+  int metrics_interval_seconds;
+
+  // Whether a stream served by this many analysis threads or workers should track plates.
+  // A tracker only sees the frames given to its own thread or worker, so with several
+  // of them "auto" turns tracking off.
+  bool trackPlates(int workersPerStream) const;
   
 private:
 
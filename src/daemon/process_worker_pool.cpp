@@ -1,14 +1,131 @@
 #include "daemon/process_worker_pool.h"
 
 #include <unistd.h>
+#include <sys/mman.h>
 #include <sys/wait.h>
+#include <signal.h>
 #include <poll.h>
+#include <algorithm>
+#include <cstring>
+#include <iostream>
 #include <vector>
 
-#include <opencv2/imgcodecs/imgcodecs.hpp>
-
 #include "openalpr/alpr.h"
+#include "openalpr/binary_results.h"
 #include "openalpr/config.h"
+#include "openalpr/support/timing.h"
+
+namespace {
+
+// Stage stats cross the result pipe after a result, every statsIntervalMs: per stage,
+// the name, count, totals and histogram.  Native byte order, like the results themselves.
+// Other results are followed by an empty stats block.
+template <typename T>
+void putValue(std::string& out, T value)
+{
+  out.append(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+template <typename T>
+bool getValue(const std::string& in, size_t& pos, T& value)
+{
+  if (in.size() - pos < sizeof(T))
+    return false;
+  memcpy(&value, in.data() + pos, sizeof(T));
+  pos += sizeof(T);
+  return true;
+}
+
+void encodeStageStats(const std::vector<alpr::AlprStageStats>& stats, std::string& out)
+{
+  out.clear();
+  putValue<uint32_t>(out, stats.size());
+  for (size_t i = 0; i < stats.size(); i++)
+  {
+    const alpr::AlprStageStats& stage = stats[i];
+    putValue<uint32_t>(out, stage.stage.size());
+    out.append(stage.stage);
+    putValue<uint64_t>(out, stage.count);
+    putValue<double>(out, stage.total_ms);
+    putValue<double>(out, stage.max_ms);
+    putValue<double>(out, stage.p50_ms);
+    putValue<double>(out, stage.p90_ms);
+    putValue<double>(out, stage.p99_ms);
+    putValue<uint32_t>(out, stage.bucket_counts.size());
+    for (size_t b = 0; b < stage.bucket_counts.size(); b++)
+    {
+      putValue<double>(out, stage.bucket_upper_ms[b]);
+      putValue<uint64_t>(out, stage.bucket_counts[b]);
+    }
+  }
+}
+
+bool decodeStageStats(const std::string& in, std::vector<alpr::AlprStageStats>& stats)
+{
+  size_t pos = 0;
+  uint32_t stageCount = 0;
+  if (!getValue(in, pos, stageCount))
+    return false;
+
+  stats.clear();
+  for (uint32_t i = 0; i < stageCount; i++)
+  {
+    alpr::AlprStageStats stage;
+    uint32_t nameLength = 0;
+    if (!getValue(in, pos, nameLength) || in.size() - pos < nameLength)
+      return false;
+    stage.stage.assign(in, pos, nameLength);
+    pos += nameLength;
+
+    uint32_t bucketCount = 0;
+    if (!getValue(in, pos, stage.count) || !getValue(in, pos, stage.total_ms) || !getValue(in, pos, stage.max_ms) ||
+        !getValue(in, pos, stage.p50_ms) || !getValue(in, pos, stage.p90_ms) || !getValue(in, pos, stage.p99_ms) ||
+        !getValue(in, pos, bucketCount))
+      return false;
+    if ((in.size() - pos) / (sizeof(double) + sizeof(uint64_t)) < bucketCount)
+      return false;
+
+    stage.bucket_upper_ms.resize(bucketCount);
+    stage.bucket_counts.resize(bucketCount);
+    for (uint32_t b = 0; b < bucketCount; b++)
+    {
+      getValue(in, pos, stage.bucket_upper_ms[b]);
+      getValue(in, pos, stage.bucket_counts[b]);
+    }
+    stats.push_back(stage);
+  }
+  return true;
+}
+
+// Sums counts and histograms stage by stage.  Percentiles can't be combined exactly,
+// so each merged one is the largest of the workers'.
+void mergeStageStats(std::vector<alpr::AlprStageStats>& total, const std::vector<alpr::AlprStageStats>& stats)
+{
+  for (size_t i = 0; i < stats.size(); i++)
+  {
+    size_t t = 0;
+    while (t < total.size() && total[t].stage != stats[i].stage)
+      t++;
+    if (t == total.size())
+    {
+      total.push_back(stats[i]);
+      continue;
+    }
+
+    alpr::AlprStageStats& merged = total[t];
+    merged.count += stats[i].count;
+    merged.total_ms += stats[i].total_ms;
+    merged.max_ms = std::max(merged.max_ms, stats[i].max_ms);
+    merged.p50_ms = std::max(merged.p50_ms, stats[i].p50_ms);
+    merged.p90_ms = std::max(merged.p90_ms, stats[i].p90_ms);
+    merged.p99_ms = std::max(merged.p99_ms, stats[i].p99_ms);
+    // Every process uses the same bucket bounds
+    for (size_t b = 0; b < merged.bucket_counts.size() && b < stats[i].bucket_counts.size(); b++)
+      merged.bucket_counts[b] += stats[i].bucket_counts[b];
+  }
+}
+
+} // namespace
 
 ProcessWorkerPool::ProcessWorkerPool(const ProcessWorkerParams& params, int workerCount)
   : params_(params), workerCount_(workerCount)
@@ -18,6 +135,15 @@ ProcessWorkerPool::ProcessWorkerPool(const ProcessWorkerParams& params, int work
 ProcessWorkerPool::~ProcessWorkerPool()
 {
   stop();
+
+  delete alpr_;
+  alpr_ = nullptr;
+
+  if (shm_ != nullptr)
+  {
+    ::munmap(shm_, shmBytes_);
+    shm_ = nullptr;
+  }
 }
 
 bool ProcessWorkerPool::writeAll(int fd, const void* buf, size_t len)
@@ -46,108 +172,264 @@ bool ProcessWorkerPool::readAll(int fd, void* buf, size_t len)
   return true;
 }
 
+unsigned char* ProcessWorkerPool::slotData(int slot)
+{
+  return shm_ + static_cast<size_t>(slot) * slotBytes_;
+}
+
 bool ProcessWorkerPool::start()
 {
+  // Two slots per worker: one in flight, one held by the caller between polls.
+  // The mapping is created before fork() so every worker shares it.
+  slotBytes_ = (params_.maxFrameBytes + 4095) & ~static_cast<size_t>(4095);
+  slots_.assign(workerCount_ * 2, SLOT_FREE);
+  shmBytes_ = slotBytes_ * slots_.size();
+  void* mapping = ::mmap(NULL, shmBytes_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+  if (mapping == MAP_FAILED)
+  {
+    shmBytes_ = 0;
+    return false;
+  }
+  shm_ = static_cast<unsigned char*>(mapping);
+
+  if (params_.prefork && alpr_ == nullptr)
+  {
+    alpr_ = createAlpr();
+    alpr_->warmUp();
+  }
+
   workers_.resize(workerCount_);
   for (int i = 0; i < workerCount_; i++)
   {
-    int toChild[2];
-    int fromChild[2];
-    if (pipe(toChild) != 0) return false;
-    if (pipe(fromChild) != 0)
-    {
-      ::close(toChild[0]); ::close(toChild[1]);
+    if (!spawnWorker(workers_[i]))
       return false;
+  }
+  return true;
+}
+
+bool ProcessWorkerPool::spawnWorker(Worker& worker)
+{
+  int toChild[2];
+  int fromChild[2];
+  if (pipe(toChild) != 0) return false;
+  if (pipe(fromChild) != 0)
+  {
+    ::close(toChild[0]); ::close(toChild[1]);
+    return false;
+  }
+
+  pid_t pid = fork();
+  if (pid < 0)
+  {
+    ::close(toChild[0]); ::close(toChild[1]);
+    ::close(fromChild[0]); ::close(fromChild[1]);
+    return false;
+  }
+
+  if (pid == 0)
+  {
+    // Child.  It inherits the parent's ends of the other workers' pipes too; closing
+    // them keeps a dead sibling's pipe from looking open.
+    for (size_t w = 0; w < workers_.size(); w++)
+    {
+      if (workers_[w].writeFd >= 0) ::close(workers_[w].writeFd);
+      if (workers_[w].readFd >= 0) ::close(workers_[w].readFd);
     }
+    ::close(toChild[1]);
+    ::close(fromChild[0]);
+    runWorker(toChild[0], fromChild[1]);
+    _exit(0);
+  }
+
+  // Parent
+  ::close(toChild[0]);
+  ::close(fromChild[1]);
+
+  worker.pid = pid;
+  worker.writeFd = toChild[1];
+  worker.readFd = fromChild[0];
+  worker.busy = false;
+  return true;
+}
+
+void ProcessWorkerPool::replaceWorker(int index)
+{
+  Worker& worker = workers_[index];
+  std::cerr << "Process worker " << index << " (pid " << worker.pid << ") stopped responding; restarting it" << std::endl;
+
+  releaseWorker(worker, SLOT_FREE);
+  if (worker.writeFd >= 0) ::close(worker.writeFd);
+  if (worker.readFd >= 0) ::close(worker.readFd);
+  worker.writeFd = -1;
+  worker.readFd = -1;
+  if (worker.pid > 0)
+  {
+    // Usually already gone; if it is wedged instead, it won't be answering anyway
+    ::kill(worker.pid, SIGKILL);
+    int status = 0;
+    waitpid(worker.pid, &status, 0);
+    worker.pid = 0;
+  }
+
+  // Its stats so far stay in the totals; the replacement starts counting from zero
+  mergeStageStats(retiredStageStats_, worker.stageStats);
+  worker.stageStats.clear();
+
+  if (!spawnWorker(worker))
+    std::cerr << "Unable to restart process worker " << index << std::endl;
+}
+
+alpr::Alpr* ProcessWorkerPool::createAlpr()
+{
+  alpr::Alpr* alpr = new alpr::Alpr(params_.country, params_.configFile);
+  alpr->setTopN(params_.topn);
+  if (params_.detectRegion) alpr->setDetectRegion(true);
+  if (!params_.templatePattern.empty()) alpr->setDefaultRegion(params_.templatePattern);
+  if (params_.debug) alpr->getConfig()->setDebug(true);
+  if (params_.trackPlates) alpr->setPlateTracking(true);
+  return alpr;
+}
+
+void ProcessWorkerPool::runWorker(int readFd, int writeFd)
+{
+  // The worker exits with _exit(), so neither instance is destroyed
+  alpr::Alpr* instance = alpr_;
+  if (instance != nullptr)
+    instance->afterFork();
+  else
+    instance = createAlpr();
+  alpr::Alpr& alpr = *instance;
+
+  std::string encoded;
+  std::string encodedStats;
+  int64_t lastStatsSent = 0;
+  while (true)
+  {
+    FrameHeader header;
+    if (!readAll(readFd, &header, sizeof(header)))
+      break;
+    if (header.rows == 0)
+      break; // shutdown
 
-    pid_t pid = fork();
-    if (pid < 0)
+    if (header.slot >= slots_.size())
     {
-      ::close(toChild[0]); ::close(toChild[1]);
-      ::close(fromChild[0]); ::close(fromChild[1]);
-      return false;
+      // An empty result, then no stats
+      uint32_t zeros[2] = { 0, 0 };
+      writeAll(writeFd, zeros, sizeof(zeros));
+      continue;
     }
 
-    if (pid == 0)
+    std::vector<RegionHeader> regions(header.roiCount);
+    if (header.roiCount > 0 && !readAll(readFd, regions.data(), regions.size() * sizeof(RegionHeader)))
+      break;
+
+    // Recognize straight out of the shared slot; nothing is copied or decoded
+    cv::Mat frame(header.rows, header.cols, header.type, slotData(header.slot));
+
+    std::vector<alpr::AlprRegionOfInterest> rois;
+    for (size_t r = 0; r < regions.size(); r++)
+      rois.push_back(alpr::AlprRegionOfInterest(regions[r].x, regions[r].y, regions[r].width, regions[r].height));
+    if (rois.empty())
+      rois.push_back(alpr::AlprRegionOfInterest(0,0,frame.cols, frame.rows));
+    alpr::AlprResults results = alpr.recognize(frame.data, frame.elemSize(), frame.cols, frame.rows, rois);
+
+    encoded = alpr::Alpr::toBinary(results);
+    // Encoding and piping every stage's histogram after each frame adds up, so the
+    // parent only gets them as often as it writes metrics
+    encodedStats.clear();
+    int64_t now = alpr::getEpochTimeMs();
+    if (params_.statsIntervalMs > 0 && now - lastStatsSent >= params_.statsIntervalMs)
     {
-      // Child
-      ::close(toChild[1]);
-      ::close(fromChild[0]);
-      int readFd = toChild[0];
-      int writeFd = fromChild[1];
-
-      alpr::Alpr alpr(params_.country, params_.configFile);
-      alpr.setTopN(params_.topn);
-      if (params_.detectRegion) alpr.setDetectRegion(true);
-      if (!params_.templatePattern.empty()) alpr.setDefaultRegion(params_.templatePattern);
-      if (params_.debug) alpr.getConfig()->setDebug(true);
-
-      while (true)
-      {
-        uint32_t len = 0;
-        if (!readAll(readFd, &len, sizeof(len)))
-          break;
-        if (len == 0)
-          break; // shutdown
-
-        std::vector<uchar> buffer(len);
-        if (!readAll(readFd, buffer.data(), len))
-          break;
-
-        cv::Mat frame = cv::imdecode(buffer, 1);
-        if (frame.empty())
-        {
-          uint32_t zero = 0;
-          writeAll(writeFd, &zero, sizeof(zero));
-          continue;
-        }
-
-        std::vector<alpr::AlprRegionOfInterest> rois;
-        rois.push_back(alpr::AlprRegionOfInterest(0,0,frame.cols, frame.rows));
-        alpr::AlprResults results = alpr.recognize(frame.data, frame.elemSize(), frame.cols, frame.rows, rois);
-        std::string json = alpr.toJson(results);
-        uint32_t outlen = static_cast<uint32_t>(json.size());
-        writeAll(writeFd, &outlen, sizeof(outlen));
-        writeAll(writeFd, json.data(), outlen);
-      }
-
-      ::close(readFd);
-      ::close(writeFd);
-      _exit(0);
+      encodeStageStats(alpr::Alpr::getStats(), encodedStats);
+      lastStatsSent = now;
     }
+    uint32_t outlen = static_cast<uint32_t>(encoded.size());
+    uint32_t statslen = static_cast<uint32_t>(encodedStats.size());
+    if (!writeAll(writeFd, &outlen, sizeof(outlen)) || !writeAll(writeFd, encoded.data(), outlen) ||
+        !writeAll(writeFd, &statslen, sizeof(statslen)) || !writeAll(writeFd, encodedStats.data(), statslen))
+      break;
+  }
 
-    // Parent
-    ::close(toChild[0]);
-    ::close(fromChild[1]);
+  ::close(readFd);
+  ::close(writeFd);
+}
 
-    workers_[i].pid = pid;
-    workers_[i].writeFd = toChild[1];
-    workers_[i].readFd = fromChild[0];
-    workers_[i].busy = false;
+int ProcessWorkerPool::acquireSlot()
+{
+  for (size_t n = 0; n < slots_.size(); n++)
+  {
+    int slot = (nextSlot_ + n) % slots_.size();
+    if (slots_[slot] == SLOT_FREE)
+    {
+      nextSlot_ = (slot + 1) % slots_.size();
+      return slot;
+    }
   }
-  return true;
+  return -1;
 }
 
-bool ProcessWorkerPool::dispatch(const cv::Mat& frame, const std::string& jobId)
+void ProcessWorkerPool::releaseWorker(Worker& worker, SlotState slotState)
 {
+  if (worker.slot >= 0)
+    slots_[worker.slot] = slotState;
+  worker.busy = false;
+  worker.slot = -1;
+  worker.jobId.clear();
+  worker.frame.release();
+}
+
+bool ProcessWorkerPool::dispatch(const cv::Mat& frame, const std::string& jobId, const std::vector<alpr::AlprRegionOfInterest>& regionsOfInterest)
+{
+  size_t frameBytes = frame.total() * frame.elemSize();
+  if (frameBytes == 0 || frameBytes > slotBytes_)
+  {
+    std::cerr << "Frame of " << frameBytes << " bytes does not fit in a " << slotBytes_ << " byte worker slot" << std::endl;
+    return false;
+  }
+
   for (int i = 0; i < workerCount_; i++)
   {
-    if (workers_[i].busy)
+    if (workers_[i].busy || workers_[i].pid <= 0)
       continue;
 
-    std::vector<uchar> buffer;
-    if (!cv::imencode(".jpg", frame, buffer))
+    int slot = acquireSlot();
+    if (slot < 0)
       return false;
 
-    uint32_t len = static_cast<uint32_t>(buffer.size());
-    if (!writeAll(workers_[i].writeFd, &len, sizeof(len)))
-      return false;
-    if (!writeAll(workers_[i].writeFd, buffer.data(), buffer.size()))
-      return false;
+    // The only copy on the parent side: raw pixels into the shared slot
+    cv::Mat slotView(frame.rows, frame.cols, frame.type(), slotData(slot));
+    frame.copyTo(slotView);
 
+    // Header and regions go out in a single write
+    FrameHeader header;
+    header.slot = static_cast<uint32_t>(slot);
+    header.rows = frame.rows;
+    header.cols = frame.cols;
+    header.type = frame.type();
+    header.roiCount = static_cast<uint32_t>(regionsOfInterest.size());
+    std::string message(reinterpret_cast<const char*>(&header), sizeof(header));
+    for (size_t r = 0; r < regionsOfInterest.size(); r++)
+    {
+      RegionHeader region;
+      region.x = regionsOfInterest[r].x;
+      region.y = regionsOfInterest[r].y;
+      region.width = regionsOfInterest[r].width;
+      region.height = regionsOfInterest[r].height;
+      message.append(reinterpret_cast<const char*>(&region), sizeof(region));
+    }
+    if (!writeAll(workers_[i].writeFd, message.data(), message.size()))
+    {
+      // The slot is free again; try the frame on the next idle worker
+      slots_[slot] = SLOT_FREE;
+      replaceWorker(i);
+      continue;
+    }
+
+    slots_[slot] = SLOT_IN_FLIGHT;
     workers_[i].busy = true;
     workers_[i].jobId = jobId;
-    workers_[i].frame = frame.clone();
+    workers_[i].slot = slot;
+    workers_[i].frame = slotView;
     return true;
   }
   return false;
@@ -159,6 +441,13 @@ std::vector<ProcessWorkerPool::CompletedJob> ProcessWorkerPool::poll(int timeout
   std::vector<pollfd> fds;
   std::vector<int> idxmap;
 
+  // Frames handed out by the previous poll() are no longer referenced by the caller
+  for (size_t s = 0; s < slots_.size(); s++)
+  {
+    if (slots_[s] == SLOT_HELD)
+      slots_[s] = SLOT_FREE;
+  }
+
   for (int i = 0; i < workerCount_; i++)
   {
     if (!workers_[i].busy) continue;
@@ -179,47 +468,63 @@ std::vector<ProcessWorkerPool::CompletedJob> ProcessWorkerPool::poll(int timeout
 
   for (size_t i = 0; i < fds.size(); i++)
   {
-    if (!(fds[i].revents & POLLIN))
+    if (!(fds[i].revents & (POLLIN | POLLHUP | POLLERR)))
       continue;
     int widx = idxmap[i];
+
+    // A worker that exits mid-job shows up as a short read; its frame is dropped
     uint32_t len = 0;
-    if (!readAll(workers_[widx].readFd, &len, sizeof(len)))
+    std::string encoded;
+    uint32_t statslen = 0;
+    std::string encodedStats;
+    bool received = readAll(workers_[widx].readFd, &len, sizeof(len));
+    if (received && len > 0)
     {
-      workers_[widx].busy = false;
-      continue;
+      encoded.resize(len);
+      received = readAll(workers_[widx].readFd, &encoded[0], len);
     }
-    std::string json;
-    if (len > 0)
+    if (received)
+      received = readAll(workers_[widx].readFd, &statslen, sizeof(statslen));
+    if (received && statslen > 0)
     {
-      json.resize(len);
-      if (!readAll(workers_[widx].readFd, &json[0], len))
-      {
-        workers_[widx].busy = false;
-        continue;
-      }
+      encodedStats.resize(statslen);
+      received = readAll(workers_[widx].readFd, &encodedStats[0], statslen);
     }
+    if (!received)
+    {
+      replaceWorker(widx);
+      continue;
+    }
+    if (statslen > 0)
+      decodeStageStats(encodedStats, workers_[widx].stageStats);
 
     CompletedJob job;
     job.jobId = workers_[widx].jobId;
-    job.json = json;
+    job.ok = len > 0 && alpr::readBinaryResults(encoded.data(), encoded.size(), job.results);
     job.frame = workers_[widx].frame;
-    workers_[widx].busy = false;
-    workers_[widx].jobId.clear();
-    workers_[widx].frame.release();
+    releaseWorker(workers_[widx], SLOT_HELD);
     completed.push_back(job);
   }
 
   return completed;
 }
 
+std::vector<alpr::AlprStageStats> ProcessWorkerPool::stageStats() const
+{
+  std::vector<alpr::AlprStageStats> total = retiredStageStats_;
+  for (size_t i = 0; i < workers_.size(); i++)
+    mergeStageStats(total, workers_[i].stageStats);
+  return total;
+}
+
 void ProcessWorkerPool::stop()
 {
-  for (int i = 0; i < workerCount_; i++)
+  for (int i = 0; i < workerCount_ && i < (int) workers_.size(); i++)
   {
     if (workers_[i].writeFd >= 0)
     {
-      uint32_t zero = 0;
-      writeAll(workers_[i].writeFd, &zero, sizeof(zero));
+      FrameHeader shutdown = FrameHeader();
+      writeAll(workers_[i].writeFd, &shutdown, sizeof(shutdown));
       ::close(workers_[i].writeFd);
       workers_[i].writeFd = -1;
     }
@@ -236,4 +541,3 @@ void ProcessWorkerPool::stop()
     }
   }
 }
-
@@ -1,19 +1,20 @@
 /*
  * Optional process-based worker pool for alprd.
- * Each worker owns its own Alpr instance; communication is via pipes.
+ * Each worker owns its own Alpr instance, either loaded after the fork or inherited
+ * from one the parent loaded first (prefork).  Frames are passed through a ring of
+ * raw pixel slots in shared memory; the pipes only carry slot indices and
+ * binary-encoded results.
  */
 
 #pragma once
 
 #include <string>
 #include <vector>
+#include <stdint.h>
 #include <sys/types.h>
 #include <opencv2/core/core.hpp>
 
-namespace alpr
-{
-  class AlprResults;
-}
+#include "openalpr/alpr.h"
 
 struct ProcessWorkerParams
 {
@@ -23,6 +24,17 @@ struct ProcessWorkerParams
   int topn = 10;
   bool detectRegion = false;
   bool debug = false;
+  // Load and warm up one Alpr before forking so the workers share its model pages
+  // copy-on-write, instead of each loading its own after the fork
+  bool prefork = false;
+  // Frames are consecutive video frames; reuse reads of plates that stay in view
+  bool trackPlates = false;
+  // Each worker sends its stage stats along with a result at most this often, and
+  // an empty stats block with the others.  0 never sends them.
+  int statsIntervalMs = 0;
+  // Capacity of each shared-memory slot.  Pages are only committed once touched,
+  // so the default (one 4K BGR frame) costs little for smaller streams.
+  size_t maxFrameBytes = 3840 * 2160 * 3;
 };
 
 class ProcessWorkerPool
@@ -33,19 +45,30 @@ public:
 
   bool start();
 
-  // Returns false if no worker is free.
-  bool dispatch(const cv::Mat& frame, const std::string& jobId);
+  // Copies the frame into a free shared-memory slot and hands it to an idle worker,
+  // which searches the given regions of it (all of it if there are none).  A worker
+  // found dead is replaced and the frame goes to the next idle one.
+  // Returns false if no worker is free or the frame does not fit in a slot.
+  bool dispatch(const cv::Mat& frame, const std::string& jobId,
+                const std::vector<alpr::AlprRegionOfInterest>& regionsOfInterest = std::vector<alpr::AlprRegionOfInterest>());
 
   struct CompletedJob
   {
     std::string jobId;
-    std::string json;
+    // False if the worker failed to process the frame
+    bool ok;
+    alpr::AlprResults results;
+    // View of the frame in its shared-memory slot.  Valid until the next poll().
     cv::Mat frame;
   };
 
   // Poll for completed jobs. timeoutMs can be zero.
   std::vector<CompletedJob> poll(int timeoutMs);
 
+  // Stage latency stats of every worker combined, as of the last ones each sent.
+  // Recognition happens in the workers, so Alpr::getStats() in this process stays empty.
+  std::vector<alpr::AlprStageStats> stageStats() const;
+
   void stop();
 
 private:
@@ -56,12 +79,62 @@ private:
     int readFd = -1;
     bool busy = false;
     std::string jobId;
+    int slot = -1;
     cv::Mat frame;
+    // Sent along with a result every statsIntervalMs
+    std::vector<alpr::AlprStageStats> stageStats;
+  };
+
+  // Sent parent -> worker for each job, followed by roiCount RegionHeaders.
+  // rows == 0 asks the worker to exit.
+  struct FrameHeader
+  {
+    uint32_t slot;
+    int32_t rows;
+    int32_t cols;
+    int32_t type;
+    uint32_t roiCount;
+  };
+
+  struct RegionHeader
+  {
+    int32_t x;
+    int32_t y;
+    int32_t width;
+    int32_t height;
+  };
+
+  enum SlotState
+  {
+    SLOT_FREE,
+    SLOT_IN_FLIGHT,
+    // Result returned; the caller may still read CompletedJob::frame
+    SLOT_HELD
   };
 
   ProcessWorkerParams params_;
   int workerCount_;
   std::vector<Worker> workers_;
+  // Stats of workers that have been replaced, so the totals never go backwards
+  std::vector<alpr::AlprStageStats> retiredStageStats_;
+
+  // Loaded in the parent when prefork is set; each worker recognizes with its own copy
+  alpr::Alpr* alpr_ = nullptr;
+
+  unsigned char* shm_ = nullptr;
+  size_t shmBytes_ = 0;
+  size_t slotBytes_ = 0;
+  std::vector<SlotState> slots_;
+  int nextSlot_ = 0;
+
+  unsigned char* slotData(int slot);
+  int acquireSlot();
+  void releaseWorker(Worker& worker, SlotState slotState);
+  bool spawnWorker(Worker& worker);
+  // Reaps a worker whose pipe failed and forks a new one in its place
+  void replaceWorker(int index);
+  alpr::Alpr* createAlpr();
+  void runWorker(int readFd, int writeFd);
 
   bool writeAll(int fd, const void* buf, size_t len);
   bool readAll(int fd, void* buf, size_t len);
@@ -0,0 +1,533 @@
+#include "daemon/result_publisher.h"
+
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+
+#include "support/platform.h"
+
+namespace
+{
+  const int STOP_POLL_MS = 50;
+
+  std::string trimmed(const std::string& s)
+  {
+    size_t begin = s.find_first_not_of(" \t\r\n");
+    if (begin == std::string::npos)
+      return "";
+    size_t end = s.find_last_not_of(" \t\r\n");
+    return s.substr(begin, end - begin + 1);
+  }
+
+  void logMessage(const ResultLogger& log, ResultLogLevel level, const std::string& message)
+  {
+    if (log)
+      log(level, message);
+    else
+      std::cerr << message << std::endl;
+  }
+}
+
+ResultPublisher::ResultPublisher(const ResultPublisherParams& params)
+  : params_(params)
+{
+  if (params_.batchSize < 1)
+    params_.batchSize = 1;
+  if (params_.maxPending < 1)
+    params_.maxPending = 1;
+}
+
+ResultPublisher::~ResultPublisher()
+{
+  stop();
+}
+
+void ResultPublisher::start()
+{
+  if (thread_ != nullptr)
+    return;
+
+  stopping_ = false;
+  thread_ = new tthread::thread(publisherThread, (void*) this);
+}
+
+void ResultPublisher::publish(const std::string& json)
+{
+  mtx_.lock();
+  if ((int) pending_.size() >= params_.maxPending)
+  {
+    pending_.pop_front();
+    stats_.dropped++;
+  }
+  pending_.push_back(json);
+  ready_.notify_one();
+  mtx_.unlock();
+}
+
+void ResultPublisher::stop()
+{
+  if (thread_ == nullptr)
+    return;
+
+  mtx_.lock();
+  stopping_ = true;
+  ready_.notify_all();
+  mtx_.unlock();
+
+  thread_->join();
+  delete thread_;
+  thread_ = nullptr;
+}
+
+ResultPublisher::Stats ResultPublisher::stats()
+{
+  mtx_.lock();
+  Stats copy = stats_;
+  mtx_.unlock();
+  return copy;
+}
+
+void ResultPublisher::publisherThread(void* arg)
+{
+  ((ResultPublisher*) arg)->run();
+}
+
+void ResultPublisher::run()
+{
+  int delayMs = params_.initialBackoffMs;
+  bool outage = false;
+
+  while (true)
+  {
+    // Everything that queued up while the previous put was in flight goes out
+    // together, so a burst of cars costs a handful of round trips instead of one each.
+    std::vector<std::string> batch;
+    size_t batchBytes = 0;
+
+    mtx_.lock();
+    while (!stopping_ && pending_.empty())
+      ready_.wait(mtx_);
+
+    if (pending_.empty())
+    {
+      mtx_.unlock();
+      break;
+    }
+
+    while (!pending_.empty() && (int) batch.size() < params_.batchSize)
+    {
+      size_t nextBytes = pending_.front().size() + 1;
+      if (!batch.empty() && batchBytes + nextBytes > params_.maxJobBytes)
+        break;
+      batch.push_back(pending_.front());
+      batchBytes += nextBytes;
+      pending_.pop_front();
+    }
+    mtx_.unlock();
+
+    size_t handled = 0;
+    if (ensureConnected() && deliver(batch, handled))
+    {
+      if (outage)
+      {
+        std::stringstream message;
+        message << "Reconnected to Beanstalk at " << params_.host << ":" << params_.port;
+        logMessage(params_.log, RESULT_LOG_INFO, message.str());
+      }
+      outage = false;
+      delayMs = params_.initialBackoffMs;
+      continue;
+    }
+
+    closeConnection();
+    if (!outage)
+    {
+      std::stringstream message;
+      message << "Error writing to Beanstalk at " << params_.host << ":" << params_.port << ".  Results are held until it is back.";
+      logMessage(params_.log, RESULT_LOG_WARN, message.str());
+    }
+    outage = true;
+
+    // Put what is left of the batch back in front so results keep their order once
+    // the queue returns
+    mtx_.lock();
+    for (size_t i = batch.size(); i > handled; i--)
+      pending_.push_front(batch[i - 1]);
+    while ((int) pending_.size() > params_.maxPending)
+    {
+      pending_.pop_front();
+      stats_.dropped++;
+    }
+
+    bool giveUp = stopping_;
+    if (giveUp)
+    {
+      stats_.dropped += pending_.size();
+      pending_.clear();
+    }
+    mtx_.unlock();
+
+    if (giveUp)
+      break;
+
+    backoff(delayMs);
+  }
+
+  closeConnection();
+}
+
+bool ResultPublisher::ensureConnected()
+{
+  if (client_ != nullptr && client_->is_connected())
+    return true;
+
+  closeConnection();
+  try
+  {
+    client_ = new Beanstalk::Client(params_.host, params_.port);
+  }
+  catch (const std::runtime_error& error)
+  {
+    client_ = nullptr;
+    return false;
+  }
+
+  if (!client_->use(params_.tube))
+  {
+    closeConnection();
+    return false;
+  }
+
+  mtx_.lock();
+  stats_.connects++;
+  mtx_.unlock();
+  return true;
+}
+
+void ResultPublisher::closeConnection()
+{
+  delete client_;
+  client_ = nullptr;
+}
+
+// Puts the batch, counting every result that beanstalkd stored or refused in handled.
+// Returns false only when the connection failed; the rest of the batch is then still
+// to be delivered.
+bool ResultPublisher::deliver(const std::vector<std::string>& batch, size_t& handled)
+{
+  handled = 0;
+
+  int64_t status = putBatch(batch);
+  if (status == BS_STATUS_FAIL)
+    return false;
+
+  if (status >= 0 || batch.size() == 1)
+  {
+    recordPut(batch.size(), status);
+    handled = batch.size();
+    return true;
+  }
+
+  // A batch refused as a whole (usually JOB_TOO_BIG) may still fit one result per job
+  std::stringstream message;
+  message << "Beanstalk rejected a batch of " << batch.size() << " results (" << bs_status_text(status)
+          << ").  Retrying them one per job.";
+  logMessage(params_.log, RESULT_LOG_WARN, message.str());
+
+  for (; handled < batch.size(); handled++)
+  {
+    status = putBatch(std::vector<std::string>(1, batch[handled]));
+    if (status == BS_STATUS_FAIL)
+      return false;
+    recordPut(1, status);
+  }
+
+  return true;
+}
+
+// Counts a put of results, or drops them if beanstalkd refused the job.  A refusal
+// comes over a healthy connection and would only be refused again, so unlike an
+// outage it is not retried.
+void ResultPublisher::recordPut(size_t results, int64_t status)
+{
+  if (status < 0)
+  {
+    std::stringstream message;
+    message << "Beanstalk rejected a job of " << results << " result(s) (" << bs_status_text(status) << ").  Dropping it.";
+    logMessage(params_.log, RESULT_LOG_WARN, message.str());
+  }
+
+  mtx_.lock();
+  if (status >= 0)
+  {
+    stats_.jobsPut++;
+    stats_.published += results;
+  }
+  else
+  {
+    stats_.dropped += results;
+  }
+  mtx_.unlock();
+}
+
+// Returns the job id, or the BS_STATUS_* code bs_put failed with
+int64_t ResultPublisher::putBatch(const std::vector<std::string>& batch)
+{
+  if (params_.batchSize == 1)
+    return client_->try_put(batch[0]);
+
+  std::string body = "[";
+  for (size_t i = 0; i < batch.size(); i++)
+  {
+    if (i > 0)
+      body += ",";
+    body += batch[i];
+  }
+  body += "]";
+
+  return client_->try_put(body);
+}
+
+// Sleeps for delayMs (doubling it for next time) unless stop() is called first
+void ResultPublisher::backoff(int& delayMs)
+{
+  for (int waited = 0; waited < delayMs; waited += STOP_POLL_MS)
+  {
+    mtx_.lock();
+    bool stopping = stopping_;
+    mtx_.unlock();
+    if (stopping)
+      return;
+
+    alpr::sleep_ms(STOP_POLL_MS);
+  }
+
+  delayMs = delayMs * 2 > params_.maxBackoffMs ? params_.maxBackoffMs : delayMs * 2;
+}
+
+
+ResultUploader::ResultUploader(const ResultUploaderParams& params)
+  : params_(params)
+{
+  if (params_.batchSize < 1)
+    params_.batchSize = 1;
+
+  /* In windows, this will init the winsock stuff */
+  curl_global_init(CURL_GLOBAL_ALL);
+}
+
+ResultUploader::~ResultUploader()
+{
+  stop();
+
+  if (curl_ != nullptr)
+    curl_easy_cleanup(curl_);
+  if (headers_ != nullptr)
+    curl_slist_free_all(headers_);
+
+  curl_global_cleanup();
+}
+
+void ResultUploader::start()
+{
+  if (thread_ != nullptr)
+    return;
+
+  // One handle for the life of the uploader keeps the HTTP connection alive between posts
+  if (curl_ == nullptr)
+  {
+    curl_ = curl_easy_init();
+    headers_ = curl_slist_append(headers_, "Accept: application/json");
+    headers_ = curl_slist_append(headers_, "Content-Type: application/json");
+    headers_ = curl_slist_append(headers_, "charsets: utf-8");
+
+    curl_easy_setopt(curl_, CURLOPT_HTTPHEADER, headers_);
+    curl_easy_setopt(curl_, CURLOPT_URL, params_.url.c_str());
+    curl_easy_setopt(curl_, CURLOPT_NOSIGNAL, 1L);
+  }
+
+  stopping_ = false;
+  thread_ = new tthread::thread(uploaderThread, (void*) this);
+}
+
+void ResultUploader::stop()
+{
+  if (thread_ == nullptr)
+    return;
+
+  mtx_.lock();
+  stopping_ = true;
+  mtx_.unlock();
+
+  thread_->join();
+  delete thread_;
+  thread_ = nullptr;
+}
+
+ResultUploader::Stats ResultUploader::stats()
+{
+  mtx_.lock();
+  Stats copy = stats_;
+  mtx_.unlock();
+  return copy;
+}
+
+std::string ResultUploader::mergeBodies(const std::vector<std::string>& bodies)
+{
+  std::string merged = "[";
+  bool first = true;
+  for (size_t i = 0; i < bodies.size(); i++)
+  {
+    std::string body = trimmed(bodies[i]);
+    if (body.size() >= 2 && body[0] == '[' && body[body.size() - 1] == ']')
+      body = trimmed(body.substr(1, body.size() - 2));
+
+    if (body.empty())
+      continue;
+
+    if (!first)
+      merged += ",";
+    merged += body;
+    first = false;
+  }
+  merged += "]";
+
+  return merged;
+}
+
+void ResultUploader::uploaderThread(void* arg)
+{
+  ((ResultUploader*) arg)->run();
+}
+
+void ResultUploader::run()
+{
+  Beanstalk::Client* client = nullptr;
+  int delayMs = params_.initialBackoffMs;
+
+  while (!isStopping())
+  {
+    if (client == nullptr)
+    {
+      try
+      {
+        client = new Beanstalk::Client(params_.host, params_.port);
+        if (!client->watch(params_.tube))
+          throw std::runtime_error("unable to watch " + params_.tube);
+      }
+      catch (const std::runtime_error& error)
+      {
+        delete client;
+        client = nullptr;
+        std::stringstream message;
+        message << "Error connecting to Beanstalk.  Will retry in " << delayMs << " ms.";
+        logMessage(params_.log, RESULT_LOG_WARN, message.str());
+        sleepUnlessStopped(delayMs);
+        delayMs = delayMs * 2 > params_.maxBackoffMs ? params_.maxBackoffMs : delayMs * 2;
+        continue;
+      }
+
+      delayMs = params_.initialBackoffMs;
+      mtx_.lock();
+      stats_.connects++;
+      mtx_.unlock();
+    }
+
+    // The timeout bounds how long stop() waits for this thread
+    std::vector<Beanstalk::Job> jobs(1);
+    if (!client->reserve(jobs[0], params_.reserveTimeoutSecs))
+    {
+      // A timeout leaves the connection usable; anything else means it is gone
+      if (!client->watch(params_.tube))
+      {
+        delete client;
+        client = nullptr;
+      }
+      continue;
+    }
+
+    // Whatever else is already waiting rides along in the same POST
+    while ((int) jobs.size() < params_.batchSize)
+    {
+      Beanstalk::Job job;
+      if (!client->reserve(job, 0))
+        break;
+      jobs.push_back(job);
+    }
+
+    std::string body;
+    if (params_.batchSize == 1)
+    {
+      body = jobs[0].body();
+    }
+    else
+    {
+      std::vector<std::string> bodies;
+      for (size_t i = 0; i < jobs.size(); i++)
+        bodies.push_back(jobs[i].body());
+      body = mergeBodies(bodies);
+    }
+
+    if (post(body))
+    {
+      for (size_t i = 0; i < jobs.size(); i++)
+        client->del(jobs[i]);
+
+      mtx_.lock();
+      stats_.posts++;
+      stats_.jobsUploaded += jobs.size();
+      mtx_.unlock();
+    }
+    else
+    {
+      for (size_t i = 0; i < jobs.size(); i++)
+        client->release(jobs[i]);
+
+      mtx_.lock();
+      stats_.failedPosts++;
+      mtx_.unlock();
+
+      std::stringstream message;
+      message << "Upload of " << jobs.size() << " queued result job(s) failed.  Will retry.";
+      logMessage(params_.log, RESULT_LOG_WARN, message.str());
+      sleepUnlessStopped(params_.retryDelayMs);
+    }
+  }
+
+  delete client;
+}
+
+bool ResultUploader::isStopping()
+{
+  mtx_.lock();
+  bool stopping = stopping_;
+  mtx_.unlock();
+  return stopping;
+}
+
+bool ResultUploader::post(const std::string& body)
+{
+  if (curl_ == nullptr)
+    return false;
+
+  curl_easy_setopt(curl_, CURLOPT_POSTFIELDS, body.c_str());
+  curl_easy_setopt(curl_, CURLOPT_POSTFIELDSIZE, (long) body.size());
+
+  if (curl_easy_perform(curl_) != CURLE_OK)
+    return false;
+
+  long status = 0;
+  curl_easy_getinfo(curl_, CURLINFO_RESPONSE_CODE, &status);
+  return status >= 200 && status < 300;
+}
+
+bool ResultUploader::sleepUnlessStopped(int ms)
+{
+  for (int waited = 0; waited < ms; waited += STOP_POLL_MS)
+  {
+    if (isStopping())
+      return false;
+    alpr::sleep_ms(STOP_POLL_MS);
+  }
+  return true;
+}
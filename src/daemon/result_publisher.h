@@ -0,0 +1,152 @@
+/*
+ * Result publishing for alprd.
+ * ResultPublisher owns one long-lived beanstalkd connection per stream process and
+ * coalesces results that pile up while a put is in flight into a single job.
+ * ResultUploader drains the tube and POSTs one or more results per HTTP request.
+ */
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <functional>
+#include <stdint.h>
+#include <curl/curl.h>
+
+#include "daemon/beanstalk.hpp"
+#include "support/tinythread.h"
+
+enum ResultLogLevel
+{
+  RESULT_LOG_INFO,
+  RESULT_LOG_WARN
+};
+
+// Where the publisher and uploader report queue and upload trouble.  Unset, messages
+// go to stderr; alprd sends them to its log since stderr is gone once it daemonizes.
+typedef std::function<void(ResultLogLevel level, const std::string& message)> ResultLogger;
+
+struct ResultPublisherParams
+{
+  std::string host = "127.0.0.1";
+  int port = 11300;
+  std::string tube = "alprd";
+  // Results per job.  1 puts each result as its own JSON object (the historical
+  // format); above 1 every job body is a JSON array of results.
+  int batchSize = 1;
+  // beanstalkd rejects jobs over 64KB by default
+  size_t maxJobBytes = 60000;
+  // Results held while beanstalkd is unreachable.  The oldest are dropped first.
+  // Jobs beanstalkd itself refuses (JOB_TOO_BIG, DRAINING, BAD_FORMAT) are dropped
+  // rather than held.
+  int maxPending = 1000;
+  int initialBackoffMs = 100;
+  int maxBackoffMs = 5000;
+  ResultLogger log;
+};
+
+class ResultPublisher
+{
+public:
+  explicit ResultPublisher(const ResultPublisherParams& params);
+  ~ResultPublisher();
+
+  void start();
+
+  // Queues one JSON result and returns immediately.  Safe to call from any thread.
+  void publish(const std::string& json);
+
+  // Flushes what can still be delivered and closes the connection
+  void stop();
+
+  struct Stats
+  {
+    uint64_t published = 0;
+    uint64_t jobsPut = 0;
+    uint64_t connects = 0;
+    uint64_t dropped = 0;
+  };
+
+  Stats stats();
+
+private:
+  ResultPublisherParams params_;
+
+  tthread::mutex mtx_;
+  tthread::condition_variable ready_;
+  std::deque<std::string> pending_;
+  bool stopping_ = false;
+  Stats stats_;
+
+  Beanstalk::Client* client_ = nullptr;
+  tthread::thread* thread_ = nullptr;
+
+  static void publisherThread(void* arg);
+  void run();
+
+  bool ensureConnected();
+  void closeConnection();
+  bool deliver(const std::vector<std::string>& batch, size_t& handled);
+  void recordPut(size_t results, int64_t status);
+  int64_t putBatch(const std::vector<std::string>& batch);
+  void backoff(int& delayMs);
+};
+
+struct ResultUploaderParams
+{
+  std::string host = "127.0.0.1";
+  int port = 11300;
+  std::string tube = "alprd";
+  std::string url;
+  // Queue jobs merged into one POST.  1 posts each job body unchanged; above 1 the
+  // body is a JSON array of all results in the reserved jobs.
+  int batchSize = 1;
+  // How long a reserve blocks before the stop flag is checked again
+  int reserveTimeoutSecs = 1;
+  int retryDelayMs = 2000;
+  int initialBackoffMs = 100;
+  int maxBackoffMs = 5000;
+  ResultLogger log;
+};
+
+class ResultUploader
+{
+public:
+  explicit ResultUploader(const ResultUploaderParams& params);
+  ~ResultUploader();
+
+  void start();
+  void stop();
+
+  struct Stats
+  {
+    uint64_t posts = 0;
+    uint64_t jobsUploaded = 0;
+    uint64_t failedPosts = 0;
+    uint64_t connects = 0;
+  };
+
+  Stats stats();
+
+  // Joins job bodies (single objects or arrays of objects) into one JSON array
+  static std::string mergeBodies(const std::vector<std::string>& bodies);
+
+private:
+  ResultUploaderParams params_;
+
+  tthread::mutex mtx_;
+  bool stopping_ = false;
+  Stats stats_;
+
+  CURL* curl_ = nullptr;
+  struct curl_slist* headers_ = nullptr;
+  tthread::thread* thread_ = nullptr;
+
+  static void uploaderThread(void* arg);
+  void run();
+
+  bool isStopping();
+  bool post(const std::string& body);
+  bool sleepUnlessStopped(int ms);
+};
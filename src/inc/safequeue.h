@@ -1,38 +1,102 @@
 #ifndef SAFE_QUEUE_H_
 #define SAFE_QUEUE_H_
 
-#include <queue>
+#include <deque>
+#include <stdint.h>
 #include "support/tinythread.h"
 
+// Bounded multi-producer/multi-consumer queue.  When full, push() either evicts the
+// oldest item or discards the new one, so producers never block.  Consumers block in
+// pop() until an item arrives or the queue is closed.
 template <typename T>
 class SafeQueue
 {
     public:
-        T pop() 
+        enum DropPolicy
+        {
+            DROP_OLDEST,
+            DROP_NEWEST
+        };
+
+        SafeQueue(int capacity = 1, DropPolicy policy = DROP_OLDEST)
+        {
+            _capacity = capacity < 1 ? 1 : capacity;
+            _policy = policy;
+            _closed = false;
+            _dropped = 0;
+        }
+
+        // Blocks until an item is available.  Returns false once the queue is closed and drained.
+        bool pop(T& item)
         {
             tthread::lock_guard<tthread::mutex> mlock(_mutex);
-            while (_queue.empty()) {
+            while (_queue.empty() && !_closed) {
                 _cond.wait(_mutex);
             }
-            T val = _queue.front();
-            _queue.pop();
-            return val;
+            if (_queue.empty())
+                return false;
+
+            item = _queue.front();
+            _queue.pop_front();
+            return true;
         }
 
-        void push(const T& item)
+        // Returns false if an item (this one or the oldest queued) was dropped to make room
+        bool push(const T& item)
         {
             tthread::lock_guard<tthread::mutex> mlock(_mutex);
-            _queue.push(item);
+            bool kept = true;
+            if ((int) _queue.size() >= _capacity)
+            {
+                _dropped++;
+                kept = false;
+                if (_policy == DROP_NEWEST)
+                    return false;
+                _queue.pop_front();
+            }
+            _queue.push_back(item);
             _cond.notify_one();
+            return kept;
+        }
+
+        // Wakes every consumer; pop() fails once the remaining items are taken
+        void close()
+        {
+            tthread::lock_guard<tthread::mutex> mlock(_mutex);
+            _closed = true;
+            _cond.notify_all();
         }
 
         bool empty()
         {
+            tthread::lock_guard<tthread::mutex> mlock(_mutex);
             return _queue.empty();
         }
 
+        int size()
+        {
+            tthread::lock_guard<tthread::mutex> mlock(_mutex);
+            return (int) _queue.size();
+        }
+
+        int capacity()
+        {
+            return _capacity;
+        }
+
+        // Items discarded because the queue was full
+        uint64_t dropped()
+        {
+            tthread::lock_guard<tthread::mutex> mlock(_mutex);
+            return _dropped;
+        }
+
     private:
-        std::queue<T> _queue;
+        std::deque<T> _queue;
+        int _capacity;
+        DropPolicy _policy;
+        bool _closed;
+        uint64_t _dropped;
         tthread::mutex _mutex;
         tthread::condition_variable _cond;
 };
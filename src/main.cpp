@@ -22,6 +22,7 @@
 #include <iostream>
 #include <iterator>
 #include <algorithm>
+#include <map>
 #include <signal.h>
 #include <poll.h>
 
@@ -36,6 +37,7 @@
 #include "motiondetector.h"
 #include "alpr.h"
 #include "recognition_worker_process.h"
+#include "image_prefetcher.h"
 
 using namespace alpr;
 
@@ -44,14 +46,22 @@ const std::string MAIN_WINDOW_NAME = "ALPR main window";
 const bool SAVE_LAST_VIDEO_STILL = false;
 const std::string LAST_VIDEO_STILL_LOCATION = "/tmp/laststill.jpg";
 const std::string WEBCAM_PREFIX = "/dev/video";
-MotionDetector motiondetector;
+// With --jobs, each worker holds this many images so it never waits on the parent between them
+const int JOBS_IN_FLIGHT_PER_WORKER = 2;
+// Created once OpenALPR's config is loaded, if --motion is set
+MotionDetector* motiondetector = NULL;
 bool do_motiondetection = true;
 
 /** Function Headers */
 bool detectandshow(Alpr* alpr, cv::Mat frame, std::string region, bool writeJson);
+bool detectandshowJpeg(Alpr* alpr, const std::vector<unsigned char>& jpegBytes, bool writeJson);
+bool showResults(const AlprResults& results, const timespec& startTime, bool writeJson);
 void print_results(const AlprResults& results, bool writeJson);
-int processImagesParallel(const std::vector<std::string>& filenames, const std::string& country, const std::string& configFile, bool detectRegion, const std::string& templatePattern, int topn, bool debug_mode, bool outputJson, int jobs);
+void print_parallel_result(const RecognitionWorkerProcess::Result& result, const std::string& imagePath, bool outputJson);
+int processImagesParallel(const std::vector<std::string>& filenames, const std::string& country, const std::string& configFile, bool detectRegion, const std::string& templatePattern, int topn, bool debug_mode, bool outputJson, int jobs, bool prefork, bool orderedOutput);
 bool is_supported_image(std::string image_file);
+void recognizePrefetched(Alpr* alpr, ImagePrefetcher& prefetcher, bool printPaths, bool outputJson);
+void abandonWorker(RecognitionWorkerProcess& worker, const std::string& reason, std::vector<RecognitionWorkerProcess::Result>& results);
 
 bool measureProcessingTime = false;
 std::string templatePattern;
@@ -71,6 +81,10 @@ int main( int argc, const char** argv )
   int topn;
   bool debug_mode = false;
   int jobs = 1;
+  bool prefork = false;
+  bool orderedOutput = false;
+  int prefetchThreads = 2;
+  bool trackPlates = true;
 
   TCLAP::CmdLine cmd("OpenAlpr Command Line Utility", ' ', Alpr::getVersion());
 
@@ -82,6 +96,7 @@ int main( int argc, const char** argv )
   TCLAP::ValueArg<std::string> configFileArg("","config","Path to the openalpr.conf file",false, "" ,"config_file");
   TCLAP::ValueArg<std::string> templatePatternArg("p","pattern","Attempt to match the plate number against a plate pattern (e.g., md for Maryland, ca for California)",false, "" ,"pattern code");
   TCLAP::ValueArg<int> topNArg("n","topn","Max number of possible plate numbers to return.  Default=10",false, 10 ,"topN");
+  TCLAP::ValueArg<int> prefetchArg("","prefetch","Number of threads reading and decoding images ahead of recognition for directories and stdin path lists.  0 decodes each image when it is needed.  Default=2",false, 2 ,"threads");
   TCLAP::ValueArg<int> jobsArg("","jobs","Number of parallel worker processes for image files.  Default=1 (synchronous)",false, 1 ,"jobs");
 
   TCLAP::SwitchArg jsonSwitch("j","json","Output recognition results in JSON format.  Default=off", cmd, false);
@@ -89,6 +104,9 @@ int main( int argc, const char** argv )
   TCLAP::SwitchArg detectRegionSwitch("d","detect_region","Attempt to detect the region of the plate image.  [Experimental]  Default=off", cmd, false);
   TCLAP::SwitchArg clockSwitch("","clock","Measure/print the total time to process image and all plates.  Default=off", cmd, false);
   TCLAP::SwitchArg motiondetect("", "motion", "Use motion detection on video file or stream.  Default=off", cmd, false);
+  TCLAP::SwitchArg orderedSwitch("", "ordered", "With --jobs, print results in input order rather than as each image finishes.  Default=off", cmd, false);
+  TCLAP::SwitchArg preforkSwitch("", "prefork", "With --jobs, load OpenALPR once and fork the workers from it, sharing its memory.  Default=off", cmd, false);
+  TCLAP::SwitchArg noTrackSwitch("", "no_track", "OCR every plate on every video frame, rather than reusing the read of a plate that stays in view.  Default=off", cmd, false);
 
   try
   {
@@ -96,6 +114,7 @@ int main( int argc, const char** argv )
     cmd.add( seekToMsArg );
     cmd.add( topNArg );
     cmd.add( jobsArg );
+    cmd.add( prefetchArg );
     cmd.add( configFileArg );
     cmd.add( fileArg );
     cmd.add( countryCodeArg );
@@ -120,6 +139,10 @@ int main( int argc, const char** argv )
     measureProcessingTime = clockSwitch.getValue();
 	do_motiondetection = motiondetect.getValue();
     jobs = jobsArg.getValue();
+    prefork = preforkSwitch.getValue();
+    orderedOutput = orderedSwitch.getValue();
+    prefetchThreads = std::max(0, prefetchArg.getValue());
+    trackPlates = !noTrackSwitch.getValue();
   }
   catch (TCLAP::ArgException &e)    // catch any exceptions
   {
@@ -127,16 +150,37 @@ int main( int argc, const char** argv )
     return 1;
   }
 
-  // Fast path: parallel processing for lists of image files only.
+  // Fast path: parallel processing for image files and directories of them only.
   bool parallelEligible = jobs > 1;
+  std::vector<std::string> imageFiles;
   if (parallelEligible)
   {
     for (unsigned int i = 0; i < filenames.size(); i++)
     {
       const std::string& filename = filenames[i];
-      if (!is_supported_image(filename) || filename == "-" || filename == "stdin" ||
+      if (filename == "-" || filename == "stdin" ||
           startsWith(filename, "http://") || startsWith(filename, "https://") ||
-          filename == "webcam" || DirectoryExists(filename.c_str()))
+          filename == "webcam")
+      {
+        parallelEligible = false;
+        break;
+      }
+
+      if (DirectoryExists(filename.c_str()))
+      {
+        std::vector<std::string> files = getFilesInDir(filename.c_str());
+        std::sort(files.begin(), files.end(), stringCompare);
+        for (unsigned int f = 0; f < files.size(); f++)
+        {
+          if (is_supported_image(files[f]))
+            imageFiles.push_back(filename + "/" + files[f]);
+        }
+      }
+      else if (is_supported_image(filename))
+      {
+        imageFiles.push_back(filename);
+      }
+      else
       {
         parallelEligible = false;
         break;
@@ -146,11 +190,11 @@ int main( int argc, const char** argv )
 
   if (parallelEligible)
   {
-    return processImagesParallel(filenames, country, configFile, detectRegion, templatePattern, topn, debug_mode, outputJson, jobs);
+    return processImagesParallel(imageFiles, country, configFile, detectRegion, templatePattern, topn, debug_mode, outputJson, jobs, prefork, orderedOutput);
   }
   else if (jobs > 1)
   {
-    std::cerr << "Parallel mode (--jobs) is only supported for image file inputs. Running sequentially." << std::endl;
+    std::cerr << "Parallel mode (--jobs) is only supported for image files and directories. Running sequentially." << std::endl;
   }
   
   cv::Mat frame;
@@ -175,24 +219,26 @@ int main( int argc, const char** argv )
     return 1;
   }
 
+  if (do_motiondetection)
+    motiondetector = new MotionDetector(alpr.getConfig());
+
+  // With reduced_decode, JPEGs go to the library still encoded so it can detect on a
+  // reduced decode.  Motion detection needs the decoded frame, so it keeps them decoded.
+  bool keepJpegBytes = alpr.getConfig()->reducedDecode && motiondetector == NULL;
+  std::vector<unsigned char> jpegBytes;
+
   for (unsigned int i = 0; i < filenames.size(); i++)
   {
     std::string filename = filenames[i];
 
     if (filename == "-")
     {
-      std::vector<uchar> data;
-      int c;
-
-      while ((c = fgetc(stdin)) != EOF)
+      if (ImagePrefetcher::readImage(filename, frame, keepJpegBytes ? &jpegBytes : NULL) == ImagePrefetcher::Item::OK)
       {
-        data.push_back((uchar) c);
-      }
-
-      frame = cv::imdecode(cv::Mat(data), 1);
-      if (!frame.empty())
-      {
-        detectandshow(&alpr, frame, "", outputJson);
+        if (!jpegBytes.empty())
+          detectandshowJpeg(&alpr, jpegBytes, outputJson);
+        else
+          detectandshow(&alpr, frame, "", outputJson);
       }
       else
       {
@@ -201,20 +247,9 @@ int main( int argc, const char** argv )
     }
     else if (filename == "stdin")
     {
-      std::string filename;
-      while (std::getline(std::cin, filename))
-      {
-        if (fileExists(filename.c_str()))
-        {
-          frame = cv::imread(filename);
-          detectandshow(&alpr, frame, "", outputJson);
-        }
-        else
-        {
-          std::cerr << "Image file not found: " << filename << std::endl;
-        }
-
-      }
+      ImagePrefetcher prefetcher(prefetchThreads, prefetchThreads * 2, keepJpegBytes);
+      prefetcher.start(std::cin);
+      recognizePrefetched(&alpr, prefetcher, false, outputJson);
     }
     else if (filename == "webcam" || startsWith(filename, WEBCAM_PREFIX))
     {
@@ -234,14 +269,16 @@ int main( int argc, const char** argv )
         return 1;
       }
 
+      if (motiondetector != NULL)
+        motiondetector->restart();
+      alpr.setPlateTracking(trackPlates);
       while (cap.read(frame))
       {
-        if (framenum == 0)
-          motiondetector.ResetMotionDetection(&frame);
         detectandshow(&alpr, frame, "", outputJson);
         sleep_ms(10);
         framenum++;
       }
+      alpr.setPlateTracking(alpr.getConfig()->plateTracking);
     }
     else if (startsWith(filename, "http://") || startsWith(filename, "https://"))
     {
@@ -253,6 +290,9 @@ int main( int argc, const char** argv )
 
       cv::Mat latestFrame;
 
+      if (motiondetector != NULL)
+        motiondetector->restart();
+      alpr.setPlateTracking(trackPlates);
       while (program_active)
       {
         std::vector<cv::Rect> regionsOfInterest;
@@ -260,8 +300,6 @@ int main( int argc, const char** argv )
 
         if (response != -1)
         {
-          if (framenum == 0)
-            motiondetector.ResetMotionDetection(&latestFrame);
           detectandshow(&alpr, latestFrame, "", outputJson);
         }
 
@@ -271,6 +309,7 @@ int main( int argc, const char** argv )
       }
 
       videoBuffer.disconnect();
+      alpr.setPlateTracking(alpr.getConfig()->plateTracking);
 
       std::cout << "Video processing ended" << std::endl;
     }
@@ -289,6 +328,10 @@ int main( int argc, const char** argv )
         cap.open(filename);
         cap.set(cv::CAP_PROP_POS_MSEC, seektoms);
 
+        // Each video starts a new background
+        if (motiondetector != NULL)
+          motiondetector->restart();
+        alpr.setPlateTracking(trackPlates);
         while (cap.read(frame))
         {
           if (SAVE_LAST_VIDEO_STILL)
@@ -298,13 +341,12 @@ int main( int argc, const char** argv )
           if (!outputJson)
             std::cout << "Frame: " << framenum << std::endl;
           
-          if (framenum == 0)
-            motiondetector.ResetMotionDetection(&frame);
           detectandshow(&alpr, frame, "", outputJson);
           //create a 1ms delay
           sleep_ms(1);
           framenum++;
         }
+        alpr.setPlateTracking(alpr.getConfig()->plateTracking);
       }
       else
       {
@@ -315,9 +357,12 @@ int main( int argc, const char** argv )
     {
       if (fileExists(filename.c_str()))
       {
-        frame = cv::imread(filename);
-
-        bool plate_found = detectandshow(&alpr, frame, "", outputJson);
+        bool plate_found = false;
+        if (ImagePrefetcher::readImage(filename, frame, keepJpegBytes ? &jpegBytes : NULL) == ImagePrefetcher::Item::OK &&
+            !jpegBytes.empty())
+          plate_found = detectandshowJpeg(&alpr, jpegBytes, outputJson);
+        else
+          plate_found = detectandshow(&alpr, frame, "", outputJson);
 
         if (!plate_found && !outputJson)
           std::cout << "No license plates found." << std::endl;
@@ -333,23 +378,16 @@ int main( int argc, const char** argv )
 
       std::sort(files.begin(), files.end(), stringCompare);
 
+      std::vector<std::string> imagePaths;
       for (int i = 0; i < files.size(); i++)
       {
         if (is_supported_image(files[i]))
-        {
-          std::string fullpath = filename + "/" + files[i];
-          std::cout << fullpath << std::endl;
-          frame = cv::imread(fullpath.c_str());
-          if (detectandshow(&alpr, frame, "", outputJson))
-          {
-            //while ((char) cv::waitKey(50) != 'c') { }
-          }
-          else
-          {
-            //cv::waitKey(50);
-          }
-        }
+          imagePaths.push_back(filename + "/" + files[i]);
       }
+
+      ImagePrefetcher prefetcher(prefetchThreads, prefetchThreads * 2, keepJpegBytes);
+      prefetcher.start(imagePaths);
+      recognizePrefetched(&alpr, prefetcher, true, outputJson);
     }
     else
     {
@@ -408,22 +446,77 @@ void print_results(const AlprResults& results, bool writeJson)
 }
 
 
+// Recognizes each image the prefetcher decodes, in input order
+void recognizePrefetched(Alpr* alpr, ImagePrefetcher& prefetcher, bool printPaths, bool outputJson)
+{
+  timespec startTime;
+  getTimeMonotonic(&startTime);
+
+  int imageCount = 0;
+  ImagePrefetcher::Item item;
+  while (prefetcher.next(item))
+  {
+    if (item.status == ImagePrefetcher::Item::NOT_FOUND)
+    {
+      std::cerr << "Image file not found: " << item.path << std::endl;
+      continue;
+    }
+    if (item.status == ImagePrefetcher::Item::DECODE_FAILED)
+    {
+      std::cerr << "Image invalid: " << item.path << std::endl;
+      continue;
+    }
+
+    if (printPaths)
+      std::cout << item.path << std::endl;
+    if (!item.jpegBytes.empty())
+      detectandshowJpeg(alpr, item.jpegBytes, outputJson);
+    else
+      detectandshow(alpr, item.frame, "", outputJson);
+    imageCount++;
+  }
+
+  if (measureProcessingTime)
+  {
+    timespec endTime;
+    getTimeMonotonic(&endTime);
+    double totalMs = diffclock(startTime, endTime);
+    std::cout << "Processed " << imageCount << " images in " << totalMs << "ms (" << (totalMs > 0 ? imageCount * 1000.0 / totalMs : 0) << " images/sec)." << std::endl;
+  }
+}
+
 bool detectandshow( Alpr* alpr, cv::Mat frame, std::string region, bool writeJson)
 {
 
   timespec startTime;
   getTimeMonotonic(&startTime);
 
+  // With motion detection, only the areas that moved are searched, and a frame
+  // without motion is skipped
   std::vector<AlprRegionOfInterest> regionsOfInterest;
-  if (do_motiondetection)
-  {
-	  cv::Rect rectan = motiondetector.MotionDetect(&frame);
-	  if (rectan.width>0) regionsOfInterest.push_back(AlprRegionOfInterest(rectan.x, rectan.y, rectan.width, rectan.height));
-  }
+  if (motiondetector != NULL)
+	  regionsOfInterest = MotionDetector::toRegionsOfInterest(motiondetector->detect(frame));
   else regionsOfInterest.push_back(AlprRegionOfInterest(0, 0, frame.cols, frame.rows));
   AlprResults results;
   if (regionsOfInterest.size()>0) results = alpr->recognize(frame.data, frame.elemSize(), frame.cols, frame.rows, regionsOfInterest);
 
+  return showResults(results, startTime, writeJson);
+}
+
+// Recognizes a JPEG from its encoded bytes, which lets the library detect on a reduced decode
+bool detectandshowJpeg(Alpr* alpr, const std::vector<unsigned char>& jpegBytes, bool writeJson)
+{
+  timespec startTime;
+  getTimeMonotonic(&startTime);
+
+  // No regions of interest searches the whole frame
+  AlprResults results = alpr->recognize(jpegBytes.data(), jpegBytes.size(), std::vector<AlprRegionOfInterest>());
+
+  return showResults(results, startTime, writeJson);
+}
+
+bool showResults(const AlprResults& results, const timespec& startTime, bool writeJson)
+{
   timespec endTime;
   getTimeMonotonic(&endTime);
   double totalProcessingTime = diffclock(startTime, endTime);
@@ -446,7 +539,23 @@ bool detectandshow( Alpr* alpr, cv::Mat frame, std::string region, bool writeJso
 }
 
 
-int processImagesParallel(const std::vector<std::string>& filenames, const std::string& country, const std::string& configFile, bool detectRegion, const std::string& templatePatternParam, int topn, bool debug_mode, bool outputJson, int jobs)
+// Stops a worker that can no longer be reached.  Its unfinished images are reported as
+// lost.
+void abandonWorker(RecognitionWorkerProcess& worker, const std::string& reason, std::vector<RecognitionWorkerProcess::Result>& results)
+{
+  std::cerr << reason << " with " << worker.jobsInFlight().size() << " images unfinished" << std::endl;
+  for (size_t j = 0; j < worker.jobsInFlight().size(); j++)
+  {
+    RecognitionWorkerProcess::Result lost;
+    lost.jobId = worker.jobsInFlight()[j];
+    lost.ok = false;
+    lost.lost = true;
+    results.push_back(lost);
+  }
+  worker.stop();
+}
+
+int processImagesParallel(const std::vector<std::string>& filenames, const std::string& country, const std::string& configFile, bool detectRegion, const std::string& templatePatternParam, int topn, bool debug_mode, bool outputJson, int jobs, bool prefork, bool orderedOutput)
 {
   if (filenames.size() == 0)
     return 0;
@@ -461,100 +570,171 @@ int processImagesParallel(const std::vector<std::string>& filenames, const std::
   params.debug = debug_mode;
   params.measureProcessingTime = measureProcessingTime;
 
-  struct WorkerState
+  timespec startTime;
+  getTimeMonotonic(&startTime);
+
+  // Loaded here and inherited by every worker, so the models are parsed once and
+  // their pages stay shared until a worker writes to them
+  Alpr* preloaded = NULL;
+  if (prefork)
   {
-    RecognitionWorkerProcess proc;
-    bool busy;
-    std::string currentFile;
-    WorkerState(const RecognitionWorkerProcess::Params& p) : proc(p), busy(false) {}
-  };
+    preloaded = new Alpr(country, configFile);
+    preloaded->setTopN(topn);
+    if (detectRegion) preloaded->setDetectRegion(true);
+    if (!templatePatternParam.empty()) preloaded->setDefaultRegion(templatePatternParam);
+    if (debug_mode) preloaded->getConfig()->setDebug(true);
+
+    if (!preloaded->isLoaded())
+    {
+      std::cerr << "Error loading OpenALPR" << std::endl;
+      delete preloaded;
+      return 1;
+    }
+    preloaded->warmUp();
+    params.preloaded = preloaded;
+  }
+
+  // A worker that dies leaves a closed pipe behind; writing to it should fail with EPIPE
+  // and be handled below rather than kill the CLI
+  signal(SIGPIPE, SIG_IGN);
 
-  std::vector<WorkerState> workers;
+  std::vector<RecognitionWorkerProcess> workers(workerCount, RecognitionWorkerProcess(params));
   for (int i = 0; i < workerCount; i++)
   {
-    workers.push_back(WorkerState(params));
-    if (!workers.back().proc.start())
+    if (!workers[i].start())
     {
       std::cerr << "Failed to start worker process " << i << std::endl;
       return 1;
     }
   }
 
+  if (measureProcessingTime)
+  {
+    timespec endTime;
+    getTimeMonotonic(&endTime);
+    std::cout << "Started " << workerCount << " workers" << (prefork ? " (prefork)" : "") << " in " << diffclock(startTime, endTime) << "ms." << std::endl;
+  }
+
+  // Job ids are indexes into filenames.  With orderedOutput, results that finish
+  // early wait here until everything before them has been printed.
+  std::map<size_t, RecognitionWorkerProcess::Result> finished;
+  size_t nextToPrint = 0;
   size_t nextFileIdx = 0;
-  int active = 0;
+  size_t completed = 0;
+  size_t lostJobs = 0;
+  std::vector<bool> alive(workerCount, true);
+  std::vector<RecognitionWorkerProcess::Result> results;
 
-  while (nextFileIdx < filenames.size() || active > 0)
+  while (completed < filenames.size())
   {
-    for (int i = 0; i < workerCount && nextFileIdx < filenames.size(); i++)
+    // Hand out jobs level by level, so idle workers are fed before busy ones get a
+    // second job queued behind the one they are working on
+    for (int level = 0; level < JOBS_IN_FLIGHT_PER_WORKER; level++)
     {
-      if (workers[i].busy)
-        continue;
-
-      std::string file = filenames[nextFileIdx];
-      nextFileIdx++; // always advance to avoid infinite retry on a bad file
-      if (!workers[i].proc.sendJob(file))
+      for (int i = 0; i < workerCount && nextFileIdx < filenames.size(); i++)
       {
-        std::cerr << "Failed to send job to worker" << std::endl;
-        continue;
+        if (alive[i] && (int) workers[i].jobsInFlight().size() <= level)
+        {
+          workers[i].queueJob(nextFileIdx, filenames[nextFileIdx]);
+          nextFileIdx++;
+        }
       }
-      workers[i].busy = true;
-      workers[i].currentFile = file;
-      active++;
     }
 
-    if (active == 0)
-      break;
-
+    results.clear();
     std::vector<pollfd> fds;
     std::vector<int> idxmap;
     for (int i = 0; i < workerCount; i++)
     {
-      if (!workers[i].busy) continue;
+      if (!alive[i] || workers[i].jobsInFlight().empty())
+        continue;
+
+      if (!workers[i].flush())
+      {
+        std::stringstream reason;
+        reason << "Failed to send jobs to worker " << i;
+        abandonWorker(workers[i], reason.str(), results);
+        alive[i] = false;
+        continue;
+      }
+
       pollfd pfd;
-      pfd.fd = workers[i].proc.readFd();
+      pfd.fd = workers[i].readFd();
       pfd.events = POLLIN;
       pfd.revents = 0;
       fds.push_back(pfd);
       idxmap.push_back(i);
     }
 
-    int ret = poll(fds.data(), fds.size(), 500);
-    if (ret <= 0)
-      continue;
+    if (fds.empty() && results.empty())
+    {
+      std::cerr << "All worker processes exited" << std::endl;
+      return 1;
+    }
 
-    for (size_t f = 0; f < fds.size(); f++)
+    if (!fds.empty() && poll(fds.data(), fds.size(), 500) > 0)
     {
-      if (!(fds[f].revents & POLLIN))
-        continue;
-      int widx = idxmap[f];
-      std::string imagePath;
-      std::string json;
-      if (!workers[widx].proc.readResult(imagePath, json))
+      for (size_t f = 0; f < fds.size(); f++)
       {
-        workers[widx].busy = false;
-        active--;
-        continue;
+        if (!(fds[f].revents & (POLLIN | POLLHUP)))
+          continue;
+        int widx = idxmap[f];
+        if (!workers[widx].readResults(results))
+        {
+          std::stringstream reason;
+          reason << "Worker process " << widx << " exited";
+          abandonWorker(workers[widx], reason.str(), results);
+          alive[widx] = false;
+        }
       }
-      workers[widx].busy = false;
-      active--;
+    }
 
-      AlprResults results = Alpr::fromJson(json);
+    for (size_t r = 0; r < results.size(); r++)
+    {
+      completed++;
+      if (results[r].lost)
+        lostJobs++;
+      if (!orderedOutput)
+      {
+        print_parallel_result(results[r], filenames[results[r].jobId], outputJson);
+        continue;
+      }
 
-      if (outputJson)
-        print_results(results, true);
-      else
+      finished[results[r].jobId] = results[r];
+      while (finished.count(nextToPrint) > 0)
       {
-        if (results.plates.size() == 0)
-          std::cout << "No license plates found for " << imagePath << "." << std::endl;
-        else
-          print_results(results, false);
+        print_parallel_result(finished[nextToPrint], filenames[nextToPrint], outputJson);
+        finished.erase(nextToPrint);
+        nextToPrint++;
       }
     }
   }
 
   for (int i = 0; i < workerCount; i++)
-    workers[i].proc.stop();
+    workers[i].stop();
 
+  delete preloaded;
+
+  if (lostJobs > 0)
+  {
+    std::cerr << lostJobs << " images were not processed" << std::endl;
+    return 1;
+  }
   return 0;
 }
 
+void print_parallel_result(const RecognitionWorkerProcess::Result& result, const std::string& imagePath, bool outputJson)
+{
+  if (result.lost)
+    std::cerr << "Image not processed: " << imagePath << std::endl;
+  else if (!result.ok && !fileExists(imagePath.c_str()))
+    std::cerr << "Image file not found: " << imagePath << std::endl;
+  else if (!result.ok)
+    std::cerr << "Image invalid: " << imagePath << std::endl;
+  else if (outputJson)
+    print_results(result.results, true);
+  else if (result.results.plates.size() == 0)
+    std::cout << "No license plates found for " << imagePath << "." << std::endl;
+  else
+    print_results(result.results, false);
+}
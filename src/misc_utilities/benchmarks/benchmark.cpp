@@ -22,6 +22,7 @@
 
 #include <iostream>
 #include <fstream>
+#include <iterator>
 #include <stdio.h>
 #include <sys/stat.h>
 #include <numeric>      // std::accumulate
@@ -33,6 +34,8 @@
 #include "detection/detectorfactory.h"
 #include "ocr/ocrfactory.h"
 #include "support/filesystem.h"
+#include "binarize_wolf.h"
+#include "../statedetection/featurematcher.h"
 
 using namespace std;
 using namespace cv;
@@ -68,7 +71,7 @@ int main( int argc, const char** argv )
     printf("Use:\n\t%s [country] [benchmark name] [img input dir] [results output dir]\n",argv[0]);
     printf("\tex: %s us speed ./speed/usimages ./speed\n",argv[0]);
     printf("\n");
-    printf("\ttest names are: speed, segocr, detection\n\n" );
+    printf("\ttest names are: speed, segocr, detection, binarize, stateindex, tiling, decode\n\n" );
     return 0;
   }
 
@@ -284,6 +287,403 @@ int main( int argc, const char** argv )
     outputStats(postProcessTimes);
     cout << endl;
   }
+  else if (benchmarkName.compare("binarize") == 0)
+  {
+    // Compares the per-window binarization used by produceThresholds against the shared
+    // integral version, on a directory of plate crops.  Outputs must match bit for bit.
+    const int ITERATIONS = 20;
+
+    vector<BinarizeWindow> windows(3);
+    windows[0].version = WOLFJOLION;
+    windows[0].winx = windows[0].winy = 18;
+    windows[0].k = 0.05;
+    windows[1].version = WOLFJOLION;
+    windows[1].winx = windows[1].winy = 22;
+    windows[1].k = 0.05 + 0.35;
+    windows[2].version = SAUVOLA;
+    windows[2].winx = windows[2].winy = 12;
+    windows[2].k = 0.18;
+
+    vector<double> separateTimes;
+    vector<double> sharedTimes;
+    int mismatchedImages = 0;
+
+    for (int i = 0; i< files.size(); i++)
+    {
+      if (hasEnding(files[i], ".png") || hasEnding(files[i], ".jpg"))
+      {
+        string fullpath = inDir + "/" + files[i];
+        Mat gray = imread( fullpath.c_str(), IMREAD_GRAYSCALE );
+        if (gray.empty())
+          continue;
+
+        vector<Mat> separate(windows.size());
+        timespec startTime;
+        timespec endTime;
+
+        getTimeMonotonic(&startTime);
+        for (int iter = 0; iter < ITERATIONS; iter++)
+        {
+          for (unsigned int w = 0; w < windows.size(); w++)
+          {
+            separate[w] = Mat(gray.size(), CV_8U);
+            NiblackSauvolaWolfJolion(gray, separate[w], windows[w].version, windows[w].winx, windows[w].winy, windows[w].k);
+            bitwise_not(separate[w], separate[w]);
+          }
+        }
+        getTimeMonotonic(&endTime);
+        separateTimes.push_back(diffclock(startTime, endTime) / ITERATIONS);
+
+        vector<Mat> shared;
+        getTimeMonotonic(&startTime);
+        for (int iter = 0; iter < ITERATIONS; iter++)
+          NiblackSauvolaWolfJolionInv(gray, windows, shared);
+        getTimeMonotonic(&endTime);
+        sharedTimes.push_back(diffclock(startTime, endTime) / ITERATIONS);
+
+        for (unsigned int w = 0; w < windows.size(); w++)
+        {
+          Mat diff;
+          compare(separate[w], shared[w], diff, CMP_NE);
+          if (countNonZero(diff) > 0)
+          {
+            cout << files[i] << ": window " << w << " differs in " << countNonZero(diff) << " pixels" << endl;
+            mismatchedImages++;
+            break;
+          }
+        }
+      }
+    }
+
+    cout << "Separate windows (3x integral + bitwise_not):" << endl;
+    outputStats(separateTimes);
+    cout << "Shared integral, inverted output:" << endl;
+    outputStats(sharedTimes);
+    cout << "Images with differing output: " << mismatchedImages << endl;
+  }
+  else if (benchmarkName.compare("stateindex") == 0)
+  {
+    // Compares brute-force state matching against the LSH index as the reference set grows.
+    // Each set is built in the output dir from warped, noisy copies of the country's keypoint
+    // images; the input dir holds plate crops named [statecode]#.png to query with.
+    const int SET_SIZES[] = { 50, 500, 1000, 2000, 5000 };
+    const int SHORTLIST = 8;
+
+    Config config(country);
+    string sourceDir = config.getKeypointsRuntimeDir() + "/" + country + "/";
+    vector<string> sources;
+    vector<string> sourceFiles = getFilesInDir(sourceDir.c_str());
+    sort( sourceFiles.begin(), sourceFiles.end(), stringCompare );
+    for (unsigned int i = 0; i < sourceFiles.size(); i++)
+    {
+      if (hasEnding(sourceFiles[i], ".jpg"))
+        sources.push_back(sourceFiles[i]);
+    }
+    if (sources.size() == 0)
+    {
+      printf("No keypoint images in %s\n", sourceDir.c_str());
+      return 0;
+    }
+
+    vector<Mat> queries;
+    vector<string> queryCodes;
+    for (int i = 0; i< files.size(); i++)
+    {
+      if (hasEnding(files[i], ".png") || hasEnding(files[i], ".jpg"))
+      {
+        string fullpath = inDir + "/" + files[i];
+        Mat query = imread( fullpath.c_str(), IMREAD_GRAYSCALE );
+        if (query.empty())
+          continue;
+        queries.push_back(query);
+        queryCodes.push_back(files[i].substr(0, 2));
+      }
+    }
+
+    RNG rng(12345);
+    for (unsigned int s = 0; s < sizeof(SET_SIZES) / sizeof(SET_SIZES[0]); s++)
+    {
+      int setSize = SET_SIZES[s];
+      stringstream setRoot;
+      setRoot << outDir << "/stateindex_" << setSize;
+      string keypointDir = setRoot.str() + "/keypoints/" + country;
+      makePath(keypointDir.c_str(), 0755);
+
+      for (int i = 0; i < setSize; i++)
+      {
+        // The first pass over the sources keeps them as they are
+        string source = sources[i % sources.size()];
+        stringstream name;
+        name << keypointDir << "/" << source.substr(0, 2) << "_" << i << ".jpg";
+        if (fileExists(name.str().c_str()))
+          continue;
+
+        Mat img = imread(sourceDir + source, IMREAD_GRAYSCALE);
+        if (i >= (int) sources.size())
+        {
+          Point2f center(img.cols / 2.0f, img.rows / 2.0f);
+          Mat warp = getRotationMatrix2D(center, rng.uniform(-6.0, 6.0), rng.uniform(0.9, 1.1));
+          warp.at<double>(0, 2) += rng.uniform(-4.0, 4.0);
+          warp.at<double>(1, 2) += rng.uniform(-4.0, 4.0);
+          warpAffine(img, img, warp, img.size(), INTER_LINEAR, BORDER_REPLICATE);
+
+          Mat noise(img.size(), CV_16S);
+          rng.fill(noise, RNG::NORMAL, 0, 6);
+          Mat noisy;
+          img.convertTo(noisy, CV_16S);
+          noisy += noise;
+          noisy.convertTo(img, CV_8U);
+        }
+        imwrite(name.str(), img);
+      }
+
+      FeatureMatcher bruteForce;
+      FeatureMatcher lsh;
+      bruteForce.setMatcher("bruteforce", SHORTLIST);
+      lsh.setMatcher("lsh", SHORTLIST);
+      bruteForce.loadRecognitionSet(setRoot.str(), country);
+      lsh.loadRecognitionSet(setRoot.str(), country);
+
+      vector<double> bruteForceTimes;
+      vector<double> lshTimes;
+      int agreed = 0;
+      int bruteForceCorrect = 0;
+      int lshCorrect = 0;
+      vector<int> matchesArray(bruteForce.numTrainingElements());
+
+      for (unsigned int q = 0; q < queries.size(); q++)
+      {
+        timespec startTime;
+        timespec endTime;
+
+        getTimeMonotonic(&startTime);
+        RecognitionResult expected = bruteForce.recognize(queries[q], false, NULL, false, matchesArray);
+        getTimeMonotonic(&endTime);
+        bruteForceTimes.push_back(diffclock(startTime, endTime));
+
+        getTimeMonotonic(&startTime);
+        RecognitionResult actual = lsh.recognize(queries[q], false, NULL, false, matchesArray);
+        getTimeMonotonic(&endTime);
+        lshTimes.push_back(diffclock(startTime, endTime));
+
+        if (expected.haswinner == actual.haswinner && (!expected.haswinner || expected.winner == actual.winner))
+          agreed++;
+        if (expected.haswinner && expected.winner == queryCodes[q])
+          bruteForceCorrect++;
+        if (actual.haswinner && actual.winner == queryCodes[q])
+          lshCorrect++;
+      }
+
+      cout << "Reference set of " << bruteForce.numTrainingElements() << " images, " << queries.size() << " queries" << endl;
+      cout << "Brute force:" << endl;
+      outputStats(bruteForceTimes);
+      cout << "LSH index, shortlist of " << SHORTLIST << ":" << endl;
+      outputStats(lshTimes);
+      cout << "\tLSH agrees with brute force on " << agreed << " / " << queries.size() << endl;
+      cout << "\tCorrect state: brute force " << bruteForceCorrect << ", LSH " << lshCorrect << endl;
+      cout << endl;
+    }
+  }
+  else if (benchmarkName.compare("tiling") == 0)
+  {
+    // Compares plate detection at the configured max_detection_input size against full
+    // resolution, scanned in one pass and in tiles.  Boxes the full-resolution pass finds
+    // are looked for among the tiled boxes.  Tiles are sized from the maximum plate size, so
+    // set max_plate_width_percent/max_plate_height_percent or there is only one tile.
+    const float SAME_BOX_OVERLAP = 0.5;
+
+    Config config(country);
+    config.setDebug(false);
+    PreWarp prewarp(&config);
+    Detector* plateDetector = createDetector(&config, &prewarp);
+
+    int configuredWidth = config.maxDetectionInputWidth;
+    int configuredHeight = config.maxDetectionInputHeight;
+
+    vector<double> downscaledTimes;
+    vector<double> fullTimes;
+    vector<double> tiledTimes;
+    int downscaledBoxes = 0;
+    int fullBoxes = 0;
+    int tiledBoxes = 0;
+    int fullBoxesFoundTiled = 0;
+
+    for (int i = 0; i< files.size(); i++)
+    {
+      if (hasEnding(files[i], ".png") || hasEnding(files[i], ".jpg"))
+      {
+        string fullpath = inDir + "/" + files[i];
+        frame = imread( fullpath.c_str(), IMREAD_GRAYSCALE );
+        if (frame.empty())
+          continue;
+
+        timespec startTime;
+        timespec endTime;
+
+        config.detectionTiling = false;
+        config.maxDetectionInputWidth = configuredWidth;
+        config.maxDetectionInputHeight = configuredHeight;
+        getTimeMonotonic(&startTime);
+        vector<PlateRegion> downscaled = plateDetector->detect(frame);
+        getTimeMonotonic(&endTime);
+        downscaledTimes.push_back(diffclock(startTime, endTime));
+
+        config.maxDetectionInputWidth = frame.cols;
+        config.maxDetectionInputHeight = frame.rows;
+        getTimeMonotonic(&startTime);
+        vector<PlateRegion> full = plateDetector->detect(frame);
+        getTimeMonotonic(&endTime);
+        fullTimes.push_back(diffclock(startTime, endTime));
+
+        config.detectionTiling = true;
+        getTimeMonotonic(&startTime);
+        vector<PlateRegion> tiled = plateDetector->detect(frame);
+        getTimeMonotonic(&endTime);
+        tiledTimes.push_back(diffclock(startTime, endTime));
+
+        // Top-level regions only; children are mostly the same plate again
+        downscaledBoxes += downscaled.size();
+        fullBoxes += full.size();
+        tiledBoxes += tiled.size();
+        for (unsigned int f = 0; f < full.size(); f++)
+        {
+          for (unsigned int t = 0; t < tiled.size(); t++)
+          {
+            float intersection = (full[f].rect & tiled[t].rect).area();
+            float combined = full[f].rect.area() + tiled[t].rect.area() - intersection;
+            if (intersection >= SAME_BOX_OVERLAP * combined)
+            {
+              fullBoxesFoundTiled++;
+              break;
+            }
+          }
+        }
+
+        cout << files[i] << ": " << downscaled.size() << " downscaled, " << full.size() << " full resolution, "
+             << tiled.size() << " tiled" << endl;
+      }
+    }
+
+    cout << "Downscaled to " << configuredWidth << "x" << configuredHeight << " (" << downscaledBoxes << " regions):" << endl;
+    outputStats(downscaledTimes);
+    cout << "Full resolution, one pass (" << fullBoxes << " regions):" << endl;
+    outputStats(fullTimes);
+    cout << "Full resolution, " << config.detectionTileThreads << " tile threads (" << tiledBoxes << " regions):" << endl;
+    outputStats(tiledTimes);
+    cout << "Full resolution regions also found tiled: " << fullBoxesFoundTiled << " / " << fullBoxes << endl;
+
+    delete plateDetector;
+  }
+  else if (benchmarkName.compare("decode") == 0)
+  {
+#if OPENCV_MAJOR_VERSION >= 3
+    // After detecting on a reduced decode, compares getting the full-size pixels for the
+    // regions found by decoding the whole frame (as recognize() used to) with decoding only
+    // the rows around them.  Only JPEGs large enough to reduce at the configured
+    // max_detection_input size, and with regions in them, are counted.
+    Config config(country);
+    config.setDebug(false);
+    PreWarp prewarp(&config);
+    Detector* plateDetector = createDetector(&config, &prewarp);
+
+    if (!canDecodeJpegRows())
+      cout << "Built without jpeg_skip_scanlines, so rows are decoded as a whole frame" << endl;
+
+    vector<double> reducedTimes;
+    vector<double> fullTimes;
+    vector<double> bandTimes;
+    double bandRowPercent = 0;
+
+    for (int i = 0; i< files.size(); i++)
+    {
+      if (hasEnding(files[i], ".jpg"))
+      {
+        string fullpath = inDir + "/" + files[i];
+        ifstream in(fullpath.c_str(), ios::binary);
+        vector<unsigned char> encoded((istreambuf_iterator<char>(in)), istreambuf_iterator<char>());
+
+        int width, height;
+        if (encoded.empty() || !readJpegSize(&encoded[0], encoded.size(), width, height))
+          continue;
+
+        int scale = chooseDecodeReduction(width, height, config.maxDetectionInputWidth, config.maxDetectionInputHeight);
+        if (scale == 1)
+        {
+          cout << files[i] << ": too small to reduce" << endl;
+          continue;
+        }
+
+        Mat encodedMat(1, (int) encoded.size(), CV_8U, &encoded[0]);
+        int flags = scale == 2 ? IMREAD_REDUCED_COLOR_2 : scale == 4 ? IMREAD_REDUCED_COLOR_4 : IMREAD_REDUCED_COLOR_8;
+
+        timespec startTime;
+        timespec endTime;
+
+        getTimeMonotonic(&startTime);
+        Mat reduced = imdecode(encodedMat, flags);
+        getTimeMonotonic(&endTime);
+        if (reduced.empty())
+          continue;
+        double reducedTime = diffclock(startTime, endTime);
+
+        Mat reducedGray;
+        cvtColor(reduced, reducedGray, COLOR_BGR2GRAY);
+        vector<PlateRegion> regions = plateDetector->detect(reducedGray);
+        if (regions.empty())
+        {
+          cout << files[i] << ": no regions" << endl;
+          continue;
+        }
+
+        if ((reduced.cols > reduced.rows) != (width > height))
+          std::swap(width, height);
+        scalePlateRegionsUp(regions, scale, width, height);
+
+        getTimeMonotonic(&startTime);
+        Mat fullColor = imdecode(encodedMat, IMREAD_COLOR);
+        Mat fullGray;
+        cvtColor(fullColor, fullGray, COLOR_BGR2GRAY);
+        getTimeMonotonic(&endTime);
+        fullTimes.push_back(diffclock(startTime, endTime));
+
+        getTimeMonotonic(&startTime);
+        FullResolutionFrame fullRes(&encoded[0], encoded.size(), scale, width, height);
+        Mat bandColor, bandGray;
+        fullRes.get(regions, bandColor, bandGray);
+        getTimeMonotonic(&endTime);
+        bandTimes.push_back(diffclock(startTime, endTime));
+        reducedTimes.push_back(reducedTime);
+
+        vector<Range> bands = plateRowBands(regions, height);
+        int bandRows = 0;
+        for (unsigned int b = 0; b < bands.size(); b++)
+          bandRows += bands[b].size();
+        bandRowPercent += 100.0 * bandRows / height;
+
+        cout << files[i] << ": 1/" << scale << " for detection, " << regions.size() << " regions in "
+             << (100 * bandRows / height) << "% of rows" << endl;
+      }
+    }
+
+    if (bandTimes.empty())
+    {
+      cout << "No reducible JPEGs with plate regions" << endl;
+    }
+    else
+    {
+      cout << "Reduced decode for detection:" << endl;
+      outputStats(reducedTimes);
+      cout << "Full-size pixels, whole frame:" << endl;
+      outputStats(fullTimes);
+      cout << "Full-size pixels, rows around regions (" << (bandRowPercent / bandTimes.size()) << "% of rows on average):" << endl;
+      outputStats(bandTimes);
+    }
+
+    delete plateDetector;
+#else
+    cout << "Reduced decoding needs OpenCV 3 or later" << endl;
+#endif
+  }
   else if (benchmarkName.compare("endtoend") == 0)
   {
     EndToEndTest e2eTest(inDir, outDir);
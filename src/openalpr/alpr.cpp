@@ -19,6 +19,8 @@
 
 #include "alpr.h"
 #include "alpr_impl.h"
+#include "binary_results.h"
+#include "stage_stats.h"
 
 #include <fstream>
 
@@ -65,16 +67,21 @@ namespace alpr
     }
   }
 
-  AlprResults Alpr::recognize(std::vector<char> imageBytes)
+  AlprResults Alpr::recognize(const std::vector<char>& imageBytes)
   {
     return impl->recognize(imageBytes);
   }
 
-  AlprResults Alpr::recognize(std::vector<char> imageBytes, std::vector<AlprRegionOfInterest> regionsOfInterest)
+  AlprResults Alpr::recognize(const std::vector<char>& imageBytes, std::vector<AlprRegionOfInterest> regionsOfInterest)
   {
 	  return impl->recognize(imageBytes, regionsOfInterest);
   }
 
+  AlprResults Alpr::recognize(const unsigned char* encodedBytes, size_t length, std::vector<AlprRegionOfInterest> regionsOfInterest)
+  {
+    return impl->recognize(encodedBytes, length, regionsOfInterest);
+  }
+
   AlprResults Alpr::recognize(unsigned char* pixelData, int bytesPerPixel, int imgWidth, int imgHeight, std::vector<AlprRegionOfInterest> regionsOfInterest)
   {
     return impl->recognize(pixelData, bytesPerPixel, imgWidth, imgHeight, regionsOfInterest);
@@ -93,6 +100,38 @@ namespace alpr
     return AlprImpl::fromJson(json);
   }
 
+  std::string Alpr::toBinary( AlprResults results )
+  {
+    std::string data;
+    writeBinaryResults(results, data);
+    return data;
+  }
+
+  AlprResults Alpr::fromBinary(const std::string& data) {
+    AlprResults results;
+    if (!readBinaryResults(data.data(), data.size(), results))
+    {
+      std::cerr << "Invalid binary results" << std::endl;
+      AlprResults emptyResults;
+      return emptyResults;
+    }
+    return results;
+  }
+
+  std::vector<AlprStageStats> Alpr::getStats()
+  {
+#ifdef OPENALPR_NO_STAGE_STATS
+    return std::vector<AlprStageStats>();
+#else
+    return collectStageStats();
+#endif
+  }
+
+  std::string Alpr::statsToPrometheus(const std::vector<AlprStageStats>& stats, const std::string& labels)
+  {
+    return formatStageStatsPrometheus(stats, labels);
+  }
+
   void Alpr::setCountry(std::string country) {
     impl->setCountry(country);
   }
@@ -121,11 +160,26 @@ namespace alpr
     impl->setDefaultRegion(region);
   }
 
+  void Alpr::setPlateTracking(bool trackPlates)
+  {
+    impl->setPlateTracking(trackPlates);
+  }
+
   bool Alpr::isLoaded()
   {
     return impl->isLoaded();
   }
 
+  void Alpr::warmUp()
+  {
+    impl->warmUp();
+  }
+
+  void Alpr::afterFork()
+  {
+    impl->afterFork();
+  }
+
   std::string Alpr::getVersion()
   {
     return AlprImpl::getVersion();
@@ -135,4 +189,71 @@ namespace alpr
   {
     return impl->config;
   }
-}
\ No newline at end of file
+
+  // Recognition context
+
+  RecognitionContext::RecognitionContext()
+  {
+    topN = DEFAULT_TOPN;
+    detectRegion = DEFAULT_DETECT_REGION;
+    trackPlates = false;
+    scratch = ALPR_NULL_PTR;
+  }
+
+  RecognitionContext::~RecognitionContext()
+  {
+    delete scratch;
+  }
+
+  // Shared engine
+
+  AlprEngine::AlprEngine(const std::string country, const std::string configFile, const std::string runtimeDir)
+  {
+    impl = new AlprImpl(country, configFile, runtimeDir);
+  }
+
+  AlprEngine::~AlprEngine()
+  {
+    delete impl;
+  }
+
+  void AlprEngine::setPrewarp(std::string prewarp_config)
+  {
+    impl->setPrewarp(prewarp_config);
+  }
+
+  void AlprEngine::setMask(unsigned char* pixelData, int bytesPerPixel, int imgWidth, int imgHeight)
+  {
+    impl->setMask(pixelData, bytesPerPixel, imgWidth, imgHeight);
+  }
+
+  AlprResults AlprEngine::recognize(RecognitionContext& context, const std::vector<char>& imageBytes)
+  {
+    return impl->recognize(context, imageBytes, std::vector<AlprRegionOfInterest>());
+  }
+
+  AlprResults AlprEngine::recognize(RecognitionContext& context, const std::vector<char>& imageBytes, std::vector<AlprRegionOfInterest> regionsOfInterest)
+  {
+    return impl->recognize(context, imageBytes, regionsOfInterest);
+  }
+
+  AlprResults AlprEngine::recognize(RecognitionContext& context, const unsigned char* encodedBytes, size_t length, std::vector<AlprRegionOfInterest> regionsOfInterest)
+  {
+    return impl->recognize(context, encodedBytes, length, regionsOfInterest);
+  }
+
+  AlprResults AlprEngine::recognize(RecognitionContext& context, unsigned char* pixelData, int bytesPerPixel, int imgWidth, int imgHeight, std::vector<AlprRegionOfInterest> regionsOfInterest)
+  {
+    return impl->recognize(context, pixelData, bytesPerPixel, imgWidth, imgHeight, regionsOfInterest);
+  }
+
+  bool AlprEngine::isLoaded()
+  {
+    return impl->isLoaded();
+  }
+
+  Config* AlprEngine::getConfig()
+  {
+    return impl->config;
+  }
+}
@@ -54,6 +54,23 @@ namespace alpr
     std::vector<AlprChar> character_details;
     bool matches_template;
   };
+
+  // How readable a plate crop looked before it went to OCR
+  struct AlprCropQuality
+  {
+    AlprCropQuality() : score(0), sharpness(0), char_height(0), contrast(0), clipped(0) {}
+
+    // 0-100, combining the measurements below
+    float score;
+    // Variance of the Laplacian of the deskewed crop.  Low values mean blur.
+    float sharpness;
+    // Character height in image pixels
+    float char_height;
+    // Standard deviation of the crop's gray levels
+    float contrast;
+    // Fraction of pixels clipped to black or white
+    float clipped;
+  };
   
 
   class AlprRegionOfInterest
@@ -104,6 +121,8 @@ namespace alpr
       // When region detection is enabled, this returns the region.  Region detection is experimental
       int regionConfidence;
       std::string region;
+
+      AlprCropQuality quality;
   };
 
   class AlprResults
@@ -112,6 +131,7 @@ namespace alpr
       AlprResults() {
         frame_number = -1;
         ocr_passes_total = 0;
+        ocr_passes_skipped = 0;
         votes_emitted = 0;
         final_plate_count = 0;
         fallback_attempts = 0;
@@ -119,6 +139,7 @@ namespace alpr
         vote_window = 0;
         min_votes = 0;
         fallback_ocr_enabled = 0;
+        ocr_quality_skipped = 0;
       };
       virtual ~AlprResults() {};
 
@@ -129,6 +150,7 @@ namespace alpr
       float total_processing_time_ms;
       std::string profile;
       int ocr_passes_total;
+      int ocr_passes_skipped;
       std::string vehicle;
       std::string scenario;
       int ocr_burst_frames;
@@ -138,6 +160,8 @@ namespace alpr
       int final_plate_count;
       int fallback_attempts;
       int fallback_ocr_enabled;
+      // Plate crops not sent to OCR because they scored too low (ocr_min_quality, ocr_best_shots)
+      int ocr_quality_skipped;
 
       std::vector<AlprPlateResult> plates;
 
@@ -146,8 +170,95 @@ namespace alpr
   };
 
 
+  // Latency of one pipeline stage (detect, ocr, ...) across every recognition in the process
+  struct AlprStageStats
+  {
+    std::string stage;
+    uint64_t count;
+    double total_ms;
+    double max_ms;
+    double p50_ms;
+    double p90_ms;
+    double p99_ms;
+
+    // bucket_counts[i] is the number of runs that took at most bucket_upper_ms[i]
+    std::vector<double> bucket_upper_ms;
+    std::vector<uint64_t> bucket_counts;
+  };
+
   class Config;
   class AlprImpl;
+  class RecognitionScratch;
+
+  // Per-call options plus the per-thread scratch state (OCR instances, worker
+  // threads) used when recognizing with a shared AlprEngine.  A context must only
+  // be used by one thread at a time; create one per thread.
+  class OPENALPR_DLL_EXPORT RecognitionContext
+  {
+    public:
+      RecognitionContext();
+      virtual ~RecognitionContext();
+
+      // Comma-separated countries to recognize.  Empty uses the engine's countries.
+      std::string country;
+
+      int topN;
+
+      // Pattern to match plates against (e.g., "md" for Maryland)
+      std::string defaultRegion;
+
+      bool detectRegion;
+
+      // Consecutive calls are frames of one video: plates still in view keep their
+      // earlier read instead of being OCR'd on every frame
+      bool trackPlates;
+
+    private:
+      RecognitionContext(const RecognitionContext&);
+      RecognitionContext& operator=(const RecognitionContext&);
+
+      friend class AlprImpl;
+      RecognitionScratch* scratch;
+  };
+
+  // Holds the detectors, patterns and OCR configuration for a set of countries.
+  // recognize() may be called from many threads at once as long as each thread
+  // passes its own RecognitionContext.  The setters are not thread-safe.  Concurrent
+  // calls never wait for each other: each context has its own OCR (Tesseract)
+  // instances, and a country gets another plate detector whenever all of its
+  // detectors are in use, so memory grows with the number of threads.
+  class OPENALPR_DLL_EXPORT AlprEngine
+  {
+    public:
+      AlprEngine(const std::string country, const std::string configFile = "", const std::string runtimeDir = "");
+      virtual ~AlprEngine();
+
+      // Update the prewarp setting without reloading the library
+      void setPrewarp(std::string prewarp_config);
+      // Update the detection mask without reloading the library
+      void setMask(unsigned char* pixelData, int bytesPerPixel, int imgWidth, int imgHeight);
+
+      // Recognize from byte data representing an encoded image (e.g., BMP, PNG, JPG, GIF etc).
+      AlprResults recognize(RecognitionContext& context, const std::vector<char>& imageBytes);
+      AlprResults recognize(RecognitionContext& context, const std::vector<char>& imageBytes, std::vector<AlprRegionOfInterest> regionsOfInterest);
+
+      // Recognize from an encoded image in caller-owned memory.  The bytes are decoded in place, not copied.
+      AlprResults recognize(RecognitionContext& context, const unsigned char* encodedBytes, size_t length, std::vector<AlprRegionOfInterest> regionsOfInterest);
+
+      // Recognize from raw pixel data.
+      AlprResults recognize(RecognitionContext& context, unsigned char* pixelData, int bytesPerPixel, int imgWidth, int imgHeight, std::vector<AlprRegionOfInterest> regionsOfInterest);
+
+      bool isLoaded();
+
+      Config* getConfig();
+
+    private:
+      AlprEngine(const AlprEngine&);
+      AlprEngine& operator=(const AlprEngine&);
+
+      AlprImpl* impl;
+  };
+
   class OPENALPR_DLL_EXPORT Alpr
   {
 
@@ -167,14 +278,20 @@ namespace alpr
       void setTopN(int topN);
       void setDefaultRegion(std::string region);
 
+      // Treat consecutive recognize() calls as frames of one video (see RecognitionContext::trackPlates)
+      void setPlateTracking(bool trackPlates);
+
       // Recognize from an image on disk
       AlprResults recognize(std::string filepath);
 
 	  // Recognize from byte data representing an encoded image (e.g., BMP, PNG, JPG, GIF etc).
-	  AlprResults recognize(std::vector<char> imageBytes);
+	  AlprResults recognize(const std::vector<char>& imageBytes);
 
 	  // Recognize from byte data representing an encoded image (e.g., BMP, PNG, JPG, GIF etc).
-	  AlprResults recognize(std::vector<char> imageBytes, std::vector<AlprRegionOfInterest> regionsOfInterest);
+	  AlprResults recognize(const std::vector<char>& imageBytes, std::vector<AlprRegionOfInterest> regionsOfInterest);
+
+      // Recognize from an encoded image in caller-owned memory.  The bytes are decoded in place, not copied.
+      AlprResults recognize(const unsigned char* encodedBytes, size_t length, std::vector<AlprRegionOfInterest> regionsOfInterest);
 
       // Recognize from raw pixel data.  
       AlprResults recognize(unsigned char* pixelData, int bytesPerPixel, int imgWidth, int imgHeight, std::vector<AlprRegionOfInterest> regionsOfInterest);
@@ -184,10 +301,29 @@ namespace alpr
       static std::string toJson(const AlprPlateResult result);
       static AlprResults fromJson(std::string json);
 
+      // Compact binary form of the same results, for passing between local processes
+      static std::string toBinary(const AlprResults results);
+      static AlprResults fromBinary(const std::string& data);
+
       bool isLoaded();
 
+      // Runs one recognition on a synthetic frame so state that is built lazily on the
+      // first frame already exists.  Call it before fork() to share that state with
+      // the children copy-on-write.
+      void warmUp();
+      // Call in a child forked from the process that created this instance, before
+      // recognizing.  Worker threads don't survive fork(), so they are started again.
+      // Contexts other than the default one should be created after the fork.
+      void afterFork();
+
       static std::string getVersion();
 
+      // Per-stage latency histograms for every recognition in this process.  Empty if
+      // the library was built without stage stats (WITH_STAGE_STATS=OFF).
+      static std::vector<AlprStageStats> getStats();
+      // The same stats in Prometheus text format.  labels (e.g., camera="1") is added to every sample.
+      static std::string statsToPrometheus(const std::vector<AlprStageStats>& stats, const std::string& labels = "");
+
       Config* getConfig();
 
     private:
@@ -2,12 +2,10 @@
 
 #include "alpr_impl.h"
 #include "result_aggregator.h"
+#include "stage_stats.h"
 #include "support/filesystem.h"
 #include <algorithm>
 
-
-void plateAnalysisThread(void* arg);
-
 using namespace std;
 using namespace cv;
 
@@ -90,6 +88,10 @@ namespace alpr
     config = new Config(country, configFile, runtimeDir);
 
     prewarp = ALPR_NULL_PTR;
+    motoCascadesChecked = false;
+    br2MotoExists = false;
+    brMotoExists = false;
+    motoWarned = false;
 
     
     // Config file or runtime dir not found.  Don't process any further.
@@ -102,13 +104,23 @@ namespace alpr
 
     prewarp = new PreWarp(config);
     
+    std::cout << "[config] plate_analysis_threads=" << plateWorkerCount() << std::endl;
+
+    engineCountries = config->loaded_countries;
     loadRecognizers();
 
     setNumThreads(0);
 
     setDetectRegion(DEFAULT_DETECT_REGION);
-    this->topN = DEFAULT_TOPN;
+    setTopN(DEFAULT_TOPN);
     setDefaultRegion("");
+    setPlateTracking(config->plateTracking);
+
+    // Build the default context's OCR instances up front so the first frame
+    // doesn't pay for loading Tesseract
+    RecognitionScratch* scratch = prepareContext(defaultContext);
+    for (unsigned int i = 0; i < scratch->countries.size(); i++)
+      contextCountry(scratch, scratch->countries[i]);
     
     timespec endTime;
     getTimeMonotonic(&endTime);
@@ -119,27 +131,122 @@ namespace alpr
 
   AlprImpl::~AlprImpl()
   {
+    delete defaultContext.scratch;
+    defaultContext.scratch = ALPR_NULL_PTR;
+
     delete config;
 
     typedef std::map<std::string, AlprRecognizers>::iterator it_type;
     for(it_type iterator = recognizers.begin(); iterator != recognizers.end(); iterator++) {
 
-      delete iterator->second.plateDetector;
-      delete iterator->second.stateDetector;
-      delete iterator->second.ocr;
+      delete iterator->second.detectors;
+      delete iterator->second.stateDetectors;
+      delete iterator->second.config;
+      delete iterator->second.poolConfig;
     }
 
     delete prewarp;
   }
 
+  RecognitionScratch::RecognitionScratch(AlprImpl* engine, int plateWorkerCount)
+  {
+    this->engine = engine;
+    this->plateWorkers = new WorkerPool(plateWorkerCount);
+    this->cancelled = false;
+    this->hybridWorkers = ALPR_NULL_PTR;
+  }
+
+  RecognitionScratch::~RecognitionScratch()
+  {
+    typedef std::map<std::string, ContextCountry>::iterator it_type;
+    for (it_type iterator = countryState.begin(); iterator != countryState.end(); iterator++)
+    {
+      for (unsigned int i = 0; i < iterator->second.ocr.size(); i++)
+        delete iterator->second.ocr[i];
+      delete iterator->second.tracker;
+    }
+
+    delete plateWorkers;
+
+    delete hybridWorkers;
+    for (unsigned int i = 0; i < hybridContexts.size(); i++)
+      delete hybridContexts[i];
+  }
+
   bool AlprImpl::isLoaded()
   {
     return config->loaded;
   }
 
+  void AlprImpl::warmUp()
+  {
+    if (!config->loaded)
+      return;
+
+    timespec startTime;
+    getTimeMonotonic(&startTime);
+
+    // Noise gives the detector something to evaluate at every scale, and the failed
+    // search runs the br-hybrid fallbacks, building their contexts as well.  A lighter
+    // band stands in for a plate so the plate-level buffers are sized too.
+    Mat frame(720, 1280, CV_8UC3);
+    RNG rng(0x414C5052);
+    rng.fill(frame, RNG::UNIFORM, Scalar::all(0), Scalar::all(255));
+#if OPENCV_MAJOR_VERSION == 2
+    rectangle(frame, Rect(540, 400, 200, 50), Scalar::all(230), CV_FILLED);
+#else
+    rectangle(frame, Rect(540, 400, 200, 50), Scalar::all(230), FILLED);
+#endif
+
+    std::vector<Rect> rois;
+    rois.push_back(Rect(0, 0, frame.cols, frame.rows));
+    recognize(defaultContext, frame, rois);
+
+    timespec endTime;
+    getTimeMonotonic(&endTime);
+    if (config->debugTiming)
+      cout << "OpenALPR Warm-up Time: " << diffclock(startTime, endTime) << "ms." << endl;
+  }
+
+  // fork() copies memory but only the calling thread, so a pool copied from the parent
+  // has no threads behind it.  The old pools are leaked rather than deleted: joining
+  // threads that don't exist in this process would never return.
+  static void replaceWorkersAfterFork(RecognitionScratch* scratch)
+  {
+    if (scratch == ALPR_NULL_PTR)
+      return;
+
+    scratch->plateWorkers = new WorkerPool(scratch->plateWorkers->size());
+    if (scratch->hybridWorkers != ALPR_NULL_PTR)
+      scratch->hybridWorkers = new WorkerPool(scratch->hybridWorkers->size());
+  }
+
+  void AlprImpl::afterFork()
+  {
+    typedef std::map<std::string, AlprRecognizers>::iterator it_type;
+    for (it_type iterator = recognizers.begin(); iterator != recognizers.end(); iterator++)
+      iterator->second.detectors->forEach([](Detector* detector) { detector->afterFork(); });
+
+    RecognitionScratch* scratch = defaultContext.scratch;
+    if (scratch == ALPR_NULL_PTR)
+      return;
+
+    replaceWorkersAfterFork(scratch);
+    for (unsigned int i = 0; i < scratch->hybridContexts.size(); i++)
+      replaceWorkersAfterFork(scratch->hybridContexts[i]->scratch);
+  }
+
 
   AlprFullDetails AlprImpl::recognizeFullDetails(cv::Mat img, std::vector<cv::Rect> regionsOfInterest)
   {
+    return recognizeFullDetails(defaultContext, img, regionsOfInterest);
+  }
+
+  AlprFullDetails AlprImpl::recognizeFullDetails(RecognitionContext& context, cv::Mat img, std::vector<cv::Rect> regionsOfInterest, FullResolutionFrame* fullRes)
+  {
+    ALPR_STAGE_TIMER(STAGE_TOTAL);
+    RecognitionScratch* scratch = prepareContext(context);
+
     timespec startTime;
     getTimeMonotonic(&startTime);
 
@@ -191,8 +298,12 @@ namespace alpr
 
     for (unsigned int i = 0; i < effectiveRois.size(); i++)
     {
-      response.results.regionsOfInterest.push_back(AlprRegionOfInterest(effectiveRois[i].x, effectiveRois[i].y,
-              effectiveRois[i].width, effectiveRois[i].height));
+      // Reported in the caller's pixels, not the reduced decode's
+      cv::Rect reported = effectiveRois[i];
+      if (fullRes != ALPR_NULL_PTR)
+        reported = scaleRectUp(reported, fullRes->scale, fullRes->width, fullRes->height);
+      response.results.regionsOfInterest.push_back(AlprRegionOfInterest(reported.x, reported.y,
+              reported.width, reported.height));
     }
 
     if (!img.data)
@@ -239,21 +350,21 @@ namespace alpr
     warpedRegionsOfInterest = prewarp->projectRects(effectiveRois, detectGray.cols, detectGray.rows, false);
 
     // Hybrid BR flow
-    if (config->country == "br" && config->brHybridEnable)
+    if (scratch->countries.size() > 0 && scratch->countries[0] == "br" && config->brHybridEnable)
     {
-      response = analyzeWithFallback(detectColor, detectGray, procColor, procGray, warpedRegionsOfInterest, response.results.regionsOfInterest, start_time);
+      response = analyzeWithFallback(context, detectColor, detectGray, procColor, procGray, fullRes, warpedRegionsOfInterest, response.results.regionsOfInterest, start_time);
     }
     else
     {
     // Iterate through each country provided (typically just one)
     // and aggregate the results if necessary
-    ResultAggregator country_aggregator(MERGE_PICK_BEST, topN, config);
-    for (unsigned int i = 0; i < config->loaded_countries.size(); i++)
+    ResultAggregator country_aggregator(MERGE_PICK_BEST, context.topN, config);
+    for (unsigned int i = 0; i < scratch->countries.size(); i++)
     {
       if (config->debugGeneral)
-        cout << "Analyzing: " << config->loaded_countries[i] << endl;
+        cout << "Analyzing: " << scratch->countries[i] << endl;
 
-        AlprFullDetails sub_results = runCountryAnalysis(config->loaded_countries[i], detectColor, detectGray, procColor, procGray, warpedRegionsOfInterest, response.results.regionsOfInterest, start_time);
+        AlprFullDetails sub_results = runCountryAnalysis(context, scratch->countries[i], context.defaultRegion, detectColor, detectGray, procColor, procGray, fullRes, warpedRegionsOfInterest, response.results.regionsOfInterest, start_time);
       country_aggregator.addResults(sub_results);
     }
     response = country_aggregator.getAggregateResults();
@@ -319,28 +430,27 @@ namespace alpr
     return response;
   }
 
-  AlprFullDetails AlprImpl::runCountryAnalysis(const std::string& country, cv::Mat detectColorImg, cv::Mat detectGrayImg, cv::Mat processColorImg, cv::Mat processGrayImg, std::vector<cv::Rect> warpedRegionsOfInterest, const std::vector<AlprRegionOfInterest>& rois, int64_t start_time)
+  AlprFullDetails AlprImpl::runCountryAnalysis(RecognitionContext& context, const std::string& country, const std::string& defaultRegion, cv::Mat detectColorImg, cv::Mat detectGrayImg, cv::Mat processColorImg, cv::Mat processGrayImg, FullResolutionFrame* fullRes, std::vector<cv::Rect> warpedRegionsOfInterest, const std::vector<AlprRegionOfInterest>& rois, int64_t start_time, SharedDetections* sharedDetections)
   {
-    config->setCountry(country);
-    loadRecognizers();
+    ContextCountry& country_state = contextCountry(context.scratch, country);
 
-    ResultAggregator iter_aggregator(MERGE_COMBINE, topN, config);
-    for (unsigned int iteration = 0; iteration < config->analysis_count; iteration++)
+    ResultAggregator iter_aggregator(MERGE_COMBINE, context.topN, config);
+    for (unsigned int iteration = 0; iteration < config->analysis_count && !context.scratch->cancelled; iteration++)
     {
       Mat iteration_image = iter_aggregator.applyImperceptibleChange(detectGrayImg, iteration);
-      AlprFullDetails iter_results = analyzeSingleCountry(detectColorImg, iteration_image, processColorImg, processGrayImg, warpedRegionsOfInterest);
+      AlprFullDetails iter_results = analyzeSingleCountry(context, country_state, defaultRegion, detectColorImg, iteration_image, processColorImg, processGrayImg, fullRes, warpedRegionsOfInterest, sharedDetections, iteration);
       iter_aggregator.addResults(iter_results);
     }
 
     AlprFullDetails sub_results = iter_aggregator.getAggregateResults();
     sub_results.results.epoch_time = start_time;
-    sub_results.results.img_width = detectColorImg.cols;
-    sub_results.results.img_height = detectColorImg.rows;
+    sub_results.results.img_width = fullRes != ALPR_NULL_PTR ? fullRes->width : detectColorImg.cols;
+    sub_results.results.img_height = fullRes != ALPR_NULL_PTR ? fullRes->height : detectColorImg.rows;
     sub_results.results.regionsOfInterest = rois;
     return sub_results;
   }
 
-  AlprFullDetails AlprImpl::analyzeWithFallback(cv::Mat detectColorImg, cv::Mat detectGrayImg, cv::Mat processColorImg, cv::Mat processGrayImg, std::vector<cv::Rect> warpedRegionsOfInterest, const std::vector<AlprRegionOfInterest>& rois, int64_t start_time)
+  AlprFullDetails AlprImpl::analyzeWithFallback(RecognitionContext& context, cv::Mat detectColorImg, cv::Mat detectGrayImg, cv::Mat processColorImg, cv::Mat processGrayImg, FullResolutionFrame* fullRes, std::vector<cv::Rect> warpedRegionsOfInterest, const std::vector<AlprRegionOfInterest>& rois, int64_t start_time)
   {
     struct Attempt {
       std::string country;
@@ -354,12 +464,7 @@ namespace alpr
     std::string vehicleProfile = decideVehicleProfile(warpedRegionsOfInterest);
     std::cout << "[vehicle] profile=" << vehicleProfile << std::endl;
 
-    std::string regionDir = config->getRuntimeBaseDir() + "/region";
-    std::string br2Moto = regionDir + "/br2_moto.xml";
-    std::string brMoto = regionDir + "/br_moto.xml";
-    bool br2MotoExists = fileExists(br2Moto.c_str());
-    bool brMotoExists = fileExists(brMoto.c_str());
-    static bool motoWarned = false;
+    probeMotoCascades();
 
     if (vehicleProfile == "moto" && (br2MotoExists || brMotoExists))
     {
@@ -370,10 +475,14 @@ namespace alpr
     }
     else
     {
-      if (vehicleProfile == "moto" && !(br2MotoExists || brMotoExists) && !motoWarned)
+      if (vehicleProfile == "moto" && !(br2MotoExists || brMotoExists))
       {
-        std::cout << "[warn] moto_cascade_assets_missing fallback=br2->br\n";
-        motoWarned = true;
+        tthread::lock_guard<tthread::mutex> guard(engineMutex);
+        if (!motoWarned)
+        {
+          std::cout << "[warn] moto_cascade_assets_missing fallback=br2->br\n";
+          motoWarned = true;
+        }
       }
       // Car path (existing order + optional eu/ad)
       for (size_t i = 0; i < config->brHybridOrder.size(); i++)
@@ -413,80 +522,142 @@ namespace alpr
       attempts.push_back(b);
     }
 
-    std::string originalCountry = config->country;
-    std::string originalDefaultRegion = defaultRegion;
-
-    double bestOkConf = -1.0;
-    double bestConf = -1.0;
-    AlprFullDetails bestOkResult;
-    AlprFullDetails bestResult;
-    std::string bestOkLabel;
-    std::string bestLabel;
+    SharedDetections sharedDetections;
+    SharedDetections* shared = config->brHybridShareDetection ? &sharedDetections : ALPR_NULL_PTR;
 
-    for (size_t idx = 0; idx < attempts.size(); idx++)
-    {
-      Attempt attempt = attempts[idx];
+    struct AttemptOutcome {
+      bool ran;
+      bool cancelled;
+      bool ok;
+      double conf;
+      std::string reason;
+      AlprFullDetails result;
+    };
+    std::vector<AttemptOutcome> outcomes(attempts.size());
 
-      config->setCountry(attempt.country);
-      loadRecognizers();
+    auto runAttempt = [&](int idx, RecognitionContext& attemptContext) {
+      const Attempt& attempt = attempts[idx];
+      AttemptOutcome& outcome = outcomes[idx];
 
-      std::string prevRegion = defaultRegion;
-      if (attempt.pattern.size() > 0)
-        setDefaultRegion(attempt.pattern);
-      else
-        setDefaultRegion(originalDefaultRegion);
+      // The pattern travels with the attempt instead of being set on the engine
+      std::string attemptRegion = attempt.pattern.size() > 0 ? attempt.pattern : context.defaultRegion;
 
-      AlprFullDetails result = runCountryAnalysis(attempt.country, detectColorImg, detectGrayImg, processColorImg, processGrayImg, warpedRegionsOfInterest, rois, start_time);
+      outcome.result = runCountryAnalysis(attemptContext, attempt.country, attemptRegion, detectColorImg, detectGrayImg, processColorImg, processGrayImg, fullRes, warpedRegionsOfInterest, rois, start_time, shared);
+      outcome.ran = true;
+      outcome.cancelled = attemptContext.scratch->cancelled;
 
-      double conf = -1.0;
+      outcome.conf = -1.0;
       bool matchesTemplate = false;
+      const AlprFullDetails& result = outcome.result;
       if (result.results.plates.size() > 0)
       {
-        conf = result.results.plates[0].bestPlate.overall_confidence;
+        outcome.conf = result.results.plates[0].bestPlate.overall_confidence;
         matchesTemplate = result.results.plates[0].bestPlate.matches_template;
       }
 
-      bool ok = (result.results.plates.size() > 0) && (conf >= config->brHybridMinConfidence);
-      std::string reason = "";
-      if (result.results.plates.size() == 0)
-        reason = "no_plate";
-      else if (conf < config->brHybridMinConfidence)
-        reason = "low_conf";
+      outcome.ok = (result.results.plates.size() > 0) && (outcome.conf >= config->brHybridMinConfidence);
+      outcome.reason = "";
+      if (outcome.cancelled)
+      {
+        outcome.ok = false;
+        outcome.reason = "cancelled";
+      }
+      else if (result.results.plates.size() == 0)
+        outcome.reason = "no_plate";
+      else if (outcome.conf < config->brHybridMinConfidence)
+        outcome.reason = "low_conf";
       else if (config->mustMatchPattern && !matchesTemplate)
       {
-        ok = false;
-        reason = "pattern_mismatch";
+        outcome.ok = false;
+        outcome.reason = "pattern_mismatch";
+      }
+    };
+
+    for (size_t idx = 0; idx < attempts.size(); idx++)
+      outcomes[idx].ran = false;
+
+    if (config->brHybridPolicy == "parallel" && attempts.size() > 1)
+    {
+      // Every attempt runs at once on its own child context.  As soon as one is
+      // accepted, the attempts after it can no longer win and are cancelled; the
+      // ones before it run to completion since they take precedence.
+      RecognitionScratch* scratch = context.scratch;
+      for (size_t idx = 0; idx < attempts.size(); idx++)
+        hybridContext(context, idx).scratch->cancelled = false;
+
+      if (scratch->hybridWorkers == ALPR_NULL_PTR || scratch->hybridWorkers->size() < (int) attempts.size())
+      {
+        delete scratch->hybridWorkers;
+        scratch->hybridWorkers = new WorkerPool(attempts.size());
       }
 
+      auto attemptTask = [&](int idx, int workerIndex) {
+        runAttempt(idx, *scratch->hybridContexts[idx]);
+        if (outcomes[idx].ok)
+        {
+          for (size_t later = idx + 1; later < attempts.size(); later++)
+            scratch->hybridContexts[later]->scratch->cancelled = true;
+        }
+      };
+      scratch->hybridWorkers->run(attempts.size(), attemptTask);
+    }
+    else
+    {
+      for (size_t idx = 0; idx < attempts.size(); idx++)
+      {
+        runAttempt(idx, context);
+        if (config->brHybridPolicy == "ordered" && outcomes[idx].ok)
+          break;
+      }
+    }
+
+    // exhaustive keeps the most confident accepted attempt; ordered and parallel
+    // keep the first one in attempt order
+    bool firstAcceptedWins = config->brHybridPolicy != "exhaustive";
+
+    int bestOkIdx = -1;
+    double bestOkConf = -1.0;
+    double bestConf = -1.0;
+    AlprFullDetails bestOkResult;
+    AlprFullDetails bestResult;
+    std::string bestOkLabel;
+    std::string bestLabel;
+
+    for (size_t idx = 0; idx < attempts.size(); idx++)
+    {
+      const Attempt& attempt = attempts[idx];
+      const AttemptOutcome& outcome = outcomes[idx];
+      if (!outcome.ran)
+        continue;
+
       if (config->debugGeneral || config->debugPostProcess)
       {
-        if (ok)
-          std::cout << "[br-hybrid] attempt " << attempt.label << " accepted conf=" << conf << std::endl;
+        if (outcome.ok)
+          std::cout << "[br-hybrid] attempt " << attempt.label << " accepted conf=" << outcome.conf << std::endl;
         else
-          std::cout << "[br-hybrid] attempt " << attempt.label << " fallback reason=" << reason << " conf=" << conf << std::endl;
+          std::cout << "[br-hybrid] attempt " << attempt.label << " fallback reason=" << outcome.reason << " conf=" << outcome.conf << std::endl;
       }
 
-      if (ok && conf > bestOkConf)
+      if (outcome.cancelled)
+        continue;
+
+      if (outcome.ok && (bestOkIdx < 0 || (!firstAcceptedWins && outcome.conf > bestOkConf)))
       {
-        bestOkConf = conf;
-        bestOkResult = result;
+        bestOkIdx = idx;
+        bestOkConf = outcome.conf;
+        bestOkResult = outcome.result;
         bestOkLabel = attempt.label;
       }
 
-      if (idx == 0 || conf > bestConf)
+      if (idx == 0 || outcome.conf > bestConf)
       {
-        bestConf = conf;
-        bestResult = result;
+        bestConf = outcome.conf;
+        bestResult = outcome.result;
         bestLabel = attempt.label;
       }
-
-      setDefaultRegion(prevRegion);
     }
 
-    config->setCountry(originalCountry);
-    loadRecognizers();
-    setDefaultRegion(originalDefaultRegion);
-    if (bestOkConf >= 0)
+    if (bestOkIdx >= 0)
     {
       std::cout << "[br-hybrid] final profile=" << bestOkLabel << " winner_conf=" << bestOkConf << std::endl;
       return bestOkResult;
@@ -495,6 +666,61 @@ namespace alpr
     return bestResult;
   }
 
+  RecognitionContext& AlprImpl::hybridContext(RecognitionContext& parent, int attempt)
+  {
+    RecognitionScratch* scratch = parent.scratch;
+    while ((int) scratch->hybridContexts.size() <= attempt)
+    {
+      // Attempts already run side by side, so each child analyzes its plates on one thread
+      RecognitionContext* child = new RecognitionContext();
+      child->scratch = new RecognitionScratch(this, 1);
+      scratch->hybridContexts.push_back(child);
+    }
+
+    RecognitionContext* child = scratch->hybridContexts[attempt];
+    child->country = parent.country;
+    child->topN = parent.topN;
+    child->defaultRegion = parent.defaultRegion;
+    child->detectRegion = parent.detectRegion;
+    child->trackPlates = parent.trackPlates;
+    return *child;
+  }
+
+  std::vector<PlateRegion> AlprImpl::detectShared(ContextCountry& country, cv::Mat detectGrayImg, std::vector<cv::Rect> regionsOfInterest, SharedDetections* sharedDetections, unsigned int iteration)
+  {
+    Detector* detector = country.recognizers->plateDetector;
+    cv::Size minPlateSize = detector->getMinPlateSize();
+
+    // Reusing regions is only exact when both runs searched the same cascade at the
+    // same scales, so the minimum plate size is part of the key
+    std::stringstream key;
+    key << detector->get_detector_file() << "#" << iteration << "#" << minPlateSize.width << "x" << minPlateSize.height;
+
+    {
+      tthread::lock_guard<tthread::mutex> guard(sharedDetections->mtx);
+      std::map<std::string, std::vector<PlateRegion> >::iterator found = sharedDetections->entries.find(key.str());
+      if (found != sharedDetections->entries.end())
+      {
+        if (config->debugDetector)
+          std::cout << "[br-hybrid] reusing detections from " << key.str() << std::endl;
+
+        return found->second;
+      }
+    }
+
+    std::vector<PlateRegion> regions;
+    {
+      AlprRecognizers* recognizer = country.recognizers;
+      PoolLease<Detector> pooled(recognizer->detectors, [this, recognizer]() { return createPooledDetector(recognizer); });
+      regions = pooled->detect(detectGrayImg, regionsOfInterest);
+    }
+
+    tthread::lock_guard<tthread::mutex> guard(sharedDetections->mtx);
+    sharedDetections->entries[key.str()] = regions;
+
+    return regions;
+  }
+
   std::string AlprImpl::decideVehicleProfile(const std::vector<cv::Rect>& warpedRegionsOfInterest)
   {
     if (config->vehicleProfileMode == "moto")
@@ -518,7 +744,7 @@ namespace alpr
     return "car";
   }
 
-  AlprFullDetails AlprImpl::analyzeSingleCountry(cv::Mat detectColorImg, cv::Mat detectGrayImg, cv::Mat processColorImg, cv::Mat processGrayImg, std::vector<cv::Rect> warpedRegionsOfInterest)
+  AlprFullDetails AlprImpl::analyzeSingleCountry(RecognitionContext& context, ContextCountry& country, const std::string& defaultRegion, cv::Mat detectColorImg, cv::Mat detectGrayImg, cv::Mat processColorImg, cv::Mat processGrayImg, FullResolutionFrame* fullRes, std::vector<cv::Rect> warpedRegionsOfInterest, SharedDetections* sharedDetections, unsigned int iteration)
   {
     AlprFullDetails response;
     response.results.profile = config->profile;
@@ -529,7 +755,6 @@ namespace alpr
     response.results.min_votes = config->minVotes;
     response.results.fallback_ocr_enabled = config->fallbackOcrEnabled ? 1 : 0;
     
-    AlprRecognizers country_recognizers = recognizers[config->country];
     timespec startTime;
     getTimeMonotonic(&startTime);
 
@@ -537,7 +762,17 @@ namespace alpr
     // Find all the candidate regions
     if (config->skipDetection == false)
     {
-      warpedPlateRegions = country_recognizers.plateDetector->detect(detectGrayImg, warpedRegionsOfInterest);
+      ALPR_STAGE_TIMER(STAGE_DETECT);
+      if (sharedDetections != ALPR_NULL_PTR)
+      {
+        warpedPlateRegions = detectShared(country, detectGrayImg, warpedRegionsOfInterest, sharedDetections, iteration);
+      }
+      else
+      {
+        AlprRecognizers* recognizer = country.recognizers;
+        PoolLease<Detector> detector(recognizer->detectors, [this, recognizer]() { return createPooledDetector(recognizer); });
+        warpedPlateRegions = detector->detect(detectGrayImg, warpedRegionsOfInterest);
+      }
     }
     else
     {
@@ -552,241 +787,460 @@ namespace alpr
       }
     }
 
-    queue<PlateRegion> plateQueue;
-    for (unsigned int i = 0; i < warpedPlateRegions.size(); i++)
-      plateQueue.push(warpedPlateRegions[i]);
+    // Detection ran on a reduced decode.  Plates are read from the full-size frame,
+    // which is only decoded now, and only around the regions found.
+    if (fullRes != ALPR_NULL_PTR && !warpedPlateRegions.empty())
+    {
+      scalePlateRegionsUp(warpedPlateRegions, fullRes->scale, fullRes->width, fullRes->height);
+      if (!fullRes->get(warpedPlateRegions, processColorImg, processGrayImg))
+      {
+        if (config->debugGeneral)
+          std::cerr << "Unable to decode the full-size frame" << std::endl;
+        warpedPlateRegions.clear();
+      }
+    }
+
+    // Candidates are analyzed one level at a time: every region in the current level runs
+    // on the worker pool, and the children of disqualified regions make up the next level.
+    // This visits regions in the same order as a FIFO queue, so plate_index is assigned
+    // exactly as it would be with a single thread.
+    vector<PlateRegion> plateLevel = warpedPlateRegions;
+
+    // Top-level regions are matched against the plates seen in earlier frames.  Only the
+    // first analysis iteration tracks; later ones see the same frame again.
+    bool tracking = context.trackPlates && iteration == 0;
+    if (tracking)
+      country.tracker->beginFrame();
 
     int platecount = 0;
-    while(!plateQueue.empty())
+    while (!plateLevel.empty() && !context.scratch->cancelled)
     {
-      PlateRegion plateRegion = plateQueue.front();
-      plateQueue.pop();
+      vector<PlateRegionAnalysis> analyses(plateLevel.size());
+
+      // Regions that need OCR.  A region continuing a track with a confident, recent
+      // read takes that read instead; otherwise its crop must score well against the
+      // track's recent crops to be read.
+      vector<int> tracks(plateLevel.size(), -1);
+      vector<cv::Mat> appearances(plateLevel.size());
+      vector<bool> reused(plateLevel.size(), false);
+      vector<float> minQuality(plateLevel.size(), 0);
+      vector<int> pending;
+      for (unsigned int i = 0; i < plateLevel.size(); i++)
+      {
+        if (tracking)
+        {
+          appearances[i] = PlateTracker::appearance(processGrayImg, plateLevel[i].rect);
+          tracks[i] = country.tracker->match(plateLevel[i].rect, appearances[i]);
+          if (country.tracker->canReuse(tracks[i]))
+          {
+            reused[i] = true;
+            analyses[i].plateDetected = true;
+            analyses[i].plate = country.tracker->bestRead(tracks[i], plateLevel[i].rect);
+            analyses[i].plate.processing_time_ms = 0;
+            analyses[i].votesEmitted = 0;
+            analyses[i].fallbackAttempts = 0;
+            analyses[i].ocrPassesTotal = 0;
+            analyses[i].ocrPassesSkipped = 0;
+            analyses[i].qualityScored = false;
+            analyses[i].qualitySkipped = false;
+            continue;
+          }
+          minQuality[i] = country.tracker->qualityBar(tracks[i]);
+        }
+        pending.push_back(i);
+      }
 
-      PipelineData pipeline_data(processColorImg, processGrayImg, plateRegion.rect, config);
-      pipeline_data.prewarp = prewarp;
+      auto analyzeTask = [&](int taskIndex, int workerIndex) {
+        int i = pending[taskIndex];
+        analyzePlateRegion(context, plateLevel[i], country, country.ocr[workerIndex], defaultRegion, processColorImg, processGrayImg, minQuality[i], analyses[i]);
+      };
+
+      WorkerPool* plateWorkers = context.scratch->plateWorkers;
+      if (plateWorkers->size() > 1)
+        plateWorkers->run(pending.size(), analyzeTask);
+      else
+        for (unsigned int i = 0; i < pending.size(); i++)
+          analyzeTask(i, 0);
 
-      timespec platestarttime;
-      getTimeMonotonic(&platestarttime);
+      if (tracking && !context.scratch->cancelled)
+      {
+        for (unsigned int i = 0; i < plateLevel.size(); i++)
+        {
+          if (reused[i])
+          {
+            country.tracker->update(tracks[i], plateLevel[i].rect, appearances[i], false, ALPR_NULL_PTR);
+            if (config->debugGeneral)
+              cout << "[track] reused read " << analyses[i].plate.bestPlate.characters << endl;
+            continue;
+          }
 
-      LicensePlateCandidate lp(&pipeline_data);
+          // A region that was never read as a plate doesn't start a track.  One that
+          // already has a track keeps it even if this frame's read failed.
+          if (tracks[i] < 0 && !analyses[i].plateDetected)
+            continue;
 
-      lp.recognize();
+          const AlprPlateResult* read = analyses[i].plateDetected ? &analyses[i].plate : ALPR_NULL_PTR;
+          int track = country.tracker->update(tracks[i], plateLevel[i].rect, appearances[i], !analyses[i].qualitySkipped, read);
+          if (analyses[i].qualityScored)
+            country.tracker->addQuality(track, analyses[i].quality.score);
 
-      bool plateDetected = false;
-      if (pipeline_data.disqualified && config->debugGeneral)
+          // Report the track's best read, which may be from an earlier frame
+          if (analyses[i].plateDetected)
+          {
+            float processingTime = analyses[i].plate.processing_time_ms;
+            analyses[i].plate = country.tracker->bestRead(track, plateLevel[i].rect);
+            analyses[i].plate.processing_time_ms = processingTime;
+          }
+          else if (analyses[i].qualitySkipped && country.tracker->hasRead(track))
+          {
+            analyses[i].plateDetected = true;
+            analyses[i].plate = country.tracker->bestRead(track, plateLevel[i].rect);
+            analyses[i].plate.processing_time_ms = 0;
+          }
+        }
+      }
+
+      // Children are separate candidates inside a region, not tracked
+      tracking = false;
+
+      vector<PlateRegion> nextLevel;
+      for (unsigned int i = 0; i < analyses.size(); i++)
       {
-        cout << "Disqualify reason: " << pipeline_data.disqualify_reason << endl;
+        response.results.votes_emitted += analyses[i].votesEmitted;
+        response.results.fallback_attempts += analyses[i].fallbackAttempts;
+        response.results.ocr_passes_total += analyses[i].ocrPassesTotal;
+        response.results.ocr_passes_skipped += analyses[i].ocrPassesSkipped;
+        if (analyses[i].qualitySkipped)
+          response.results.ocr_quality_skipped += 1;
+
+        if (analyses[i].plateDetected)
+        {
+          analyses[i].plate.plate_index = platecount++;
+          response.results.final_plate_count += 1;
+          response.results.plates.push_back(analyses[i].plate);
+        }
+        else if (!analyses[i].qualitySkipped)
+        {
+          // Not a valid plate
+          // Check if this plate has any children, if so, send them back up for processing
+          for (unsigned int childidx = 0; childidx < plateLevel[i].children.size(); childidx++)
+            nextLevel.push_back(plateLevel[i].children[childidx]);
+        }
       }
-      if (!pipeline_data.disqualified)
+
+      plateLevel.swap(nextLevel);
+    }
+
+    // Unwarp plate regions if necessary
+    prewarp->projectPlateRegions(warpedPlateRegions, detectGrayImg.cols, detectGrayImg.rows, true);
+    response.plateRegions = warpedPlateRegions;
+
+    timespec endTime;
+    getTimeMonotonic(&endTime);
+    response.results.total_processing_time_ms = diffclock(startTime, endTime);
+
+    return response;
+  }
+
+  void AlprImpl::analyzePlateRegion(RecognitionContext& context, const PlateRegion& plateRegion, ContextCountry& country, OCR* ocr, const std::string& defaultRegion, cv::Mat processColorImg, cv::Mat processGrayImg, float minQuality, PlateRegionAnalysis& out)
+  {
+    out.plateDetected = false;
+    out.votesEmitted = 0;
+    out.fallbackAttempts = 0;
+    out.ocrPassesTotal = 0;
+    out.ocrPassesSkipped = 0;
+    out.qualityScored = false;
+    out.qualitySkipped = false;
+
+    if (context.scratch->cancelled)
+      return;
+
+    PipelineData pipeline_data(processColorImg, processGrayImg, plateRegion.rect, config, country.countryConfig);
+    pipeline_data.prewarp = prewarp;
+
+    timespec platestarttime;
+    getTimeMonotonic(&platestarttime);
+
+    LicensePlateCandidate lp(&pipeline_data);
+
+    lp.recognize();
+
+    if (pipeline_data.disqualified && config->debugGeneral)
+    {
+      cout << "Disqualify reason: " << pipeline_data.disqualify_reason << endl;
+    }
+    if (!pipeline_data.disqualified)
+    {
+      out.quality = scoreCropQuality(&pipeline_data);
+      out.qualityScored = true;
+      if (out.quality.score < std::max(config->ocrMinQuality, minQuality))
       {
-        AlprPlateResult baseResult;
-        baseResult.country = config->country;
+        if (config->debugGeneral)
+          cout << "[quality] skipping OCR, crop score " << out.quality.score << " < " << std::max(config->ocrMinQuality, minQuality)
+               << " (sharpness " << out.quality.sharpness << ", char height " << out.quality.char_height
+               << ", contrast " << out.quality.contrast << ", clipped " << out.quality.clipped << ")" << endl;
+        out.qualitySkipped = true;
+        return;
+      }
 
-        // If there's only one pattern for a country, use it.  Otherwise use the default
-        if (country_recognizers.ocr->postProcessor.getPatterns().size() == 1)
-          baseResult.region = country_recognizers.ocr->postProcessor.getPatterns()[0];
-        else
-          baseResult.region = defaultRegion;
+      AlprPlateResult baseResult;
+      baseResult.country = country.countryConfig->country;
+      baseResult.quality = out.quality;
 
-        baseResult.regionConfidence = 0;
-        baseResult.requested_topn = topN;
+      // If there's only one pattern for a country, use it.  Otherwise use the default
+      if (ocr->postProcessor.getPatterns().size() == 1)
+        baseResult.region = ocr->postProcessor.getPatterns()[0];
+      else
+        baseResult.region = defaultRegion;
+
+      baseResult.regionConfidence = 0;
+      baseResult.requested_topn = context.topN;
+
+      // If using prewarp, remap the plate corners to the original image
+      vector<Point2f> cornerPoints = pipeline_data.plate_corners;
+      cornerPoints = prewarp->projectPoints(cornerPoints, true);
 
-        // If using prewarp, remap the plate corners to the original image
-        vector<Point2f> cornerPoints = pipeline_data.plate_corners;
-        cornerPoints = prewarp->projectPoints(cornerPoints, true);
+      for (int pointidx = 0; pointidx < 4; pointidx++)
+      {
+        baseResult.plate_points[pointidx].x = (int) cornerPoints[pointidx].x;
+        baseResult.plate_points[pointidx].y = (int) cornerPoints[pointidx].y;
+      }
 
-        for (int pointidx = 0; pointidx < 4; pointidx++)
+      #ifndef SKIP_STATE_DETECTION
+      if (context.detectRegion && country.recognizers->stateDetector->isLoaded())
+      {
+        AlprRecognizers* recognizer = country.recognizers;
+        PoolLease<StateDetector> stateDetector(recognizer->stateDetectors, [this, recognizer]() { return createPooledStateDetector(recognizer); });
+        std::vector<StateCandidate> state_candidates = stateDetector->detect(pipeline_data.color_deskewed.data,
+                                                                             pipeline_data.color_deskewed.elemSize(),
+                                                                             pipeline_data.color_deskewed.cols,
+                                                                             pipeline_data.color_deskewed.rows);
+
+        if (state_candidates.size() > 0)
         {
-          baseResult.plate_points[pointidx].x = (int) cornerPoints[pointidx].x;
-          baseResult.plate_points[pointidx].y = (int) cornerPoints[pointidx].y;
+          baseResult.region = state_candidates[0].state_code;
+          baseResult.regionConfidence = (int) state_candidates[0].confidence;
         }
+      }
+      #endif
+
+      if (baseResult.region.length() > 0 && ocr->postProcessor.regionIsValid(baseResult.region) == false)
+      {
+        std::cerr << "Invalid pattern provided: " << baseResult.region << std::endl;
+        std::cerr << "Valid patterns are located in the " << country.countryConfig->country << ".patterns file" << std::endl;
+      }
 
-        #ifndef SKIP_STATE_DETECTION
-        if (detectRegion && country_recognizers.stateDetector->isLoaded())
+      cv::Mat charTransformMatrix = getCharacterTransformMatrix(&pipeline_data);
+
+      auto buildPlateFromPost = [&](const std::vector<PPResult>& ppResults, AlprPlateResult& plate)->bool {
+        plate = baseResult;
+        int bestPlateIndex = 0;
+        bool isBestPlateSelected = false;
+        for (unsigned int pp = 0; pp < ppResults.size(); pp++)
         {
-          std::vector<StateCandidate> state_candidates = country_recognizers.stateDetector->detect(pipeline_data.color_deskewed.data,
-                                                                               pipeline_data.color_deskewed.elemSize(),
-                                                                               pipeline_data.color_deskewed.cols,
-                                                                               pipeline_data.color_deskewed.rows);
+          if (isBestPlateSelected == false && ppResults[pp].matchesTemplate){
+            bestPlateIndex = plate.topNPlates.size();
+            isBestPlateSelected = true;
+          }
+
+          AlprPlate aplate;
+          aplate.characters = ppResults[pp].letters;
+          aplate.overall_confidence = ppResults[pp].totalscore;
+          aplate.matches_template = ppResults[pp].matchesTemplate;
 
-          if (state_candidates.size() > 0)
+          // Grab detailed results for each character
+          for (unsigned int c_idx = 0; c_idx < ppResults[pp].letter_details.size(); c_idx++)
           {
-            baseResult.region = state_candidates[0].state_code;
-            baseResult.regionConfidence = (int) state_candidates[0].confidence;
+            AlprChar character_details;
+            Letter l = ppResults[pp].letter_details[c_idx];
+
+            character_details.character = l.letter;
+            character_details.confidence = l.totalscore;
+            cv::Rect char_rect = pipeline_data.charRegionsFlat[l.charposition];
+            std::vector<AlprCoordinate> charpoints = getCharacterPoints(char_rect, charTransformMatrix );
+            for (int cpt = 0; cpt < 4; cpt++)
+              character_details.corners[cpt] = charpoints[cpt];
+            aplate.character_details.push_back(character_details);
           }
+          plate.topNPlates.push_back(aplate);
         }
-        #endif
 
-        if (baseResult.region.length() > 0 && country_recognizers.ocr->postProcessor.regionIsValid(baseResult.region) == false)
+        if (plate.topNPlates.size() > bestPlateIndex)
         {
-          std::cerr << "Invalid pattern provided: " << baseResult.region << std::endl;
-          std::cerr << "Valid patterns are located in the " << config->country << ".patterns file" << std::endl;
+          plate.bestPlate = plate.topNPlates[bestPlateIndex];
+          return true;
         }
+        return false;
+      };
 
-        cv::Mat charTransformMatrix = getCharacterTransformMatrix(&pipeline_data);
-
-        auto buildPlateFromPost = [&](const std::vector<PPResult>& ppResults, AlprPlateResult& out)->bool {
-          out = baseResult;
-          int bestPlateIndex = 0;
-          bool isBestPlateSelected = false;
-          for (unsigned int pp = 0; pp < ppResults.size(); pp++)
-          {
-            if (isBestPlateSelected == false && ppResults[pp].matchesTemplate){
-              bestPlateIndex = out.topNPlates.size();
-              isBestPlateSelected = true;
-            }
-
-            AlprPlate aplate;
-            aplate.characters = ppResults[pp].letters;
-            aplate.overall_confidence = ppResults[pp].totalscore;
-            aplate.matches_template = ppResults[pp].matchesTemplate;
-
-            // Grab detailed results for each character
-            for (unsigned int c_idx = 0; c_idx < ppResults[pp].letter_details.size(); c_idx++)
-            {
-              AlprChar character_details;
-              Letter l = ppResults[pp].letter_details[c_idx];
-
-              character_details.character = l.letter;
-              character_details.confidence = l.totalscore;
-              cv::Rect char_rect = pipeline_data.charRegionsFlat[l.charposition];
-              std::vector<AlprCoordinate> charpoints = getCharacterPoints(char_rect, charTransformMatrix );
-              for (int cpt = 0; cpt < 4; cpt++)
-                character_details.corners[cpt] = charpoints[cpt];
-              aplate.character_details.push_back(character_details);
-            }
-            out.topNPlates.push_back(aplate);
-          }
+      int burst = std::max(1, config->ocrBurstFrames);
+      int voteWindow = std::max(1, config->voteWindow);
+      int minVotes = std::max(1, config->minVotes);
+      pipeline_data.ocr_passes_total = 0;
+      pipeline_data.ocr_passes_skipped = 0;
+      std::vector<AlprPlateResult> passResults;
+      int passesPerBurst = 0;
+      auto runPass = [&](){
+        int scheduledBefore = pipeline_data.ocr_passes_total + pipeline_data.ocr_passes_skipped;
+        ocr->performOCR(&pipeline_data);
+        passesPerBurst = pipeline_data.ocr_passes_total + pipeline_data.ocr_passes_skipped - scheduledBefore;
+        ocr->postProcessor.analyze(baseResult.region, context.topN);
+        const vector<PPResult> ppResults = ocr->postProcessor.getResults();
+        AlprPlateResult passResult;
+        if (buildPlateFromPost(ppResults, passResult)) {
+          passResults.push_back(passResult);
+        }
+      };
 
-          if (out.topNPlates.size() > bestPlateIndex)
-          {
-            out.bestPlate = out.topNPlates[bestPlateIndex];
-            return true;
-          }
+      // The burst is settled once the latest reading clears the early exit bar and
+      // already has enough votes to win
+      auto burstSettled = [&]()->bool {
+        if (config->ocrEarlyExitConfidence <= 0 || passResults.empty())
           return false;
-        };
-
-        int burst = std::max(1, config->ocrBurstFrames);
-        int voteWindow = std::max(1, config->voteWindow);
-        int minVotes = std::max(1, config->minVotes);
-        pipeline_data.ocr_passes_total = 0;
-        std::vector<AlprPlateResult> passResults;
-        auto runPass = [&](){
-          country_recognizers.ocr->performOCR(&pipeline_data);
-          country_recognizers.ocr->postProcessor.analyze(baseResult.region, topN);
-          const vector<PPResult> ppResults = country_recognizers.ocr->postProcessor.getResults();
-          AlprPlateResult passResult;
-          if (buildPlateFromPost(ppResults, passResult)) {
-            passResults.push_back(passResult);
-          }
-        };
-
-        for (int i = 0; i < burst; i++) runPass();
+        const AlprPlate& latest = passResults.back().bestPlate;
+        if (latest.characters.empty() || latest.overall_confidence < config->ocrEarlyExitConfidence)
+          return false;
+        if (config->ocrEarlyExitRequirePattern && !latest.matches_template)
+          return false;
+        int votes = 0;
+        for (size_t r = 0; r < passResults.size(); r++)
+          if (passResults[r].bestPlate.characters == latest.characters)
+            votes++;
+        return votes >= minVotes;
+      };
 
-        int localFallbackAttempts = 0;
-        if (passResults.size() == 0 && config->fallbackOcrEnabled)
+      for (int i = 0; i < burst; i++)
+      {
+        runPass();
+        if (i + 1 < burst && burstSettled())
         {
-          localFallbackAttempts = std::max(1, voteWindow);
-          for (int i = 0; i < localFallbackAttempts; i++) runPass();
+          pipeline_data.ocr_passes_skipped += (burst - i - 1) * passesPerBurst;
+          break;
         }
+      }
 
-        if (passResults.size() > static_cast<size_t>(voteWindow)) {
-          passResults.erase(passResults.begin(), passResults.end() - voteWindow);
-        }
+      int localFallbackAttempts = 0;
+      if (passResults.size() == 0 && config->fallbackOcrEnabled)
+      {
+        localFallbackAttempts = std::max(1, voteWindow);
+        for (int i = 0; i < localFallbackAttempts; i++) runPass();
+      }
 
-        response.results.votes_emitted += static_cast<int>(passResults.size());
-        response.results.fallback_attempts += localFallbackAttempts;
-        response.results.ocr_passes_total += pipeline_data.ocr_passes_total;
-
-        struct VoteEntry {
-          int count = 0;
-          double bestConf = -1.0;
-          AlprPlateResult bestResult;
-        };
-        std::map<std::string, VoteEntry> voteMap;
-        for (const auto& res : passResults) {
-          if (res.bestPlate.characters.empty()) continue;
-          auto& entry = voteMap[res.bestPlate.characters];
-          entry.count += 1;
-          if (res.bestPlate.overall_confidence > entry.bestConf) {
-            entry.bestConf = res.bestPlate.overall_confidence;
-            entry.bestResult = res;
-          }
-        }
+      if (passResults.size() > static_cast<size_t>(voteWindow)) {
+        passResults.erase(passResults.begin(), passResults.end() - voteWindow);
+      }
+
+      out.votesEmitted = static_cast<int>(passResults.size());
+      out.fallbackAttempts = localFallbackAttempts;
+      out.ocrPassesTotal = pipeline_data.ocr_passes_total;
+      out.ocrPassesSkipped = pipeline_data.ocr_passes_skipped;
 
-        int bestCount = 0;
+      struct VoteEntry {
+        int count = 0;
         double bestConf = -1.0;
-        bool hasWinner = false;
-        AlprPlateResult winner;
-        for (const auto& kv : voteMap) {
-          if (kv.second.count > bestCount ||
-              (kv.second.count == bestCount && kv.second.bestConf > bestConf)) {
-            bestCount = kv.second.count;
-            bestConf = kv.second.bestConf;
-            winner = kv.second.bestResult;
-            hasWinner = true;
-          }
+        AlprPlateResult bestResult;
+      };
+      std::map<std::string, VoteEntry> voteMap;
+      for (const auto& res : passResults) {
+        if (res.bestPlate.characters.empty()) continue;
+        auto& entry = voteMap[res.bestPlate.characters];
+        entry.count += 1;
+        if (res.bestPlate.overall_confidence > entry.bestConf) {
+          entry.bestConf = res.bestPlate.overall_confidence;
+          entry.bestResult = res;
         }
+      }
 
-        if (hasWinner && bestCount >= minVotes)
-        {
-          timespec plateEndTime;
-          getTimeMonotonic(&plateEndTime);
-          winner.processing_time_ms = diffclock(platestarttime, plateEndTime);
-          winner.plate_index = platecount++;
-          response.results.final_plate_count += 1;
-          plateDetected = true;
-          response.results.plates.push_back(winner);
+      int bestCount = 0;
+      double bestConf = -1.0;
+      bool hasWinner = false;
+      AlprPlateResult winner;
+      for (const auto& kv : voteMap) {
+        if (kv.second.count > bestCount ||
+            (kv.second.count == bestCount && kv.second.bestConf > bestConf)) {
+          bestCount = kv.second.count;
+          bestConf = kv.second.bestConf;
+          winner = kv.second.bestResult;
+          hasWinner = true;
         }
       }
 
-      if (!plateDetected)
+      if (hasWinner && bestCount >= minVotes)
       {
-        // Not a valid plate
-        // Check if this plate has any children, if so, send them back up for processing
-        for (unsigned int childidx = 0; childidx < plateRegion.children.size(); childidx++)
-        {
-          plateQueue.push(plateRegion.children[childidx]);
-        }
+        timespec plateEndTime;
+        getTimeMonotonic(&plateEndTime);
+        winner.processing_time_ms = diffclock(platestarttime, plateEndTime);
+        out.plate = winner;
+        out.plateDetected = true;
       }
-
     }
+  }
 
-    // Unwarp plate regions if necessary
-    prewarp->projectPlateRegions(warpedPlateRegions, detectGrayImg.cols, detectGrayImg.rows, true);
-    response.plateRegions = warpedPlateRegions;
+  AlprResults AlprImpl::recognize( const std::vector<char>& imageBytes)
+  {
+    std::vector<AlprRegionOfInterest> regionsOfInterest;
+    return recognize(defaultContext, imageBytes, regionsOfInterest);
+  }
 
-    timespec endTime;
-    getTimeMonotonic(&endTime);
-    response.results.total_processing_time_ms = diffclock(startTime, endTime);
+  AlprResults AlprImpl::recognize(const std::vector<char>& imageBytes, std::vector<AlprRegionOfInterest> regionsOfInterest)
+  {
+    return recognize(defaultContext, imageBytes, regionsOfInterest);
+  }
 
-    return response;
+  AlprResults AlprImpl::recognize(const unsigned char* encodedBytes, size_t length, std::vector<AlprRegionOfInterest> regionsOfInterest)
+  {
+    return recognize(defaultContext, encodedBytes, length, regionsOfInterest);
   }
 
-  AlprResults AlprImpl::recognize( std::vector<char> imageBytes)
+  AlprResults AlprImpl::recognize(RecognitionContext& context, const std::vector<char>& imageBytes, std::vector<AlprRegionOfInterest> regionsOfInterest)
   {
-    try
-    {
-      cv::Mat img = cv::imdecode(cv::Mat(imageBytes), 1);
-      return this->recognize(img);
-    }
-    catch (cv::Exception& e)
-    {
-      std::cerr << "Caught exception in OpenALPR recognize: " << e.msg << std::endl;
-      AlprResults emptyresults;
-      return emptyresults;
-    }
+    return recognize(context, (const unsigned char*) imageBytes.data(), imageBytes.size(), regionsOfInterest);
   }
 
-  AlprResults AlprImpl::recognize(std::vector<char> imageBytes, std::vector<AlprRegionOfInterest> regionsOfInterest)
+  AlprResults AlprImpl::recognize(RecognitionContext& context, const unsigned char* encodedBytes, size_t length, std::vector<AlprRegionOfInterest> regionsOfInterest)
   {
     try
     {
-      cv::Mat img = cv::imdecode(cv::Mat(imageBytes), 1);
+      if (length == 0)
+        return recognizeFullDetails(context, cv::Mat(), convertRects(regionsOfInterest)).results;
+
+      // imdecode only reads its input, so a header over the caller's buffer is enough
+      cv::Mat encoded(1, (int) length, CV_8U, (void*) encodedBytes);
+
+#if OPENCV_MAJOR_VERSION >= 3
+      // Frames that don't need warping or preprocessing can be detected on a reduced decode.
+      // The IMREAD_REDUCED_* flags are new in OpenCV 3; older versions always decode in full.
+      int width, height;
+      int scale = 1;
+      if (config->reducedDecode && !prewarp->valid && !config->preprocEnable && !config->debugShowImages &&
+          readJpegSize(encodedBytes, length, width, height))
+        scale = chooseDecodeReduction(width, height, config->maxDetectionInputWidth, config->maxDetectionInputHeight);
+
+      if (scale > 1)
+      {
+        int flags = scale == 2 ? IMREAD_REDUCED_COLOR_2 : scale == 4 ? IMREAD_REDUCED_COLOR_4 : IMREAD_REDUCED_COLOR_8;
+        cv::Mat reduced = cv::imdecode(encoded, flags);
+        if (!reduced.empty())
+        {
+          // The decoder applies EXIF rotation; the frame header doesn't
+          if ((reduced.cols > reduced.rows) != (width > height))
+            std::swap(width, height);
+
+          FullResolutionFrame fullRes(encodedBytes, length, scale, width, height);
+          std::vector<cv::Rect> rois = convertRects(regionsOfInterest);
+          for (unsigned int i = 0; i < rois.size(); i++)
+            rois[i] = scaleRectDown(rois[i], scale);
+
+          return recognizeFullDetails(context, reduced, rois, &fullRes).results;
+        }
+      }
+#endif
+
+      cv::Mat img = cv::imdecode(encoded, 1);
 
       std::vector<cv::Rect> rois = convertRects(regionsOfInterest);
 
-      AlprFullDetails fullDetails = recognizeFullDetails(img, rois);
+      AlprFullDetails fullDetails = recognizeFullDetails(context, img, rois);
       return fullDetails.results;
     }
     catch (cv::Exception& e)
@@ -798,6 +1252,11 @@ namespace alpr
   }
 
   AlprResults AlprImpl::recognize( unsigned char* pixelData, int bytesPerPixel, int imgWidth, int imgHeight, std::vector<AlprRegionOfInterest> regionsOfInterest)
+  {
+    return recognize(defaultContext, pixelData, bytesPerPixel, imgWidth, imgHeight, regionsOfInterest);
+  }
+
+  AlprResults AlprImpl::recognize(RecognitionContext& context, unsigned char* pixelData, int bytesPerPixel, int imgWidth, int imgHeight, std::vector<AlprRegionOfInterest> regionsOfInterest)
   {
 
     try
@@ -813,7 +1272,7 @@ namespace alpr
         regionsOfInterest.push_back(fullFrame);
       }
 
-      return this->recognize(img, this->convertRects(regionsOfInterest));
+      return this->recognize(context, img, this->convertRects(regionsOfInterest));
     }
     catch (cv::Exception& e)
     {
@@ -833,7 +1292,12 @@ namespace alpr
 
   AlprResults AlprImpl::recognize(cv::Mat img, std::vector<cv::Rect> regionsOfInterest)
   {
-    AlprFullDetails fullDetails = recognizeFullDetails(img, regionsOfInterest);
+    return recognize(defaultContext, img, regionsOfInterest);
+  }
+
+  AlprResults AlprImpl::recognize(RecognitionContext& context, cv::Mat img, std::vector<cv::Rect> regionsOfInterest)
+  {
+    AlprFullDetails fullDetails = recognizeFullDetails(context, img, regionsOfInterest);
     return fullDetails.results;
   }
 
@@ -864,6 +1328,7 @@ namespace alpr
     cJSON_AddNumberToObject(root,"processing_time_ms", results.total_processing_time_ms );
     cJSON_AddStringToObject(root,"profile", results.profile.c_str());
     cJSON_AddNumberToObject(root,"ocr_passes_total", results.ocr_passes_total);
+    cJSON_AddNumberToObject(root,"ocr_passes_skipped", results.ocr_passes_skipped);
     cJSON_AddStringToObject(root,"vehicle", results.vehicle.c_str());
     cJSON_AddStringToObject(root,"scenario", results.scenario.c_str());
     cJSON_AddNumberToObject(root,"ocr_burst_frames", results.ocr_burst_frames);
@@ -873,6 +1338,7 @@ namespace alpr
     cJSON_AddNumberToObject(root,"final_plate_count", results.final_plate_count);
     cJSON_AddNumberToObject(root,"fallback_attempts", results.fallback_attempts);
     cJSON_AddNumberToObject(root,"fallback_ocr_enabled", results.fallback_ocr_enabled);
+    cJSON_AddNumberToObject(root,"ocr_quality_skipped", results.ocr_quality_skipped);
 
     // Add the regions of interest to the JSON
     cJSON *rois;
@@ -944,6 +1410,14 @@ namespace alpr
     cJSON_AddNumberToObject(root,"processing_time_ms",	result->processing_time_ms);
     cJSON_AddNumberToObject(root,"requested_topn",	result->requested_topn);
 
+    cJSON *quality = cJSON_CreateObject();
+    cJSON_AddNumberToObject(quality, "score", result->quality.score);
+    cJSON_AddNumberToObject(quality, "sharpness", result->quality.sharpness);
+    cJSON_AddNumberToObject(quality, "char_height", result->quality.char_height);
+    cJSON_AddNumberToObject(quality, "contrast", result->quality.contrast);
+    cJSON_AddNumberToObject(quality, "clipped", result->quality.clipped);
+    cJSON_AddItemToObject(root, "quality", quality);
+
     cJSON_AddItemToObject(root, "coordinates", 		coords=cJSON_CreateArray());
     for (int i=0;i<4;i++)
     {
@@ -1005,6 +1479,8 @@ namespace alpr
     if (profileObj && profileObj->valuestring) allResults.profile = profileObj->valuestring;
     cJSON* passesObj = cJSON_GetObjectItem(root, "ocr_passes_total");
     allResults.ocr_passes_total = passesObj ? passesObj->valueint : 0;
+    cJSON* skippedObj = cJSON_GetObjectItem(root, "ocr_passes_skipped");
+    allResults.ocr_passes_skipped = skippedObj ? skippedObj->valueint : 0;
     cJSON* vehicleObj = cJSON_GetObjectItem(root, "vehicle");
     if (vehicleObj && vehicleObj->valuestring) allResults.vehicle = vehicleObj->valuestring;
     cJSON* scenarioObj = cJSON_GetObjectItem(root, "scenario");
@@ -1023,6 +1499,8 @@ namespace alpr
     allResults.fallback_attempts = fbAttemptsObj ? fbAttemptsObj->valueint : 0;
     cJSON* fbEnabledObj = cJSON_GetObjectItem(root, "fallback_ocr_enabled");
     allResults.fallback_ocr_enabled = fbEnabledObj ? fbEnabledObj->valueint : 0;
+    cJSON* qualitySkippedObj = cJSON_GetObjectItem(root, "ocr_quality_skipped");
+    allResults.ocr_quality_skipped = qualitySkippedObj ? qualitySkippedObj->valueint : 0;
 
 
     cJSON* rois = cJSON_GetObjectItem(root,"regions_of_interest");
@@ -1054,6 +1532,16 @@ namespace alpr
       plate.regionConfidence = cJSON_GetObjectItem(item, "region_confidence")->valueint;
       plate.requested_topn = cJSON_GetObjectItem(item, "requested_topn")->valueint;
 
+      cJSON* quality = cJSON_GetObjectItem(item, "quality");
+      if (quality)
+      {
+        plate.quality.score = cJSON_GetObjectItem(quality, "score")->valuedouble;
+        plate.quality.sharpness = cJSON_GetObjectItem(quality, "sharpness")->valuedouble;
+        plate.quality.char_height = cJSON_GetObjectItem(quality, "char_height")->valuedouble;
+        plate.quality.contrast = cJSON_GetObjectItem(quality, "contrast")->valuedouble;
+        plate.quality.clipped = cJSON_GetObjectItem(quality, "clipped")->valuedouble;
+      }
+
 
       cJSON* coordinates = cJSON_GetObjectItem(item,"coordinates");
       for (int c = 0; c < 4; c++)
@@ -1096,6 +1584,7 @@ namespace alpr
 
   void AlprImpl::setCountry(std::string country) {
     config->load_countries(country);
+    engineCountries = config->loaded_countries;
     loadRecognizers();
   }
 
@@ -1115,9 +1604,11 @@ namespace alpr
       cv::Mat imgData = cv::Mat(arraySize, 1, CV_8U, pixelData);
       cv::Mat mask = imgData.reshape(bytesPerPixel, imgHeight);
 
+      detectorMask = mask.clone();
+
       typedef std::map<std::string, AlprRecognizers>::iterator it_type;
       for (it_type iterator = recognizers.begin(); iterator != recognizers.end(); iterator++)
-        iterator->second.plateDetector->setMask(mask);
+        iterator->second.detectors->forEach([&mask](Detector* detector) { detector->setMask(mask); });
     }
     catch (cv::Exception& e)
     {
@@ -1130,17 +1621,21 @@ namespace alpr
   void AlprImpl::setDetectRegion(bool detectRegion)
   {
     
-    this->detectRegion = detectRegion;
+    defaultContext.detectRegion = detectRegion;
 
 
   }
   void AlprImpl::setTopN(int topn)
   {
-    this->topN = topn;
+    defaultContext.topN = topn;
   }
   void AlprImpl::setDefaultRegion(string region)
   {
-    this->defaultRegion = region;
+    defaultContext.defaultRegion = region;
+  }
+  void AlprImpl::setPlateTracking(bool trackPlates)
+  {
+    defaultContext.trackPlates = trackPlates;
   }
 
   std::string AlprImpl::getVersion()
@@ -1150,7 +1645,89 @@ namespace alpr
   }
   
   
+  RecognitionScratch* AlprImpl::prepareContext(RecognitionContext& context)
+  {
+    // A context handed to a different engine starts over with that engine's models
+    if (context.scratch != ALPR_NULL_PTR && context.scratch->engine != this)
+    {
+      delete context.scratch;
+      context.scratch = ALPR_NULL_PTR;
+    }
+
+    if (context.scratch == ALPR_NULL_PTR)
+      context.scratch = new RecognitionScratch(this, plateWorkerCount());
+
+    RecognitionScratch* scratch = context.scratch;
+    if (context.country.length() == 0)
+    {
+      scratch->countries = engineCountries;
+      scratch->parsedCountry = "";
+    }
+    else if (scratch->parsedCountry != context.country || scratch->countries.size() == 0)
+    {
+      scratch->countries = config->parse_country_string(context.country);
+      scratch->parsedCountry = context.country;
+    }
+
+    return scratch;
+  }
+
+  ContextCountry& AlprImpl::contextCountry(RecognitionScratch* scratch, const std::string& country)
+  {
+    std::map<std::string, ContextCountry>::iterator existing = scratch->countryState.find(country);
+    if (existing != scratch->countryState.end())
+      return existing->second;
+
+    ContextCountry state;
+    {
+      // First use of this country by this context.  The recognizers are shared, so
+      // loading a country the engine hasn't seen yet happens under the lock.
+      tthread::lock_guard<tthread::mutex> guard(engineMutex);
+
+      std::map<std::string, AlprRecognizers>::iterator recognizer = recognizers.find(country);
+      if (recognizer == recognizers.end())
+      {
+        // Other contexts are reading the shared Config, so the country is loaded into
+        // a private copy that the detector keeps for its lifetime
+        Config* countryConfig = new Config(*config);
+        countryConfig->setCountry(country);
+
+        addRecognizers(country, countryConfig, countryConfig);
+        recognizer = recognizers.find(country);
+      }
+
+      if (recognizer->second.config != ALPR_NULL_PTR)
+        state.countryConfig = recognizer->second.config->countryConfig;
+      else
+        state.countryConfig = config->getCountryConfig(country);
+      state.recognizers = &recognizer->second;
+    }
+
+    // OCR instances belong to the context, so they are built outside the lock
+    for (int w = 0; w < scratch->plateWorkers->size(); w++)
+      state.ocr.push_back(createOcr(config, state.countryConfig));
+    state.tracker = new PlateTracker(config);
+
+    scratch->countryState[country] = state;
+    return scratch->countryState[country];
+  }
+
+  void AlprImpl::probeMotoCascades()
+  {
+    // The moto cascades are optional assets; probe for them once rather than every frame
+    tthread::lock_guard<tthread::mutex> guard(engineMutex);
+    if (motoCascadesChecked)
+      return;
+
+    std::string regionDir = config->getRuntimeBaseDir() + "/region";
+    br2MotoExists = fileExists((regionDir + "/br2_moto.xml").c_str());
+    brMotoExists = fileExists((regionDir + "/br_moto.xml").c_str());
+    motoCascadesChecked = true;
+  }
+
   void AlprImpl::loadRecognizers() {
+    std::string activeCountry = config->country;
+
     for (unsigned int i = 0; i < config->loaded_countries.size(); i++)
     {
       config->setCountry(config->loaded_countries[i]);
@@ -1158,23 +1735,85 @@ namespace alpr
       if (recognizers.find(config->country) == recognizers.end())
       {
         // Country training data has not already been loaded.  Load it.
-        AlprRecognizers recognizer;
-        recognizer.plateDetector = createDetector(config, prewarp);
-        recognizer.ocr = createOcr(config);
+        addRecognizers(config->country, config, ALPR_NULL_PTR);
+      }
 
-        #ifndef SKIP_STATE_DETECTION
-        recognizer.stateDetector = new StateDetector(this->config->country, this->config->config_file_path, this->config->runtimeBaseDir);
-        #else
-        recognizer.stateDetector = NULL;
-        #endif
+    }
 
-        recognizers[config->country] = recognizer;
-      }
+    if (activeCountry.length() > 0)
+      config->setCountry(activeCountry);
+  }
+
+  // countryConfig is set to the country.  privateConfig is the same Config when the
+  // recognizers own it, or NULL when it is the engine's shared one.
+  AlprRecognizers& AlprImpl::addRecognizers(const std::string& country, Config* countryConfig, Config* privateConfig)
+  {
+    AlprRecognizers& recognizer = recognizers[country];
+    recognizer.countryCode = country;
+    recognizer.config = privateConfig;
+    recognizer.poolConfig = ALPR_NULL_PTR;
+
+    recognizer.plateDetector = createDetector(countryConfig, prewarp);
+    if (!detectorMask.empty())
+      recognizer.plateDetector->setMask(detectorMask);
+    recognizer.detectors = new CheckoutPool<Detector>();
+    recognizer.detectors->add(recognizer.plateDetector);
+
+    #ifndef SKIP_STATE_DETECTION
+    recognizer.stateDetector = new StateDetector(country, countryConfig->config_file_path, countryConfig->runtimeBaseDir);
+    recognizer.stateDetector->setMatcher(countryConfig->stateIdMatcher, countryConfig->stateIdShortlist);
+    recognizer.stateDetectors = new CheckoutPool<StateDetector>();
+    recognizer.stateDetectors->add(recognizer.stateDetector);
+    #else
+    recognizer.stateDetector = NULL;
+    recognizer.stateDetectors = NULL;
+    #endif
+
+    return recognizer;
+  }
 
+  // Another detector for the pool, built when a call finds every one in use
+  Detector* AlprImpl::createPooledDetector(AlprRecognizers* recognizer)
+  {
+    Config* detectorConfig = recognizer->config;
+    if (detectorConfig == ALPR_NULL_PTR)
+    {
+      // The shared Config is set to whichever country was loaded last, and a detector
+      // takes its country from the Config it is built from
+      tthread::lock_guard<tthread::mutex> guard(engineMutex);
+      if (recognizer->poolConfig == ALPR_NULL_PTR)
+      {
+        recognizer->poolConfig = new Config(*config);
+        recognizer->poolConfig->setCountry(recognizer->countryCode);
+      }
+      detectorConfig = recognizer->poolConfig;
     }
+
+    Detector* detector = createDetector(detectorConfig, prewarp);
+    if (!detectorMask.empty())
+      detector->setMask(detectorMask);
+    return detector;
+  }
+
+  #ifndef SKIP_STATE_DETECTION
+  StateDetector* AlprImpl::createPooledStateDetector(AlprRecognizers* recognizer)
+  {
+    StateDetector* detector = new StateDetector(recognizer->countryCode, config->config_file_path, config->runtimeBaseDir);
+    detector->setMatcher(config->stateIdMatcher, config->stateIdShortlist);
+    return detector;
   }
+  #endif
 
   
+  int AlprImpl::plateWorkerCount()
+  {
+    // Debug windows and pause-on-frame must stay on the calling thread
+    if (config->debugShowImages || config->debugPauseOnFrame)
+      return 1;
+
+    return config->plateAnalysisThreads;
+  }
+
   cv::Mat AlprImpl::getCharacterTransformMatrix(PipelineData* pipeline_data ) {
     std::vector<Point2f> crop_corners;
     crop_corners.push_back(Point2f(0,0));
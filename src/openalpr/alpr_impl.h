@@ -25,6 +25,7 @@
 #include <sstream>
 #include <vector>
 #include <queue>
+#include <atomic>
 
 #include "alpr.h"
 #include "config.h"
@@ -46,11 +47,17 @@
 #include "pipeline_data.h"
 
 #include "prewarp.h"
+#include "reduced_decode.h"
+#include "plate_tracker.h"
+#include "crop_quality.h"
 
 #include <opencv2/core/core.hpp>
    
 #include "support/platform.h"
 #include "support/utf8.h"
+#include "support/tinythread.h"
+#include "support/checkout_pool.h"
+#include "support/worker_pool.h"
 
 #define DEFAULT_TOPN 25
 #define DEFAULT_DETECT_REGION false
@@ -66,12 +73,90 @@ namespace alpr
     AlprResults results;
   };
 
+  // Per-country models shared by every RecognitionContext using the engine
   struct AlprRecognizers
   {
+    // Cascades and state matchers keep per-image state, so each call checks one out
+    // of these pools rather than waiting for a shared one.  The pools start with
+    // plateDetector and stateDetector, whose cascade file, minimum plate size and
+    // loaded state stand for every other in the pool.
     Detector* plateDetector;
     StateDetector* stateDetector;
-    OCR* ocr;
+    CheckoutPool<Detector>* detectors;
+    CheckoutPool<StateDetector>* stateDetectors;
     std::string countryCode;
+
+    // Private Config for a country first loaded by a context, or NULL when the
+    // country was loaded with the engine and lives in the shared Config
+    Config* config;
+    // Private Config set to this country that detectors added to the pool are built
+    // from when config is NULL.  Made the first time one is needed.
+    Config* poolConfig;
+  };
+
+  // A country as seen by one RecognitionContext: the engine's shared snapshot and
+  // detectors, plus OCR instances owned by the context (one per plate worker) and
+  // the plates it is tracking across frames.
+  struct ContextCountry
+  {
+    const CountryConfig* countryConfig;
+    AlprRecognizers* recognizers;
+    std::vector<OCR*> ocr;
+    PlateTracker* tracker;
+  };
+
+  class AlprImpl;
+
+  // Mutable state behind a RecognitionContext.  Tesseract instances keep state
+  // between calls, so each context gets its own OCR objects and worker pool.
+  class RecognitionScratch
+  {
+    public:
+      RecognitionScratch(AlprImpl* engine, int plateWorkerCount);
+      virtual ~RecognitionScratch();
+
+      AlprImpl* engine;
+
+      // ctx.country as last parsed, and the resulting list of countries
+      std::string parsedCountry;
+      std::vector<std::string> countries;
+
+      std::map<std::string, ContextCountry> countryState;
+
+      WorkerPool* plateWorkers;
+
+      // Set to abandon the recognition running on this context (speculative br-hybrid
+      // attempts that lost to an earlier one)
+      std::atomic<bool> cancelled;
+
+      // Parallel br-hybrid: one child context (with its own OCR) per attempt, and the
+      // threads that run them
+      std::vector<RecognitionContext*> hybridContexts;
+      WorkerPool* hybridWorkers;
+  };
+
+  // Plates found while analyzing one frame with several br-hybrid attempts, keyed
+  // by cascade file and analysis iteration
+  struct SharedDetections
+  {
+    tthread::mutex mtx;
+    std::map<std::string, std::vector<PlateRegion> > entries;
+  };
+
+  struct PlateRegionAnalysis
+  {
+    bool plateDetected;
+    AlprPlateResult plate;
+    int votesEmitted;
+    int fallbackAttempts;
+    int ocrPassesTotal;
+    int ocrPassesSkipped;
+
+    // Set once the crop has been deskewed and scored
+    bool qualityScored;
+    AlprCropQuality quality;
+    // The crop scored below the bar and was not sent to OCR
+    bool qualitySkipped;
   };
 
   class AlprImpl
@@ -81,15 +166,23 @@ namespace alpr
       AlprImpl(const std::string country, const std::string configFile = "", const std::string runtimeDir = "");
       virtual ~AlprImpl();
 
+      // The overloads without a RecognitionContext use the engine's default context
+      // and must not be called concurrently.  Calls with distinct contexts may run in parallel.
       AlprFullDetails recognizeFullDetails(cv::Mat img, std::vector<cv::Rect> regionsOfInterest);
+      // With fullRes, img is a reduced decode of it and regionsOfInterest are in img's pixels
+      AlprFullDetails recognizeFullDetails(RecognitionContext& context, cv::Mat img, std::vector<cv::Rect> regionsOfInterest, FullResolutionFrame* fullRes = ALPR_NULL_PTR);
 
-      AlprResults recognize( std::vector<char> imageBytes );
-      AlprResults recognize( std::vector<char> imageBytes, std::vector<AlprRegionOfInterest> regionsOfInterest );
+      AlprResults recognize( const std::vector<char>& imageBytes );
+      AlprResults recognize( const std::vector<char>& imageBytes, std::vector<AlprRegionOfInterest> regionsOfInterest );
+      AlprResults recognize( const unsigned char* encodedBytes, size_t length, std::vector<AlprRegionOfInterest> regionsOfInterest );
       AlprResults recognize( unsigned char* pixelData, int bytesPerPixel, int imgWidth, int imgHeight, std::vector<AlprRegionOfInterest> regionsOfInterest );
       AlprResults recognize( cv::Mat img );
       AlprResults recognize( cv::Mat img, std::vector<cv::Rect> regionsOfInterest );
 
-      AlprFullDetails analyzeSingleCountry(cv::Mat detectColorImg, cv::Mat detectGrayImg, cv::Mat processColorImg, cv::Mat processGrayImg, std::vector<cv::Rect> regionsOfInterest);
+      AlprResults recognize( RecognitionContext& context, const std::vector<char>& imageBytes, std::vector<AlprRegionOfInterest> regionsOfInterest );
+      AlprResults recognize( RecognitionContext& context, const unsigned char* encodedBytes, size_t length, std::vector<AlprRegionOfInterest> regionsOfInterest );
+      AlprResults recognize( RecognitionContext& context, unsigned char* pixelData, int bytesPerPixel, int imgWidth, int imgHeight, std::vector<AlprRegionOfInterest> regionsOfInterest );
+      AlprResults recognize( RecognitionContext& context, cv::Mat img, std::vector<cv::Rect> regionsOfInterest );
 
       void setCountry(std::string country);
       void setPrewarp(std::string prewarp_config);
@@ -98,6 +191,7 @@ namespace alpr
       void setDetectRegion(bool detectRegion);
       void setTopN(int topn);
       void setDefaultRegion(std::string region);
+      void setPlateTracking(bool trackPlates);
 
       static std::string toJson( const AlprResults results );
       static std::string toJson( const AlprPlateResult result );
@@ -111,19 +205,46 @@ namespace alpr
 
       bool isLoaded();
 
+      void warmUp();
+      void afterFork();
+
     private:
 
       std::map<std::string, AlprRecognizers> recognizers;
 
+      // Countries recognized when a context does not name its own
+      std::vector<std::string> engineCountries;
+
       PreWarp* prewarp;
 
-      int topN;
-      bool detectRegion;
-      std::string defaultRegion;
+      // Serializes lazy loading of countries into the shared config/recognizers
+      // and the one-time moto cascade probe
+      tthread::mutex engineMutex;
+      bool motoCascadesChecked;
+      bool br2MotoExists;
+      bool brMotoExists;
+      bool motoWarned;
+
+      // Last mask given to setMask, applied to detectors added to the pools later
+      cv::Mat detectorMask;
+
+      // Backs the single-threaded Alpr API (setTopN, setDefaultRegion, ...)
+      RecognitionContext defaultContext;
 
       void loadRecognizers();
-      AlprFullDetails runCountryAnalysis(const std::string& country, cv::Mat detectColorImg, cv::Mat detectGrayImg, cv::Mat processColorImg, cv::Mat processGrayImg, std::vector<cv::Rect> warpedRegionsOfInterest, const std::vector<AlprRegionOfInterest>& rois, int64_t start_time);
-      AlprFullDetails analyzeWithFallback(cv::Mat detectColorImg, cv::Mat detectGrayImg, cv::Mat processColorImg, cv::Mat processGrayImg, std::vector<cv::Rect> warpedRegionsOfInterest, const std::vector<AlprRegionOfInterest>& rois, int64_t start_time);
+      AlprRecognizers& addRecognizers(const std::string& country, Config* countryConfig, Config* privateConfig);
+      Detector* createPooledDetector(AlprRecognizers* recognizer);
+      StateDetector* createPooledStateDetector(AlprRecognizers* recognizer);
+      int plateWorkerCount();
+      RecognitionScratch* prepareContext(RecognitionContext& context);
+      ContextCountry& contextCountry(RecognitionScratch* scratch, const std::string& country);
+      void probeMotoCascades();
+      AlprFullDetails analyzeSingleCountry(RecognitionContext& context, ContextCountry& country, const std::string& defaultRegion, cv::Mat detectColorImg, cv::Mat detectGrayImg, cv::Mat processColorImg, cv::Mat processGrayImg, FullResolutionFrame* fullRes, std::vector<cv::Rect> regionsOfInterest, SharedDetections* sharedDetections, unsigned int iteration);
+      std::vector<PlateRegion> detectShared(ContextCountry& country, cv::Mat detectGrayImg, std::vector<cv::Rect> regionsOfInterest, SharedDetections* sharedDetections, unsigned int iteration);
+      void analyzePlateRegion(RecognitionContext& context, const PlateRegion& plateRegion, ContextCountry& country, OCR* ocr, const std::string& defaultRegion, cv::Mat processColorImg, cv::Mat processGrayImg, float minQuality, PlateRegionAnalysis& out);
+      AlprFullDetails runCountryAnalysis(RecognitionContext& context, const std::string& country, const std::string& defaultRegion, cv::Mat detectColorImg, cv::Mat detectGrayImg, cv::Mat processColorImg, cv::Mat processGrayImg, FullResolutionFrame* fullRes, std::vector<cv::Rect> warpedRegionsOfInterest, const std::vector<AlprRegionOfInterest>& rois, int64_t start_time, SharedDetections* sharedDetections = ALPR_NULL_PTR);
+      RecognitionContext& hybridContext(RecognitionContext& parent, int attempt);
+      AlprFullDetails analyzeWithFallback(RecognitionContext& context, cv::Mat detectColorImg, cv::Mat detectGrayImg, cv::Mat processColorImg, cv::Mat processGrayImg, FullResolutionFrame* fullRes, std::vector<cv::Rect> warpedRegionsOfInterest, const std::vector<AlprRegionOfInterest>& rois, int64_t start_time);
       std::string decideVehicleProfile(const std::vector<cv::Rect>& warpedRegionsOfInterest);
       
       cv::Mat getCharacterTransformMatrix(PipelineData* pipeline_data );
@@ -213,4 +213,186 @@ void NiblackSauvolaWolfJolion (Mat im, Mat output, NiblackVersion version,
     	}
     }
   }
-}
\ No newline at end of file
+}
+namespace alpr
+{
+
+  namespace
+  {
+    // Per-window state for NiblackSauvolaWolfJolionInv.  The arithmetic below repeats
+    // calcLocalStats/NiblackSauvolaWolfJolion operation for operation (including the
+    // float rounding of the mean/deviation maps) so the output is identical.
+    struct WindowPass
+    {
+      BinarizeWindow window;
+      int wxh;
+      int wyh;
+      int x_firstth;
+      int x_lastth;
+      int y_firstth;
+      int y_lastth;
+      double winarea;
+      double max_s;
+
+      // Threshold surface for the most recently computed source row
+      std::vector<float> thRow;
+      int thRowSource;
+    };
+
+    inline void windowStats(const double* sum_top, const double* sum_bot, const double* sq_top, const double* sq_bot,
+                            int i, int winx, double winarea, double& m, double& s)
+    {
+      double sum = sum_bot[i+winx] - sum_top[i+winx] - sum_bot[i] + sum_top[i];
+      double sum_sq = sq_bot[i+winx] - sq_top[i+winx] - sq_bot[i] + sq_top[i];
+
+      m  = sum / winarea;
+      s  = sqrt ((sum_sq - m*sum)/winarea);
+    }
+
+    double maxLocalDeviation(const Mat& im_sum, const Mat& im_sum_sq, const WindowPass& pass, int cols)
+    {
+      double m, s;
+      double max_s = 0;
+      for (int j = pass.y_firstth; j <= pass.y_lastth; j++)
+      {
+        const double* sum_top = im_sum.ptr<double>(j - pass.wyh);
+        const double* sum_bot = im_sum.ptr<double>(j - pass.wyh + pass.window.winy);
+        const double* sq_top = im_sum_sq.ptr<double>(j - pass.wyh);
+        const double* sq_bot = im_sum_sq.ptr<double>(j - pass.wyh + pass.window.winy);
+
+        for (int i = 0; i <= cols - pass.window.winx; i++)
+        {
+          windowStats(sum_top, sum_bot, sq_top, sq_bot, i, pass.window.winx, pass.winarea, m, s);
+          if (s > max_s) max_s = s;
+        }
+      }
+      return max_s;
+    }
+
+    // Fills pass.thRow with the thresholds of image row j, border columns included
+    void computeThresholdRow(const Mat& im_sum, const Mat& im_sum_sq, WindowPass& pass, int j,
+                             int cols, double min_I, double dR)
+    {
+      const BinarizeWindow& w = pass.window;
+      const double* sum_top = im_sum.ptr<double>(j - pass.wyh);
+      const double* sum_bot = im_sum.ptr<double>(j - pass.wyh + w.winy);
+      const double* sq_top = im_sum_sq.ptr<double>(j - pass.wyh);
+      const double* sq_bot = im_sum_sq.ptr<double>(j - pass.wyh + w.winy);
+
+      float* th_row = &pass.thRow[0];
+      int last_i = cols - w.winx;
+      double m, s, th = 0;
+      for (int i = 0; i <= last_i; i++)
+      {
+        windowStats(sum_top, sum_bot, sq_top, sq_bot, i, w.winx, pass.winarea, m, s);
+
+        // The original stores the statistics in CV_32F maps before using them
+        double mf = (float) m;
+        double sf = (float) s;
+
+        switch (w.version)
+        {
+          case NIBLACK:
+            th = mf + w.k*sf;
+            break;
+          case SAUVOLA:
+            th = mf * (1 + w.k*(sf/dR-1));
+            break;
+          case WOLFJOLION:
+            th = mf + w.k * (sf/pass.max_s-1) * (mf-min_I);
+            break;
+        }
+        th_row[i + pass.wxh] = (float) th;
+      }
+
+      // Left border repeats the first window, then the right border repeats the last.
+      // The right border is written last, so it wins where the two overlap.
+      float left_th = th_row[pass.wxh];
+      float right_th = (float) th;
+      for (int x = 0; x <= pass.x_firstth; x++)
+        th_row[x] = left_th;
+      for (int x = pass.x_lastth; x < cols; x++)
+        th_row[x] = right_th;
+
+      pass.thRowSource = j;
+    }
+  }
+
+  void NiblackSauvolaWolfJolionInv (const Mat& im, const std::vector<BinarizeWindow>& windows,
+                                    std::vector<Mat>& outputs, double dR)
+  {
+    outputs.resize(windows.size());
+    for (unsigned int w = 0; w < windows.size(); w++)
+      outputs[w].create(im.size(), CV_8U);
+
+    if (windows.size() == 0 || im.empty())
+      return;
+
+    // When a window doesn't fit, the original leaves parts of the threshold surface
+    // unset (no valid row or column of window centers).  Keep those rare cases on
+    // the original code path.
+    bool fits = true;
+    for (unsigned int w = 0; w < windows.size(); w++)
+      fits = fits && windows[w].winx <= im.cols && 2 * (windows[w].winy/2) < im.rows;
+
+    if (!fits)
+    {
+      for (unsigned int w = 0; w < windows.size(); w++)
+      {
+        NiblackSauvolaWolfJolion (im, outputs[w], windows[w].version, windows[w].winx, windows[w].winy, windows[w].k, dR);
+        bitwise_not(outputs[w], outputs[w]);
+      }
+      return;
+    }
+
+    Mat im_sum, im_sum_sq;
+    cv::integral(im, im_sum, im_sum_sq, CV_64F);
+
+    double min_I, max_I;
+    minMaxLoc(im, &min_I, &max_I);
+
+    std::vector<WindowPass> passes(windows.size());
+    for (unsigned int w = 0; w < windows.size(); w++)
+    {
+      WindowPass& pass = passes[w];
+      pass.window = windows[w];
+      pass.wxh = pass.window.winx/2;
+      pass.wyh = pass.window.winy/2;
+      pass.x_firstth = pass.wxh;
+      pass.x_lastth = im.cols - pass.wxh - 1;
+      pass.y_firstth = pass.wyh;
+      pass.y_lastth = im.rows - pass.wyh - 1;
+      pass.winarea = pass.window.winx * pass.window.winy;
+      pass.thRow.resize(im.cols);
+      pass.thRowSource = -1;
+
+      // Only Wolf needs the global maximum deviation before it can threshold anything
+      pass.max_s = 0;
+      if (pass.window.version == WOLFJOLION)
+        pass.max_s = maxLocalDeviation(im_sum, im_sum_sq, pass, im.cols);
+    }
+
+    // Single pass over the image rows.  Rows above/below the valid window range reuse
+    // the nearest computed threshold row, exactly like the original border fill.
+    for (int y = 0; y < im.rows; y++)
+    {
+      const uchar* im_row = im.ptr<uchar>(y);
+
+      for (unsigned int w = 0; w < passes.size(); w++)
+      {
+        WindowPass& pass = passes[w];
+        int source_row = std::min(std::max(y, pass.y_firstth), pass.y_lastth);
+        if (pass.thRowSource != source_row)
+          computeThresholdRow(im_sum, im_sum_sq, pass, source_row, im.cols, min_I, dR);
+
+        const float* th_row = &pass.thRow[0];
+        uchar* out_row = outputs[w].ptr<uchar>(y);
+
+        // Written as !(>=) so a NaN threshold gives the same result as the original
+        for (int x = 0; x < im.cols; x++)
+          out_row[x] = !(im_row[x] >= th_row[x]) ? 255 : 0;
+      }
+    }
+  }
+
+}
@@ -45,6 +45,20 @@ namespace alpr
   void NiblackSauvolaWolfJolion (cv::Mat im, cv::Mat output, NiblackVersion version,
                                  int winx, int winy, double k, double dR=BINARIZEWOLF_DEFAULTDR);
 
+  struct BinarizeWindow
+  {
+    NiblackVersion version;
+    int winx;
+    int winy;
+    double k;
+  };
+
+  // Binarizes im once per window, sharing one pair of integral images between all of
+  // them.  Each output is inverted (text is 255), and matches NiblackSauvolaWolfJolion
+  // followed by bitwise_not bit for bit.
+  void NiblackSauvolaWolfJolionInv (const cv::Mat& im, const std::vector<BinarizeWindow>& windows,
+                                    std::vector<cv::Mat>& outputs, double dR=BINARIZEWOLF_DEFAULTDR);
+
 }
 
 #endif // OPENALPR_BINARIZEWOLF_H
@@ -0,0 +1,274 @@
+/*
+ * Copyright (c) 2015 OpenALPR Technology, Inc.
+ * Open source Automated License Plate Recognition [http://www.openalpr.com]
+ *
+ * This file is part of OpenALPR.
+ *
+ * OpenALPR is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License
+ * version 3 as published by the Free Software Foundation
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "binary_results.h"
+
+#include <cstring>
+#include <stdint.h>
+
+namespace alpr
+{
+
+  namespace
+  {
+    const uint32_t BINARY_RESULTS_MAGIC = 0x41524232; // "ARB2"
+
+    class BinaryWriter
+    {
+    public:
+      BinaryWriter(std::string& out) : out(out) {}
+
+      template <typename T>
+      void put(T value)
+      {
+        out.append(reinterpret_cast<const char*>(&value), sizeof(T));
+      }
+
+      void putString(const std::string& value)
+      {
+        put<uint32_t>(value.size());
+        out.append(value);
+      }
+
+    private:
+      std::string& out;
+    };
+
+    class BinaryReader
+    {
+    public:
+      BinaryReader(const char* data, size_t length) : data(data), length(length), pos(0), ok(true) {}
+
+      template <typename T>
+      T get()
+      {
+        T value = T();
+        if (!ok || length - pos < sizeof(T))
+        {
+          ok = false;
+          return value;
+        }
+        memcpy(&value, data + pos, sizeof(T));
+        pos += sizeof(T);
+        return value;
+      }
+
+      std::string getString()
+      {
+        uint32_t size = get<uint32_t>();
+        if (!ok || length - pos < size)
+        {
+          ok = false;
+          return "";
+        }
+        std::string value(data + pos, size);
+        pos += size;
+        return value;
+      }
+
+      // Guards element counts so a corrupt buffer can't trigger a huge allocation
+      uint32_t getCount(size_t minElementSize)
+      {
+        uint32_t count = get<uint32_t>();
+        if (ok && (size_t) count * minElementSize > length - pos)
+          ok = false;
+        return ok ? count : 0;
+      }
+
+      const char* data;
+      size_t length;
+      size_t pos;
+      bool ok;
+    };
+
+    void writePlate(BinaryWriter& writer, const AlprPlate& plate)
+    {
+      writer.putString(plate.characters);
+      writer.put<float>(plate.overall_confidence);
+      writer.put<uint8_t>(plate.matches_template ? 1 : 0);
+      writer.put<uint32_t>(plate.character_details.size());
+      for (unsigned int i = 0; i < plate.character_details.size(); i++)
+      {
+        const AlprChar& details = plate.character_details[i];
+        writer.putString(details.character);
+        writer.put<float>(details.confidence);
+        for (int c = 0; c < 4; c++)
+        {
+          writer.put<int32_t>(details.corners[c].x);
+          writer.put<int32_t>(details.corners[c].y);
+        }
+      }
+    }
+
+    AlprPlate readPlate(BinaryReader& reader)
+    {
+      AlprPlate plate;
+      plate.characters = reader.getString();
+      plate.overall_confidence = reader.get<float>();
+      plate.matches_template = reader.get<uint8_t>() != 0;
+      uint32_t num_chars = reader.getCount(sizeof(uint32_t) + sizeof(float) + 8 * sizeof(int32_t));
+      for (uint32_t i = 0; i < num_chars; i++)
+      {
+        AlprChar details;
+        details.character = reader.getString();
+        details.confidence = reader.get<float>();
+        for (int c = 0; c < 4; c++)
+        {
+          details.corners[c].x = reader.get<int32_t>();
+          details.corners[c].y = reader.get<int32_t>();
+        }
+        plate.character_details.push_back(details);
+      }
+      return plate;
+    }
+  }
+
+  void writeBinaryResults(const AlprResults& results, std::string& out)
+  {
+    out.clear();
+    BinaryWriter writer(out);
+
+    writer.put<uint32_t>(BINARY_RESULTS_MAGIC);
+    writer.put<int64_t>(results.epoch_time);
+    writer.put<int64_t>(results.frame_number);
+    writer.put<int32_t>(results.img_width);
+    writer.put<int32_t>(results.img_height);
+    writer.put<float>(results.total_processing_time_ms);
+    writer.putString(results.profile);
+    writer.put<int32_t>(results.ocr_passes_total);
+    writer.put<int32_t>(results.ocr_passes_skipped);
+    writer.putString(results.vehicle);
+    writer.putString(results.scenario);
+    writer.put<int32_t>(results.ocr_burst_frames);
+    writer.put<int32_t>(results.vote_window);
+    writer.put<int32_t>(results.min_votes);
+    writer.put<int32_t>(results.votes_emitted);
+    writer.put<int32_t>(results.final_plate_count);
+    writer.put<int32_t>(results.fallback_attempts);
+    writer.put<int32_t>(results.fallback_ocr_enabled);
+    writer.put<int32_t>(results.ocr_quality_skipped);
+
+    writer.put<uint32_t>(results.regionsOfInterest.size());
+    for (unsigned int i = 0; i < results.regionsOfInterest.size(); i++)
+    {
+      writer.put<int32_t>(results.regionsOfInterest[i].x);
+      writer.put<int32_t>(results.regionsOfInterest[i].y);
+      writer.put<int32_t>(results.regionsOfInterest[i].width);
+      writer.put<int32_t>(results.regionsOfInterest[i].height);
+    }
+
+    writer.put<uint32_t>(results.plates.size());
+    for (unsigned int i = 0; i < results.plates.size(); i++)
+    {
+      const AlprPlateResult& plate = results.plates[i];
+      writer.put<int32_t>(plate.requested_topn);
+      writer.putString(plate.country);
+      writer.put<float>(plate.processing_time_ms);
+      for (int c = 0; c < 4; c++)
+      {
+        writer.put<int32_t>(plate.plate_points[c].x);
+        writer.put<int32_t>(plate.plate_points[c].y);
+      }
+      writer.put<int32_t>(plate.plate_index);
+      writer.put<int32_t>(plate.regionConfidence);
+      writer.putString(plate.region);
+      writer.put<float>(plate.quality.score);
+      writer.put<float>(plate.quality.sharpness);
+      writer.put<float>(plate.quality.char_height);
+      writer.put<float>(plate.quality.contrast);
+      writer.put<float>(plate.quality.clipped);
+
+      writePlate(writer, plate.bestPlate);
+      writer.put<uint32_t>(plate.topNPlates.size());
+      for (unsigned int p = 0; p < plate.topNPlates.size(); p++)
+        writePlate(writer, plate.topNPlates[p]);
+    }
+  }
+
+  bool readBinaryResults(const char* data, size_t length, AlprResults& results)
+  {
+    BinaryReader reader(data, length);
+
+    if (reader.get<uint32_t>() != BINARY_RESULTS_MAGIC)
+      return false;
+
+    results.epoch_time = reader.get<int64_t>();
+    results.frame_number = reader.get<int64_t>();
+    results.img_width = reader.get<int32_t>();
+    results.img_height = reader.get<int32_t>();
+    results.total_processing_time_ms = reader.get<float>();
+    results.profile = reader.getString();
+    results.ocr_passes_total = reader.get<int32_t>();
+    results.ocr_passes_skipped = reader.get<int32_t>();
+    results.vehicle = reader.getString();
+    results.scenario = reader.getString();
+    results.ocr_burst_frames = reader.get<int32_t>();
+    results.vote_window = reader.get<int32_t>();
+    results.min_votes = reader.get<int32_t>();
+    results.votes_emitted = reader.get<int32_t>();
+    results.final_plate_count = reader.get<int32_t>();
+    results.fallback_attempts = reader.get<int32_t>();
+    results.fallback_ocr_enabled = reader.get<int32_t>();
+    results.ocr_quality_skipped = reader.get<int32_t>();
+
+    results.regionsOfInterest.clear();
+    uint32_t num_rois = reader.getCount(4 * sizeof(int32_t));
+    for (uint32_t i = 0; i < num_rois; i++)
+    {
+      int x = reader.get<int32_t>();
+      int y = reader.get<int32_t>();
+      int width = reader.get<int32_t>();
+      int height = reader.get<int32_t>();
+      results.regionsOfInterest.push_back(AlprRegionOfInterest(x, y, width, height));
+    }
+
+    results.plates.clear();
+    uint32_t num_plates = reader.getCount(sizeof(int32_t));
+    for (uint32_t i = 0; i < num_plates && reader.ok; i++)
+    {
+      AlprPlateResult plate;
+      plate.requested_topn = reader.get<int32_t>();
+      plate.country = reader.getString();
+      plate.processing_time_ms = reader.get<float>();
+      for (int c = 0; c < 4; c++)
+      {
+        plate.plate_points[c].x = reader.get<int32_t>();
+        plate.plate_points[c].y = reader.get<int32_t>();
+      }
+      plate.plate_index = reader.get<int32_t>();
+      plate.regionConfidence = reader.get<int32_t>();
+      plate.region = reader.getString();
+      plate.quality.score = reader.get<float>();
+      plate.quality.sharpness = reader.get<float>();
+      plate.quality.char_height = reader.get<float>();
+      plate.quality.contrast = reader.get<float>();
+      plate.quality.clipped = reader.get<float>();
+
+      plate.bestPlate = readPlate(reader);
+      uint32_t num_candidates = reader.getCount(sizeof(uint32_t));
+      for (uint32_t p = 0; p < num_candidates && reader.ok; p++)
+        plate.topNPlates.push_back(readPlate(reader));
+
+      results.plates.push_back(plate);
+    }
+
+    return reader.ok;
+  }
+
+}
@@ -0,0 +1,40 @@
+/*
+ * Copyright (c) 2015 OpenALPR Technology, Inc.
+ * Open source Automated License Plate Recognition [http://www.openalpr.com]
+ *
+ * This file is part of OpenALPR.
+ *
+ * OpenALPR is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License
+ * version 3 as published by the Free Software Foundation
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef OPENALPR_BINARYRESULTS_H
+#define OPENALPR_BINARYRESULTS_H
+
+#include <string>
+
+#include "alpr.h"
+
+namespace alpr
+{
+
+  // Compact binary encoding of AlprResults for passing results between processes
+  // on the same host.  Numbers are written in native byte order, strings are
+  // length-prefixed.  Carries the same fields as Alpr::toJson.
+  void writeBinaryResults(const AlprResults& results, std::string& out);
+
+  // Returns false if the buffer is truncated or was written by another format version
+  bool readBinaryResults(const char* data, size_t length, AlprResults& results);
+
+}
+
+#endif // OPENALPR_BINARYRESULTS_H
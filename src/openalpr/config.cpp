@@ -84,6 +84,7 @@ namespace alpr
     string debug_message = "";
 
     this->loaded = false;
+    this->countryConfig = NULL;
 
 
 
@@ -279,6 +280,27 @@ namespace alpr
     maxPlateHeightPercent = getFloat(ini, defaultIni, "", "max_plate_height_percent", 100);
     maxDetectionInputWidth = getInt(ini, defaultIni, "", "max_detection_input_width", 1280);
     maxDetectionInputHeight = getInt(ini, defaultIni, "", "max_detection_input_height", 768);
+    detectionTiling = getBoolean(ini, defaultIni, "", "detection_tiling", false);
+    detectionTileThreads = getInt(ini, defaultIni, "", "detection_tile_threads", 4);
+    if (detectionTileThreads < 1)
+      detectionTileThreads = 1;
+    detectionTileSize = getFloat(ini, defaultIni, "", "detection_tile_size", 3);
+    if (detectionTileSize < 2)
+      detectionTileSize = 2;
+    reducedDecode = getBoolean(ini, defaultIni, "", "reduced_decode", false);
+
+    motionMaxWidth = getInt(ini, defaultIni, "", "motion_max_width", 320);
+    motionMinAreaPercent = getFloat(ini, defaultIni, "", "motion_min_area_percent", 0.1);
+    motionMergePercent = getFloat(ini, defaultIni, "", "motion_merge_percent", 3);
+    motionPaddingPercent = getFloat(ini, defaultIni, "", "motion_padding_percent", 25);
+    motionMaxRegions = getInt(ini, defaultIni, "", "motion_max_regions", 6);
+
+    plateTracking = getBoolean(ini, defaultIni, "", "plate_tracking", false);
+    plateTrackIou = getFloat(ini, defaultIni, "", "plate_track_iou", 0.5);
+    plateTrackMaxAppearanceDiff = getFloat(ini, defaultIni, "", "plate_track_max_appearance_diff", 12);
+    plateTrackMinConfidence = getFloat(ini, defaultIni, "", "plate_track_min_confidence", 80);
+    plateTrackReocrFrames = getInt(ini, defaultIni, "", "plate_track_reocr_frames", 30);
+    plateTrackMaxMissedFrames = getInt(ini, defaultIni, "", "plate_track_max_missed_frames", 5);
 
     contrastDetectionThreshold = getFloat(ini, defaultIni, "", "contrast_detection_threshold", 0.3);
     
@@ -289,6 +311,10 @@ namespace alpr
     detection_mask_image = getString(ini, defaultIni, "", "detection_mask_image", "");
     
     analysis_count = getInt(ini, defaultIni, "", "analysis_count", 1);
+
+    plateAnalysisThreads = getInt(ini, defaultIni, "", "plate_analysis_threads", 1);
+    if (plateAnalysisThreads < 1)
+      plateAnalysisThreads = 1;
     
     prewarp = getString(ini, defaultIni, "", "prewarp", "");
 
@@ -320,6 +346,7 @@ namespace alpr
     int defaultBurst = 1;
     int defaultMinVotes = 1;
     bool defaultFallback = false;
+    int defaultBestShots = 0;
     if (vehicle == "moto") {
       defaultBurst = 6;
       defaultMinVotes = 3;
@@ -328,6 +355,7 @@ namespace alpr
       defaultBurst = std::max(defaultBurst, 10);
       defaultMinVotes = std::max(defaultMinVotes, 3);
       defaultFallback = true;
+      defaultBestShots = 3;
     }
 
     ocrBurstFrames = (configuredBurst > 0) ? configuredBurst : defaultBurst;
@@ -343,12 +371,37 @@ namespace alpr
     std::cout << "[config] ocr_burst_frames=" << ocrBurstFrames
               << " vote_window=" << voteWindow
               << " min_votes=" << minVotes << std::endl;
+
+    ocrPassCacheSize = getInt(ini, defaultIni, "", "ocr_pass_cache_size", 32);
+    if (ocrPassCacheSize < 0)
+      ocrPassCacheSize = 0;
+    ocrEarlyExitConfidence = getFloat(ini, defaultIni, "", "ocr_early_exit_confidence", 0);
+    ocrEarlyExitRequirePattern = getBoolean(ini, defaultIni, "", "ocr_early_exit_require_pattern", true);
+    ocrMinQuality = getFloat(ini, defaultIni, "", "ocr_min_quality", 0);
+    int configuredBestShots = getInt(ini, defaultIni, "", "ocr_best_shots", -1);
+    ocrBestShots = (configuredBestShots >= 0) ? configuredBestShots : defaultBestShots;
+    int configuredBestShotWindow = getInt(ini, defaultIni, "", "ocr_best_shot_window", 0);
+    ocrBestShotWindow = (configuredBestShotWindow > 0) ? configuredBestShotWindow : voteWindow;
+    if (ocrBestShots > 0 && ocrBestShotWindow <= ocrBestShots) {
+      if (configuredBestShotWindow > 0)
+        std::cerr << "[config][warn] ocr_best_shot_window must be larger than ocr_best_shots; using " << ocrBestShots * 3 << std::endl;
+      ocrBestShotWindow = ocrBestShots * 3;
+    }
+    std::cout << "[config] ocr_min_quality=" << ocrMinQuality
+              << " ocr_best_shots=" << ocrBestShots
+              << " ocr_best_shot_window=" << ocrBestShotWindow << std::endl;
+
+    std::cout << "[config] ocr_pass_cache_size=" << ocrPassCacheSize
+              << " ocr_early_exit_confidence=" << ocrEarlyExitConfidence
+              << " ocr_early_exit_require_pattern=" << (ocrEarlyExitRequirePattern ? 1 : 0) << std::endl;
             
     maxPlateAngleDegrees = getInt(ini, defaultIni, "", "max_plate_angle_degrees", 15);
 
 
     ocrImagePercent = getFloat(ini, defaultIni, "", "ocr_img_size_percent", 100);
     stateIdImagePercent = getFloat(ini, defaultIni, "", "state_id_img_size_percent", 100);
+    stateIdMatcher = getString(ini, defaultIni, "", "state_id_matcher", "auto");
+    stateIdShortlist = getInt(ini, defaultIni, "", "state_id_shortlist", 8);
 
     ocrMinFontSize = getInt(ini, defaultIni, "", "ocr_min_font_point", 100);
 
@@ -365,6 +418,16 @@ namespace alpr
     }
     brHybridFallbackRegion = getString(ini, defaultIni, "", "br_hybrid_fallback_region", "");
     brHybridMinConfidence = getFloat(ini, defaultIni, "", "br_hybrid_min_confidence", 80);
+    brHybridPolicy = getString(ini, defaultIni, "", "br_hybrid_policy", "exhaustive");
+    std::transform(brHybridPolicy.begin(), brHybridPolicy.end(), brHybridPolicy.begin(), ::tolower);
+    if (brHybridPolicy != "exhaustive" &&
+        brHybridPolicy != "ordered" &&
+        brHybridPolicy != "parallel")
+    {
+      std::cerr << "[config][warn] invalid br_hybrid_policy=" << brHybridPolicy << ", using exhaustive" << std::endl;
+      brHybridPolicy = "exhaustive";
+    }
+    brHybridShareDetection = getBoolean(ini, defaultIni, "", "br_hybrid_share_detection", true);
 
     // OCR / plugins / vehicle attributes (parser only; no runtime changes)
     ocrConfig.primary = getString(ini, defaultIni, "", "ocr_primary", "openalpr");
@@ -460,87 +523,89 @@ namespace alpr
   }
   
   
-  void Config::loadCountryValues(string configFile, string country)
+  void Config::loadCountryValues(string configFile, string country, CountryConfig& values)
   {
     CSimpleIniA iniObj;
     iniObj.SetMultiKey(true);
     iniObj.LoadFile(configFile.c_str());
     CSimpleIniA* ini = &iniObj;
+
+    values.country = country;
     
-    minPlateSizeWidthPx = getInt(ini, "", "min_plate_size_width_px", 100);
-    minPlateSizeHeightPx = getInt(ini, "", "min_plate_size_height_px", 100);
+    values.minPlateSizeWidthPx = getInt(ini, "", "min_plate_size_width_px", 100);
+    values.minPlateSizeHeightPx = getInt(ini, "", "min_plate_size_height_px", 100);
 
-    multiline = 	getBoolean(ini, "", "multiline",		false);
+    values.multiline = 	getBoolean(ini, "", "multiline",		false);
 
     string invert_val = getString(ini, "", "invert", "auto");
 
     if (invert_val == "always")
     {
-      auto_invert = false;
-      always_invert = true;
+      values.auto_invert = false;
+      values.always_invert = true;
     }
     else if (invert_val == "never")
     {
-      auto_invert = false;
-      always_invert = false;
+      values.auto_invert = false;
+      values.always_invert = false;
     }
     else
     {
-      auto_invert = true;
-      always_invert = false;
+      values.auto_invert = true;
+      values.always_invert = false;
     }
 
-    plateWidthMM = getFloat(ini, "", "plate_width_mm", 100);
-    plateHeightMM = getFloat(ini, "", "plate_height_mm", 100);
+    values.plateWidthMM = getFloat(ini, "", "plate_width_mm", 100);
+    values.plateHeightMM = getFloat(ini, "", "plate_height_mm", 100);
 
-    charHeightMM = getAllFloats(ini, "", "char_height_mm");
-    charWidthMM = getAllFloats(ini, "", "char_width_mm");
+    values.charHeightMM = getAllFloats(ini, "", "char_height_mm");
+    values.charWidthMM = getAllFloats(ini, "", "char_width_mm");
     
     // Compute the average char height/widths 
-    avgCharHeightMM = 0;
-    avgCharWidthMM = 0;
-    for (unsigned int i = 0; i < charHeightMM.size(); i++)
+    values.avgCharHeightMM = 0;
+    values.avgCharWidthMM = 0;
+    for (unsigned int i = 0; i < values.charHeightMM.size(); i++)
     {
-      avgCharHeightMM += charHeightMM[i];
-      avgCharWidthMM += charWidthMM[i];
+      values.avgCharHeightMM += values.charHeightMM[i];
+      values.avgCharWidthMM += values.charWidthMM[i];
     }
-    avgCharHeightMM /= charHeightMM.size();
-    avgCharWidthMM /= charHeightMM.size();
+    values.avgCharHeightMM /= values.charHeightMM.size();
+    values.avgCharWidthMM /= values.charHeightMM.size();
     
-    charWhitespaceTopMM = getFloat(ini, "", "char_whitespace_top_mm", 100);
-    charWhitespaceBotMM = getFloat(ini, "", "char_whitespace_bot_mm", 100);
-    charWhitespaceBetweenLinesMM = getFloat(ini, "", "char_whitespace_between_lines_mm", 5);
+    values.charWhitespaceTopMM = getFloat(ini, "", "char_whitespace_top_mm", 100);
+    values.charWhitespaceBotMM = getFloat(ini, "", "char_whitespace_bot_mm", 100);
+    values.charWhitespaceBetweenLinesMM = getFloat(ini, "", "char_whitespace_between_lines_mm", 5);
 
-    templateWidthPx = getInt(ini, "", "template_max_width_px", 100);
-    templateHeightPx = getInt(ini, "", "template_max_height_px", 100);
+    values.templateWidthPx = getInt(ini, "", "template_max_width_px", 100);
+    values.templateHeightPx = getInt(ini, "", "template_max_height_px", 100);
 
-    charAnalysisMinPercent = getFloat(ini, "", "char_analysis_min_pct", 0);
-    charAnalysisHeightRange = getFloat(ini, "", "char_analysis_height_range", 0);
-    charAnalysisHeightStepSize = getFloat(ini, "", "char_analysis_height_step_size", 0);
-    charAnalysisNumSteps = getInt(ini, "", "char_analysis_height_num_steps", 0);
+    values.charAnalysisMinPercent = getFloat(ini, "", "char_analysis_min_pct", 0);
+    values.charAnalysisHeightRange = getFloat(ini, "", "char_analysis_height_range", 0);
+    values.charAnalysisHeightStepSize = getFloat(ini, "", "char_analysis_height_step_size", 0);
+    values.charAnalysisNumSteps = getInt(ini, "", "char_analysis_height_num_steps", 0);
 
-    segmentationMinSpeckleHeightPercent = getFloat(ini, "", "segmentation_min_speckle_height_percent", 0);
-    segmentationMinBoxWidthPx = getInt(ini, "", "segmentation_min_box_width_px", 0);
-    segmentationMinCharHeightPercent = getFloat(ini, "", "segmentation_min_charheight_percent", 0);
-    segmentationMaxCharWidthvsAverage = getFloat(ini, "", "segmentation_max_segment_width_percent_vs_average", 0);
+    values.segmentationMinSpeckleHeightPercent = getFloat(ini, "", "segmentation_min_speckle_height_percent", 0);
+    values.segmentationMinBoxWidthPx = getInt(ini, "", "segmentation_min_box_width_px", 0);
+    values.segmentationMinCharHeightPercent = getFloat(ini, "", "segmentation_min_charheight_percent", 0);
+    values.segmentationMaxCharWidthvsAverage = getFloat(ini, "", "segmentation_max_segment_width_percent_vs_average", 0);
 
-    plateLinesSensitivityVertical = getFloat(ini, "", "plateline_sensitivity_vertical", 0);
-    plateLinesSensitivityHorizontal = getFloat(ini, "", "plateline_sensitivity_horizontal", 0);
+    values.plateLinesSensitivityVertical = getFloat(ini, "", "plateline_sensitivity_vertical", 0);
+    values.plateLinesSensitivityHorizontal = getFloat(ini, "", "plateline_sensitivity_horizontal", 0);
 
-    detectorFile = getString(ini, "", "detector_file", "");
+    values.detectorFile = getString(ini, "", "detector_file", "");
     
-    ocrLanguage = getString(ini, "", "ocr_language", "none");
+    values.ocrLanguage = getString(ini, "", "ocr_language", "none");
 
-    postProcessRegexLetters = getString(ini, "", "postprocess_regex_letters", "\\pL");
-    postProcessRegexNumbers = getString(ini, "", "postprocess_regex_numbers", "\\pN");
+    values.postProcessRegexLetters = getString(ini, "", "postprocess_regex_letters", "\\pL");
+    values.postProcessRegexNumbers = getString(ini, "", "postprocess_regex_numbers", "\\pN");
 
-    ocrImageWidthPx = round(((float) templateWidthPx) * ocrImagePercent);
-    ocrImageHeightPx = round(((float)templateHeightPx) * ocrImagePercent);
-    stateIdImageWidthPx = round(((float)templateWidthPx) * stateIdImagePercent);
-    stateIdimageHeightPx = round(((float)templateHeightPx) * stateIdImagePercent);
+    values.ocrImageWidthPx = round(((float) values.templateWidthPx) * ocrImagePercent);
+    values.ocrImageHeightPx = round(((float)values.templateHeightPx) * ocrImagePercent);
+    values.stateIdImageWidthPx = round(((float)values.templateWidthPx) * stateIdImagePercent);
+    values.stateIdimageHeightPx = round(((float)values.templateHeightPx) * stateIdImagePercent);
 
-    postProcessMinCharacters = getInt(ini, "", "postprocess_min_characters", 4);
-    postProcessMaxCharacters = getInt(ini, "", "postprocess_max_characters", 8);
+    values.postProcessMinCharacters = getInt(ini, "", "postprocess_min_characters", 4);
+    values.postProcessMaxCharacters = getInt(ini, "", "postprocess_max_characters", 8);
   }
 
   void Config::setDebug(bool value)
@@ -619,25 +684,62 @@ namespace alpr
     return false;
   }
 
+  const CountryConfig* Config::getCountryConfig(const std::string& country) const
+  {
+    std::map<std::string, std::shared_ptr<const CountryConfig> >::const_iterator it = countrySnapshots.find(country);
+    if (it == countrySnapshots.end())
+      return NULL;
+
+    return it->second.get();
+  }
+
   bool Config::setCountry(std::string country)
   {
     this->country = country;
+
+    // Each country is resolved from disk once.  Switching back to it later only swaps
+    // the active snapshot, so steady-state frames never hit the file system.
+    std::shared_ptr<const CountryConfig> snapshot;
+    std::map<std::string, std::shared_ptr<const CountryConfig> >::iterator it = countrySnapshots.find(country);
+    if (it != countrySnapshots.end())
+    {
+      snapshot = it->second;
+    }
+    else
+    {
+      snapshot = loadCountrySnapshot(country);
+      if (!snapshot)
+        return false;
+
+      countrySnapshots[country] = snapshot;
+    }
+
+    applyCountryConfig(*snapshot);
+
+    if (!country_is_loaded(country))
+      this->loaded_countries.push_back(country);
     
-    
+    return true;
+  }
+
+  std::shared_ptr<const CountryConfig> Config::loadCountrySnapshot(const std::string& country)
+  {
+    std::shared_ptr<const CountryConfig> none;
 
     std::string country_config_file = this->runtimeBaseDir + "/config/" + country + ".conf";
     if (fileExists(country_config_file.c_str()) == false)
     {
       std::cerr << "--(!) Country config file '" << country_config_file << "' does not exist.  Missing config for the country: '" << country<< "'!" << endl;
-      return false;
+      return none;
     }
 
-    loadCountryValues(country_config_file, country);
+    std::shared_ptr<CountryConfig> values(new CountryConfig());
+    loadCountryValues(country_config_file, country, *values);
 
-    if (fileExists((this->runtimeBaseDir + "/ocr/tessdata/" + this->ocrLanguage + ".traineddata").c_str()) == false)
+    if (fileExists((this->runtimeBaseDir + "/ocr/tessdata/" + values->ocrLanguage + ".traineddata").c_str()) == false)
     {
       std::cerr << "--(!) Runtime directory '" << this->runtimeBaseDir << "' is invalid.  Missing OCR data for the country: '" << country<< "'!" << endl;
-      return false;
+      return none;
     }
 
     std::string cascadePath = this->runtimeBaseDir + CASCADE_DIR + country + ".xml";
@@ -655,13 +757,52 @@ namespace alpr
         }
         std::cerr << std::endl;
       }
-      return false;
+      return none;
     }
 
-    if (!country_is_loaded(country))
-      this->loaded_countries.push_back(country);
-    
-    return true;
+    return values;
+  }
+
+  void Config::applyCountryConfig(const CountryConfig& values)
+  {
+    this->countryConfig = &values;
+
+    minPlateSizeWidthPx = values.minPlateSizeWidthPx;
+    minPlateSizeHeightPx = values.minPlateSizeHeightPx;
+    multiline = values.multiline;
+    auto_invert = values.auto_invert;
+    always_invert = values.always_invert;
+    plateWidthMM = values.plateWidthMM;
+    plateHeightMM = values.plateHeightMM;
+    charHeightMM = values.charHeightMM;
+    charWidthMM = values.charWidthMM;
+    avgCharHeightMM = values.avgCharHeightMM;
+    avgCharWidthMM = values.avgCharWidthMM;
+    charWhitespaceTopMM = values.charWhitespaceTopMM;
+    charWhitespaceBotMM = values.charWhitespaceBotMM;
+    charWhitespaceBetweenLinesMM = values.charWhitespaceBetweenLinesMM;
+    templateWidthPx = values.templateWidthPx;
+    templateHeightPx = values.templateHeightPx;
+    charAnalysisMinPercent = values.charAnalysisMinPercent;
+    charAnalysisHeightRange = values.charAnalysisHeightRange;
+    charAnalysisHeightStepSize = values.charAnalysisHeightStepSize;
+    charAnalysisNumSteps = values.charAnalysisNumSteps;
+    segmentationMinSpeckleHeightPercent = values.segmentationMinSpeckleHeightPercent;
+    segmentationMinBoxWidthPx = values.segmentationMinBoxWidthPx;
+    segmentationMinCharHeightPercent = values.segmentationMinCharHeightPercent;
+    segmentationMaxCharWidthvsAverage = values.segmentationMaxCharWidthvsAverage;
+    plateLinesSensitivityVertical = values.plateLinesSensitivityVertical;
+    plateLinesSensitivityHorizontal = values.plateLinesSensitivityHorizontal;
+    detectorFile = values.detectorFile;
+    ocrLanguage = values.ocrLanguage;
+    postProcessRegexLetters = values.postProcessRegexLetters;
+    postProcessRegexNumbers = values.postProcessRegexNumbers;
+    ocrImageWidthPx = values.ocrImageWidthPx;
+    ocrImageHeightPx = values.ocrImageHeightPx;
+    stateIdImageWidthPx = values.stateIdImageWidthPx;
+    stateIdimageHeightPx = values.stateIdimageHeightPx;
+    postProcessMinCharacters = values.postProcessMinCharacters;
+    postProcessMaxCharacters = values.postProcessMaxCharacters;
   }
 
 }
@@ -23,7 +23,10 @@
 
 
 #include "constants.h"
+#include "country_config.h"
 
+#include <map>
+#include <memory>
 #include <string>
 #include <vector>
 
@@ -45,6 +48,13 @@ namespace alpr
 
       std::string country;
 
+      // Immutable settings for the active country.  The per-country fields below
+      // mirror this snapshot for existing callers.
+      const CountryConfig* countryConfig;
+
+      // Snapshot for a country that has already been loaded, or NULL
+      const CountryConfig* getCountryConfig(const std::string& country) const;
+
       struct OCRConfig {
         std::string primary;
         std::string policy; // primary_only | fallback_on_low_confidence | ensemble
@@ -86,6 +96,31 @@ namespace alpr
       float maxPlateHeightPercent;
       int maxDetectionInputWidth;
       int maxDetectionInputHeight;
+      // Split the detection image into overlapping tiles scanned in parallel (DetectorCPU)
+      bool detectionTiling;
+      int detectionTileThreads;
+      float detectionTileSize;      // tile edge, in maximum plate sizes
+      // Decode JPEGs at 1/2, 1/4 or 1/8 size for detection; plates are read from the full-size image
+      bool reducedDecode;
+
+      // Motion detection front end (MotionDetector)
+      int motionMaxWidth;
+      float motionMinAreaPercent;
+      float motionMergePercent;
+      float motionPaddingPercent;
+      int motionMaxRegions;
+
+      // Reuse reads of plates that stay in view across video frames (see PlateTracker)
+      bool plateTracking;
+      float plateTrackIou;
+      float plateTrackMaxAppearanceDiff;
+      float plateTrackMinConfidence;
+      int plateTrackReocrFrames;
+      int plateTrackMaxMissedFrames;
+
+      // Descriptor matching for state identification (see FeatureMatcher)
+      std::string stateIdMatcher;  // auto | bruteforce | lsh
+      int stateIdShortlist;        // reference images the LSH index hands to brute-force matching
       
       float contrastDetectionThreshold;
       
@@ -94,6 +129,7 @@ namespace alpr
       std::string detection_mask_image;
 
       int analysis_count;
+      int plateAnalysisThreads;     // concurrent plate candidate workers per frame
       
       bool auto_invert;
       bool always_invert;
@@ -159,6 +195,8 @@ namespace alpr
       std::vector<std::string> brHybridOrder;
       std::string brHybridFallbackRegion; // format: country:pattern (e.g., eu:ad)
       float brHybridMinConfidence;
+      std::string brHybridPolicy;  // exhaustive | ordered | parallel
+      bool brHybridShareDetection; // reuse detections across attempts with the same cascade
 
       // Vehicle/scenario strategy (core-driven)
       std::string vehicle;         // car | moto
@@ -167,6 +205,12 @@ namespace alpr
       int voteWindow;              // window for temporal voting
       int minVotes;                // minimum votes for acceptance
       bool fallbackOcrEnabled;     // enable fallback OCR attempts
+      int ocrPassCacheSize;        // recent OCR pass inputs remembered per OCR instance (0 = off)
+      float ocrEarlyExitConfidence; // stop running OCR passes once one reaches this (0 = off)
+      bool ocrEarlyExitRequirePattern; // early exit also needs a pattern match
+      float ocrMinQuality;         // crops scoring below this skip OCR (0 = off)
+      int ocrBestShots;            // with plate tracking, OCR only a track's best crops (0 = off)
+      int ocrBestShotWindow;       // recent crops of a track that ocrBestShots picks from
       bool motoUpsample;           // enable upsample for moto crops
       float motoUpsampleScale;     // upsample scale factor
 
@@ -228,17 +272,23 @@ namespace alpr
 
       bool setCountry(std::string country);
 
+      // Splits a comma-separated country list, e.g. "us, eu"
+      std::vector<std::string> parse_country_string(std::string countries);
+
     private:
     
       float ocrImagePercent;
       float stateIdImagePercent;
 
-      std::vector<std::string> parse_country_string(std::string countries);
       std::vector<std::string> parse_hybrid_order(std::string order);
       bool country_is_loaded(std::string country);
 
       void loadCommonValues(std::string configFile);
-      void loadCountryValues(std::string configFile, std::string country);
+      void loadCountryValues(std::string configFile, std::string country, CountryConfig& values);
+      std::shared_ptr<const CountryConfig> loadCountrySnapshot(const std::string& country);
+      void applyCountryConfig(const CountryConfig& values);
+
+      std::map<std::string, std::shared_ptr<const CountryConfig> > countrySnapshots;
 
   };
 
@@ -0,0 +1,92 @@
+/*
+ * Copyright (c) 2015 OpenALPR Technology, Inc.
+ * Open source Automated License Plate Recognition [http://www.openalpr.com]
+ *
+ * This file is part of OpenALPR.
+ *
+ * OpenALPR is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License
+ * version 3 as published by the Free Software Foundation
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef OPENALPR_COUNTRYCONFIG_H
+#define OPENALPR_COUNTRYCONFIG_H
+
+#include <string>
+#include <vector>
+
+namespace alpr
+{
+
+  // Settings resolved from runtime_data/config/<country>.conf.  A snapshot is built
+  // once per country by Config::setCountry and never modified afterwards, so the
+  // pipeline can read it through a const pointer without touching the file system.
+  struct CountryConfig
+  {
+    std::string country;
+
+    float minPlateSizeWidthPx;
+    float minPlateSizeHeightPx;
+
+    bool multiline;
+
+    bool auto_invert;
+    bool always_invert;
+
+    float plateWidthMM;
+    float plateHeightMM;
+
+    std::vector<float> charHeightMM;
+    std::vector<float> charWidthMM;
+
+    float avgCharHeightMM;
+    float avgCharWidthMM;
+
+    float charWhitespaceTopMM;
+    float charWhitespaceBotMM;
+    float charWhitespaceBetweenLinesMM;
+
+    int templateWidthPx;
+    int templateHeightPx;
+
+    int ocrImageWidthPx;
+    int ocrImageHeightPx;
+
+    int stateIdImageWidthPx;
+    int stateIdimageHeightPx;
+
+    float charAnalysisMinPercent;
+    float charAnalysisHeightRange;
+    float charAnalysisHeightStepSize;
+    int charAnalysisNumSteps;
+
+    float plateLinesSensitivityVertical;
+    float plateLinesSensitivityHorizontal;
+
+    float segmentationMinSpeckleHeightPercent;
+    int segmentationMinBoxWidthPx;
+    float segmentationMinCharHeightPercent;
+    float segmentationMaxCharWidthvsAverage;
+
+    std::string detectorFile;
+
+    std::string ocrLanguage;
+
+    std::string postProcessRegexLetters;
+    std::string postProcessRegexNumbers;
+
+    unsigned int postProcessMinCharacters;
+    unsigned int postProcessMaxCharacters;
+  };
+
+}
+
+#endif // OPENALPR_COUNTRYCONFIG_H
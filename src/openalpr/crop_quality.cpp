@@ -0,0 +1,105 @@
+/*
+ * Copyright (c) 2015 OpenALPR Technology, Inc.
+ * Open source Automated License Plate Recognition [http://www.openalpr.com]
+ *
+ * This file is part of OpenALPR.
+ *
+ * OpenALPR is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License
+ * version 3 as published by the Free Software Foundation
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "crop_quality.h"
+
+#include <algorithm>
+#include <cmath>
+#include "opencv2/imgproc/imgproc.hpp"
+
+namespace alpr
+{
+
+  namespace
+  {
+    // Measurements at or above these count as fully readable
+    const float SHARPNESS_REFERENCE = 400;
+    const float CHAR_HEIGHT_REFERENCE = 20;
+    const float CONTRAST_REFERENCE = 40;
+
+    // Gray levels at or beyond these are treated as clipped
+    const int CLIP_LOW = 3;
+    const int CLIP_HIGH = 252;
+
+    float distance(const cv::Point2f& a, const cv::Point2f& b)
+    {
+      return std::sqrt((a.x - b.x) * (a.x - b.x) + (a.y - b.y) * (a.y - b.y));
+    }
+  }
+
+  float combineCropQuality(float sharpness, float charHeight, float contrast, float clipped)
+  {
+    float sharp = std::min(1.0f, sharpness / SHARPNESS_REFERENCE);
+    float height = std::min(1.0f, charHeight / CHAR_HEIGHT_REFERENCE);
+    float spread = std::min(1.0f, contrast / CONTRAST_REFERENCE);
+
+    // A geometric mean, so one bad measurement pulls the score down more than a
+    // middling one.  Clipping costs twice its share of the crop.
+    float base = std::pow(sharp * height * spread, 1.0f / 3);
+    float unclipped = std::max(0.0f, 1.0f - 2 * clipped);
+    return 100 * base * unclipped;
+  }
+
+  AlprCropQuality scoreCropQuality(PipelineData* pipeline_data)
+  {
+    AlprCropQuality quality;
+    const cv::Mat& crop = pipeline_data->crop_gray;
+    if (crop.empty())
+      return quality;
+
+    cv::Mat laplacian;
+    cv::Laplacian(crop, laplacian, CV_32F);
+    cv::Scalar lapMean, lapStdDev;
+    cv::meanStdDev(laplacian, lapMean, lapStdDev);
+    quality.sharpness = (float) (lapStdDev[0] * lapStdDev[0]);
+
+    cv::Scalar grayMean, grayStdDev;
+    cv::meanStdDev(crop, grayMean, grayStdDev);
+    quality.contrast = (float) grayStdDev[0];
+
+    // The text lines are in crop pixels; the plate corners say how many image
+    // pixels one crop row covers
+    float lineHeight = 0;
+    for (unsigned int i = 0; i < pipeline_data->textLines.size(); i++)
+      lineHeight = std::max(lineHeight, pipeline_data->textLines[i].lineHeight);
+    if (pipeline_data->plate_corners.size() == 4)
+    {
+      const std::vector<cv::Point2f>& corners = pipeline_data->plate_corners;
+      float plateHeight = (distance(corners[0], corners[3]) + distance(corners[1], corners[2])) / 2;
+      quality.char_height = lineHeight * plateHeight / crop.rows;
+    }
+
+    // A pixel is clipped only when every channel is pinned at the same end of its range.
+    // One saturated channel is normal for a strongly coloured plate and doesn't cost OCR detail.
+    const cv::Mat& color = pipeline_data->color_deskewed.empty() ? crop : pipeline_data->color_deskewed;
+    cv::Mat pixels = (color.isContinuous() ? color : color.clone()).reshape(1, color.rows * color.cols);
+    cv::Mat brightest, darkest;
+    cv::reduce(pixels, brightest, 1, cv::REDUCE_MAX);
+    cv::reduce(pixels, darkest, 1, cv::REDUCE_MIN);
+    cv::Mat high, low, clippedMask;
+    cv::inRange(darkest, cv::Scalar(CLIP_HIGH), cv::Scalar(255), high);
+    cv::inRange(brightest, cv::Scalar(0), cv::Scalar(CLIP_LOW), low);
+    cv::bitwise_or(high, low, clippedMask);
+    quality.clipped = (float) cv::countNonZero(clippedMask) / pixels.rows;
+
+    quality.score = combineCropQuality(quality.sharpness, quality.char_height, quality.contrast, quality.clipped);
+    return quality;
+  }
+
+}
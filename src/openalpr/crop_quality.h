@@ -0,0 +1,40 @@
+/*
+ * Copyright (c) 2015 OpenALPR Technology, Inc.
+ * Open source Automated License Plate Recognition [http://www.openalpr.com]
+ *
+ * This file is part of OpenALPR.
+ *
+ * OpenALPR is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License
+ * version 3 as published by the Free Software Foundation
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef OPENALPR_CROPQUALITY_H
+#define OPENALPR_CROPQUALITY_H
+
+#include "opencv2/core/core.hpp"
+
+#include "alpr.h"
+#include "pipeline_data.h"
+
+namespace alpr
+{
+
+  // Scores a plate crop that has been deskewed (crop_gray, color_deskewed and
+  // plate_corners filled in), before OCR.  Cheap next to a Tesseract pass.
+  AlprCropQuality scoreCropQuality(PipelineData* pipeline_data);
+
+  // The measurements of a crop combined into a 0-100 score
+  float combineCropQuality(float sharpness, float charHeight, float contrast, float clipped);
+
+}
+
+#endif // OPENALPR_CROPQUALITY_H
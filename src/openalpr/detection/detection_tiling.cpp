@@ -0,0 +1,131 @@
+/*
+ * Copyright (c) 2015 OpenALPR Technology, Inc.
+ * Open source Automated License Plate Recognition [http://www.openalpr.com]
+ *
+ * This file is part of OpenALPR.
+ *
+ * OpenALPR is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License
+ * version 3 as published by the Free Software Foundation
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "detection_tiling.h"
+
+#include <algorithm>
+#include <climits>
+
+using namespace cv;
+using namespace std;
+
+namespace alpr
+{
+
+  // Boxes from different tiles overlapping at least this much (intersection over union)
+  // are the same plate
+  const float TILE_DUPLICATE_OVERLAP = 0.5;
+
+  struct TileDetection
+  {
+    Rect rect;
+    int tile;
+    // Distance to the nearest edge of its tile that isn't also an image edge
+    int margin;
+  };
+
+  static bool tileDetectionHasLargerMargin(const TileDetection& a, const TileDetection& b) { return a.margin > b.margin; }
+
+  vector<int> tileStarts(int length, int tile, int overlap)
+  {
+    vector<int> starts;
+    for (int start = 0; ; start += tile - overlap)
+    {
+      if (start + tile >= length)
+      {
+        starts.push_back(std::max(0, length - tile));
+        break;
+      }
+      starts.push_back(start);
+    }
+    return starts;
+  }
+
+  vector<Rect> detectionTiles(Size imageSize, Size minPlateSize, Size maxPlateSize, float tileSizeInPlates)
+  {
+    Size overlap(std::max(maxPlateSize.width, minPlateSize.width), std::max(maxPlateSize.height, minPlateSize.height));
+    Size tileSize(std::min((int) (overlap.width * tileSizeInPlates), imageSize.width),
+                  std::min((int) (overlap.height * tileSizeInPlates), imageSize.height));
+
+    vector<int> xs = tileStarts(imageSize.width, tileSize.width, overlap.width);
+    vector<int> ys = tileStarts(imageSize.height, tileSize.height, overlap.height);
+
+    vector<Rect> tiles;
+    for (unsigned int y = 0; y < ys.size(); y++)
+    {
+      for (unsigned int x = 0; x < xs.size(); x++)
+        tiles.push_back(Rect(xs[x], ys[y], tileSize.width, tileSize.height));
+    }
+    return tiles;
+  }
+
+  vector<Rect> mergeTileDetections(const vector<Rect>& tiles, const vector<vector<Rect> >& tilePlates, Size imageSize)
+  {
+    vector<TileDetection> detections;
+    for (unsigned int t = 0; t < tiles.size() && t < tilePlates.size(); t++)
+    {
+      Rect tile = tiles[t];
+      for (unsigned int i = 0; i < tilePlates[t].size(); i++)
+      {
+        TileDetection detection;
+        detection.rect = tilePlates[t][i] + tile.tl();
+        detection.tile = t;
+
+        Rect r = detection.rect;
+        detection.margin = INT_MAX;
+        if (tile.x > 0)
+          detection.margin = std::min(detection.margin, r.x - tile.x);
+        if (tile.y > 0)
+          detection.margin = std::min(detection.margin, r.y - tile.y);
+        if (tile.br().x < imageSize.width)
+          detection.margin = std::min(detection.margin, tile.br().x - r.br().x);
+        if (tile.br().y < imageSize.height)
+          detection.margin = std::min(detection.margin, tile.br().y - r.br().y);
+        detections.push_back(detection);
+      }
+    }
+
+    // A plate in an overlap is found by every tile covering it.  Keep the copy found farthest
+    // from a seam; boxes from the same tile are left alone, as in a single pass.
+    std::stable_sort(detections.begin(), detections.end(), tileDetectionHasLargerMargin);
+    vector<TileDetection> kept;
+    for (unsigned int i = 0; i < detections.size(); i++)
+    {
+      bool duplicate = false;
+      for (unsigned int k = 0; k < kept.size() && !duplicate; k++)
+      {
+        if (kept[k].tile == detections[i].tile)
+          continue;
+
+        float intersection = (kept[k].rect & detections[i].rect).area();
+        float combined = kept[k].rect.area() + detections[i].rect.area() - intersection;
+        duplicate = intersection >= TILE_DUPLICATE_OVERLAP * combined;
+      }
+
+      if (!duplicate)
+        kept.push_back(detections[i]);
+    }
+
+    vector<Rect> plates;
+    for (unsigned int i = 0; i < kept.size(); i++)
+      plates.push_back(kept[i].rect);
+    return plates;
+  }
+
+}
@@ -0,0 +1,47 @@
+/*
+ * Copyright (c) 2015 OpenALPR Technology, Inc.
+ * Open source Automated License Plate Recognition [http://www.openalpr.com]
+ *
+ * This file is part of OpenALPR.
+ *
+ * OpenALPR is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License
+ * version 3 as published by the Free Software Foundation
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef OPENALPR_DETECTIONTILING_H
+#define OPENALPR_DETECTIONTILING_H
+
+#include <vector>
+#include "opencv2/core/core.hpp"
+
+namespace alpr
+{
+
+  // Starts of tiles `tile` long that overlap by `overlap` and cover [0, length).  The last
+  // tile is pulled back to end at length, which only adds overlap.
+  std::vector<int> tileStarts(int length, int tile, int overlap);
+
+  // Tiles for scanning an image in pieces.  Each is tileSizeInPlates times the largest
+  // plate (but no bigger than the image), and neighbours overlap by the largest plate, so
+  // every plate the detector could find fits whole inside some tile.
+  std::vector<cv::Rect> detectionTiles(cv::Size imageSize, cv::Size minPlateSize, cv::Size maxPlateSize, float tileSizeInPlates);
+
+  // Combines the boxes found in each tile (in that tile's coordinates) into one list in
+  // image coordinates.  Boxes from different tiles overlapping by at least half (IoU)
+  // are one plate, and the copy farthest from a tile seam is kept.  Boxes from the same
+  // tile are all kept, as in a single pass.
+  std::vector<cv::Rect> mergeTileDetections(const std::vector<cv::Rect>& tiles, const std::vector<std::vector<cv::Rect> >& tilePlates,
+                                            cv::Size imageSize);
+
+}
+
+#endif // OPENALPR_DETECTIONTILING_H
@@ -28,6 +28,7 @@ namespace alpr
   Detector::Detector(Config* config, PreWarp* prewarp) : detector_mask(config, prewarp)
   {
     this->config = config;
+    this->countryConfig = config->countryConfig;
 
     // Load the mask specified in the config if it exists
     if (config->detection_mask_image.length() > 0 && fileExists(config->detection_mask_image.c_str()))
@@ -64,32 +65,16 @@ namespace alpr
 
   vector<PlateRegion> Detector::detect(Mat frame, std::vector<cv::Rect> regionsOfInterest)
   {
-
-    Mat frame_gray;
-    
-    if (frame.channels() > 2)
-    {
-      cvtColor( frame, frame_gray, COLOR_BGR2GRAY );
-    }
-    else
-    {
-      frame.copyTo(frame_gray);
-    }
-
-    // Apply the detection mask if it has been specified by the user
     if (detector_mask.mask_loaded)
-      frame_gray = detector_mask.apply_mask(frame_gray);
+      detector_mask.prepare(frame.size());
 
     // Setup debug mask image
     Mat mask_debug_img;
     if (detector_mask.mask_loaded && config->debugDetector)
-    {
-      frame_gray.copyTo(mask_debug_img);
-      cvtColor(frame_gray, mask_debug_img, COLOR_GRAY2BGR);
-    }
-    
-    vector<PlateRegion> detectedRegions;   
-    for (int i = 0; i < regionsOfInterest.size(); i++)
+      cvtColor(prepareDetectionPatch(frame, Rect(0, 0, frame.cols, frame.rows), detector_mask), mask_debug_img, COLOR_GRAY2BGR);
+
+    vector<Rect> rois;
+    for (unsigned int i = 0; i < regionsOfInterest.size(); i++)
     {
       Rect roi = regionsOfInterest[i];
       
@@ -103,11 +88,45 @@ namespace alpr
       
       // Sanity check.  If roi width or height is less than minimum possible plate size,
       // then skip it
-      if ((roi.width < config->minPlateSizeWidthPx) || 
-          (roi.height < config->minPlateSizeHeightPx))
+      if ((roi.width < countryConfig->minPlateSizeWidthPx) || 
+          (roi.height < countryConfig->minPlateSizeHeightPx))
+        continue;
+
+      rois.push_back(roi);
+    }
+
+    // Overlapping ROIs are converted and masked once, as a single patch.  The cascade still
+    // runs per ROI: the scale factor and maximum plate size come from the ROI's own size.
+    vector<Rect> patches = mergeOverlapping(rois);
+    vector<Mat> patchPixels(patches.size());
+    
+    vector<PlateRegion> detectedRegions;
+    vector<Rect> scannedRois;
+    vector<vector<PlateRegion> > scannedRegions;
+    for (unsigned int i = 0; i < rois.size(); i++)
+    {
+      Rect roi = rois[i];
+
+      // The same ROI twice finds the same plates
+      int repeatOf = -1;
+      for (unsigned int k = 0; k < scannedRois.size() && repeatOf < 0; k++)
+      {
+        if (scannedRois[k] == roi)
+          repeatOf = k;
+      }
+      if (repeatOf >= 0)
+      {
+        detectedRegions.insert(detectedRegions.end(), scannedRegions[repeatOf].begin(), scannedRegions[repeatOf].end());
         continue;
+      }
+
+      unsigned int p = 0;
+      while ((patches[p] & roi) != roi)
+        p++;
+      if (patchPixels[p].empty())
+        patchPixels[p] = prepareDetectionPatch(frame, patches[p], detector_mask);
       
-      Mat cropped = frame_gray(roi);
+      Mat cropped = patchPixels[p](roi - patches[p].tl());
 
       int w = cropped.size().width;
       int h = cropped.size().height;
@@ -121,7 +140,7 @@ namespace alpr
     
       float maxWidth = ((float) w) * (config->maxPlateWidthPercent / 100.0f) * scale_factor;
       float maxHeight = ((float) h) * (config->maxPlateHeightPercent / 100.0f) * scale_factor;
-      Size minPlateSize(config->minPlateSizeWidthPx, config->minPlateSizeHeightPx);
+      Size minPlateSize(countryConfig->minPlateSizeWidthPx, countryConfig->minPlateSizeHeightPx);
       Size maxPlateSize(maxWidth, maxHeight);
     
       vector<Rect> allRegions = find_plates(cropped, minPlateSize, maxPlateSize);
@@ -156,7 +175,8 @@ namespace alpr
       
       vector<PlateRegion> orderedRegions = aggregateRegions(regions_not_masked);
 
-      
+      scannedRois.push_back(roi);
+      scannedRegions.push_back(orderedRegions);
 
       for (unsigned int j = 0; j < orderedRegions.size(); j++)
         detectedRegions.push_back(orderedRegions[j]);
@@ -170,14 +190,18 @@ namespace alpr
     
     return detectedRegions;
   }
-  
+
   std::string Detector::get_detector_file() {
-    if (config->detectorFile.length() == 0)
-      return config->getCascadeRuntimeDir() + config->country + ".xml";
+    if (countryConfig->detectorFile.length() == 0)
+      return config->getCascadeRuntimeDir() + countryConfig->country + ".xml";
     
-    return config->getCascadeRuntimeDir() + config->detectorFile;
+    return config->getCascadeRuntimeDir() + countryConfig->detectorFile;
   }
 
+  cv::Size Detector::getMinPlateSize()
+  {
+    return cv::Size(countryConfig->minPlateSizeWidthPx, countryConfig->minPlateSizeHeightPx);
+  }
 
   float Detector::computeScaleFactor(int width, int height) {
     
@@ -258,4 +282,48 @@ namespace alpr
     return topLevelRegions;
   }
 
+  Mat prepareDetectionPatch(Mat frame, Rect patch, DetectorMask& mask)
+  {
+    Mat patch_gray;
+    
+    if (frame.channels() > 2)
+      cvtColor( frame(patch), patch_gray, COLOR_BGR2GRAY );
+    else
+      patch_gray = frame(patch);
+
+    // Apply the detection mask if it has been specified by the user
+    if (mask.mask_loaded)
+      patch_gray = mask.apply_mask(patch_gray, patch);
+
+    return patch_gray;
+  }
+
+  vector<Rect> mergeOverlapping(const vector<Rect>& rects)
+  {
+    vector<Rect> merged;
+    for (unsigned int i = 0; i < rects.size(); i++)
+    {
+      // Growing a rect can make it reach ones it missed before, so keep absorbing until it stops
+      Rect grown = rects[i];
+      bool absorbed = true;
+      while (absorbed)
+      {
+        absorbed = false;
+        for (unsigned int k = 0; k < merged.size(); k++)
+        {
+          if ((merged[k] & grown).area() > 0)
+          {
+            grown = grown | merged[k];
+            merged.erase(merged.begin() + k);
+            absorbed = true;
+            break;
+          }
+        }
+      }
+      merged.push_back(grown);
+    }
+
+    return merged;
+  }
+
 }
@@ -36,6 +36,8 @@ namespace alpr
 
 
 
+  // Not thread-safe: cascade classifiers and the prepared mask keep per-image state,
+  // so concurrent callers each need a detector of their own
   class Detector
   {
 
@@ -50,23 +52,40 @@ namespace alpr
       virtual std::vector<cv::Rect> find_plates(cv::Mat frame, cv::Size min_plate_size, cv::Size max_plate_size)=0;
       
       void setMask(cv::Mat mask);
+
+      // Replaces any threads the detector runs on, which don't survive fork()
+      virtual void afterFork() {}
+
+      // Cascade file this detector loads.  Detectors built from the same file find the
+      // same plates, apart from their minimum plate size.
+      std::string get_detector_file();
+      cv::Size getMinPlateSize();
       
     protected:
       Config* config;
+      const CountryConfig* countryConfig;
       
       bool loaded;
       
       DetectorMask detector_mask;
 
-      std::string get_detector_file();
-      
       float computeScaleFactor(int width, int height);
+
       std::vector<PlateRegion> aggregateRegions(std::vector<cv::Rect> regions);
 
 
 
   };
 
+  // Gray, masked pixels of one part of the frame.  A view of the frame when it is
+  // already gray and unmasked, so find_plates must not modify its input.  A loaded
+  // mask must already be prepared for the frame's size.
+  cv::Mat prepareDetectionPatch(cv::Mat frame, cv::Rect patch, DetectorMask& mask);
+
+  // Unions rects that overlap (directly or through a chain of others) until no two
+  // overlap.  Every input rect lies inside exactly one of the results.
+  std::vector<cv::Rect> mergeOverlapping(const std::vector<cv::Rect>& rects);
+
 }
 
 #endif // OPENALPR_REGIONDETECTOR_H
@@ -18,8 +18,10 @@
 */
 
 #include "detectorcpu.h"
+#include "detection_tiling.h"
 
 #include <stdio.h>
+#include <algorithm>
 
 using namespace cv;
 using namespace std;
@@ -27,11 +29,12 @@ using namespace std;
 namespace alpr
 {
 
-
   DetectorCPU::DetectorCPU(Config* config, PreWarp* prewarp) : Detector(config, prewarp) {
 
 
     
+    this->tile_workers = NULL;
+
     if( this->plate_cascade.load( get_detector_file() ) )
     {
       this->loaded = true;
@@ -45,6 +48,13 @@ namespace alpr
 
 
   DetectorCPU::~DetectorCPU() {
+    delete tile_workers;
+  }
+
+  void DetectorCPU::afterFork() {
+    // The old pool's threads only exist in the parent, so it is leaked rather than joined
+    if (tile_workers != NULL)
+      tile_workers = new WorkerPool(tile_workers->size());
   }
 
 
@@ -71,12 +81,14 @@ namespace alpr
     timespec startTime;
     getTimeMonotonic(&startTime);
 
-    equalizeHist( frame, frame );
-    
-    plate_cascade.detectMultiScale( frame, plates, config->detection_iteration_increase, config->detectionStrictness,
-                                      CASCADE_DO_CANNY_PRUNING,
-                                      //0|CV_HAAR_SCALE_IMAGE,
-                                      min_plate_size, max_plate_size );
+    // frame may be a view of the caller's image, so equalize into a buffer of our own
+    Mat equalized;
+    equalizeHist( frame, equalized );
+
+    if (config->detectionTiling)
+      plates = find_plates_tiled(equalized, min_plate_size, max_plate_size);
+    else
+      scan(plate_cascade, equalized, plates, min_plate_size, max_plate_size);
 
 
     if (config->debugTiming)
@@ -90,4 +102,53 @@ namespace alpr
 
   }
 
+  void DetectorCPU::scan(CascadeClassifier& cascade, Mat image, vector<Rect>& plates, Size min_plate_size, Size max_plate_size)
+  {
+    cascade.detectMultiScale( image, plates, config->detection_iteration_increase, config->detectionStrictness,
+                              CASCADE_DO_CANNY_PRUNING,
+                              //0|CV_HAAR_SCALE_IMAGE,
+                              min_plate_size, max_plate_size );
+  }
+
+  vector<Rect> DetectorCPU::find_plates_tiled(Mat equalized, Size min_plate_size, Size max_plate_size)
+  {
+    vector<Rect> plates;
+
+    vector<Rect> tiles = detectionTiles(equalized.size(), min_plate_size, max_plate_size, config->detectionTileSize);
+    if (tiles.size() <= 1)
+    {
+      scan(plate_cascade, equalized, plates, min_plate_size, max_plate_size);
+      return plates;
+    }
+
+    if (tile_workers == NULL)
+    {
+      tile_workers = new WorkerPool(config->detectionTileThreads);
+      tile_cascades.resize(config->detectionTileThreads - 1);
+      for (unsigned int i = 0; i < tile_cascades.size(); i++)
+        tile_cascades[i].load( get_detector_file() );
+    }
+
+    vector<vector<Rect> > tile_plates(tiles.size());
+    auto scanTile = [&](int t, int workerIndex) {
+      CascadeClassifier& cascade = (workerIndex == 0) ? plate_cascade : tile_cascades[workerIndex - 1];
+
+      // Each tile only searches the scales that fit in it
+      Size tile_max(std::min(max_plate_size.width, tiles[t].width), std::min(max_plate_size.height, tiles[t].height));
+      scan(cascade, equalized(tiles[t]), tile_plates[t], min_plate_size, tile_max);
+    };
+    tile_workers->run(tiles.size(), scanTile);
+
+    size_t boxes = 0;
+    for (unsigned int t = 0; t < tile_plates.size(); t++)
+      boxes += tile_plates[t].size();
+    plates = mergeTileDetections(tiles, tile_plates, equalized.size());
+
+    if (config->debugDetector)
+      cout << "Tiled detection: " << tiles.size() << " tiles, " << boxes << " boxes, "
+           << plates.size() << " after merging" << endl;
+
+    return plates;
+  }
+
 }
@@ -28,6 +28,7 @@
 #include "opencv2/ml/ml.hpp"
 
 #include "detector.h"
+#include "support/worker_pool.h"
 
 namespace alpr
 {
@@ -38,11 +39,22 @@ namespace alpr
       virtual ~DetectorCPU();
 
       std::vector<cv::Rect> find_plates(cv::Mat frame, cv::Size min_plate_size, cv::Size max_plate_size);
+
+      void afterFork();
       
   private:
 
       cv::CascadeClassifier plate_cascade;
 
+      // With detection_tiling, tile worker 0 scans with plate_cascade and worker i with
+      // tile_cascades[i - 1].  A cascade keeps per-image state, so workers can't share one.
+      std::vector<cv::CascadeClassifier> tile_cascades;
+      WorkerPool* tile_workers;
+
+      std::vector<cv::Rect> find_plates_tiled(cv::Mat equalized, cv::Size min_plate_size, cv::Size max_plate_size);
+      void scan(cv::CascadeClassifier& cascade, cv::Mat image, std::vector<cv::Rect>& plates,
+                cv::Size min_plate_size, cv::Size max_plate_size);
+
   };
 
 }
@@ -90,9 +90,9 @@ namespace alpr
     return mean_value < MIN_WHITENESS;
   }
   
-  void DetectorMask::resize_mask(cv::Mat image) {
+  void DetectorMask::resize_mask(cv::Size frame_size) {
     
-    resize(mask, resized_mask, image.size());
+    resize(mask, resized_mask, frame_size);
 
     if (prewarp->valid) 
     {
@@ -137,28 +137,42 @@ namespace alpr
     //cout << scan_area << endl;
   }
 
-  Mat DetectorMask::apply_mask(Mat image) {
+  void DetectorMask::prepare(cv::Size frame_size) {
     if (!mask_loaded)
-      return image;
-       
-    if (!resized_mask_loaded || image.size() != resized_mask.size() || 
+      return;
+
+    if (!resized_mask_loaded || frame_size != resized_mask.size() ||
             last_prewarp_hash != prewarp->toString())
     {
-      resize_mask(image);
+      resize_mask(frame_size);
       
       last_prewarp_hash = prewarp->toString();
       
       resized_mask_loaded = true;
     }
-    
-    if (image.size() != resized_mask.size() && config->debugDetector)
-    {
-      cout << "Mask does not match image size" << endl;
+  }
+
+  Mat DetectorMask::apply_mask(Mat image) {
+    if (!mask_loaded)
       return image;
+
+    prepare(image.size());
+    return apply_mask(image, Rect(0, 0, image.cols, image.rows));
+  }
+
+  Mat DetectorMask::apply_mask(Mat crop, Rect crop_rect) {
+    if (!mask_loaded)
+      return crop;
+
+    if ((crop_rect & Rect(0, 0, resized_mask.cols, resized_mask.rows)) != crop_rect)
+    {
+      if (config->debugDetector)
+        cout << "Mask does not match image size" << endl;
+      return crop;
     }
     
-    Mat response = Mat::zeros(image.size(), image.type());
-    bitwise_and(image, resized_mask, response);
+    Mat response = Mat::zeros(crop.size(), crop.type());
+    bitwise_and(crop, resized_mask(crop_rect), response);
     
     return response;
   }
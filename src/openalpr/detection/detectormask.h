@@ -43,12 +43,18 @@ namespace alpr
     bool region_is_masked(cv::Rect region);
     
     cv::Mat apply_mask(cv::Mat image);
+
+    // Sizes the mask for frames of this size.  Call before the functions below.
+    void prepare(cv::Size frame_size);
+
+    // Masks a crop taken from the given rect of a frame
+    cv::Mat apply_mask(cv::Mat crop, cv::Rect crop_rect);
     
     bool mask_loaded;
     
   private:
 
-    void resize_mask(cv::Mat image);
+    void resize_mask(cv::Size frame_size);
     
     PreWarp* prewarp;
     std::string last_prewarp_hash;
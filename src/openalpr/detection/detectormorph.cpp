@@ -50,17 +50,17 @@ namespace alpr {
   std::vector<cv::Rect> DetectorMorph::find_plates(cv::Mat frame_gray, cv::Size min_plate_size, cv::Size max_plate_size)
   {
 
-    Mat frame_gray_cp(frame_gray.size(), frame_gray.type());
-    frame_gray.copyTo(frame_gray_cp);
-    blur(frame_gray, frame_gray, Size(5, 5));
+    // frame_gray may be a view of the caller's image, so it is only read
+    Mat frame_blurred;
+    blur(frame_gray, frame_blurred, Size(5, 5));
 
     vector<Rect> plates;
     
     Mat img_open, img_result;
     Mat element = getStructuringElement(MORPH_RECT, Size(30, 4));
-    morphologyEx(frame_gray, img_open, MORPH_OPEN, element, cv::Point(-1, -1));
+    morphologyEx(frame_blurred, img_open, MORPH_OPEN, element, cv::Point(-1, -1));
 
-    img_result = frame_gray - img_open;
+    img_result = frame_blurred - img_open;
 
     if (config->debugDetector && config->debugShowImages) {
       imshow("Opening", img_result);
@@ -143,7 +143,7 @@ namespace alpr {
       // get the rotation matrix
       Mat M = getRotationMatrix2D(PlateRect.center, PlateRect.angle, 1.0);
       // perform the affine transformation
-      warpAffine(frame_gray_cp, rotated, M, frame_gray_cp.size(), INTER_CUBIC);
+      warpAffine(frame_gray, rotated, M, frame_gray.size(), INTER_CUBIC);
       //Crop area around candidate plate
       getRectSubPix(rotated, rect_size, PlateRect.center, img_crop);
 
@@ -170,7 +170,7 @@ namespace alpr {
               int numBlobs = plateBlobs.size();
               int numBlobsInv = plateBlobsInv.size();
 
-              float idealAspect = config->avgCharWidthMM / config->avgCharHeightMM;
+              float idealAspect = countryConfig->avgCharWidthMM / countryConfig->avgCharHeightMM;
               for (int j = 0; j < numBlobs; j++) {
                       cv::Rect r0 = cv::boundingRect(cv::Mat(plateBlobs[j]));
 
@@ -207,7 +207,7 @@ namespace alpr {
 
     float error = 1.2;
 
-    float aspect = config->plateWidthMM / config->plateHeightMM;
+    float aspect = countryConfig->plateWidthMM / countryConfig->plateHeightMM;
     //Set a min and max area. All other patchs are discarded
     int min = 10 * aspect * 10; // minimum area
     int max = 100 * aspect * 100; // maximum area
@@ -138,9 +138,11 @@ namespace alpr
     }
     else
     {
-      equalizeHist( orig_frame, orig_frame );
+      // orig_frame may be a view of the caller's image, so equalize into a buffer of our own
+      Mat equalized;
+      equalizeHist( orig_frame, equalized );
 
-      plate_cascade.detectMultiScale( orig_frame, plates, config->detection_iteration_increase, config->detectionStrictness,
+      plate_cascade.detectMultiScale( equalized, plates, config->detection_iteration_increase, config->detectionStrictness,
                                       CV_HAAR_DO_CANNY_PRUNING,
                                       min_plate_size, max_plate_size );
     }
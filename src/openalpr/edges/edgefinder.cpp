@@ -20,6 +20,7 @@
 #include "edgefinder.h"
 #include "textlinecollection.h"
 #include "support/timing.h"
+#include "stage_stats.h"
 
 using namespace std;
 using namespace cv;
@@ -40,6 +41,7 @@ namespace alpr
   }
 
   std::vector<cv::Point2f> EdgeFinder::findEdgeCorners() {
+    ALPR_STAGE_TIMER(STAGE_EDGE_FINDING);
 
     bool high_contrast = is_high_contrast(pipeline_data->crop_gray);
     
@@ -83,10 +85,10 @@ namespace alpr
     else if (tlc.longerSegment.length > tlc.charHeight * 3)
     {
 
-      float charHeightToPlateWidthRatio = pipeline_data->config->plateWidthMM / pipeline_data->config->avgCharHeightMM;
+      float charHeightToPlateWidthRatio = pipeline_data->country_config->plateWidthMM / pipeline_data->country_config->avgCharHeightMM;
       float idealPixelWidth = tlc.charHeight *  (charHeightToPlateWidthRatio * 1.03);	// Add 3% so we don't clip any characters
 
-      float charHeightToPlateHeightRatio = pipeline_data->config->plateHeightMM / pipeline_data->config->avgCharHeightMM;
+      float charHeightToPlateHeightRatio = pipeline_data->country_config->plateHeightMM / pipeline_data->country_config->avgCharHeightMM;
       float idealPixelHeight = tlc.charHeight *  charHeightToPlateHeightRatio;
 
 
@@ -129,7 +131,7 @@ namespace alpr
     vector<Point2f> remappedCorners = imgTransform.transformSmallPointsToBigImage(corners);
 
     Size cropSize = imgTransform.getCropSize(remappedCorners, 
-            Size(pipeline_data->config->templateWidthPx, pipeline_data->config->templateHeightPx));
+            Size(pipeline_data->country_config->templateWidthPx, pipeline_data->country_config->templateHeightPx));
 
     Mat transmtx = imgTransform.getTransformationMatrix(remappedCorners, cropSize);
     Mat newCrop = imgTransform.crop(cropSize, transmtx);
@@ -261,7 +263,7 @@ namespace alpr
 
       // Make sure the aspect ratio is somewhat close to a license plate.
       float aspect_ratio = polygon_width / polygon_height;
-      float ideal_aspect_ratio = pipeline_data->config->plateWidthMM / pipeline_data->config->plateHeightMM;
+      float ideal_aspect_ratio = pipeline_data->country_config->plateWidthMM / pipeline_data->country_config->plateHeightMM;
 
       float ratio = ideal_aspect_ratio / aspect_ratio;
 
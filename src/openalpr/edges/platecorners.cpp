@@ -139,7 +139,7 @@ namespace alpr
     LineSegment right;
 
 
-    float charHeightToPlateWidthRatio = pipelineData->config->plateWidthMM / pipelineData->config->avgCharHeightMM;
+    float charHeightToPlateWidthRatio = pipelineData->country_config->plateWidthMM / pipelineData->country_config->avgCharHeightMM;
     float idealPixelWidth = tlc.charHeight *  (charHeightToPlateWidthRatio * 1.03);	// Add 3% so we don't clip any characters
 
     float confidenceDiff = 0;
@@ -245,7 +245,7 @@ namespace alpr
     
     // Add a few extra pixels to the guessed line, so we don't accidentally crop the characters
     int extra_vertical_pixels = 3;
-    float charHeightToPlateHeightRatio = pipelineData->config->plateHeightMM / pipelineData->config->avgCharHeightMM;
+    float charHeightToPlateHeightRatio = pipelineData->country_config->plateHeightMM / pipelineData->country_config->avgCharHeightMM;
     float idealPixelHeight = tlc.charHeight *  charHeightToPlateHeightRatio;
 
     float missingSegmentPenalty = 0;
@@ -300,7 +300,7 @@ namespace alpr
     // Get the height difference
 
     float heightRatio = tlc.charHeight / plateHeightPx;
-    float idealHeightRatio = (pipelineData->config->avgCharHeightMM / pipelineData->config->plateHeightMM);
+    float idealHeightRatio = (pipelineData->country_config->avgCharHeightMM / pipelineData->country_config->plateHeightMM);
     float heightRatioDiff = abs(heightRatio - idealHeightRatio);
 
     scoreKeeper.setScore("SCORING_PLATEHEIGHT_WEIGHT", heightRatioDiff, SCORING_PLATEHEIGHT_WEIGHT);
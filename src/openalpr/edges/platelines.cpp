@@ -137,8 +137,8 @@ namespace alpr
     if (this->debug)
       cout << "PlateLines::getLines" << endl;
 
-    int HORIZONTAL_SENSITIVITY = pipelineData->config->plateLinesSensitivityHorizontal;
-    int VERTICAL_SENSITIVITY = pipelineData->config->plateLinesSensitivityVertical;
+    int HORIZONTAL_SENSITIVITY = pipelineData->country_config->plateLinesSensitivityHorizontal;
+    int VERTICAL_SENSITIVITY = pipelineData->country_config->plateLinesSensitivityVertical;
 
     vector<Vec2f> allLines;
     vector<PlateLine> filteredLines;
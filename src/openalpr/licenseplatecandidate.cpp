@@ -22,6 +22,7 @@
 #include "licenseplatecandidate.h"
 #include "edges/edgefinder.h"
 #include "transformation.h"
+#include "stage_stats.h"
 
 using namespace std;
 using namespace cv;
@@ -44,13 +45,13 @@ namespace alpr
   void LicensePlateCandidate::recognize()
   {
 
-    pipeline_data->isMultiline = config->multiline;
+    pipeline_data->isMultiline = pipeline_data->country_config->multiline;
 
 
     Rect expandedRegion = this->pipeline_data->regionOfInterest;
 
     pipeline_data->crop_gray = Mat(this->pipeline_data->grayImg, expandedRegion);
-    resize(pipeline_data->crop_gray, pipeline_data->crop_gray, Size(config->templateWidthPx, config->templateHeightPx));
+    resize(pipeline_data->crop_gray, pipeline_data->crop_gray, Size(pipeline_data->country_config->templateWidthPx, pipeline_data->country_config->templateHeightPx));
 
 
     CharacterAnalysis textAnalysis(pipeline_data);
@@ -65,6 +66,7 @@ namespace alpr
     if (pipeline_data->disqualified)
       return;
 
+    ALPR_STAGE_TIMER(STAGE_DESKEW);
     timespec startTime;
     getTimeMonotonic(&startTime);
 
@@ -72,7 +74,7 @@ namespace alpr
     // Compute the transformation matrix to go from the current image to the new plate corners
     Transformation imgTransform(this->pipeline_data->grayImg, pipeline_data->crop_gray, expandedRegion);
     Size cropSize = imgTransform.getCropSize(pipeline_data->plate_corners,
-            Size(pipeline_data->config->ocrImageWidthPx, pipeline_data->config->ocrImageHeightPx));
+            Size(pipeline_data->country_config->ocrImageWidthPx, pipeline_data->country_config->ocrImageHeightPx));
     Mat transmtx = imgTransform.getTransformationMatrix(pipeline_data->plate_corners, cropSize);
 
 
@@ -1,10 +1,31 @@
 #include "motiondetector.h"
 
+#include <algorithm>
+#include <climits>
+
 using namespace cv;
 
 namespace alpr
 {
-  
+
+namespace
+{
+	// MOG2 marks shadows at 127; only confident foreground counts as motion
+	const int FOREGROUND_THRESHOLD = 200;
+
+	Rect unionRect(const Rect& a, const Rect& b)
+	{
+		int x = std::min(a.x, b.x);
+		int y = std::min(a.y, b.y);
+		return Rect(x, y, std::max(a.x + a.width, b.x + b.width) - x, std::max(a.y + a.height, b.y + b.height) - y);
+	}
+
+	Rect growRect(const Rect& r, int pixels)
+	{
+		return Rect(r.x - pixels, r.y - pixels, r.width + 2 * pixels, r.height + 2 * pixels);
+	}
+}
+
 MotionDetector::MotionDetector()
 {
 	#if OPENCV_MAJOR_VERSION == 2
@@ -13,6 +34,30 @@ MotionDetector::MotionDetector()
 	// OpenCV 3
 	pMOG2 = createBackgroundSubtractorMOG2();
 	#endif
+	initialized = false;
+
+	maxWidth = 320;
+	minAreaPercent = 0.1f;
+	mergePercent = 3;
+	paddingPercent = 25;
+	maxRegions = 6;
+}
+
+MotionDetector::MotionDetector(Config* config)
+{
+	#if OPENCV_MAJOR_VERSION == 2
+	pMOG2 = new BackgroundSubtractorMOG2();
+	#else
+	// OpenCV 3
+	pMOG2 = createBackgroundSubtractorMOG2();
+	#endif
+	initialized = false;
+
+	maxWidth = config->motionMaxWidth;
+	minAreaPercent = config->motionMinAreaPercent;
+	mergePercent = config->motionMergePercent;
+	paddingPercent = config->motionPaddingPercent;
+	maxRegions = config->motionMaxRegions;
 }
 
 MotionDetector::~MotionDetector()
@@ -20,68 +65,184 @@ MotionDetector::~MotionDetector()
 
 }
 
+cv::Mat MotionDetector::downscale(const cv::Mat& frame, float& scale)
+{
+	Mat gray;
+	if (frame.channels() > 2)
+		cvtColor(frame, gray, frame.channels() == 4 ? COLOR_BGRA2GRAY : COLOR_BGR2GRAY);
+	else
+		gray = frame;
+
+	scale = 1;
+	if (maxWidth > 0 && gray.cols > maxWidth)
+	{
+		scale = (float) maxWidth / gray.cols;
+		Mat small;
+		resize(gray, small, Size(maxWidth, std::max(1, (int) (gray.rows * scale))), 0, 0, INTER_AREA);
+		return small;
+	}
+	return gray;
+}
+
 void MotionDetector::ResetMotionDetection(cv::Mat* frame)
 {
+	float scale;
+	Mat small = downscale(*frame, scale);
 #if OPENCV_MAJOR_VERSION == 2
-	pMOG2->operator()(*frame, fgMaskMOG2, 1);
+	pMOG2->operator()(small, fgMaskMOG2, 1);
 #else
 	// OpenCV 3
-	pMOG2->apply(*frame, fgMaskMOG2, 1);
+	pMOG2->apply(small, fgMaskMOG2, 1);
 #endif
+	initialized = true;
 }
 
-cv::Rect MotionDetector::MotionDetect(cv::Mat* frame)
-//Detect motion and create ONE recangle that contains all the detected motion
+void MotionDetector::restart()
 {
-	std::vector<std::vector<cv::Point> > contours;
-	std::vector<cv::Vec4i> hierarchy;
-	cv::Rect bounding_rect;
-	std::vector<cv::Rect> rects;
-	cv::Rect largest_rect, rect_temp;
+	// detect() reseeds with a learning rate of 1, which replaces the old model
+	initialized = false;
+}
 
-	// Detect motion
+std::vector<MotionRegion> MotionDetector::detect(const cv::Mat& frame)
+{
+	std::vector<MotionRegion> regions;
+	if (frame.empty())
+		return regions;
+
+	// Nothing is known about the first frame, so all of it counts as moving
+	if (!initialized)
+	{
+		Mat first = frame;
+		ResetMotionDetection(&first);
+		MotionRegion all;
+		all.rect = Rect(0, 0, frame.cols, frame.rows);
+		all.activity = 1;
+		regions.push_back(all);
+		return regions;
+	}
+
+	float scale;
+	Mat small = downscale(frame, scale);
 
 #if OPENCV_MAJOR_VERSION == 2
-	pMOG2->operator()(*frame, fgMaskMOG2, -1);
+	pMOG2->operator()(small, fgMaskMOG2, -1);
 #else
 	// OpenCV 3
-	pMOG2->apply(*frame, fgMaskMOG2);
+	pMOG2->apply(small, fgMaskMOG2);
 #endif
 
-	//Remove noise
-	cv::erode(fgMaskMOG2, fgMaskMOG2, getStructuringElement(cv::MORPH_RECT, cv::Size(6, 6)));
-	// Find the contours of motion areas in the image
-	findContours(fgMaskMOG2, contours, hierarchy, RETR_LIST, CHAIN_APPROX_SIMPLE);
-	// Find the bounding rectangles of the areas of motion
-	if (contours.size() > 0)
+	//Remove shadows and noise
+	Mat moving;
+	threshold(fgMaskMOG2, moving, FOREGROUND_THRESHOLD, 255, THRESH_BINARY);
+	morphologyEx(moving, moving, MORPH_OPEN, getStructuringElement(MORPH_RECT, Size(3, 3)));
+
+	// findContours may modify its input, and the mask is still needed for the activity scores
+	std::vector<std::vector<cv::Point> > contours;
+	Mat contourInput = moving.clone();
+	findContours(contourInput, contours, RETR_EXTERNAL, CHAIN_APPROX_SIMPLE);
+
+	double minArea = small.cols * small.rows * minAreaPercent / 100.0;
+	std::vector<cv::Rect> rects;
+	for (unsigned int i = 0; i < contours.size(); i++)
+	{
+		Rect r = boundingRect(contours[i]);
+		if (r.area() < minArea)
+			continue;
+
+		// Pad by a share of each blob's own size, so a plate at the edge of a vehicle is kept
+		int padding = (int) (std::max(r.width, r.height) * paddingPercent / 100.0f);
+		rects.push_back(growRect(r, padding) & Rect(0, 0, small.cols, small.rows));
+	}
+
+	int mergeGap = (int) (small.cols * mergePercent / 100.0f);
+	rects = clusterRects(rects, mergeGap, maxRegions);
+
+	for (unsigned int i = 0; i < rects.size(); i++)
+	{
+		MotionRegion region;
+		region.activity = (float) countNonZero(moving(rects[i])) / rects[i].area();
+
+		// Back to frame pixels, rounding outwards
+		int x1 = (int) floor(rects[i].x / scale);
+		int y1 = (int) floor(rects[i].y / scale);
+		int x2 = (int) ceil((rects[i].x + rects[i].width) / scale);
+		int y2 = (int) ceil((rects[i].y + rects[i].height) / scale);
+		region.rect = Rect(x1, y1, x2 - x1, y2 - y1) & Rect(0, 0, frame.cols, frame.rows);
+		regions.push_back(region);
+	}
+
+	std::sort(regions.begin(), regions.end(), [](const MotionRegion& a, const MotionRegion& b) {
+		return a.activity > b.activity;
+	});
+	return regions;
+}
+
+std::vector<cv::Rect> MotionDetector::clusterRects(std::vector<cv::Rect> rects, int mergeGap, int maxRegions)
+{
+	// Merge anything that overlaps or sits within the gap, until nothing changes
+	bool merged = true;
+	while (merged)
 	{
-		for (int i = 0; i < contours.size(); i++)
+		merged = false;
+		for (unsigned int i = 0; i < rects.size() && !merged; i++)
 		{
-			bounding_rect = boundingRect(contours[i]);
-			rects.push_back(bounding_rect);
+			for (unsigned int j = i + 1; j < rects.size(); j++)
+			{
+				if ((growRect(rects[i], mergeGap) & rects[j]).area() > 0)
+				{
+					rects[i] = unionRect(rects[i], rects[j]);
+					rects.erase(rects.begin() + j);
+					merged = true;
+					break;
+				}
+			}
 		}
-		// Determine the overall area with motion.
-		largest_rect = rects[0];
-		for (int i = 1; i < rects.size(); i++)
+	}
+
+	// Too many separate areas: merge whichever pair grows the least
+	while (maxRegions > 0 && (int) rects.size() > maxRegions)
+	{
+		unsigned int bestI = 0, bestJ = 1;
+		int bestGrowth = INT_MAX;
+		for (unsigned int i = 0; i < rects.size(); i++)
 		{
-			rect_temp.x = min(largest_rect.x,rects[i].x);
-			rect_temp.y = min(largest_rect.y,rects[i].y);
-			rect_temp.width = max(largest_rect.x + largest_rect.width, rects[i].x + rects[i].width)-rect_temp.x;
-			rect_temp.height = max(largest_rect.y + largest_rect.height, rects[i].y + rects[i].height) - rect_temp.y;
-			largest_rect = rect_temp;
+			for (unsigned int j = i + 1; j < rects.size(); j++)
+			{
+				int growth = unionRect(rects[i], rects[j]).area() - rects[i].area() - rects[j].area();
+				if (growth < bestGrowth)
+				{
+					bestGrowth = growth;
+					bestI = i;
+					bestJ = j;
+				}
+			}
 		}
-		rectangle(*frame, rect_temp, cv::Scalar(0, 255, 0), 1, 8, 0);
+		rects[bestI] = unionRect(rects[bestI], rects[bestJ]);
+		rects.erase(rects.begin() + bestJ);
 	}
-	else
-        {
-          largest_rect.x = 0;
-          largest_rect.y = 0;
-          largest_rect.width = 0;
-          largest_rect.height = 0;
-        }
-		
-//	imshow("Motion detect", fgMaskMOG2);
-	return expandRect(largest_rect, 0, 0, frame->cols, frame->rows);
+
+	return rects;
+}
+
+cv::Rect MotionDetector::MotionDetect(cv::Mat* frame)
+//Detect motion and create ONE recangle that contains all the detected motion
+{
+	std::vector<MotionRegion> regions = detect(*frame);
+	if (regions.empty())
+		return Rect(0, 0, 0, 0);
+
+	Rect all = regions[0].rect;
+	for (unsigned int i = 1; i < regions.size(); i++)
+		all = unionRect(all, regions[i].rect);
+	return all;
+}
+
+std::vector<AlprRegionOfInterest> MotionDetector::toRegionsOfInterest(const std::vector<MotionRegion>& regions)
+{
+	std::vector<AlprRegionOfInterest> rois;
+	for (unsigned int i = 0; i < regions.size(); i++)
+		rois.push_back(AlprRegionOfInterest(regions[i].rect.x, regions[i].rect.y, regions[i].rect.width, regions[i].rect.height));
+	return rois;
 }
 
 }
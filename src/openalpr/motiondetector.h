@@ -2,22 +2,67 @@
 #ifndef OPENALPR_MOTIONDETECTOR_H
 #define OPENALPR_MOTIONDETECTOR_H
 
+#include <vector>
 #include "opencv2/opencv.hpp"
+#include "alpr.h"
+#include "config.h"
 #include "utility.h"
 
 namespace alpr
 {
+  // An area of the frame that changed, padded so a plate on the moving vehicle
+  // falls inside it
+  struct MotionRegion
+  {
+    cv::Rect rect;
+    // Fraction of the region's pixels that moved, 0-1
+    float activity;
+  };
+
+  // Background subtraction on a downscaled grayscale copy of each frame.  Moving
+  // areas are clustered into a few regions, which can be passed to recognize() as
+  // regions of interest so detection only looks where something moved.
   class MotionDetector
   {
       private: cv::Ptr<cv::BackgroundSubtractor> pMOG2; //MOG2 Background subtractor
       private: cv::Mat fgMaskMOG2;
+      private: bool initialized;
+
+      // Settings, from the motion_* config keys
+      private: int maxWidth;
+      private: float minAreaPercent;
+      private: float mergePercent;
+      private: float paddingPercent;
+      private: int maxRegions;
+
+      private: cv::Mat downscale(const cv::Mat& frame, float& scale);
+
       public:
           MotionDetector();
+          MotionDetector(Config* config);
           virtual ~MotionDetector();
 
+          // Starts the background over from this frame
           void ResetMotionDetection(cv::Mat* frame);
+
+          // Forgets the background, so the next frame seeds it and is returned whole.
+          // Use when a new video starts.
+          void restart();
+
+          // Regions of the frame that moved since the previous frames, in frame pixels,
+          // most active first.  Empty if nothing moved.  The first frame after
+          // construction is returned whole.  The frame is not modified.
+          std::vector<MotionRegion> detect(const cv::Mat& frame);
+
+          // One rectangle covering all the motion, or an empty one
           cv::Rect MotionDetect(cv::Mat* frame);
+
+          static std::vector<AlprRegionOfInterest> toRegionsOfInterest(const std::vector<MotionRegion>& regions);
+
+          // Clusters rectangles closer than mergeGap pixels, then merges the closest
+          // pairs until at most maxRegions remain
+          static std::vector<cv::Rect> clusterRects(std::vector<cv::Rect> rects, int mergeGap, int maxRegions);
   };
 }
 
-#endif // OPENALPR_MOTIONDETECTOR_H
\ No newline at end of file
+#endif // OPENALPR_MOTIONDETECTOR_H
@@ -18,12 +18,14 @@
 */
 
 #include "ocr.h"
+#include "stage_stats.h"
 
 namespace alpr
 {
   
-  OCR::OCR(Config* config) : postProcessor(config) {
+  OCR::OCR(Config* config, const CountryConfig* countryConfig) : postProcessor(config, countryConfig) {
     this->config = config;
+    this->countryConfig = (countryConfig != NULL) ? countryConfig : config->countryConfig;
   }
 
 
@@ -38,6 +40,9 @@ namespace alpr
     getTimeMonotonic(&startTime);
 
     segment(pipeline_data);
+
+    // Segmentation is timed on its own
+    ALPR_STAGE_TIMER(STAGE_OCR);
     
     postProcessor.clear();
 
@@ -50,7 +55,7 @@ namespace alpr
       for (uint32_t i = 0; i < chars.size(); i++)
       {
         // For multi-line plates, set the character indexes to sequential values based on the line number
-        int line_ordered_index = (line_idx * config->postProcessMaxCharacters) + chars[i].char_index;
+        int line_ordered_index = (line_idx * countryConfig->postProcessMaxCharacters) + chars[i].char_index;
         postProcessor.addLetter(chars[i].letter, line_idx, line_ordered_index, chars[i].confidence);
         absolute_charpos++;
       }
@@ -34,7 +34,8 @@ namespace alpr
   
   class OCR {
   public:
-    OCR(Config* config);
+    // countryConfig defaults to the country currently selected in config
+    OCR(Config* config, const CountryConfig* countryConfig = NULL);
     virtual ~OCR();
 
     void performOCR(PipelineData* pipeline_data);
@@ -46,6 +47,7 @@ namespace alpr
     virtual void segment(PipelineData* pipeline_data)=0;
     
     Config* config;
+    const CountryConfig* countryConfig;
 
   };
 }
@@ -0,0 +1,178 @@
+/*
+ * Copyright (c) 2015 OpenALPR Technology, Inc.
+ * Open source Automated License Plate Recognition [http://www.openalpr.com]
+ *
+ * This file is part of OpenALPR.
+ *
+ * OpenALPR is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License
+ * version 3 as published by the Free Software Foundation
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "ocr_pass_cache.h"
+
+#include <cstring>
+
+using namespace std;
+using namespace cv;
+
+namespace alpr
+{
+
+  OcrPassCache::OcrPassCache(int capacity)
+  {
+    this->capacity = capacity;
+    this->clock = 0;
+  }
+
+  OcrPassCache::~OcrPassCache()
+  {
+  }
+
+  const std::vector<OcrPassResult>* OcrPassCache::find(const cv::Mat& image, const std::vector<cv::Rect>& charRegions)
+  {
+    if (capacity <= 0)
+      return NULL;
+
+    Entry* entry = findEntry(hashKey(image, charRegions), image, charRegions);
+    if (entry == NULL)
+      return NULL;
+
+    entry->lastUsed = ++clock;
+    return &entry->passes;
+  }
+
+  void OcrPassCache::add(const cv::Mat& image, const std::vector<cv::Rect>& charRegions, int passIndex, const OcrPassResult& result)
+  {
+    if (capacity <= 0)
+      return;
+
+    uint64_t hash = hashKey(image, charRegions);
+    Entry* entry = findEntry(hash, image, charRegions);
+
+    if (entry == NULL)
+    {
+      if (passIndex != 0)
+        return;
+
+      if ((int) entries.size() < capacity)
+      {
+        entries.push_back(Entry());
+        entry = &entries.back();
+      }
+      else
+      {
+        // Evict the least recently used input
+        entry = &entries[0];
+        for (unsigned int i = 1; i < entries.size(); i++)
+        {
+          if (entries[i].lastUsed < entry->lastUsed)
+            entry = &entries[i];
+        }
+      }
+
+      entry->hash = hash;
+      image.copyTo(entry->image);
+      entry->charRegions = charRegions;
+      entry->passes.clear();
+    }
+
+    if (passIndex != (int) entry->passes.size())
+      return;
+
+    entry->passes.push_back(result);
+    entry->lastUsed = ++clock;
+  }
+
+  OcrPassCache::Entry* OcrPassCache::findEntry(uint64_t hash, const cv::Mat& image, const std::vector<cv::Rect>& charRegions)
+  {
+    for (unsigned int i = 0; i < entries.size(); i++)
+    {
+      Entry& entry = entries[i];
+      if (entry.hash != hash || entry.image.size() != image.size() || entry.image.type() != image.type())
+        continue;
+      if (entry.charRegions != charRegions)
+        continue;
+
+      bool same = true;
+      size_t row_bytes = image.cols * image.elemSize();
+      for (int y = 0; y < image.rows && same; y++)
+        same = memcmp(entry.image.ptr(y), image.ptr(y), row_bytes) == 0;
+
+      if (same)
+        return &entry;
+    }
+    return NULL;
+  }
+
+  uint64_t OcrPassCache::hashKey(const cv::Mat& image, const std::vector<cv::Rect>& charRegions)
+  {
+    // FNV-1a over the pixels and boxes
+    const uint64_t FNV_PRIME = 1099511628211ULL;
+    uint64_t hash = 14695981039346656037ULL;
+
+    size_t row_bytes = image.cols * image.elemSize();
+    for (int y = 0; y < image.rows; y++)
+    {
+      const uchar* row = image.ptr(y);
+      for (size_t x = 0; x < row_bytes; x++)
+        hash = (hash ^ row[x]) * FNV_PRIME;
+    }
+
+    for (unsigned int i = 0; i < charRegions.size(); i++)
+    {
+      int values[4] = { charRegions[i].x, charRegions[i].y, charRegions[i].width, charRegions[i].height };
+      for (int v = 0; v < 4; v++)
+        hash = (hash ^ (uint64_t) (uint32_t) values[v]) * FNV_PRIME;
+    }
+
+    return hash;
+  }
+
+  bool ocrPassReachesEarlyExit(const OcrPassResult& pass, unsigned int charPositions, unsigned int lineCount,
+                               float minConfidence, PostProcess* patterns)
+  {
+    if (minConfidence <= 0 || charPositions == 0)
+      return false;
+
+    // The first entry for each character position is Tesseract's top symbol; the rest are choices
+    std::vector<const OcrChar*> topChoice(charPositions, (const OcrChar*) NULL);
+    for (unsigned int c = 0; c < pass.chars.size(); c++)
+    {
+      int pos = pass.chars[c].char_index;
+      if (pos >= 0 && pos < (int) topChoice.size() && topChoice[pos] == NULL)
+        topChoice[pos] = &pass.chars[c];
+    }
+
+    float total = 0;
+    std::string text;
+    for (unsigned int pos = 0; pos < topChoice.size(); pos++)
+    {
+      if (topChoice[pos] == NULL)
+        return false;
+      total += topChoice[pos]->confidence;
+      text += topChoice[pos]->letter;
+    }
+
+    if (total / topChoice.size() < minConfidence)
+      return false;
+
+    if (patterns != NULL)
+    {
+      // A single line can only be checked against the patterns when it is the whole plate
+      if (lineCount != 1 || !patterns->matchesAnyPattern(text))
+        return false;
+    }
+
+    return true;
+  }
+
+}
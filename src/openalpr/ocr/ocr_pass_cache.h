@@ -0,0 +1,85 @@
+/*
+ * Copyright (c) 2015 OpenALPR Technology, Inc.
+ * Open source Automated License Plate Recognition [http://www.openalpr.com]
+ *
+ * This file is part of OpenALPR.
+ *
+ * OpenALPR is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License
+ * version 3 as published by the Free Software Foundation
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef OPENALPR_OCRPASSCACHE_H
+#define OPENALPR_OCRPASSCACHE_H
+
+#include <stdint.h>
+#include <vector>
+
+#include "opencv2/core/core.hpp"
+
+#include "ocr.h"
+
+namespace alpr
+{
+
+  struct OcrPassResult
+  {
+    std::vector<OcrChar> chars;
+    double score;
+  };
+
+  // Remembers what Tesseract produced for recent (threshold image, character boxes)
+  // inputs, one result per pass variant in the order they were run.  Keys are compared
+  // byte for byte, so a hit is exactly the input that produced the stored result.
+  // Not thread-safe; each OCR instance owns its own cache.
+  class OcrPassCache
+  {
+    public:
+      OcrPassCache(int capacity);
+      virtual ~OcrPassCache();
+
+      // Returns the stored passes for this input, or NULL
+      const std::vector<OcrPassResult>* find(const cv::Mat& image, const std::vector<cv::Rect>& charRegions);
+
+      // Records the result of pass number passIndex.  Passes must be added in order.
+      void add(const cv::Mat& image, const std::vector<cv::Rect>& charRegions, int passIndex, const OcrPassResult& result);
+
+    protected:
+      // Lookups only compare pixels for entries whose hash matches
+      virtual uint64_t hashKey(const cv::Mat& image, const std::vector<cv::Rect>& charRegions);
+
+    private:
+      struct Entry
+      {
+        uint64_t hash;
+        cv::Mat image;
+        std::vector<cv::Rect> charRegions;
+        std::vector<OcrPassResult> passes;
+        uint64_t lastUsed;
+      };
+
+      int capacity;
+      uint64_t clock;
+      std::vector<Entry> entries;
+
+      Entry* findEntry(uint64_t hash, const cv::Mat& image, const std::vector<cv::Rect>& charRegions);
+  };
+
+  // Whether a pass is good enough to skip the ones after it.  Each of the line's
+  // charPositions needs a top choice, and their mean confidence must reach
+  // minConfidence (0 turns early exit off).  Given patterns, the line must also be the
+  // plate's only one and read as a match for one of them.
+  bool ocrPassReachesEarlyExit(const OcrPassResult& pass, unsigned int charPositions, unsigned int lineCount,
+                               float minConfidence, PostProcess* patterns);
+
+}
+
+#endif // OPENALPR_OCRPASSCACHE_H
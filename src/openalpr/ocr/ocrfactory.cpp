@@ -3,9 +3,9 @@
 
 namespace alpr
 {
-  OCR* createOcr(Config* config)
+  OCR* createOcr(Config* config, const CountryConfig* countryConfig)
   {
-    return new TesseractOcr(config);
+    return new TesseractOcr(config, countryConfig);
   }
 
 }
@@ -26,7 +26,7 @@
 namespace alpr
 {
 
-  OCR* createOcr(Config* config);
+  OCR* createOcr(Config* config, const CountryConfig* countryConfig = NULL);
 
 }
 #endif	/* OPENALPR_DETECTORFACTORY_H */
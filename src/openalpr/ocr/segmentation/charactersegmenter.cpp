@@ -20,6 +20,7 @@
 #include <opencv2/core/core.hpp>
 
 #include "charactersegmenter.h"
+#include "stage_stats.h"
 
 using namespace cv;
 using namespace std;
@@ -55,6 +56,7 @@ namespace alpr
   }
   
   void CharacterSegmenter::segment() {
+    ALPR_STAGE_TIMER(STAGE_SEGMENTATION);
 
     timespec startTime;
     getTimeMonotonic(&startTime);
@@ -73,7 +75,7 @@ namespace alpr
       this->bottom = pipeline_data->textLines[lineidx].bottomLine;
 
       float avgCharHeight = pipeline_data->textLines[lineidx].lineHeight;
-      float height_to_width_ratio = pipeline_data->config->charHeightMM[lineidx] / pipeline_data->config->charWidthMM[lineidx];
+      float height_to_width_ratio = pipeline_data->country_config->charHeightMM[lineidx] / pipeline_data->country_config->charWidthMM[lineidx];
       float avgCharWidth = avgCharHeight / height_to_width_ratio;
 
       if (config->debugCharSegmenter)
@@ -225,9 +227,9 @@ namespace alpr
   // Scores the histogram quality as well based on num chars, char volume, and even separation
   vector<Rect> CharacterSegmenter::getHistogramBoxes(HistogramVertical histogram, float avgCharWidth, float avgCharHeight, float* score)
   {
-    float MIN_HISTOGRAM_HEIGHT = avgCharHeight * config->segmentationMinCharHeightPercent;
+    float MIN_HISTOGRAM_HEIGHT = avgCharHeight * pipeline_data->country_config->segmentationMinCharHeightPercent;
 
-    float MAX_SEGMENT_WIDTH = avgCharWidth * config->segmentationMaxCharWidthvsAverage;
+    float MAX_SEGMENT_WIDTH = avgCharWidth * pipeline_data->country_config->segmentationMaxCharWidthvsAverage;
 
     //float MIN_BOX_AREA = (avgCharWidth * avgCharHeight) * 0.25;
 
@@ -238,7 +240,7 @@ namespace alpr
 
     for (unsigned int i = 0; i < allBoxes.size(); i++)
     {
-      if (allBoxes[i].width >= config->segmentationMinBoxWidthPx && allBoxes[i].width <= MAX_SEGMENT_WIDTH &&
+      if (allBoxes[i].width >= pipeline_data->country_config->segmentationMinBoxWidthPx && allBoxes[i].width <= MAX_SEGMENT_WIDTH &&
           allBoxes[i].height > MIN_HISTOGRAM_HEIGHT )
       {
         charBoxes.push_back(allBoxes[i]);
@@ -279,7 +281,7 @@ namespace alpr
 
   vector<Rect> CharacterSegmenter::getBestCharBoxes(Mat img, vector<Rect> charBoxes, float avgCharWidth)
   {
-    float MAX_SEGMENT_WIDTH = avgCharWidth * config->segmentationMaxCharWidthvsAverage;
+    float MAX_SEGMENT_WIDTH = avgCharWidth * pipeline_data->country_config->segmentationMaxCharWidthvsAverage;
 
     // This histogram is based on how many char boxes (from ALL of the many thresholded images) are covering each column
     // Makes a sort of histogram from all the previous char boxes.  Figures out the best fit from that.
@@ -326,7 +328,7 @@ namespace alpr
       for (unsigned int boxidx = 0; boxidx < allBoxes.size(); boxidx++)
       {
         int w = allBoxes[boxidx].width;
-        if (w >= config->segmentationMinBoxWidthPx && w <= MAX_SEGMENT_WIDTH)
+        if (w >= pipeline_data->country_config->segmentationMinBoxWidthPx && w <= MAX_SEGMENT_WIDTH)
         {
           float widthDiffPixels = abs(w - avgCharWidth);
           float widthDiffPercent = widthDiffPixels / avgCharWidth;
@@ -396,7 +398,7 @@ namespace alpr
   void CharacterSegmenter::removeSmallContours(vector<Mat> thresholds, float avgCharHeight,  TextLine textLine)
   {
     //const float MIN_CHAR_AREA = 0.02 * avgCharWidth * avgCharHeight;	// To clear out the tiny specks
-    const float MIN_CONTOUR_HEIGHT = config->segmentationMinSpeckleHeightPercent * avgCharHeight;
+    const float MIN_CONTOUR_HEIGHT = pipeline_data->country_config->segmentationMinSpeckleHeightPercent * avgCharHeight;
 
     Mat textLineMask = Mat::zeros(thresholds[0].size(), CV_8U);
     fillConvexPoly(textLineMask, textLine.linePolygon.data(), textLine.linePolygon.size(), Scalar(255,255,255));
@@ -434,7 +436,7 @@ namespace alpr
   vector<Rect> CharacterSegmenter::combineCloseBoxes( vector<Rect> charBoxes)
   {
     // Don't bother combining if there are fewer than the min number of characters
-    if (charBoxes.size() < config->postProcessMinCharacters)
+    if (charBoxes.size() < pipeline_data->country_config->postProcessMinCharacters)
       return charBoxes;
     
     // First find the median char gap (the space from midpoint to midpoint of chars)
@@ -530,7 +532,7 @@ namespace alpr
     const float MIN_SPECKLE_HEIGHT_PERCENT = 0.13;
     const float MIN_SPECKLE_WIDTH_PX = 3;
     const float MIN_CONTOUR_AREA_PERCENT = 0.1;
-    const float MIN_CONTOUR_HEIGHT_PERCENT = config->segmentationMinCharHeightPercent;
+    const float MIN_CONTOUR_HEIGHT_PERCENT = pipeline_data->country_config->segmentationMinCharHeightPercent;
 
     Mat mask = getCharBoxMask(thresholds[0], charRegions);
 
@@ -698,7 +700,7 @@ namespace alpr
     // clear all data for every box #3.
 
     //const float MIN_AREA_PERCENT = 0.1;
-    const float MIN_CONTOUR_HEIGHT_PERCENT = config->segmentationMinCharHeightPercent;
+    const float MIN_CONTOUR_HEIGHT_PERCENT = pipeline_data->country_config->segmentationMinCharHeightPercent;
 
     
     vector<int> boxScores(charRegions.size());
@@ -920,14 +922,14 @@ namespace alpr
       float rightCoveragePx = (charRegions[charRegions.size() -1].x + charRegions[charRegions.size() -1].width) - rightEdge;
       float rightCoveragePercent = ((float) rightCoveragePx) / ((float) charRegions[charRegions.size() -1].width);
       if ((leftCoveragePercent > MAX_COVERAGE_PERCENT) ||
-          (charRegions[0].width - leftCoveragePx < config->segmentationMinBoxWidthPx))
+          (charRegions[0].width - leftCoveragePx < pipeline_data->country_config->segmentationMinBoxWidthPx))
       {
         rectangle(mask, charRegions[0], Scalar(0,0,0), -1);	// Mask the whole region
         if (this->config->debugCharSegmenter)
           cout << "Edge Filter: Entire left region is erased" << endl;
       }
       if ((rightCoveragePercent > MAX_COVERAGE_PERCENT) ||
-          (charRegions[charRegions.size() -1].width - rightCoveragePx < config->segmentationMinBoxWidthPx))
+          (charRegions[charRegions.size() -1].width - rightCoveragePx < pipeline_data->country_config->segmentationMinBoxWidthPx))
       {
         rectangle(mask, charRegions[charRegions.size() -1], Scalar(0,0,0), -1);
         if (this->config->debugCharSegmenter)
@@ -1047,7 +1049,7 @@ namespace alpr
       {
         //cout << "Edge Filter: " << tallestContourHeight << " -- " << avgCharHeight << endl;
         if (tallestContourHeight >= avgCharHeight * 0.9 &&
-            ((tallestContourWidth < config->segmentationMinBoxWidthPx) || (tallestContourArea < avgCharWidth * avgCharHeight * 0.1)))
+            ((tallestContourWidth < pipeline_data->country_config->segmentationMinBoxWidthPx) || (tallestContourArea < avgCharWidth * avgCharHeight * 0.1)))
         {
           cout << "Edge Filter: Avg contour width: " << avgCharWidth << " This guy is: " << tallestContourWidth << endl;
           cout << "Edge Filter: tallestContourArea: " << tallestContourArea << " Minimum: " << avgCharWidth * avgCharHeight * 0.1 << endl;
@@ -30,8 +30,8 @@ using namespace tesseract;
 namespace alpr
 {
 
-  TesseractOcr::TesseractOcr(Config* config)
-  : OCR(config)
+  TesseractOcr::TesseractOcr(Config* config, const CountryConfig* countryConfig)
+  : OCR(config, countryConfig), passCache(config->ocrPassCacheSize)
   {
     const string MINIMUM_TESSERACT_VERSION = "3.03";
 
@@ -48,7 +48,7 @@ namespace alpr
       TessdataPrefix += "tessdata/";    
 
     // Tesseract requires the prefix directory to be set as an env variable
-    tesseract.Init(TessdataPrefix.c_str(), config->ocrLanguage.c_str() 	);
+    tesseract.Init(TessdataPrefix.c_str(), countryConfig->ocrLanguage.c_str() 	);
     tesseract.SetVariable("save_blob_choices", "T");
     tesseract.SetVariable("debug_file", "/dev/null");
     tesseract.SetPageSegMode(PSM_SINGLE_CHAR);
@@ -156,14 +156,18 @@ namespace alpr
       return std::make_pair(chars, score);
     };
 
+    // Pass variants tried for every threshold image, in order
+    bool isMoto = (config->vehicle == "moto");
+    bool isGaragem = (config->scenario == "garagem");
+    bool applyUpsample = config->motoUpsample || isMoto || isGaragem;
+    double upScale = (config->motoUpsampleScale > 0.0) ? config->motoUpsampleScale : 2.0;
+    bool addUpsample = applyUpsample && upScale != 1.0;
+    int passCount = 1 + (addUpsample ? 1 : 0) + ((isMoto || isGaragem) ? 1 : 0) + (isGaragem ? 1 : 0);
+
     auto buildPasses = [&](const cv::Mat& base, std::vector<std::pair<cv::Mat,double>>& out){
       out.clear();
       out.push_back(std::make_pair(base, 1.0));
-      bool isMoto = (config->vehicle == "moto");
-      bool isGaragem = (config->scenario == "garagem");
-      bool applyUpsample = config->motoUpsample || isMoto || isGaragem;
-      double upScale = (config->motoUpsampleScale > 0.0) ? config->motoUpsampleScale : 2.0;
-      if (applyUpsample && upScale != 1.0) {
+      if (addUpsample) {
         cv::Mat up;
         cv::resize(base, up, cv::Size(), upScale, upScale, cv::INTER_CUBIC);
         out.push_back(std::make_pair(up, upScale));
@@ -189,22 +193,59 @@ namespace alpr
       }
     };
 
+    const std::vector<cv::Rect>& lineRegions = pipeline_data->charRegions[line_idx];
+    bool stopped = false;
     for (unsigned int i = 0; i < pipeline_data->thresholds.size(); i++)
     {
+      const cv::Mat& threshold = pipeline_data->thresholds[i];
+
+      // Passes already run on these exact pixels (e.g., an earlier burst frame) are reused.
+      // The variants themselves are only built once a pass actually has to run.
+      const std::vector<OcrPassResult>* cached = stopped ? NULL : passCache.find(threshold, lineRegions);
       std::vector<std::pair<cv::Mat,double>> passes;
-      buildPasses(pipeline_data->thresholds[i], passes);
-      for (size_t p = 0; p < passes.size(); ++p) {
-        pipeline_data->ocr_passes_total++;
-        auto res = runPass(passes[p].first, passes[p].second, static_cast<int>(p), static_cast<int>(i));
-        if (res.second > best_score) {
-          best_score = res.second;
-          best_chars = res.first;
+
+      for (int p = 0; p < passCount; ++p) {
+        if (stopped) {
+          pipeline_data->ocr_passes_skipped++;
+          continue;
         }
+
+        OcrPassResult res;
+        if (cached != NULL && p < (int) cached->size()) {
+          res = (*cached)[p];
+          pipeline_data->ocr_passes_skipped++;
+        }
+        else {
+          if (passes.empty())
+            buildPasses(threshold, passes);
+          pipeline_data->ocr_passes_total++;
+          auto run = runPass(passes[p].first, passes[p].second, p, static_cast<int>(i));
+          res.chars = run.first;
+          res.score = run.second;
+          passCache.add(threshold, lineRegions, p, res);
+          cached = NULL;
+        }
+
+        if (res.score > best_score) {
+          best_score = res.score;
+          best_chars = res.chars;
+        }
+
+        if (passReachesEarlyExit(res, line_idx, pipeline_data))
+          stopped = true;
       }
     }
     
     return best_chars;
   }
+
+  bool TesseractOcr::passReachesEarlyExit(const OcrPassResult& pass, int line_index, PipelineData* pipeline_data)
+  {
+    return ocrPassReachesEarlyExit(pass, pipeline_data->charRegions[line_index].size(), pipeline_data->charRegions.size(),
+                                   config->ocrEarlyExitConfidence,
+                                   config->ocrEarlyExitRequirePattern ? &postProcessor : NULL);
+  }
+
   void TesseractOcr::segment(PipelineData* pipeline_data) {
 
     CharacterSegmenter segmenter(pipeline_data);
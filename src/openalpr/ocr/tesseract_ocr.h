@@ -32,6 +32,7 @@
 #include "support/version.h"
 
 #include "ocr.h"
+#include "ocr_pass_cache.h"
 #include "tesseract/baseapi.h"
 
 namespace alpr
@@ -41,7 +42,7 @@ namespace alpr
   {
 
     public:
-      TesseractOcr(Config* config);
+      TesseractOcr(Config* config, const CountryConfig* countryConfig = NULL);
       virtual ~TesseractOcr();
 
 
@@ -50,9 +51,13 @@ namespace alpr
 
       std::vector<OcrChar> recognize_line(int line_index, PipelineData* pipeline_data);
       void segment(PipelineData* pipeline_data);
+
+      bool passReachesEarlyExit(const OcrPassResult& pass, int line_index, PipelineData* pipeline_data);
     
       tesseract::TessBaseAPI tesseract;
 
+      OcrPassCache passCache;
+
   };
 
 }
@@ -22,9 +22,9 @@ namespace alpr
     this->init(colorImage, grayImage, regionOfInterest, config);
   }
   
-  PipelineData::PipelineData(Mat colorImage, Mat grayImg, Rect regionOfInterest, Config* config)
+  PipelineData::PipelineData(Mat colorImage, Mat grayImg, Rect regionOfInterest, Config* config, const CountryConfig* countryConfig)
   {
-    this->init(colorImage, grayImg, regionOfInterest, config);
+    this->init(colorImage, grayImg, regionOfInterest, config, countryConfig);
   }
 
   PipelineData::~PipelineData()
@@ -41,15 +41,17 @@ namespace alpr
     thresholds.clear();
   }
 
-  void PipelineData::init(cv::Mat colorImage, cv::Mat grayImage, cv::Rect regionOfInterest, Config *config) {
+  void PipelineData::init(cv::Mat colorImage, cv::Mat grayImage, cv::Rect regionOfInterest, Config *config, const CountryConfig* countryConfig) {
     this->colorImg = colorImage;
     this->grayImg = grayImage;
     this->regionOfInterest = regionOfInterest;
     this->config = config;
+    this->country_config = (countryConfig != NULL) ? countryConfig : config->countryConfig;
     this->region_confidence = 0;
     this->plate_inverted = false;
     this->disqualified = false;
     this->disqualify_reason = "";
     this->ocr_passes_total = 0;
+    this->ocr_passes_skipped = 0;
   }
 }
@@ -17,14 +17,15 @@ namespace alpr
 
     public:
       PipelineData(cv::Mat colorImage, cv::Rect regionOfInterest, Config* config);
-      PipelineData(cv::Mat colorImage, cv::Mat grayImage, cv::Rect regionOfInterest, Config* config);
+      PipelineData(cv::Mat colorImage, cv::Mat grayImage, cv::Rect regionOfInterest, Config* config, const CountryConfig* countryConfig = NULL);
       virtual ~PipelineData();
 
-      void init(cv::Mat colorImage, cv::Mat grayImage, cv::Rect regionOfInterest, Config* config);
+      void init(cv::Mat colorImage, cv::Mat grayImage, cv::Rect regionOfInterest, Config* config, const CountryConfig* countryConfig = NULL);
       void clearThresholds();
 
       // Inputs
       Config* config;
+      const CountryConfig* country_config;
 
       PreWarp* prewarp;
 
@@ -66,7 +67,9 @@ namespace alpr
       std::vector<cv::Rect> charRegionsFlat;
 
       // Diagnostics
+      // Tesseract passes actually run, and passes avoided by the cache or early exit
       int ocr_passes_total = 0;
+      int ocr_passes_skipped = 0;
 
 
 
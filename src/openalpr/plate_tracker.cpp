@@ -0,0 +1,207 @@
+/*
+ * Copyright (c) 2015 OpenALPR Technology, Inc.
+ * Open source Automated License Plate Recognition [http://www.openalpr.com]
+ *
+ * This file is part of OpenALPR.
+ *
+ * OpenALPR is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License
+ * version 3 as published by the Free Software Foundation
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "plate_tracker.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <functional>
+#include "opencv2/imgproc/imgproc.hpp"
+
+namespace alpr
+{
+
+  namespace
+  {
+    const int APPEARANCE_WIDTH = 64;
+    const int APPEARANCE_HEIGHT = 16;
+
+    void moveCoordinate(AlprCoordinate& point, const cv::Rect& from, const cv::Rect& to)
+    {
+      float sx = from.width > 0 ? (float) to.width / from.width : 1;
+      float sy = from.height > 0 ? (float) to.height / from.height : 1;
+      point.x = (int) (to.x + (point.x - from.x) * sx);
+      point.y = (int) (to.y + (point.y - from.y) * sy);
+    }
+
+    void movePlate(AlprPlate& plate, const cv::Rect& from, const cv::Rect& to)
+    {
+      for (unsigned int i = 0; i < plate.character_details.size(); i++)
+        for (int c = 0; c < 4; c++)
+          moveCoordinate(plate.character_details[i].corners[c], from, to);
+    }
+  }
+
+  PlateTracker::PlateTracker(Config* config)
+  {
+    this->config = config;
+    this->frameNumber = 0;
+  }
+
+  PlateTracker::~PlateTracker()
+  {
+  }
+
+  void PlateTracker::beginFrame()
+  {
+    frameNumber++;
+
+    std::vector<Track> kept;
+    for (unsigned int i = 0; i < tracks.size(); i++)
+    {
+      if (frameNumber - tracks[i].lastSeenFrame <= config->plateTrackMaxMissedFrames)
+        kept.push_back(tracks[i]);
+    }
+    tracks.swap(kept);
+  }
+
+  cv::Mat PlateTracker::appearance(const cv::Mat& grayImg, const cv::Rect& rect)
+  {
+    cv::Rect clipped = rect & cv::Rect(0, 0, grayImg.cols, grayImg.rows);
+    if (clipped.width < 2 || clipped.height < 2)
+      return cv::Mat();
+
+    cv::Mat thumb;
+    cv::resize(grayImg(clipped), thumb, cv::Size(APPEARANCE_WIDTH, APPEARANCE_HEIGHT), 0, 0, cv::INTER_AREA);
+
+    // Subtracting the mean keeps gradual lighting changes from counting as a new crop
+    cv::Mat normalized;
+    thumb.convertTo(normalized, CV_32F, 1.0, -cv::mean(thumb)[0]);
+    return normalized;
+  }
+
+  float PlateTracker::appearanceDiff(const cv::Mat& a, const cv::Mat& b)
+  {
+    if (a.empty() || b.empty() || a.size() != b.size())
+      return FLT_MAX;
+
+    cv::Mat diff;
+    cv::absdiff(a, b, diff);
+    return (float) cv::mean(diff)[0];
+  }
+
+  float PlateTracker::iou(const cv::Rect& a, const cv::Rect& b)
+  {
+    int intersection = (a & b).area();
+    int combined = a.area() + b.area() - intersection;
+    if (combined <= 0)
+      return 0;
+    return (float) intersection / combined;
+  }
+
+  int PlateTracker::match(const cv::Rect& rect, const cv::Mat& appearance)
+  {
+    int bestTrack = -1;
+    float bestIou = 0;
+    for (unsigned int i = 0; i < tracks.size(); i++)
+    {
+      if (tracks[i].lastSeenFrame == frameNumber)
+        continue;
+
+      float overlap = iou(rect, tracks[i].rect);
+      if (overlap < config->plateTrackIou || overlap <= bestIou)
+        continue;
+      if (appearanceDiff(appearance, tracks[i].appearance) > config->plateTrackMaxAppearanceDiff)
+        continue;
+
+      bestTrack = i;
+      bestIou = overlap;
+    }
+    return bestTrack;
+  }
+
+  bool PlateTracker::canReuse(int track)
+  {
+    if (track < 0)
+      return false;
+
+    const Track& t = tracks[track];
+    return t.hasRead &&
+        t.best.bestPlate.overall_confidence >= config->plateTrackMinConfidence &&
+        t.framesSinceOcr < config->plateTrackReocrFrames;
+  }
+
+  int PlateTracker::update(int track, const cv::Rect& rect, const cv::Mat& appearance, bool ocrRan, const AlprPlateResult* plate)
+  {
+    if (track < 0)
+    {
+      Track t;
+      t.framesSinceOcr = 0;
+      t.hasRead = false;
+      tracks.push_back(t);
+      track = tracks.size() - 1;
+    }
+
+    Track& t = tracks[track];
+    t.rect = rect;
+    t.appearance = appearance;
+    t.lastSeenFrame = frameNumber;
+    t.framesSinceOcr = ocrRan ? 0 : t.framesSinceOcr + 1;
+
+    if (plate != NULL && (!t.hasRead || plate->bestPlate.overall_confidence >= t.best.bestPlate.overall_confidence))
+    {
+      t.best = *plate;
+      t.bestRect = rect;
+      t.hasRead = true;
+    }
+
+    return track;
+  }
+
+  AlprPlateResult PlateTracker::bestRead(int track, const cv::Rect& rect)
+  {
+    const Track& t = tracks[track];
+    AlprPlateResult plate = t.best;
+
+    for (int i = 0; i < 4; i++)
+      moveCoordinate(plate.plate_points[i], t.bestRect, rect);
+    movePlate(plate.bestPlate, t.bestRect, rect);
+    for (unsigned int i = 0; i < plate.topNPlates.size(); i++)
+      movePlate(plate.topNPlates[i], t.bestRect, rect);
+
+    return plate;
+  }
+
+  bool PlateTracker::hasRead(int track)
+  {
+    return track >= 0 && tracks[track].hasRead;
+  }
+
+  float PlateTracker::qualityBar(int track)
+  {
+    int shots = config->ocrBestShots;
+    if (track < 0 || shots <= 0 || (int) tracks[track].qualities.size() < shots)
+      return 0;
+
+    std::vector<float> recent(tracks[track].qualities.begin(), tracks[track].qualities.end());
+    std::nth_element(recent.begin(), recent.begin() + (shots - 1), recent.end(), std::greater<float>());
+    return recent[shots - 1];
+  }
+
+  void PlateTracker::addQuality(int track, float score)
+  {
+    std::deque<float>& qualities = tracks[track].qualities;
+    qualities.push_back(score);
+
+    // The window includes the crop being judged, so it holds one fewer earlier crop
+    while ((int) qualities.size() > config->ocrBestShotWindow - 1)
+      qualities.pop_front();
+  }
+
+}
@@ -0,0 +1,107 @@
+/*
+ * Copyright (c) 2015 OpenALPR Technology, Inc.
+ * Open source Automated License Plate Recognition [http://www.openalpr.com]
+ *
+ * This file is part of OpenALPR.
+ *
+ * OpenALPR is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License
+ * version 3 as published by the Free Software Foundation
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef OPENALPR_PLATETRACKER_H
+#define OPENALPR_PLATETRACKER_H
+
+#include <deque>
+#include <vector>
+#include "opencv2/core/core.hpp"
+
+#include "alpr.h"
+#include "config.h"
+
+namespace alpr
+{
+
+  // Follows plate regions across the frames of a video so that a plate which is
+  // still in view can keep its earlier read instead of going through OCR again.
+  // A region continues a track when it overlaps the track's last position and its
+  // crop still looks the same.  Each track keeps the most confident read it has had.
+  // Not thread-safe; each RecognitionContext has its own trackers.
+  class PlateTracker
+  {
+    public:
+      PlateTracker(Config* config);
+      virtual ~PlateTracker();
+
+      // Starts a new frame and forgets tracks that have not been seen for a while
+      void beginFrame();
+
+      // A small brightness-normalized thumbnail of the region, used to tell whether
+      // the crop has changed.  Empty if the region is outside the image.
+      static cv::Mat appearance(const cv::Mat& grayImg, const cv::Rect& rect);
+
+      // Mean absolute pixel difference between two appearances, or a large value
+      // if either is empty
+      static float appearanceDiff(const cv::Mat& a, const cv::Mat& b);
+
+      static float iou(const cv::Rect& a, const cv::Rect& b);
+
+      // The track this region continues, or -1.  A track is only matched once per frame.
+      int match(const cv::Rect& rect, const cv::Mat& appearance);
+
+      // True if the track's best read is confident and recent enough to stand in for OCR
+      bool canReuse(int track);
+
+      // Records the region as the track's position in this frame and returns the
+      // track (a new one if track is -1).  plate is the read OCR produced for it, or
+      // NULL if OCR was skipped or found nothing.
+      int update(int track, const cv::Rect& rect, const cv::Mat& appearance, bool ocrRan, const AlprPlateResult* plate);
+
+      bool hasRead(int track);
+
+      // The track's best read, with its coordinates moved to where the plate is now
+      AlprPlateResult bestRead(int track, const cv::Rect& rect);
+
+      // The crop quality a region continuing this track needs to be among the
+      // ocr_best_shots best of the track's recent crops.  0 while the track is new
+      // or best-shot selection is off.
+      float qualityBar(int track);
+
+      // Adds this frame's crop quality to the track's recent window
+      void addQuality(int track, float score);
+
+      int trackCount() { return tracks.size(); }
+
+    private:
+      struct Track
+      {
+        cv::Rect rect;
+        cv::Mat appearance;
+        int lastSeenFrame;
+        int framesSinceOcr;
+
+        bool hasRead;
+        AlprPlateResult best;
+        // Where the plate was when the best read was taken
+        cv::Rect bestRect;
+
+        // Quality scores of the most recent crops, oldest first
+        std::deque<float> qualities;
+      };
+
+      Config* config;
+      std::vector<Track> tracks;
+      int frameNumber;
+  };
+
+}
+
+#endif // OPENALPR_PLATETRACKER_H
@@ -0,0 +1,160 @@
+/*
+ * Copyright (c) 2015 OpenALPR Technology, Inc.
+ * Open source Automated License Plate Recognition [http://www.openalpr.com]
+ *
+ * This file is part of OpenALPR.
+ *
+ * OpenALPR is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License
+ * version 3 as published by the Free Software Foundation
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "pattern_automaton.h"
+
+#include <algorithm>
+
+using namespace std;
+
+namespace alpr
+{
+
+  // One bit per pattern
+  const unsigned int MAX_AUTOMATON_PATTERNS = 64;
+
+  PatternAutomaton::PatternAutomaton(const vector<RegexRule*>& rules)
+  {
+    valid = rules.size() > 0 && rules.size() <= MAX_AUTOMATON_PATTERNS;
+    maxLength = 0;
+    allPatterns = 0;
+
+    map<string, int> classIndex;
+    for (unsigned int r = 0; valid && r < rules.size(); r++)
+    {
+      const vector<string>& positions = rules[r]->getPositionRegexes();
+      if (positions.empty())
+      {
+        valid = false;
+        break;
+      }
+
+      vector<int> patternClasses;
+      for (unsigned int p = 0; p < positions.size(); p++)
+      {
+        map<string, int>::iterator existing = classIndex.find(positions[p]);
+        if (existing != classIndex.end())
+        {
+          patternClasses.push_back(existing->second);
+          continue;
+        }
+
+        re2::RE2* regex = new re2::RE2(positions[p]);
+        classes.push_back(regex);
+        if (!regex->ok())
+          valid = false;
+
+        classIndex[positions[p]] = classes.size() - 1;
+        patternClasses.push_back(classes.size() - 1);
+      }
+
+      positionClasses.push_back(patternClasses);
+      allPatterns |= ((uint64_t) 1) << r;
+      maxLength = max(maxLength, (int) patternClasses.size());
+    }
+
+    if (!valid)
+    {
+      positionClasses.clear();
+      allPatterns = 0;
+      maxLength = 0;
+      return;
+    }
+
+    lengthMasks.resize(maxLength + 1, 0);
+    for (unsigned int r = 0; r < positionClasses.size(); r++)
+      lengthMasks[positionClasses[r].size()] |= ((uint64_t) 1) << r;
+
+    rejectAll.resize(maxLength, 0);
+  }
+
+  PatternAutomaton::~PatternAutomaton()
+  {
+    for (unsigned int i = 0; i < classes.size(); i++)
+      delete classes[i];
+  }
+
+  uint64_t PatternAutomaton::getPatternsOfLength(int length) const
+  {
+    if (length < 0 || length >= (int) lengthMasks.size())
+      return 0;
+    return lengthMasks[length];
+  }
+
+  const uint64_t* PatternAutomaton::getAcceptMasks(const string& character)
+  {
+    map<string, vector<uint64_t> >::iterator cached = acceptCache.find(character);
+    if (cached != acceptCache.end())
+      return cached->second.data();
+
+    // Anything but exactly one code point fails the rules' length check
+    if (!utf8::is_valid(character.begin(), character.end()) ||
+        utf8::distance(character.begin(), character.end()) != 1)
+      return rejectAll.data();
+
+    vector<char> classAccepts(classes.size());
+    for (unsigned int c = 0; c < classes.size(); c++)
+      classAccepts[c] = re2::RE2::FullMatch(character, *classes[c]);
+
+    vector<uint64_t>& masks = acceptCache[character];
+    masks.resize(maxLength, 0);
+    for (unsigned int r = 0; r < positionClasses.size(); r++)
+    {
+      for (unsigned int p = 0; p < positionClasses[r].size(); p++)
+      {
+        if (classAccepts[positionClasses[r][p]])
+          masks[p] |= ((uint64_t) 1) << r;
+      }
+    }
+
+    return masks.data();
+  }
+
+  bool PatternAutomaton::matches(const string& text)
+  {
+    vector<string> characters;
+    if (!valid || !splitCharacters(text, characters))
+      return false;
+    if (characters.size() > (unsigned int) maxLength)
+      return false;
+
+    uint64_t alive = allPatterns & lengthMasks[characters.size()];
+    for (unsigned int i = 0; i < characters.size() && alive != 0; i++)
+      alive &= getAcceptMasks(characters[i])[i];
+
+    return alive != 0;
+  }
+
+  bool PatternAutomaton::splitCharacters(const string& text, vector<string>& characters)
+  {
+    characters.clear();
+    if (!utf8::is_valid(text.begin(), text.end()))
+      return false;
+
+    string::const_iterator it = text.begin();
+    while (it != text.end())
+    {
+      string::const_iterator start = it;
+      utf8::next(it, text.end());
+      characters.push_back(string(start, it));
+    }
+    return true;
+  }
+
+}
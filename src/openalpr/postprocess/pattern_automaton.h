@@ -0,0 +1,80 @@
+/*
+ * Copyright (c) 2015 OpenALPR Technology, Inc.
+ * Open source Automated License Plate Recognition [http://www.openalpr.com]
+ *
+ * This file is part of OpenALPR.
+ *
+ * OpenALPR is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License
+ * version 3 as published by the Free Software Foundation
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef OPENALPR_PATTERNAUTOMATON_H
+#define OPENALPR_PATTERNAUTOMATON_H
+
+#include <map>
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+#include "regexrule.h"
+
+namespace alpr
+{
+
+  // The patterns of one region, compiled into a character class per position.  A
+  // pattern is one bit in a mask, so a text is matched by walking its characters once
+  // and and-ing together which patterns accept each character where it falls; a
+  // prefix whose mask goes to zero cannot be completed into a match.
+  //
+  // The regex behind each class is only run the first time a character is seen,
+  // after that the answer comes from a table.
+  class PatternAutomaton
+  {
+    public:
+      PatternAutomaton(const std::vector<RegexRule*>& rules);
+      virtual ~PatternAutomaton();
+
+      // False if any pattern could not be split into single-character positions, or
+      // there are too many of them; the RegexRules have to be used instead.
+      bool isValid() const { return valid; }
+
+      int getMaxLength() const { return maxLength; }
+      uint64_t getAllPatterns() const { return allPatterns; }
+      uint64_t getPatternsOfLength(int length) const;
+
+      // For each position below getMaxLength(), the patterns that accept the given
+      // character (one code point) there.  Stays valid for the automaton's lifetime.
+      const uint64_t* getAcceptMasks(const std::string& character);
+
+      // Same answer as trying every rule's match() on the text
+      bool matches(const std::string& text);
+
+      // Splits text into its code points.  Returns false if it is not valid UTF-8.
+      static bool splitCharacters(const std::string& text, std::vector<std::string>& characters);
+
+    private:
+      bool valid;
+      int maxLength;
+      uint64_t allPatterns;
+      std::vector<uint64_t> lengthMasks;
+
+      // positionClasses[pattern][position] indexes classes
+      std::vector<std::vector<int> > positionClasses;
+      std::vector<re2::RE2*> classes;
+
+      std::map<std::string, std::vector<uint64_t> > acceptCache;
+      std::vector<uint64_t> rejectAll;
+  };
+
+}
+
+#endif // OPENALPR_PATTERNAUTOMATON_H
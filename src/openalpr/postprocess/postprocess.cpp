@@ -18,9 +18,10 @@
 */
 
 #include "postprocess.h"
+#include "stage_stats.h"
 
 #include <fstream>
-#include <queue>
+#include <algorithm>
 #include <utility>
 
 using namespace std;
@@ -28,22 +29,23 @@ using namespace std;
 namespace alpr
 {
 
-  PostProcess::PostProcess(Config* config)
+  PostProcess::PostProcess(Config* config, const CountryConfig* countryConfig)
   {
     this->config = config;
+    this->countryConfig = (countryConfig != NULL) ? countryConfig : config->countryConfig;
 
     this->min_confidence = 0;
     this->skip_level = 0;
     
     stringstream filename;
-    filename << config->getPostProcessRuntimeDir() << "/" << config->country << ".patterns";
+    filename << config->getPostProcessRuntimeDir() << "/" << this->countryConfig->country << ".patterns";
 
     std::ifstream infile(filename.str().c_str());
 
     string region, pattern;
     while (infile >> region >> pattern)
     {
-      RegexRule* rule = new RegexRule(region, pattern, config->postProcessRegexLetters, config->postProcessRegexNumbers);
+      RegexRule* rule = new RegexRule(region, pattern, this->countryConfig->postProcessRegexLetters, this->countryConfig->postProcessRegexNumbers);
       //cout << "REGION: " << region << " PATTERN: " << pattern << endl;
 
       if (rules.find(region) == rules.end())
@@ -60,6 +62,10 @@ namespace alpr
       }
     }
 
+    for (map<string, vector<RegexRule*> >::iterator it = rules.begin(); it != rules.end(); ++it)
+      automata[it->first] = new PatternAutomaton(it->second);
+
+    this->newlineMasks = NULL;
   }
 
   PostProcess::~PostProcess()
@@ -74,6 +80,9 @@ namespace alpr
         delete iter->second[i];
       }
     }
+
+    for (map<string, PatternAutomaton*>::iterator it = automata.begin(); it != automata.end(); ++it)
+      delete it->second;
   }
   
   void PostProcess::setConfidenceThreshold(float min_confidence, float skip_level) {
@@ -163,6 +172,7 @@ namespace alpr
 
   void PostProcess::analyze(string templateregion, int topn)
   {
+    ALPR_STAGE_TIMER(STAGE_POSTPROCESS);
     timespec startTime;
     getTimeMonotonic(&startTime);
 
@@ -198,7 +208,16 @@ namespace alpr
     timespec permutationStartTime;
     getTimeMonotonic(&permutationStartTime);
 
-    findAllPermutations(templateregion, topn);
+    PatternAutomaton* automaton = NULL;
+    if (templateregion != "")
+    {
+      map<string, PatternAutomaton*>::iterator it = automata.find(templateregion);
+      if (it != automata.end() && it->second->isValid())
+        automaton = it->second;
+    }
+
+    prepareLetterText(automaton);
+    findAllPermutations(templateregion, topn, automaton);
 
     if (config->debugTiming)
     {
@@ -259,6 +278,27 @@ namespace alpr
     return rules.find(templateregion) != rules.end();
   }
   
+  bool PostProcess::matchesAnyPattern(const std::string& text)
+  {
+    for (map<string, vector<RegexRule*> >::iterator it = rules.begin(); it != rules.end(); ++it)
+    {
+      PatternAutomaton* automaton = automata[it->first];
+      if (automaton->isValid())
+      {
+        if (automaton->matches(text))
+          return true;
+        continue;
+      }
+
+      for (unsigned int i = 0; i < it->second.size(); i++)
+      {
+        if (it->second[i]->match(text))
+          return true;
+      }
+    }
+    return false;
+  }
+
   float PostProcess::calculateMaxConfidenceScore()
   {
     // Take the best score for each char position and average it.
@@ -286,71 +326,184 @@ namespace alpr
     return this->allPossibilities;
   }
 
-  struct PermutationCompare {
-    bool operator() (pair<float,vector<int> > &a, pair<float,vector<int> > &b)
+  bool PostProcess::permutationLess(const Permutation& a, const Permutation& b)
+  {
+    // Equal scores come out in the order they went in
+    if (a.score != b.score)
+      return a.score < b.score;
+    return a.order > b.order;
+  }
+
+  void PostProcess::prepareLetterText(PatternAutomaton* automaton)
+  {
+    letterText.resize(letters.size());
+    unitMasks.clear();
+    newlineMasks = (automaton != NULL) ? automaton->getAcceptMasks("\n") : NULL;
+
+    vector<string> characters;
+    for (int i = 0; i < letters.size(); i++)
     {
-      return (a.first < b.first);
+      letterText[i].resize(letters[i].size());
+      for (int j = 0; j < letters[i].size(); j++)
+      {
+        LetterText& text = letterText[i][j];
+        text.skip = (letters[i][j].letter == SKIP_CHAR);
+        text.firstUnit = unitMasks.size();
+
+        if (automaton != NULL && !text.skip)
+        {
+          if (PatternAutomaton::splitCharacters(letters[i][j].letter, characters))
+          {
+            for (int k = 0; k < characters.size(); k++)
+              unitMasks.push_back(automaton->getAcceptMasks(characters[k]));
+          }
+          else
+          {
+            // Not valid UTF-8, so no pattern accepts it
+            unitMasks.push_back(automaton->getAcceptMasks(letters[i][j].letter));
+          }
+        }
+
+        text.lastUnit = unitMasks.size();
+      }
     }
-  };
+  }
 
-  void PostProcess::findAllPermutations(string templateregion, int topn) {
+  void PostProcess::findAllPermutations(string templateregion, int topn, PatternAutomaton* automaton) {
 
-    // use a priority queue to process permutations in highest scoring order
-    priority_queue<pair<float,vector<int> >, vector<pair<float,vector<int> > >, PermutationCompare> permutations;
-    set<float> permutationHashes;
+    // Best-first search: the queue is a heap of permutations, highest score on top,
+    // whose letter indices sit side by side in one arena
+    int positions = letters.size();
+    permutationQueue.clear();
+    permutationArena.assign(positions, 0);
 
     // push the first word onto the queue
-    float totalscore = 0;
+    Permutation first;
+    first.score = 0;
     for (int i=0; i<letters.size(); i++)
     {
       if (letters[i].size() > 0)
-        totalscore += letters[i][0].totalscore;
+        first.score += letters[i][0].totalscore;
     }
-    vector<int> v(letters.size());
-    permutations.push(make_pair(totalscore, v));
+    first.offset = 0;
+    first.lastChanged = 0;
+    first.deadAt = -1;
+    first.order = 0;
+    permutationQueue.push_back(first);
+    unsigned int pushed = 1;
 
     int consecutiveNonMatches = 0;
-    while (permutations.size() > 0)
+    while (permutationQueue.size() > 0)
     {
       // get the top permutation and analyze
-      pair<float, vector<int> > topPermutation = permutations.top();
-      if (analyzePermutation(topPermutation.second, templateregion, topn) == true)
+      pop_heap(permutationQueue.begin(), permutationQueue.end(), permutationLess);
+      Permutation top = permutationQueue.back();
+      permutationQueue.pop_back();
+
+      if (analyzePermutation(&permutationArena[top.offset], templateregion, automaton, top.deadAt) == true)
         consecutiveNonMatches = 0;
       else
         consecutiveNonMatches += 1;
-      permutations.pop();
 
       if (allPossibilities.size() >= topn || consecutiveNonMatches >= (topn*2))
         break;
 
       // add child permutations to queue
-      for (int i=0; i<letters.size(); i++)
+      for (int i = top.lastChanged; i < positions; i++)
       {
+        int index = permutationArena[top.offset + i];
+
         // no more permutations with this letter
-        if (topPermutation.second[i]+1 >= letters[i].size())
+        if (index + 1 >= letters[i].size())
           continue;
 
-        pair<float, vector<int> > childPermutation = topPermutation;
-        childPermutation.first -= letters[i][topPermutation.second[i]].totalscore - letters[i][topPermutation.second[i] + 1].totalscore;
-        childPermutation.second[i] += 1;
+        Permutation child;
+        child.score = top.score - (letters[i][index].totalscore - letters[i][index + 1].totalscore);
+        child.offset = permutationArena.size();
+        child.lastChanged = i;
+        child.deadAt = (top.deadAt >= 0 && i > top.deadAt) ? top.deadAt : -1;
+        child.order = pushed++;
 
-        // ignore permutations that have already been visited (assume that score is a good hash for permutation)
-        if (permutationHashes.end() != permutationHashes.find(childPermutation.first))
-          continue;
+        permutationArena.resize(child.offset + positions);
+        copy(permutationArena.begin() + top.offset, permutationArena.begin() + top.offset + positions,
+             permutationArena.begin() + child.offset);
+        permutationArena[child.offset + i] += 1;
+
+        permutationQueue.push_back(child);
+        push_heap(permutationQueue.begin(), permutationQueue.end(), permutationLess);
+      }
+    }
+  }
 
-        permutations.push(childPermutation);
-        permutationHashes.insert(childPermutation.first);
+  bool PostProcess::walkTemplate(const int* letterIndices, PatternAutomaton* automaton, int& deadAt)
+  {
+    uint64_t alive = automaton->getAllPatterns();
+    int maxLength = automaton->getMaxLength();
+    int length = 0;
+
+    int last_line = 0;
+    for (int i = 0; i < letters.size(); i++)
+    {
+      if (letters[i].size() == 0)
+        continue;
+
+      const Letter& letter = letters[i][letterIndices[i]];
+      const LetterText& text = letterText[i][letterIndices[i]];
+
+      // The "\n" between lines takes a position like any other character
+      if (letter.line_index != last_line)
+      {
+        alive = (length < maxLength) ? (alive & newlineMasks[length]) : 0;
+        length++;
+      }
+      last_line = letter.line_index;
+
+      for (int u = text.firstUnit; u < text.lastUnit; u++)
+      {
+        alive = (length < maxLength) ? (alive & unitMasks[u][length]) : 0;
+        length++;
+      }
+
+      if (alive == 0)
+      {
+        deadAt = i;
+        return false;
       }
     }
+
+    deadAt = -1;
+    return (alive & automaton->getPatternsOfLength(length)) != 0;
   }
 
-  bool PostProcess::analyzePermutation(vector<int> letterIndices, string templateregion, int topn)
+  bool PostProcess::analyzePermutation(const int* letterIndices, const string& templateregion, PatternAutomaton* automaton, int& deadAt)
   {
+    int plate_char_length = 0;
+    for (int i = 0; i < letters.size(); i++)
+    {
+      if (letters[i].size() > 0 && !letterText[i][letterIndices[i]].skip)
+        plate_char_length += 1;
+    }
+
+    // ignore plates that don't fit the length requirements
+    if (plate_char_length < countryConfig->postProcessMinCharacters ||
+      plate_char_length > countryConfig->postProcessMaxCharacters)
+      return false;
+
+    // Apply templates.  The automaton answers without building the text, so
+    // permutations that are thrown out for missing the template never are.
+    bool templateMatch = false;
+    if (automaton != NULL)
+    {
+      templateMatch = (deadAt < 0) && walkTemplate(letterIndices, automaton, deadAt);
+      if (config->mustMatchPattern && !templateMatch)
+        return false;
+    }
+
     PPResult possibility;
-    possibility.letters = "";
     possibility.totalscore = 0;
-    possibility.matchesTemplate = false;
-    int plate_char_length = 0;
+    possibility.matchesTemplate = templateMatch;
+    possibility.letters.reserve(plate_char_length * 4);
+    possibility.letter_details.reserve(plate_char_length);
 
     int last_line = 0;
     for (int i = 0; i < letters.size(); i++)
@@ -358,37 +511,30 @@ namespace alpr
       if (letters[i].size() == 0)
         continue;
 
-      Letter letter = letters[i][letterIndices[i]];
+      const Letter& letter = letters[i][letterIndices[i]];
 
       // Add a "\n" on new lines
       if (letter.line_index != last_line)
       {
-        possibility.letters = possibility.letters + "\n";
+        possibility.letters += "\n";
       }
       last_line = letter.line_index;
       
-      if (letter.letter != SKIP_CHAR)
+      if (!letterText[i][letterIndices[i]].skip)
       {
-        possibility.letters = possibility.letters + letter.letter;
+        possibility.letters += letter.letter;
         possibility.letter_details.push_back(letter);
-        plate_char_length += 1;
       }
       possibility.totalscore = possibility.totalscore + letter.totalscore;
     }
 
-    // ignore plates that don't fit the length requirements
-    if (plate_char_length < config->postProcessMinCharacters ||
-      plate_char_length > config->postProcessMaxCharacters)
-      return false;
-
-    // Apply templates
-    if (templateregion != "")
+    // Regions the automaton could not compile still go through their regexes
+    if (automaton == NULL && templateregion != "")
     {
-      vector<RegexRule*> regionRules = rules[templateregion];
-
-      for (int i = 0; i < regionRules.size(); i++)
+      map<string, vector<RegexRule*> >::iterator regionRules = rules.find(templateregion);
+      for (int i = 0; regionRules != rules.end() && i < regionRules->second.size(); i++)
       {
-        possibility.matchesTemplate = regionRules[i]->match(possibility.letters);
+        possibility.matchesTemplate = regionRules->second[i]->match(possibility.letters);
         if (possibility.matchesTemplate)
         {
           break;
@@ -21,6 +21,7 @@
 #define OPENALPR_POSTPROCESS_H
 
 #include "regexrule.h"
+#include "pattern_automaton.h"
 #include "constants.h"
 #include "utility.h"
 #include <set>
@@ -57,7 +58,7 @@ namespace alpr
   class PostProcess
   {
     public:
-      PostProcess(Config* config);
+      PostProcess(Config* config, const CountryConfig* countryConfig = NULL);
       ~PostProcess();
 
       void addLetter(std::string letter, int line_index, int charposition, float score);
@@ -71,6 +72,9 @@ namespace alpr
       const std::vector<PPResult> getResults();
 
       bool regionIsValid(std::string templateregion);
+
+      // True if text matches any pattern loaded for the country
+      bool matchesAnyPattern(const std::string& text);
       
       std::vector<std::string> getPatterns();
       
@@ -78,13 +82,44 @@ namespace alpr
       
     private:
       Config* config;
-
-      void findAllPermutations(std::string templateregion, int topn);
-      bool analyzePermutation(std::vector<int> letterIndices, std::string templateregion, int topn);
+      const CountryConfig* countryConfig;
+
+      // A permutation waiting in the search queue.  Its letter index for each char
+      // position is kept in permutationArena, starting at offset.
+      struct Permutation
+      {
+        float score;
+        int offset;
+        // Children only move this position or later ones on, so no set of indices is
+        // reached twice
+        int lastChanged;
+        // First char position at which the template automaton had no patterns left,
+        // or -1.  Children that leave that prefix alone cannot match either.
+        int deadAt;
+        unsigned int order;
+      };
+
+      // What each letter adds to a permutation's text, worked out once per analyze()
+      struct LetterText
+      {
+        bool skip;
+        // Range of unitMasks holding the automaton's accept masks for the letter's code points
+        int firstUnit;
+        int lastUnit;
+      };
+
+      static bool permutationLess(const Permutation& a, const Permutation& b);
+
+      void prepareLetterText(PatternAutomaton* automaton);
+      void findAllPermutations(std::string templateregion, int topn, PatternAutomaton* automaton);
+      bool analyzePermutation(const int* letterIndices, const std::string& templateregion, PatternAutomaton* automaton, int& deadAt);
+      bool walkTemplate(const int* letterIndices, PatternAutomaton* automaton, int& deadAt);
 
       void insertLetter(std::string letter, int line_index, int charPosition, float score);
 
       std::map<std::string, std::vector<RegexRule*> > rules;
+      // The same rules compiled per region, where they allow it
+      std::map<std::string, PatternAutomaton*> automata;
 
       float calculateMaxConfidenceScore();
 
@@ -93,6 +128,14 @@ namespace alpr
 
       std::vector<PPResult> allPossibilities;
       std::set<std::string> allPossibilitiesLetters;
+
+      std::vector<std::vector<LetterText> > letterText;
+      std::vector<const uint64_t*> unitMasks;
+      const uint64_t* newlineMasks;
+
+      // Reused between plates so the search does not allocate once it has warmed up
+      std::vector<int> permutationArena;
+      std::vector<Permutation> permutationQueue;
       
       float min_confidence;
       float skip_level;
@@ -19,6 +19,7 @@
 
 #include <iostream>
 #include <sstream>
+#include <cstring>
 
 #include "regexrule.h"
 
@@ -46,6 +47,10 @@ namespace alpr
     std::stringstream regexval;
     string::iterator utf_iterator = pattern.begin();
     numchars = 0;
+    // The regex text for the character position being read, and whether every
+    // position so far stands for exactly one character
+    string position = "";
+    bool splittable = true;
     while (utf_iterator < pattern.end())
     {
       int cp = utf8::next(utf_iterator, pattern.end());
@@ -56,15 +61,20 @@ namespace alpr
       if (utf_character == "[")
       {
         regexval << "[";
+        position += "[";
         
         while (utf_character != "]" )
         {
           if (utf_iterator >= pattern.end())
+          {
+            splittable = false;
             break; // Invalid regex, don't bother processing
+          }
           int cp = utf8::next(utf_iterator, pattern.end());
 
           utf_character = utf8chr(cp);
           regexval << utf_character;
+          position += utf_character;
         }
         
       }
@@ -72,29 +82,40 @@ namespace alpr
       {
         // Don't add "\" characters to our character count
         regexval << utf_character;
+        position += utf_character;
         continue;
       }
       else if (utf_character == "?")
       {
         regexval << ".";
+        position += ".";
       }
       else if (utf_character == "@")
       {
         regexval << letters_regex;
+        position += letters_regex;
       }
       else if (utf_character == "#")
       {
         regexval << numbers_regex;
+        position += numbers_regex;
       }
       else if ((utf_character == "*") || (utf_character == "+"))
       {
         cerr << "Regex with wildcards (* or +) not supported" << endl;
+        splittable = false;
       }
       else
       {
+        // Unescaped regex operators would not stay inside their own position
+        if (position.empty() && utf_character.size() == 1 && strchr("|(){}^$", utf_character[0]) != NULL)
+          splittable = false;
         regexval << utf_character;
+        position += utf_character;
       }
 
+      positionRegexes.push_back(position);
+      position = "";
       numchars++;
     }
 
@@ -111,6 +132,9 @@ namespace alpr
     {
       this->valid = true;
     }
+
+    if (!this->valid || !splittable || !position.empty())
+      positionRegexes.clear();
   }
   
   
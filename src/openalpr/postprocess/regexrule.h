@@ -21,6 +21,7 @@
 #define	OPENALPR_REGEXRULE_H
 
 #include <string>
+#include <vector>
 
 #include "support/re2.h"
 #include "support/utf8.h"
@@ -36,8 +37,14 @@ namespace alpr
 
       bool match(std::string text);
 
+      // The regex for each character position of the pattern, in order.  Empty if the
+      // pattern cannot be split that way (wildcards, a bad class or other regex syntax);
+      // such patterns can only be checked with match().
+      const std::vector<std::string>& getPositionRegexes() const { return positionRegexes; }
+
     private:
       bool valid;
+      std::vector<std::string> positionRegexes;
       
       int numchars;
       re2::RE2* re2_regex;
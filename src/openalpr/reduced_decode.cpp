@@ -0,0 +1,429 @@
+/*
+ * Copyright (c) 2015 OpenALPR Technology, Inc.
+ * Open source Automated License Plate Recognition [http://www.openalpr.com]
+ *
+ * This file is part of OpenALPR.
+ *
+ * OpenALPR is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License
+ * version 3 as published by the Free Software Foundation
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "reduced_decode.h"
+
+#include <algorithm>
+#include <string.h>
+
+#ifdef OPENALPR_JPEG_ROW_DECODE
+#include <stdio.h>
+#include <setjmp.h>
+#include <jpeglib.h>
+#endif
+
+#if OPENCV_MAJOR_VERSION >= 3
+#include "opencv2/imgcodecs/imgcodecs.hpp"
+#else
+#include "opencv2/highgui/highgui.hpp"
+#endif
+#include "opencv2/imgproc/imgproc.hpp"
+
+namespace alpr
+{
+
+  // Steps over the marker at pos.  payload and payloadLength are the segment after it,
+  // or empty for markers that stand alone.  Returns false at the end of the data.
+  static bool nextJpegMarker(const unsigned char* data, size_t length, size_t& pos, unsigned char& marker, size_t& payload, size_t& payloadLength)
+  {
+    // Fill bytes
+    while (pos + 2 <= length && data[pos] == 0xFF && data[pos + 1] == 0xFF)
+      pos++;
+
+    if (pos + 2 > length || data[pos] != 0xFF)
+      return false;
+
+    marker = data[pos + 1];
+    pos += 2;
+    payload = pos;
+    payloadLength = 0;
+
+    // Markers that stand alone, and the start of the scan data or the image end
+    if (marker == 0x01 || (marker >= 0xD0 && marker <= 0xD7) || marker == 0xDA || marker == 0xD9)
+      return true;
+
+    if (pos + 2 > length)
+      return false;
+
+    size_t segmentLength = (data[pos] << 8) | data[pos + 1];
+    if (segmentLength < 2)
+      return false;
+
+    payload = pos + 2;
+    payloadLength = segmentLength - 2;
+    pos += segmentLength;
+    return true;
+  }
+
+  bool readJpegSize(const unsigned char* data, size_t length, int& width, int& height)
+  {
+    if (length < 4 || data[0] != 0xFF || data[1] != 0xD8)
+      return false;
+
+    size_t pos = 2;
+    unsigned char marker;
+    size_t payload, payloadLength;
+    while (nextJpegMarker(data, length, pos, marker, payload, payloadLength))
+    {
+      // Scan data before any frame header
+      if (marker == 0xDA || marker == 0xD9)
+        return false;
+
+      // SOF0-SOF15, except DHT (C4), JPG (C8) and DAC (CC) which share the range
+      if (marker >= 0xC0 && marker <= 0xCF && marker != 0xC4 && marker != 0xC8 && marker != 0xCC)
+      {
+        if (payload + 5 > length)
+          return false;
+
+        height = (data[payload + 1] << 8) | data[payload + 2];
+        width = (data[payload + 3] << 8) | data[payload + 4];
+        return width > 0 && height > 0;
+      }
+    }
+
+    return false;
+  }
+
+  static unsigned int readExifShort(const unsigned char* p, bool littleEndian)
+  {
+    return littleEndian ? (p[0] | (p[1] << 8)) : ((p[0] << 8) | p[1]);
+  }
+
+  static size_t readExifLong(const unsigned char* p, bool littleEndian)
+  {
+    return littleEndian ? (readExifShort(p, true) | ((size_t) readExifShort(p + 2, true) << 16))
+                        : (((size_t) readExifShort(p, false) << 16) | readExifShort(p + 2, false));
+  }
+
+  int readJpegOrientation(const unsigned char* data, size_t length)
+  {
+    const unsigned int ORIENTATION_TAG = 0x0112;
+
+    if (length < 4 || data[0] != 0xFF || data[1] != 0xD8)
+      return 1;
+
+    size_t pos = 2;
+    unsigned char marker;
+    size_t payload, payloadLength;
+    while (nextJpegMarker(data, length, pos, marker, payload, payloadLength))
+    {
+      if (marker == 0xDA || marker == 0xD9)
+        break;
+
+      // APP1 holding "Exif\0\0" and a TIFF header
+      size_t end = std::min(payload + payloadLength, length);
+      if (marker != 0xE1 || end < payload + 14 || memcmp(data + payload, "Exif\0\0", 6) != 0)
+        continue;
+
+      const unsigned char* tiff = data + payload + 6;
+      size_t tiffLength = end - (payload + 6);
+      bool littleEndian = tiff[0] == 'I' && tiff[1] == 'I';
+      if (!littleEndian && !(tiff[0] == 'M' && tiff[1] == 'M'))
+        return 1;
+
+      // The orientation is in the first IFD
+      size_t ifd = readExifLong(tiff + 4, littleEndian);
+      if (ifd + 2 > tiffLength)
+        return 1;
+
+      unsigned int entries = readExifShort(tiff + ifd, littleEndian);
+      for (unsigned int i = 0; i < entries; i++)
+      {
+        size_t entry = ifd + 2 + i * 12;
+        if (entry + 12 > tiffLength)
+          break;
+
+        if (readExifShort(tiff + entry, littleEndian) == ORIENTATION_TAG)
+        {
+          int orientation = readExifShort(tiff + entry + 8, littleEndian);
+          return orientation >= 1 && orientation <= 8 ? orientation : 1;
+        }
+      }
+      return 1;
+    }
+
+    return 1;
+  }
+
+  int chooseDecodeReduction(int width, int height, int minWidth, int minHeight)
+  {
+    int scale = 1;
+    while (scale < 8 && width / (scale * 2) >= minWidth && height / (scale * 2) >= minHeight)
+      scale *= 2;
+
+    return scale;
+  }
+
+  static void addRowBands(const std::vector<PlateRegion>& regions, int height, std::vector<cv::Range>& bands)
+  {
+    for (unsigned int i = 0; i < regions.size(); i++)
+    {
+      const cv::Rect& rect = regions[i].rect;
+      int start = std::max(0, rect.y - rect.height);
+      int end = std::min(height, rect.y + 2 * rect.height);
+      if (start < end)
+        bands.push_back(cv::Range(start, end));
+
+      addRowBands(regions[i].children, height, bands);
+    }
+  }
+
+  static bool rangeStartsBefore(const cv::Range& a, const cv::Range& b)
+  {
+    return a.start < b.start;
+  }
+
+  std::vector<cv::Range> plateRowBands(const std::vector<PlateRegion>& regions, int height)
+  {
+    std::vector<cv::Range> bands;
+    addRowBands(regions, height, bands);
+    std::sort(bands.begin(), bands.end(), rangeStartsBefore);
+
+    std::vector<cv::Range> merged;
+    for (unsigned int i = 0; i < bands.size(); i++)
+    {
+      if (!merged.empty() && bands[i].start <= merged.back().end)
+        merged.back().end = std::max(merged.back().end, bands[i].end);
+      else
+        merged.push_back(bands[i]);
+    }
+
+    return merged;
+  }
+
+#ifdef OPENALPR_JPEG_ROW_DECODE
+  struct JpegErrorManager
+  {
+    jpeg_error_mgr pub;
+    jmp_buf jump;
+  };
+
+  // libjpeg's default exits the process
+  static void jpegErrorExit(j_common_ptr cinfo)
+  {
+    longjmp(((JpegErrorManager*) cinfo->err)->jump, 1);
+  }
+
+  // Warnings about corrupt data would otherwise print a line per frame
+  static void jpegOutputMessage(j_common_ptr)
+  {
+  }
+
+  // Decodes the given rows (sorted and not overlapping) into bgr, which is the size of
+  // the whole frame.  Rows above a band are skipped without being color converted or
+  // upsampled, and nothing below the last band is read.
+  static bool decodeJpegRows(const unsigned char* data, size_t length, const std::vector<cv::Range>& rows, cv::Mat& bgr)
+  {
+    jpeg_decompress_struct cinfo;
+    JpegErrorManager jerr;
+    memset(&cinfo, 0, sizeof(cinfo));
+    cinfo.err = jpeg_std_error(&jerr.pub);
+    jerr.pub.error_exit = jpegErrorExit;
+    jerr.pub.output_message = jpegOutputMessage;
+
+    if (setjmp(jerr.jump))
+    {
+      jpeg_destroy_decompress(&cinfo);
+      return false;
+    }
+
+    jpeg_create_decompress(&cinfo);
+    jpeg_mem_src(&cinfo, (unsigned char*) data, (unsigned long) length);
+    jpeg_read_header(&cinfo, TRUE);
+    cinfo.out_color_space = JCS_EXT_BGR;
+    jpeg_start_decompress(&cinfo);
+
+    if ((int) cinfo.output_width != bgr.cols || (int) cinfo.output_height != bgr.rows || cinfo.output_components != 3)
+    {
+      jpeg_destroy_decompress(&cinfo);
+      return false;
+    }
+
+    for (unsigned int i = 0; i < rows.size(); i++)
+    {
+      if ((int) cinfo.output_scanline < rows[i].start)
+        jpeg_skip_scanlines(&cinfo, rows[i].start - cinfo.output_scanline);
+
+      while ((int) cinfo.output_scanline < rows[i].end)
+      {
+        JSAMPROW row = bgr.ptr<unsigned char>(cinfo.output_scanline);
+        if (jpeg_read_scanlines(&cinfo, &row, 1) != 1)
+        {
+          jpeg_destroy_decompress(&cinfo);
+          return false;
+        }
+      }
+    }
+
+    jpeg_destroy_decompress(&cinfo);
+    return true;
+  }
+#endif
+
+  bool canDecodeJpegRows()
+  {
+#ifdef OPENALPR_JPEG_ROW_DECODE
+    return true;
+#else
+    return false;
+#endif
+  }
+
+  // Runs of rows inside band that haven't been decoded yet
+  static void appendMissingRows(const std::vector<unsigned char>& rowDecoded, const cv::Range& band, std::vector<cv::Range>& missing)
+  {
+    int y = band.start;
+    while (y < band.end)
+    {
+      while (y < band.end && rowDecoded[y])
+        y++;
+
+      int start = y;
+      while (y < band.end && !rowDecoded[y])
+        y++;
+
+      if (start < y)
+        missing.push_back(cv::Range(start, y));
+    }
+  }
+
+  FullResolutionFrame::FullResolutionFrame(const unsigned char* encoded, size_t length, int scale, int width, int height)
+  {
+    this->encoded = encoded;
+    this->length = length;
+    this->scale = scale;
+    this->width = width;
+    this->height = height;
+    this->failed = false;
+    this->rowDecoded.assign(height, 0);
+    this->decodedRows = 0;
+
+    // Rows can only be found by position when the decoder won't rotate or flip the frame
+    this->bandsAllowed = canDecodeJpegRows() && readJpegOrientation(encoded, length) == 1;
+  }
+
+  bool FullResolutionFrame::get(const std::vector<PlateRegion>& regions, cv::Mat& color, cv::Mat& gray)
+  {
+    tthread::lock_guard<tthread::mutex> guard(mtx);
+    if (!failed)
+    {
+      std::vector<cv::Range> bands = plateRowBands(regions, height);
+      std::vector<cv::Range> missing;
+      for (unsigned int i = 0; i < bands.size(); i++)
+        appendMissingRows(rowDecoded, bands[i], missing);
+
+      if (!missing.empty())
+        failed = !decodeRows(missing);
+    }
+
+    color = this->color;
+    gray = this->gray;
+    return !failed;
+  }
+
+  bool FullResolutionFrame::decodeRows(std::vector<cv::Range> missing)
+  {
+    bool decoded = false;
+#ifdef OPENALPR_JPEG_ROW_DECODE
+    // Past about half the frame, skipping the rows in between saves less than a
+    // second pass over the scan data costs
+    const float MAX_BAND_ROWS = 0.5;
+
+    int rows = decodedRows;
+    for (unsigned int i = 0; i < missing.size(); i++)
+      rows += missing[i].size();
+
+    if (bandsAllowed && rows < height * MAX_BAND_ROWS)
+    {
+      if (this->color.empty())
+      {
+        this->color = cv::Mat::zeros(height, width, CV_8UC3);
+        this->gray = cv::Mat::zeros(height, width, CV_8U);
+      }
+
+      decoded = decodeJpegRows(encoded, length, missing, this->color);
+      if (!decoded)
+        bandsAllowed = false;
+    }
+#endif
+
+    if (!decoded)
+    {
+      cv::Mat encodedMat(1, (int) length, CV_8U, (void*) encoded);
+      cv::Mat full = cv::imdecode(encodedMat, cv::IMREAD_COLOR);
+      if (full.cols != width || full.rows != height)
+        return false;
+
+      // Other threads may be reading the rows already decoded, so only the rest are copied
+      missing.clear();
+      appendMissingRows(rowDecoded, cv::Range(0, height), missing);
+      if (this->color.empty())
+      {
+        this->color = full;
+        this->gray = cv::Mat(height, width, CV_8U);
+      }
+      else
+      {
+        for (unsigned int i = 0; i < missing.size(); i++)
+          full.rowRange(missing[i]).copyTo(this->color.rowRange(missing[i]));
+      }
+    }
+
+    for (unsigned int i = 0; i < missing.size(); i++)
+    {
+      cv::Mat grayRows = this->gray.rowRange(missing[i]);
+      cv::cvtColor(this->color.rowRange(missing[i]), grayRows, cv::COLOR_BGR2GRAY);
+      std::fill(rowDecoded.begin() + missing[i].start, rowDecoded.begin() + missing[i].end, 1);
+      decodedRows += missing[i].size();
+    }
+
+    return true;
+  }
+
+  cv::Rect scaleRectUp(const cv::Rect& rect, int scale, int maxWidth, int maxHeight)
+  {
+    int x = std::min(rect.x * scale, maxWidth);
+    int y = std::min(rect.y * scale, maxHeight);
+    int right = std::min((rect.x + rect.width) * scale, maxWidth);
+    int bottom = std::min((rect.y + rect.height) * scale, maxHeight);
+
+    return cv::Rect(x, y, right - x, bottom - y);
+  }
+
+  cv::Rect scaleRectDown(const cv::Rect& rect, int scale)
+  {
+    // Round outward so the reduced rectangle still covers the whole region
+    int x = rect.x / scale;
+    int y = rect.y / scale;
+    int right = (rect.x + rect.width + scale - 1) / scale;
+    int bottom = (rect.y + rect.height + scale - 1) / scale;
+
+    return cv::Rect(x, y, right - x, bottom - y);
+  }
+
+  void scalePlateRegionsUp(std::vector<PlateRegion>& regions, int scale, int maxWidth, int maxHeight)
+  {
+    for (unsigned int i = 0; i < regions.size(); i++)
+    {
+      regions[i].rect = scaleRectUp(regions[i].rect, scale, maxWidth, maxHeight);
+      scalePlateRegionsUp(regions[i].children, scale, maxWidth, maxHeight);
+    }
+  }
+
+}
@@ -0,0 +1,93 @@
+/*
+ * Copyright (c) 2015 OpenALPR Technology, Inc.
+ * Open source Automated License Plate Recognition [http://www.openalpr.com]
+ *
+ * This file is part of OpenALPR.
+ *
+ * OpenALPR is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License
+ * version 3 as published by the Free Software Foundation
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef OPENALPR_REDUCEDDECODE_H
+#define OPENALPR_REDUCEDDECODE_H
+
+#include <vector>
+#include "opencv2/core/core.hpp"
+
+#include "detection/detector_types.h"
+#include "support/tinythread.h"
+
+namespace alpr
+{
+
+  // Reads the dimensions from a JPEG's frame header without decoding it.  Returns
+  // false if the data is not a JPEG or the header is cut off.
+  bool readJpegSize(const unsigned char* data, size_t length, int& width, int& height);
+
+  // The largest of 2, 4 and 8 that keeps a width x height image at least
+  // minWidth x minHeight, or 1 if even halving would make it smaller.
+  int chooseDecodeReduction(int width, int height, int minWidth, int minHeight);
+
+  // The EXIF orientation (1-8) of a JPEG, or 1 if it doesn't have one
+  int readJpegOrientation(const unsigned char* data, size_t length);
+
+  // The rows plate regions are read from: each region padded by its own height above
+  // and below (the edge finder looks up to half a region past it), merged and sorted.
+  std::vector<cv::Range> plateRowBands(const std::vector<PlateRegion>& regions, int height);
+
+  // True if this build can decode bands of JPEG rows instead of the whole frame
+  bool canDecodeJpegRows();
+
+  // A JPEG that was decoded at 1/scale of its size for detection.  Full-size pixels
+  // are decoded only around the plate regions that need them, and each row only once.
+  // The encoded bytes must outlive this object.
+  class FullResolutionFrame
+  {
+    public:
+      FullResolutionFrame(const unsigned char* encoded, size_t length, int scale, int width, int height);
+
+      int scale;
+      int width;
+      int height;
+
+      // Full-size pixels covering the rows of plateRowBands(regions); rows outside them
+      // are black until a later call needs them.  Falls back to decoding the whole frame
+      // when the bands cover over half of it or the JPEG can't be decoded in bands.  Safe to
+      // call from several threads; all of them share the same pixels.  Returns false if
+      // the frame can't be decoded.
+      bool get(const std::vector<PlateRegion>& regions, cv::Mat& color, cv::Mat& gray);
+
+    private:
+      const unsigned char* encoded;
+      size_t length;
+      bool bandsAllowed;
+
+      tthread::mutex mtx;
+      bool failed;
+      std::vector<unsigned char> rowDecoded;
+      int decodedRows;
+      cv::Mat color;
+      cv::Mat gray;
+
+      bool decodeRows(std::vector<cv::Range> missing);
+  };
+
+  // Converts rectangles between the reduced and the full-size frame
+  cv::Rect scaleRectUp(const cv::Rect& rect, int scale, int maxWidth, int maxHeight);
+  cv::Rect scaleRectDown(const cv::Rect& rect, int scale);
+
+  // Scales plate regions found in the reduced frame (and their children) up to the full-size frame
+  void scalePlateRegionsUp(std::vector<PlateRegion>& regions, int scale, int maxWidth, int maxHeight);
+
+}
+
+#endif // OPENALPR_REDUCEDDECODE_H
@@ -18,6 +18,7 @@
 */
 
 #include "result_aggregator.h"
+#include "stage_stats.h"
 
 #include <iomanip>
 
@@ -86,6 +87,7 @@ namespace alpr
   
   AlprFullDetails ResultAggregator::getAggregateResults()
   {
+    ALPR_STAGE_TIMER(STAGE_AGGREGATION);
     assert(all_results.size() > 0);
 
     if (all_results.size() == 1)
@@ -116,14 +118,18 @@ namespace alpr
     response.results.min_votes = all_results[0].results.min_votes;
     response.results.fallback_ocr_enabled = all_results[0].results.fallback_ocr_enabled;
     response.results.ocr_passes_total = 0;
+    response.results.ocr_passes_skipped = 0;
     response.results.votes_emitted = 0;
     response.results.final_plate_count = 0;
     response.results.fallback_attempts = 0;
+    response.results.ocr_quality_skipped = 0;
     for (const auto& r : all_results) {
       response.results.ocr_passes_total += r.results.ocr_passes_total;
+      response.results.ocr_passes_skipped += r.results.ocr_passes_skipped;
       response.results.votes_emitted += r.results.votes_emitted;
       response.results.final_plate_count += r.results.final_plate_count;
       response.results.fallback_attempts += r.results.fallback_attempts;
+      response.results.ocr_quality_skipped += r.results.ocr_quality_skipped;
     }
 
 
@@ -0,0 +1,301 @@
+/*
+ * Copyright (c) 2015 OpenALPR Technology, Inc.
+ * Open source Automated License Plate Recognition [http://www.openalpr.com]
+ *
+ * This file is part of OpenALPR.
+ *
+ * OpenALPR is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License
+ * version 3 as published by the Free Software Foundation
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "stage_stats.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <sstream>
+
+#include "support/tinythread.h"
+
+namespace alpr
+{
+
+  const int LatencyHistogram::SUB_BUCKETS;
+  const int LatencyHistogram::SUB_BUCKET_BITS;
+  const int LatencyHistogram::MAX_MAGNITUDE;
+  const int LatencyHistogram::BUCKET_COUNT;
+
+  namespace
+  {
+    const char* STAGE_NAMES[STAGE_COUNT] = {
+      "detect",
+      "char_analysis",
+      "edge_finding",
+      "deskew",
+      "segmentation",
+      "ocr",
+      "postprocess",
+      "aggregation",
+      "total"
+    };
+
+    // Bucket bounds reported in AlprStageStats and the Prometheus output
+    const double REPORTED_BOUNDS_MS[] = { 0.1, 0.25, 0.5, 1, 2.5, 5, 10, 25, 50, 100, 250, 500, 1000, 2500, 5000, 10000 };
+    const int REPORTED_BOUND_COUNT = sizeof(REPORTED_BOUNDS_MS) / sizeof(REPORTED_BOUNDS_MS[0]);
+
+    // Written only by the owning thread (relaxed load + store, no read-modify-write);
+    // read by collectStageStats from any thread.
+    struct ThreadHistograms
+    {
+      std::atomic<uint64_t> counts[STAGE_COUNT][LatencyHistogram::BUCKET_COUNT];
+      std::atomic<uint64_t> totalMicros[STAGE_COUNT];
+      std::atomic<uint64_t> maxMicros[STAGE_COUNT];
+
+      ThreadHistograms()
+      {
+        for (int s = 0; s < STAGE_COUNT; s++)
+        {
+          for (int b = 0; b < LatencyHistogram::BUCKET_COUNT; b++)
+            counts[s][b].store(0, std::memory_order_relaxed);
+          totalMicros[s].store(0, std::memory_order_relaxed);
+          maxMicros[s].store(0, std::memory_order_relaxed);
+        }
+      }
+    };
+
+    // Plain totals used while merging
+    struct MergedHistograms
+    {
+      uint64_t counts[STAGE_COUNT][LatencyHistogram::BUCKET_COUNT];
+      uint64_t totalMicros[STAGE_COUNT];
+      uint64_t maxMicros[STAGE_COUNT];
+
+      MergedHistograms()
+      {
+        for (int s = 0; s < STAGE_COUNT; s++)
+        {
+          for (int b = 0; b < LatencyHistogram::BUCKET_COUNT; b++)
+            counts[s][b] = 0;
+          totalMicros[s] = 0;
+          maxMicros[s] = 0;
+        }
+      }
+
+      void add(const ThreadHistograms& h)
+      {
+        for (int s = 0; s < STAGE_COUNT; s++)
+        {
+          for (int b = 0; b < LatencyHistogram::BUCKET_COUNT; b++)
+            counts[s][b] += h.counts[s][b].load(std::memory_order_relaxed);
+          totalMicros[s] += h.totalMicros[s].load(std::memory_order_relaxed);
+          uint64_t threadMax = h.maxMicros[s].load(std::memory_order_relaxed);
+          if (threadMax > maxMicros[s])
+            maxMicros[s] = threadMax;
+        }
+      }
+    };
+
+    // Threads currently recording, plus the totals of threads that have exited
+    struct Registry
+    {
+      tthread::mutex mutex;
+      std::vector<ThreadHistograms*> live;
+      MergedHistograms retired;
+    };
+
+    Registry& registry()
+    {
+      static Registry instance;
+      return instance;
+    }
+
+    struct ThreadSlot
+    {
+      ThreadHistograms* histograms;
+
+      ThreadSlot()
+      {
+        histograms = new ThreadHistograms();
+        Registry& reg = registry();
+        tthread::lock_guard<tthread::mutex> guard(reg.mutex);
+        reg.live.push_back(histograms);
+      }
+
+      ~ThreadSlot()
+      {
+        Registry& reg = registry();
+        tthread::lock_guard<tthread::mutex> guard(reg.mutex);
+        reg.retired.add(*histograms);
+        for (unsigned int i = 0; i < reg.live.size(); i++)
+        {
+          if (reg.live[i] == histograms)
+          {
+            reg.live.erase(reg.live.begin() + i);
+            break;
+          }
+        }
+        delete histograms;
+      }
+    };
+
+    ThreadHistograms& threadHistograms()
+    {
+      static thread_local ThreadSlot slot;
+      return *slot.histograms;
+    }
+
+    void bump(std::atomic<uint64_t>& counter, uint64_t amount)
+    {
+      counter.store(counter.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+    }
+
+    std::string formatDouble(double value)
+    {
+      char buffer[32];
+      snprintf(buffer, sizeof(buffer), "%.6g", value);
+      return buffer;
+    }
+  }
+
+  const char* stageName(PipelineStage stage)
+  {
+    if (stage < 0 || stage >= STAGE_COUNT)
+      return "unknown";
+    return STAGE_NAMES[stage];
+  }
+
+  int LatencyHistogram::bucketFor(uint64_t micros)
+  {
+    if (micros < (uint64_t) SUB_BUCKETS)
+      return (int) micros;
+
+    if ((micros >> MAX_MAGNITUDE) != 0)
+      return BUCKET_COUNT - 1;
+
+    int magnitude = SUB_BUCKET_BITS;
+    while ((micros >> (magnitude + 1)) != 0)
+      magnitude++;
+
+    int shift = magnitude - SUB_BUCKET_BITS;
+    int subBucket = (int) ((micros >> shift) & (SUB_BUCKETS - 1));
+    return SUB_BUCKETS + shift * SUB_BUCKETS + subBucket;
+  }
+
+  uint64_t LatencyHistogram::bucketUpperBound(int bucket)
+  {
+    if (bucket < SUB_BUCKETS)
+      return (uint64_t) bucket;
+
+    int shift = (bucket - SUB_BUCKETS) / SUB_BUCKETS;
+    int subBucket = (bucket - SUB_BUCKETS) % SUB_BUCKETS;
+    uint64_t lower = ((uint64_t) (SUB_BUCKETS + subBucket)) << shift;
+    return lower + (((uint64_t) 1) << shift) - 1;
+  }
+
+  void recordStageLatency(PipelineStage stage, uint64_t micros)
+  {
+    ThreadHistograms& h = threadHistograms();
+    bump(h.counts[stage][LatencyHistogram::bucketFor(micros)], 1);
+    bump(h.totalMicros[stage], micros);
+    if (micros > h.maxMicros[stage].load(std::memory_order_relaxed))
+      h.maxMicros[stage].store(micros, std::memory_order_relaxed);
+  }
+
+  std::vector<AlprStageStats> collectStageStats()
+  {
+    MergedHistograms merged;
+    {
+      Registry& reg = registry();
+      tthread::lock_guard<tthread::mutex> guard(reg.mutex);
+      merged = reg.retired;
+      for (unsigned int i = 0; i < reg.live.size(); i++)
+        merged.add(*reg.live[i]);
+    }
+
+    std::vector<AlprStageStats> stats;
+    for (int s = 0; s < STAGE_COUNT; s++)
+    {
+      AlprStageStats stage;
+      stage.stage = STAGE_NAMES[s];
+      stage.count = 0;
+      for (int b = 0; b < LatencyHistogram::BUCKET_COUNT; b++)
+        stage.count += merged.counts[s][b];
+
+      stage.total_ms = merged.totalMicros[s] / 1000.0;
+      stage.max_ms = merged.maxMicros[s] / 1000.0;
+
+      // Quantiles report the upper edge of the bucket holding the ranked sample,
+      // capped at the largest value actually seen
+      double quantiles[3] = { 0.5, 0.9, 0.99 };
+      double* outputs[3] = { &stage.p50_ms, &stage.p90_ms, &stage.p99_ms };
+      for (int q = 0; q < 3; q++)
+      {
+        *outputs[q] = 0;
+        uint64_t rank = (uint64_t) (quantiles[q] * stage.count + 0.999999);
+        uint64_t seen = 0;
+        for (int b = 0; b < LatencyHistogram::BUCKET_COUNT && stage.count > 0; b++)
+        {
+          seen += merged.counts[s][b];
+          if (seen >= rank)
+          {
+            *outputs[q] = std::min(LatencyHistogram::bucketUpperBound(b), merged.maxMicros[s]) / 1000.0;
+            break;
+          }
+        }
+      }
+
+      int bucket = 0;
+      uint64_t cumulative = 0;
+      for (int r = 0; r < REPORTED_BOUND_COUNT; r++)
+      {
+        double boundMicros = REPORTED_BOUNDS_MS[r] * 1000.0;
+        while (bucket < LatencyHistogram::BUCKET_COUNT && LatencyHistogram::bucketUpperBound(bucket) <= boundMicros)
+          cumulative += merged.counts[s][bucket++];
+
+        stage.bucket_upper_ms.push_back(REPORTED_BOUNDS_MS[r]);
+        stage.bucket_counts.push_back(cumulative);
+      }
+
+      stats.push_back(stage);
+    }
+
+    return stats;
+  }
+
+  std::string formatStageStatsPrometheus(const std::vector<AlprStageStats>& stats, const std::string& labels)
+  {
+    std::string prefix = labels.empty() ? "" : labels + ",";
+    std::stringstream out;
+
+    out << "# HELP openalpr_stage_latency_seconds Time spent in each recognition stage.\n";
+    out << "# TYPE openalpr_stage_latency_seconds histogram\n";
+    for (unsigned int i = 0; i < stats.size(); i++)
+    {
+      const AlprStageStats& stage = stats[i];
+      std::string stageLabel = prefix + "stage=\"" + stage.stage + "\"";
+
+      for (unsigned int b = 0; b < stage.bucket_counts.size(); b++)
+        out << "openalpr_stage_latency_seconds_bucket{" << stageLabel << ",le=\"" << formatDouble(stage.bucket_upper_ms[b] / 1000.0) << "\"} " << stage.bucket_counts[b] << "\n";
+      out << "openalpr_stage_latency_seconds_bucket{" << stageLabel << ",le=\"+Inf\"} " << stage.count << "\n";
+      out << "openalpr_stage_latency_seconds_sum{" << stageLabel << "} " << formatDouble(stage.total_ms / 1000.0) << "\n";
+      out << "openalpr_stage_latency_seconds_count{" << stageLabel << "} " << stage.count << "\n";
+    }
+
+    out << "# HELP openalpr_stage_latency_max_seconds Slowest single run of each recognition stage.\n";
+    out << "# TYPE openalpr_stage_latency_max_seconds gauge\n";
+    for (unsigned int i = 0; i < stats.size(); i++)
+      out << "openalpr_stage_latency_max_seconds{" << prefix << "stage=\"" << stats[i].stage << "\"} " << formatDouble(stats[i].max_ms / 1000.0) << "\n";
+
+    return out.str();
+  }
+
+}
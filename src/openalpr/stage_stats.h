@@ -0,0 +1,110 @@
+/*
+ * Copyright (c) 2015 OpenALPR Technology, Inc.
+ * Open source Automated License Plate Recognition [http://www.openalpr.com]
+ *
+ * This file is part of OpenALPR.
+ *
+ * OpenALPR is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License
+ * version 3 as published by the Free Software Foundation
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef OPENALPR_STAGESTATS_H
+#define OPENALPR_STAGESTATS_H
+
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+#include "alpr.h"
+#include "support/timing.h"
+
+namespace alpr
+{
+
+  enum PipelineStage
+  {
+    STAGE_DETECT,
+    STAGE_CHAR_ANALYSIS,
+    STAGE_EDGE_FINDING,
+    STAGE_DESKEW,
+    STAGE_SEGMENTATION,
+    STAGE_OCR,
+    STAGE_POSTPROCESS,
+    STAGE_AGGREGATION,
+    STAGE_TOTAL,
+    STAGE_COUNT
+  };
+
+  const char* stageName(PipelineStage stage);
+
+  // Latency histogram with HDR-style buckets: exact below 16us, then 16 linear
+  // sub-buckets per power of two, so any recorded value is off by at most 1/16.
+  class LatencyHistogram
+  {
+    public:
+      static const int SUB_BUCKETS = 16;
+      static const int SUB_BUCKET_BITS = 4;
+      // Values are clamped at 2^32 us (about 71 minutes)
+      static const int MAX_MAGNITUDE = 32;
+      static const int BUCKET_COUNT = SUB_BUCKETS + (MAX_MAGNITUDE - SUB_BUCKET_BITS) * SUB_BUCKETS;
+
+      static int bucketFor(uint64_t micros);
+      // Largest value, in microseconds, that falls in the bucket
+      static uint64_t bucketUpperBound(int bucket);
+  };
+
+  // Adds one sample to the calling thread's histogram for the stage.  Each thread
+  // writes only its own counters, so recording never takes a lock or contends.
+  void recordStageLatency(PipelineStage stage, uint64_t micros);
+
+  // Merges every thread's histograms (including threads that have exited)
+  std::vector<AlprStageStats> collectStageStats();
+
+  // Prometheus text exposition of the stats.  labels, if not empty, is added to
+  // every sample (e.g., camera="1").
+  std::string formatStageStatsPrometheus(const std::vector<AlprStageStats>& stats, const std::string& labels);
+
+  // Times the enclosing scope
+  class StageTimer
+  {
+    public:
+      StageTimer(PipelineStage stage) : stage(stage)
+      {
+        getTimeMonotonic(&startTime);
+      }
+
+      ~StageTimer()
+      {
+        timespec endTime;
+        getTimeMonotonic(&endTime);
+        double ms = diffclock(startTime, endTime);
+        recordStageLatency(stage, ms > 0 ? (uint64_t) (ms * 1000.0) : 0);
+      }
+
+    private:
+      PipelineStage stage;
+      timespec startTime;
+  };
+
+}
+
+// Building with OPENALPR_NO_STAGE_STATS (cmake -DWITH_STAGE_STATS=OFF) removes the
+// timers from the pipeline entirely
+#ifdef OPENALPR_NO_STAGE_STATS
+  #define ALPR_STAGE_TIMER(stage)
+#else
+  #define ALPR_STAGE_TIMER_CONCAT2(a, b) a##b
+  #define ALPR_STAGE_TIMER_CONCAT(a, b) ALPR_STAGE_TIMER_CONCAT2(a, b)
+  #define ALPR_STAGE_TIMER(stage) alpr::StageTimer ALPR_STAGE_TIMER_CONCAT(stage_timer_, __LINE__)(stage)
+#endif
+
+#endif // OPENALPR_STAGESTATS_H
@@ -0,0 +1,132 @@
+/*
+ * Copyright (c) 2015 OpenALPR Technology, Inc.
+ * Open source Automated License Plate Recognition [http://www.openalpr.com]
+ *
+ * This file is part of OpenALPR.
+ *
+ * OpenALPR is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License
+ * version 3 as published by the Free Software Foundation
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef OPENALPR_CHECKOUTPOOL_H
+#define OPENALPR_CHECKOUTPOOL_H
+
+#include <functional>
+#include <vector>
+
+#include "tinythread.h"
+
+namespace alpr
+{
+
+  // Objects that keep per-call state, handed out to one caller at a time.  When every
+  // one is checked out, checkOut() builds another rather than waiting, so the pool
+  // grows to the number of concurrent callers.  Owns its objects.
+  template <typename T>
+  class CheckoutPool
+  {
+  public:
+    CheckoutPool() {}
+
+    virtual ~CheckoutPool()
+    {
+      for (unsigned int i = 0; i < all.size(); i++)
+        delete all[i];
+    }
+
+    // Adds an object that is free to check out
+    void add(T* item)
+    {
+      tthread::lock_guard<tthread::mutex> guard(mtx);
+      all.push_back(item);
+      idle.push_back(item);
+    }
+
+    // A free object, or one made by create() (outside the lock) if there is none
+    T* checkOut(const std::function<T*()>& create)
+    {
+      {
+        tthread::lock_guard<tthread::mutex> guard(mtx);
+        if (!idle.empty())
+        {
+          T* item = idle.back();
+          idle.pop_back();
+          return item;
+        }
+      }
+
+      T* item = create();
+      tthread::lock_guard<tthread::mutex> guard(mtx);
+      all.push_back(item);
+      return item;
+    }
+
+    void checkIn(T* item)
+    {
+      tthread::lock_guard<tthread::mutex> guard(mtx);
+      idle.push_back(item);
+    }
+
+    // Calls f on every object, checked out or not
+    void forEach(const std::function<void(T*)>& f)
+    {
+      tthread::lock_guard<tthread::mutex> guard(mtx);
+      for (unsigned int i = 0; i < all.size(); i++)
+        f(all[i]);
+    }
+
+    int size()
+    {
+      tthread::lock_guard<tthread::mutex> guard(mtx);
+      return all.size();
+    }
+
+  private:
+    CheckoutPool(const CheckoutPool&);
+    CheckoutPool& operator=(const CheckoutPool&);
+
+    tthread::mutex mtx;
+    std::vector<T*> all;
+    std::vector<T*> idle;
+  };
+
+  // Holds an object checked out of a CheckoutPool and checks it back in when it goes
+  // out of scope, even if the call using it throws
+  template <typename T>
+  class PoolLease
+  {
+  public:
+    PoolLease(CheckoutPool<T>* pool, const std::function<T*()>& create)
+    {
+      this->pool = pool;
+      this->item = pool->checkOut(create);
+    }
+
+    ~PoolLease()
+    {
+      pool->checkIn(item);
+    }
+
+    T* operator->() { return item; }
+    T* get() { return item; }
+
+  private:
+    PoolLease(const PoolLease&);
+    PoolLease& operator=(const PoolLease&);
+
+    CheckoutPool<T>* pool;
+    T* item;
+  };
+
+}
+
+#endif // OPENALPR_CHECKOUTPOOL_H
@@ -1,6 +1,7 @@
 #include "filesystem.h"
 
 #include <algorithm>
+#include <atomic>
 #include <errno.h>
 #include <fstream>
 #include <string.h>
@@ -10,6 +11,13 @@
 namespace alpr
 {
 
+  static std::atomic<uint64_t> filesystem_lookups(0);
+
+  uint64_t getFilesystemLookupCount()
+  {
+    return filesystem_lookups.load();
+  }
+
   bool startsWith(std::string const &fullString, std::string const &prefix)
   {
     if(fullString.substr(0, prefix.size()).compare(prefix) == 0) {
@@ -51,6 +59,7 @@ namespace alpr
   bool DirectoryExists( const char* pzPath )
   {
     if ( pzPath == NULL) return false;
+    filesystem_lookups++;
 
     DIR *pDir;
     bool bExists = false;
@@ -69,6 +78,7 @@ namespace alpr
   bool fileExists( const char* pzPath )
   {
     if (pzPath == NULL) return false;
+    filesystem_lookups++;
 
     bool fExists = false;
     std::ifstream f(pzPath);
@@ -80,6 +90,7 @@ namespace alpr
   std::vector<std::string> getFilesInDir(const char* dirPath)
   {
     DIR *dir;
+    filesystem_lookups++;
 
     std::vector<std::string> files;
 
@@ -182,6 +193,7 @@ namespace alpr
   FileInfo getFileInfo(std::string filename)
   {
     FileInfo response;
+    filesystem_lookups++;
 
     struct stat stat_buf;
     int rc = stat(filename.c_str(), &stat_buf);
@@ -39,6 +39,10 @@ namespace alpr
   bool fileExists( const char* pzPath );
   std::vector<std::string> getFilesInDir(const char* dirPath);
 
+  // Number of DirectoryExists/fileExists/getFilesInDir/getFileInfo calls made by this process.
+  // Used to verify that steady-state recognition does not touch the file system.
+  uint64_t getFilesystemLookupCount();
+
   bool stringCompare( const std::string &left, const std::string &right );
 
   bool makePath(const char* path, mode_t mode);
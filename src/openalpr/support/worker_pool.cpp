@@ -0,0 +1,148 @@
+/*
+ * Copyright (c) 2015 OpenALPR Technology, Inc.
+ * Open source Automated License Plate Recognition [http://www.openalpr.com]
+ *
+ * This file is part of OpenALPR.
+ *
+ * OpenALPR is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License
+ * version 3 as published by the Free Software Foundation
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "worker_pool.h"
+
+namespace alpr
+{
+
+  WorkerPool::WorkerPool(int num_workers)
+  {
+    this->num_workers = num_workers < 1 ? 1 : num_workers;
+    this->current_task = NULL;
+    this->task_count = 0;
+    this->next_task = 0;
+    this->pending_tasks = 0;
+    this->generation = 0;
+    this->stopping = false;
+
+    // Reserve up front so the WorkerStart pointers handed to threads stay valid
+    starts.resize(this->num_workers);
+    for (int i = 1; i < this->num_workers; i++)
+    {
+      starts[i].pool = this;
+      starts[i].worker_index = i;
+      threads.push_back(new tthread::thread(workerThread, (void*) &starts[i]));
+    }
+  }
+
+  WorkerPool::~WorkerPool()
+  {
+    mtx.lock();
+    stopping = true;
+    work_ready.notify_all();
+    mtx.unlock();
+
+    for (unsigned int i = 0; i < threads.size(); i++)
+    {
+      threads[i]->join();
+      delete threads[i];
+    }
+  }
+
+  void WorkerPool::run(int task_count, const WorkerTask& task)
+  {
+    if (task_count <= 0)
+      return;
+
+    if (threads.size() == 0 || task_count == 1)
+    {
+      for (int i = 0; i < task_count; i++)
+        task(i, 0);
+      return;
+    }
+
+    mtx.lock();
+    this->current_task = &task;
+    this->task_count = task_count;
+    this->next_task = 0;
+    this->pending_tasks = task_count;
+    this->first_error = std::exception_ptr();
+    this->generation++;
+    work_ready.notify_all();
+
+    drainTasks(0);
+
+    while (pending_tasks > 0)
+      work_done.wait(mtx);
+
+    this->current_task = NULL;
+    std::exception_ptr error = first_error;
+    first_error = std::exception_ptr();
+    mtx.unlock();
+
+    if (error)
+      std::rethrow_exception(error);
+  }
+
+  void WorkerPool::workerThread(void* arg)
+  {
+    WorkerStart* start = (WorkerStart*) arg;
+    start->pool->workerLoop(start->worker_index);
+  }
+
+  void WorkerPool::workerLoop(int worker_index)
+  {
+    unsigned int seen_generation = 0;
+
+    mtx.lock();
+    while (true)
+    {
+      while (!stopping && seen_generation == generation)
+        work_ready.wait(mtx);
+
+      if (stopping)
+        break;
+
+      seen_generation = generation;
+      drainTasks(worker_index);
+    }
+    mtx.unlock();
+  }
+
+  // Called with mtx held.  The lock is released while each task runs.
+  void WorkerPool::drainTasks(int worker_index)
+  {
+    while (current_task != NULL && next_task < task_count)
+    {
+      int task_index = next_task++;
+      const WorkerTask* task = current_task;
+      mtx.unlock();
+
+      std::exception_ptr error;
+      try
+      {
+        (*task)(task_index, worker_index);
+      }
+      catch (...)
+      {
+        error = std::current_exception();
+      }
+
+      mtx.lock();
+      if (error && !first_error)
+        first_error = error;
+
+      pending_tasks--;
+      if (pending_tasks == 0)
+        work_done.notify_all();
+    }
+  }
+
+}
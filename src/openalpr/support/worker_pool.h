@@ -0,0 +1,81 @@
+/*
+ * Copyright (c) 2015 OpenALPR Technology, Inc.
+ * Open source Automated License Plate Recognition [http://www.openalpr.com]
+ *
+ * This file is part of OpenALPR.
+ *
+ * OpenALPR is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License
+ * version 3 as published by the Free Software Foundation
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef OPENALPR_WORKERPOOL_H
+#define OPENALPR_WORKERPOOL_H
+
+#include <exception>
+#include <functional>
+#include <vector>
+
+#include "tinythread.h"
+
+namespace alpr
+{
+
+  // Task callback: (task index, worker index).  Worker indexes are stable in
+  // [0, size()) so callers can keep one scratch object per worker.
+  typedef std::function<void(int, int)> WorkerTask;
+
+  // Fixed-size pool of threads that runs a batch of indexed tasks and blocks
+  // until the whole batch is done.  The calling thread participates as worker 0,
+  // so a pool of size N spawns N-1 threads.  A pool of size 1 runs inline.
+  class WorkerPool
+  {
+  public:
+    WorkerPool(int num_workers);
+    virtual ~WorkerPool();
+
+    int size() const { return num_workers; }
+
+    // Runs task(i, worker) for every i in [0, task_count).  The first exception
+    // thrown by any task is rethrown here once the batch has finished.
+    void run(int task_count, const WorkerTask& task);
+
+  private:
+    struct WorkerStart
+    {
+      WorkerPool* pool;
+      int worker_index;
+    };
+
+    static void workerThread(void* arg);
+    void workerLoop(int worker_index);
+    void drainTasks(int worker_index);
+
+    int num_workers;
+    std::vector<tthread::thread*> threads;
+    std::vector<WorkerStart> starts;
+
+    tthread::mutex mtx;
+    tthread::condition_variable work_ready;
+    tthread::condition_variable work_done;
+
+    const WorkerTask* current_task;
+    int task_count;
+    int next_task;
+    int pending_tasks;
+    unsigned int generation;
+    bool stopping;
+    std::exception_ptr first_error;
+  };
+
+}
+
+#endif // OPENALPR_WORKERPOOL_H
@@ -21,6 +21,7 @@
 
 #include "characteranalysis.h"
 #include "linefinder.h"
+#include "stage_stats.h"
 
 using namespace cv;
 using namespace std;
@@ -48,10 +49,11 @@ namespace alpr
 
   void CharacterAnalysis::analyze()
   {
+    ALPR_STAGE_TIMER(STAGE_CHAR_ANALYSIS);
     timespec startTime;
     getTimeMonotonic(&startTime);
 
-    if (config->always_invert)
+    if (pipeline_data->country_config->always_invert)
       bitwise_not(pipeline_data->crop_gray, pipeline_data->crop_gray);
 
     pipeline_data->clearThresholds();
@@ -145,16 +147,16 @@ namespace alpr
       displayImage(config, "Matching Contours", img_contours);
     }
 
-    if (config->auto_invert)
+    if (pipeline_data->country_config->auto_invert)
       pipeline_data->plate_inverted = isPlateInverted();
     else
-      pipeline_data->plate_inverted = config->always_invert;
+      pipeline_data->plate_inverted = pipeline_data->country_config->always_invert;
 
     if (config->debugGeneral)
       cout << "Plate inverted: " << pipeline_data->plate_inverted << endl;
     
     // Invert multiline plates and redo the thresholds before finding the second line
-    if (config->multiline && config->auto_invert && pipeline_data->plate_inverted)
+    if (pipeline_data->country_config->multiline && pipeline_data->country_config->auto_invert && pipeline_data->plate_inverted)
     {
       bitwise_not(pipeline_data->crop_gray, pipeline_data->crop_gray);
       pipeline_data->thresholds = produceThresholds(pipeline_data->crop_gray, pipeline_data->config);
@@ -303,10 +305,10 @@ namespace alpr
 
   void CharacterAnalysis::filter(Mat img, TextContours& textContours)
   {
-    int STARTING_MIN_HEIGHT = round (((float) img.rows) * config->charAnalysisMinPercent);
-    int STARTING_MAX_HEIGHT = round (((float) img.rows) * (config->charAnalysisMinPercent + config->charAnalysisHeightRange));
-    int HEIGHT_STEP = round (((float) img.rows) * config->charAnalysisHeightStepSize);
-    int NUM_STEPS = config->charAnalysisNumSteps;
+    int STARTING_MIN_HEIGHT = round (((float) img.rows) * pipeline_data->country_config->charAnalysisMinPercent);
+    int STARTING_MAX_HEIGHT = round (((float) img.rows) * (pipeline_data->country_config->charAnalysisMinPercent + pipeline_data->country_config->charAnalysisHeightRange));
+    int HEIGHT_STEP = round (((float) img.rows) * pipeline_data->country_config->charAnalysisHeightStepSize);
+    int NUM_STEPS = pipeline_data->country_config->charAnalysisNumSteps;
 
     int bestFitScore = -1;
 
@@ -349,12 +351,12 @@ namespace alpr
     // For multiline plates, we want to target the biggest line for character analysis, since it should be easier to spot.
     float larger_char_height_mm = 0;
     float larger_char_width_mm = 0;
-    for (unsigned int i = 0; i < config->charHeightMM.size(); i++)
+    for (unsigned int i = 0; i < pipeline_data->country_config->charHeightMM.size(); i++)
     {
-      if (config->charHeightMM[i] > larger_char_height_mm)
+      if (pipeline_data->country_config->charHeightMM[i] > larger_char_height_mm)
       {
-        larger_char_height_mm = config->charHeightMM[i];
-        larger_char_width_mm = config->charWidthMM[i];
+        larger_char_height_mm = pipeline_data->country_config->charHeightMM[i];
+        larger_char_width_mm = pipeline_data->country_config->charWidthMM[i];
       }
     }
     
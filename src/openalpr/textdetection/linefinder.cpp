@@ -210,10 +210,10 @@ namespace alpr
         
         //float best_line_width = histogram_hits[best_line_index].second - histogram_hits[best_line_index].first;
         if (pipeline_data->config->debugCharAnalysis)
-          cout << "Ideal calculation: " << pipeline_data->config->charHeightMM[0] << " : " << pipeline_data->config->charHeightMM[1] << " - " << transformed_best_line_width << endl;
+          cout << "Ideal calculation: " << pipeline_data->country_config->charHeightMM[0] << " : " << pipeline_data->country_config->charHeightMM[1] << " - " << transformed_best_line_width << endl;
         
-        float ideal_above_size = (pipeline_data->config->charHeightMM[0] / pipeline_data->config->charHeightMM[1]) * transformed_best_line_width;
-        float ideal_below_size = (pipeline_data->config->charHeightMM[1] / pipeline_data->config->charHeightMM[0]) * transformed_best_line_width;
+        float ideal_above_size = (pipeline_data->country_config->charHeightMM[0] / pipeline_data->country_config->charHeightMM[1]) * transformed_best_line_width;
+        float ideal_below_size = (pipeline_data->country_config->charHeightMM[1] / pipeline_data->country_config->charHeightMM[0]) * transformed_best_line_width;
         
         float max_deviation_percent = 0.30;
         
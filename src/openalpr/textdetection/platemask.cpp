@@ -43,7 +43,7 @@ namespace alpr
   // but helpful when determining the plate edges
   void PlateMask::findOuterBoxMask( vector<TextContours > contours )
   {
-    double min_parent_area = pipeline_data->config->templateHeightPx * pipeline_data->config->templateWidthPx * 0.10;	// Needs to be at least 10% of the plate area to be considered.
+    double min_parent_area = pipeline_data->country_config->templateHeightPx * pipeline_data->country_config->templateWidthPx * 0.10;	// Needs to be at least 10% of the plate area to be considered.
 
     int winningIndex = -1;
     int winningParentId = -1;
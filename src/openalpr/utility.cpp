@@ -127,39 +127,27 @@ namespace alpr
     timespec startTime;
     getTimeMonotonic(&startTime);
 
-    vector<Mat> thresholds;
-
-    for (int i = 0; i < THRESHOLD_COUNT; i++)
-      thresholds.push_back(Mat(img_gray.size(), CV_8U));
-
-    int i = 0;
-
-    // Adaptive
-    //adaptiveThreshold(img_gray, thresholds[i++], 255, ADAPTIVE_THRESH_MEAN_C, THRESH_BINARY_INV , 7, 3);
-    //adaptiveThreshold(img_gray, thresholds[i++], 255, ADAPTIVE_THRESH_MEAN_C, THRESH_BINARY_INV , 13, 3);
-    //adaptiveThreshold(img_gray, thresholds[i++], 255, ADAPTIVE_THRESH_MEAN_C, THRESH_BINARY_INV , 17, 3);
-
-    // Wolf
-    int k = 0, win=18;
-    //NiblackSauvolaWolfJolion (img_gray, thresholds[i++], WOLFJOLION, win, win, 0.05 + (k * 0.35));
-    //bitwise_not(thresholds[i-1], thresholds[i-1]);
-    NiblackSauvolaWolfJolion (img_gray, thresholds[i++], WOLFJOLION, win, win, 0.05 + (k * 0.35));
-    bitwise_not(thresholds[i-1], thresholds[i-1]);
+    // Wolf (window 18, k=0.05), Wolf (window 22, k=0.40) and Sauvola (window 12, k=0.18).
+    // All three share one set of integral images and come back already inverted.
+    vector<BinarizeWindow> windows(THRESHOLD_COUNT);
+    int k = 0, win = 18;
+    windows[0].version = WOLFJOLION;
+    windows[0].winx = windows[0].winy = win;
+    windows[0].k = 0.05 + (k * 0.35);
 
     k = 1;
     win = 22;
-    NiblackSauvolaWolfJolion (img_gray, thresholds[i++], WOLFJOLION, win, win, 0.05 + (k * 0.35));
-    bitwise_not(thresholds[i-1], thresholds[i-1]);
-    //NiblackSauvolaWolfJolion (img_gray, thresholds[i++], WOLFJOLION, win, win, 0.05 + (k * 0.35));
-    //bitwise_not(thresholds[i-1], thresholds[i-1]);
+    windows[1].version = WOLFJOLION;
+    windows[1].winx = windows[1].winy = win;
+    windows[1].k = 0.05 + (k * 0.35);
 
-    // Sauvola
     k = 1;
-    NiblackSauvolaWolfJolion (img_gray, thresholds[i++], SAUVOLA, 12, 12, 0.18 * k);
-    bitwise_not(thresholds[i-1], thresholds[i-1]);
-    //k=2;
-    //NiblackSauvolaWolfJolion (img_gray, thresholds[i++], SAUVOLA, 12, 12, 0.18 * k);
-    //bitwise_not(thresholds[i-1], thresholds[i-1]);
+    windows[2].version = SAUVOLA;
+    windows[2].winx = windows[2].winy = 12;
+    windows[2].k = 0.18 * k;
+
+    vector<Mat> thresholds;
+    NiblackSauvolaWolfJolionInv(img_gray, windows, thresholds);
 
     if (config->debugTiming)
     {
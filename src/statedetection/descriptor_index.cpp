@@ -0,0 +1,222 @@
+/*
+ * Copyright (c) 2015 OpenALPR Technology, Inc.
+ * Open source Automated License Plate Recognition [http://www.openalpr.com]
+ *
+ * This file is part of OpenALPR.
+ *
+ * OpenALPR is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License
+ * version 3 as published by the Free Software Foundation
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "descriptor_index.h"
+
+#include <algorithm>
+#include <cstring>
+#include <random>
+
+using namespace cv;
+using namespace std;
+
+namespace alpr
+{
+
+  const int LSH_TABLES = 8;
+  const int LSH_KEY_BITS = 16;
+  // Fixed, so every process builds the same tables
+  const uint32_t LSH_SEED = 0x5eed1234;
+
+  DescriptorIndex::DescriptorIndex()
+  {
+    imageCount = 0;
+    descriptorBytes = 0;
+    stamp = 0;
+  }
+
+  DescriptorIndex::~DescriptorIndex()
+  {
+  }
+
+  void DescriptorIndex::build(const vector<Mat>& imageDescriptors)
+  {
+    imageCount = 0;
+    descriptorBytes = 0;
+    rows.clear();
+    imageOf.clear();
+
+    for (unsigned int i = 0; i < imageDescriptors.size(); i++)
+    {
+      const Mat& descriptors = imageDescriptors[i];
+      if (descriptors.rows == 0)
+        continue;
+
+      CV_Assert(descriptors.depth() == CV_8U);
+      if (descriptorBytes == 0)
+        descriptorBytes = descriptors.cols * descriptors.channels();
+      CV_Assert(descriptors.cols * descriptors.channels() == descriptorBytes);
+
+      for (int r = 0; r < descriptors.rows; r++)
+      {
+        rows.push_back(descriptors.ptr<unsigned char>(r));
+        imageOf.push_back(i);
+      }
+    }
+
+    if (rows.size() == 0)
+      return;
+
+    // Sample each table's key bits
+    mt19937 rng(LSH_SEED);
+    int totalBits = descriptorBytes * 8;
+    int keyBits = std::min(LSH_KEY_BITS, totalBits);
+    tableBits.assign(LSH_TABLES, vector<int>());
+    for (int t = 0; t < LSH_TABLES; t++)
+    {
+      vector<int> bits(totalBits);
+      for (int b = 0; b < totalBits; b++)
+        bits[b] = b;
+      for (int b = 0; b < keyBits; b++)
+        swap(bits[b], bits[b + rng() % (totalBits - b)]);
+      tableBits[t].assign(bits.begin(), bits.begin() + keyBits);
+    }
+
+    // Counting sort the ids into each table's buckets
+    size_t buckets = ((size_t) 1) << keyBits;
+    bucketStart.assign(LSH_TABLES, vector<uint32_t>());
+    bucketIds.assign(LSH_TABLES, vector<uint32_t>());
+    vector<uint32_t> keys(rows.size());
+    for (int t = 0; t < LSH_TABLES; t++)
+    {
+      vector<uint32_t>& start = bucketStart[t];
+      start.assign(buckets + 1, 0);
+      for (size_t id = 0; id < rows.size(); id++)
+      {
+        keys[id] = keyFor(rows[id], t);
+        start[keys[id] + 1]++;
+      }
+      for (size_t k = 0; k < buckets; k++)
+        start[k + 1] += start[k];
+
+      vector<uint32_t> next(start.begin(), start.end() - 1);
+      bucketIds[t].resize(rows.size());
+      for (size_t id = 0; id < rows.size(); id++)
+        bucketIds[t][next[keys[id]]++] = id;
+    }
+
+    seenStamp.assign(rows.size(), 0);
+    stamp = 0;
+    imageCount = imageDescriptors.size();
+  }
+
+  uint32_t DescriptorIndex::keyFor(const unsigned char* row, int table) const
+  {
+    const vector<int>& bits = tableBits[table];
+    uint32_t key = 0;
+    for (unsigned int b = 0; b < bits.size(); b++)
+      key |= ((row[bits[b] >> 3] >> (bits[b] & 7)) & 1) << b;
+    return key;
+  }
+
+  vector<int> DescriptorIndex::shortlist(const Mat& queryDescriptors, int maxDistance, int maxImages)
+  {
+    vector<int> images;
+    if (imageCount == 0 || queryDescriptors.rows == 0 ||
+        queryDescriptors.cols * queryDescriptors.channels() != descriptorBytes)
+      return images;
+
+    vector<int> votes(imageCount, 0);
+    int keyBits = tableBits[0].size();
+    for (int q = 0; q < queryDescriptors.rows; q++)
+    {
+      const unsigned char* query = queryDescriptors.ptr<unsigned char>(q);
+
+      // A new stamp marks every descriptor unseen without clearing the array
+      if (++stamp == 0)
+      {
+        fill(seenStamp.begin(), seenStamp.end(), 0);
+        stamp = 1;
+      }
+
+      int bestDistance = maxDistance + 1;
+      int bestImage = -1;
+      for (int t = 0; t < LSH_TABLES; t++)
+      {
+        uint32_t key = keyFor(query, t);
+        for (int probe = -1; probe < keyBits; probe++)
+        {
+          uint32_t probeKey = (probe < 0) ? key : (key ^ (1u << probe));
+          const vector<uint32_t>& start = bucketStart[t];
+          for (uint32_t i = start[probeKey]; i < start[probeKey + 1]; i++)
+          {
+            uint32_t id = bucketIds[t][i];
+            if (seenStamp[id] == stamp)
+              continue;
+            seenStamp[id] = stamp;
+
+            int distance = hammingDistance(query, rows[id], descriptorBytes);
+            if (distance < bestDistance)
+            {
+              bestDistance = distance;
+              bestImage = imageOf[id];
+            }
+          }
+        }
+      }
+
+      if (bestImage >= 0)
+        votes[bestImage]++;
+    }
+
+    vector<pair<int, int> > ranked;
+    for (int i = 0; i < imageCount; i++)
+    {
+      if (votes[i] > 0)
+        ranked.push_back(make_pair(-votes[i], i));
+    }
+    sort(ranked.begin(), ranked.end());
+
+    for (unsigned int i = 0; i < ranked.size() && (int) i < maxImages; i++)
+      images.push_back(ranked[i].second);
+    return images;
+  }
+
+  int DescriptorIndex::hammingDistance(const unsigned char* a, const unsigned char* b, int bytes)
+  {
+    int distance = 0;
+    int i = 0;
+    for (; i + 8 <= bytes; i += 8)
+    {
+      uint64_t x, y;
+      memcpy(&x, a + i, 8);
+      memcpy(&y, b + i, 8);
+#if defined(__GNUC__)
+      distance += __builtin_popcountll(x ^ y);
+#else
+      uint64_t v = x ^ y;
+      v = v - ((v >> 1) & 0x5555555555555555ULL);
+      v = (v & 0x3333333333333333ULL) + ((v >> 2) & 0x3333333333333333ULL);
+      v = (v + (v >> 4)) & 0x0F0F0F0F0F0F0F0FULL;
+      distance += (int) ((v * 0x0101010101010101ULL) >> 56);
+#endif
+    }
+    for (; i < bytes; i++)
+    {
+      unsigned char v = a[i] ^ b[i];
+      while (v)
+      {
+        distance += v & 1;
+        v >>= 1;
+      }
+    }
+    return distance;
+  }
+
+}
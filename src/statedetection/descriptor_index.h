@@ -0,0 +1,80 @@
+/*
+ * Copyright (c) 2015 OpenALPR Technology, Inc.
+ * Open source Automated License Plate Recognition [http://www.openalpr.com]
+ *
+ * This file is part of OpenALPR.
+ *
+ * OpenALPR is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License
+ * version 3 as published by the Free Software Foundation
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef OPENALPR_DESCRIPTORINDEX_H
+#define OPENALPR_DESCRIPTORINDEX_H
+
+#include <vector>
+#include <stdint.h>
+
+#include "opencv2/core/core.hpp"
+
+namespace alpr
+{
+
+  // Locality-sensitive hash index over binary descriptors (e.g., BRISK), used to pick
+  // out which reference images are worth matching a query against.
+  //
+  // Each table keys a descriptor by a fixed random sample of its bits, so descriptors
+  // a small Hamming distance apart tend to share a bucket in at least one table.  A
+  // lookup probes its own bucket plus every bucket one bit away in each table, then
+  // measures the real distance to whatever it finds.
+  class DescriptorIndex
+  {
+    public:
+      DescriptorIndex();
+      virtual ~DescriptorIndex();
+
+      // Indexes every row of each image's descriptors.  The matrices must stay
+      // alive and unchanged for as long as the index is used.
+      void build(const std::vector<cv::Mat>& imageDescriptors);
+
+      bool isBuilt() const { return imageCount > 0; }
+
+      // Up to maxImages reference images, best first.  An image scores one vote for
+      // every query descriptor whose nearest indexed neighbour (within maxDistance)
+      // it holds.
+      std::vector<int> shortlist(const cv::Mat& queryDescriptors, int maxDistance, int maxImages);
+
+      static int hammingDistance(const unsigned char* a, const unsigned char* b, int bytes);
+
+    private:
+      int imageCount;
+      int descriptorBytes;
+
+      // Descriptor id -> its row and image
+      std::vector<const unsigned char*> rows;
+      std::vector<int> imageOf;
+
+      // Per table: the sampled bit positions, and the ids in each bucket in
+      // bucketStart[key] .. bucketStart[key + 1]
+      std::vector<std::vector<int> > tableBits;
+      std::vector<std::vector<uint32_t> > bucketStart;
+      std::vector<std::vector<uint32_t> > bucketIds;
+
+      // Descriptors already measured for the current query row
+      std::vector<uint32_t> seenStamp;
+      uint32_t stamp;
+
+      uint32_t keyFor(const unsigned char* row, int table) const;
+  };
+
+}
+
+#endif // OPENALPR_DESCRIPTORINDEX_H
@@ -19,6 +19,8 @@
 
 #include "featurematcher.h"
 
+#include <fstream>
+
 using namespace cv;
 using namespace std;
 
@@ -29,6 +31,14 @@ namespace alpr
   //const int DEFAULT_TRAINING_FEATURES = 305;
   const float MAX_DISTANCE_TO_MATCH = 100.0f;
 
+  // Reference sets at least this large are matched through the LSH index when the
+  // matcher is "auto"
+  const int AUTO_INDEX_MIN_IMAGES = 200;
+
+  // Everything that changes what the detector and extractor below produce.  Part of
+  // the keypoint cache's key, so change it along with them.
+  const std::string FEATURE_SETTINGS = std::string("fast:10:nonmax;brisk:10:1:0.9;gray;opencv:") + CV_VERSION;
+
   FeatureMatcher::FeatureMatcher()
   {
     //this->descriptorMatcher = DescriptorMatcher::create( "BruteForce-HammingLUT" );
@@ -44,6 +54,9 @@ namespace alpr
     this->extractor = BRISK::create(10, 1, 0.9);
 #endif
 
+    this->matcherType = "bruteforce";
+    this->shortlistSize = 8;
+
   }
 
   FeatureMatcher::~FeatureMatcher()
@@ -72,12 +85,69 @@ namespace alpr
     return billMapping.size();
   }
 
+  void FeatureMatcher::setMatcher(const std::string& matcher, int shortlistSize)
+  {
+    if (matcher != "bruteforce" && matcher != "lsh" && matcher != "auto")
+    {
+      cerr << "Unknown state_id_matcher '" << matcher << "', using bruteforce" << endl;
+      this->matcherType = "bruteforce";
+    }
+    else
+    {
+      this->matcherType = matcher;
+    }
+    this->shortlistSize = std::max(1, shortlistSize);
+
+    if (useIndex() && !descriptorIndex.isBuilt())
+      descriptorIndex.build(trainingImgDescriptors);
+  }
+
+  bool FeatureMatcher::useIndex()
+  {
+    if (matcherType == "lsh")
+      return trainingImgDescriptors.size() > 0;
+    if (matcherType == "auto")
+      return (int) trainingImgDescriptors.size() >= AUTO_INDEX_MIN_IMAGES;
+    return false;
+  }
+
   void FeatureMatcher::surfStyleMatching( const Mat& queryDescriptors, vector<KeyPoint> queryKeypoints,
                                           vector<DMatch>& matches12 )
   {
     vector<vector<DMatch> > matchesKnn;
 
-    this->descriptorMatcher->radiusMatch(queryDescriptors, matchesKnn, MAX_DISTANCE_TO_MATCH);
+    if (useIndex())
+    {
+      // Brute-force match only the shortlisted images.  Their matches are exactly the ones
+      // the full matcher finds in them; what can change is which image is runner-up in
+      // the ratio test when it wasn't shortlisted.
+      vector<int> shortlist = descriptorIndex.shortlist(queryDescriptors, (int) MAX_DISTANCE_TO_MATCH, shortlistSize);
+
+      if (shortlist.size() > 0)
+      {
+        vector<Mat> shortlisted;
+        for (unsigned int i = 0; i < shortlist.size(); i++)
+          shortlisted.push_back(trainingImgDescriptors[shortlist[i]]);
+
+        // Shares the descriptor data, so this is cheap to set up per query
+        Ptr<DescriptorMatcher> verifier(new BFMatcher(NORM_HAMMING, false));
+        verifier->add(shortlisted);
+        verifier->train();
+        verifier->radiusMatch(queryDescriptors, matchesKnn, MAX_DISTANCE_TO_MATCH);
+
+        for (unsigned int q = 0; q < matchesKnn.size(); q++)
+        {
+          for (unsigned int m = 0; m < matchesKnn[q].size(); m++)
+            matchesKnn[q][m].imgIdx = shortlist[matchesKnn[q][m].imgIdx];
+        }
+      }
+
+      matchesKnn.resize(queryDescriptors.rows);
+    }
+    else
+    {
+      this->descriptorMatcher->radiusMatch(queryDescriptors, matchesKnn, MAX_DISTANCE_TO_MATCH);
+    }
 
     vector<DMatch> tempMatches;
     _surfStyleMatching(queryDescriptors, matchesKnn, tempMatches);
@@ -244,19 +314,54 @@ namespace alpr
 
     if (DirectoryExists(country_dir.c_str()))
     {
-      vector<Mat> trainImages;
       vector<string> plateFiles = getFilesInDir(country_dir.c_str());
 
+      // Read every training image first.  Their bytes are the cache key, and the
+      // input to feature extraction if the cache is missing or stale.
+      vector<string> imageFiles;
+      vector<vector<char> > imageBytes;
+      uint64_t imagesHash = KeypointCache::hash(FEATURE_SETTINGS.data(), FEATURE_SETTINGS.size());
       for (unsigned int i = 0; i < plateFiles.size(); i++)
       {
         if (hasEnding(plateFiles[i], ".jpg") == false)
           continue;
 
         string fullpath = country_dir + plateFiles[i];
-        Mat img = imread( fullpath );
+        ifstream infile(fullpath.c_str(), ios::binary);
+        vector<char> bytes((istreambuf_iterator<char>(infile)), istreambuf_iterator<char>());
 
-        // convert to gray and resize to the size of the templates
-        cvtColor(img, img, CV_BGR2GRAY);
+        uint64_t length = bytes.size();
+        imagesHash = KeypointCache::hash(plateFiles[i].data(), plateFiles[i].size() + 1, imagesHash);
+        imagesHash = KeypointCache::hash(&length, sizeof(length), imagesHash);
+        if (bytes.size() > 0)
+          imagesHash = KeypointCache::hash(&bytes[0], bytes.size(), imagesHash);
+
+        imageFiles.push_back(plateFiles[i]);
+        imageBytes.push_back(bytes);
+      }
+
+      uint64_t settingsHash = KeypointCache::hash(FEATURE_SETTINGS.data(), FEATURE_SETTINGS.size());
+      vector<string> cachePaths = KeypointCache::candidatePaths(directory, country, imagesHash);
+
+      vector<Mat> trainImages;
+      for (unsigned int i = 0; i < cachePaths.size(); i++)
+      {
+        if (keypointCache.load(cachePaths[i], settingsHash, imagesHash, billMapping, trainingImgKeypoints, trainImages))
+        {
+          this->descriptorMatcher->add(trainImages);
+          this->descriptorMatcher->train();
+          trainingImgDescriptors = trainImages;
+          if (useIndex())
+            descriptorIndex.build(trainingImgDescriptors);
+          return true;
+        }
+      }
+
+      for (unsigned int i = 0; i < imageFiles.size(); i++)
+      {
+        Mat img;
+        if (imageBytes[i].size() > 0)
+          img = imdecode(Mat(imageBytes[i]), IMREAD_COLOR);
 
         if( img.empty() )
         {
@@ -264,6 +369,9 @@ namespace alpr
           return -1;
         }
 
+        // convert to gray and resize to the size of the templates
+        cvtColor(img, img, CV_BGR2GRAY);
+
         Mat descriptors;
 
         vector<KeyPoint> keypoints;
@@ -272,14 +380,22 @@ namespace alpr
 
         if (descriptors.cols > 0)
         {
-          billMapping.push_back(plateFiles[i].substr(0, 2));
+          billMapping.push_back(imageFiles[i].substr(0, 2));
           trainImages.push_back(descriptors);
           trainingImgKeypoints.push_back(keypoints);
         }
       }
 
+      // Save the features for next time in the user's cache
+      string savePath = KeypointCache::userCachePath(country, imagesHash);
+      if (savePath.size() > 0)
+        KeypointCache::save(savePath, settingsHash, imagesHash, billMapping, trainingImgKeypoints, trainImages);
+
       this->descriptorMatcher->add(trainImages);
       this->descriptorMatcher->train();
+      trainingImgDescriptors = trainImages;
+      if (useIndex())
+        descriptorIndex.build(trainingImgDescriptors);
 
       return true;
     }
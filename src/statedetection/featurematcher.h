@@ -27,6 +27,8 @@
 #include "opencv2/highgui/highgui.hpp"
 
 #include "line_segment.h"
+#include "keypoint_cache.h"
+#include "descriptor_index.h"
 #include "support/filesystem.h"
 
 namespace alpr
@@ -51,17 +53,32 @@ namespace alpr
 
       bool loadRecognitionSet(std::string runtime_dir, std::string country);
 
+      // How query features are matched against the reference images: "bruteforce"
+      // against all of them, "lsh" against the shortlistSize images a DescriptorIndex
+      // picks, or "auto" to use lsh only for large reference sets.
+      void setMatcher(const std::string& matcher, int shortlistSize);
+
       bool isLoaded();
 
       int numTrainingElements();
 
     private:
 
+      // Declared first so the mapped descriptors outlive the matcher that reads them
+      KeypointCache keypointCache;
+
       cv::Ptr<cv::DescriptorMatcher> descriptorMatcher;
       cv::Ptr<cv::FastFeatureDetector> detector;
       cv::Ptr<cv::BRISK> extractor;
 
       std::vector<std::vector<cv::KeyPoint> > trainingImgKeypoints;
+      std::vector<cv::Mat> trainingImgDescriptors;
+
+      std::string matcherType;
+      int shortlistSize;
+      DescriptorIndex descriptorIndex;
+
+      bool useIndex();
 
       void _surfStyleMatching(const cv::Mat& queryDescriptors, std::vector<std::vector<cv::DMatch> > matchesKnn, std::vector<cv::DMatch>& matches12);
 
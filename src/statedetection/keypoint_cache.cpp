@@ -0,0 +1,359 @@
+/*
+ * Copyright (c) 2015 OpenALPR Technology, Inc.
+ * Open source Automated License Plate Recognition [http://www.openalpr.com]
+ *
+ * This file is part of OpenALPR.
+ *
+ * OpenALPR is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License
+ * version 3 as published by the Free Software Foundation
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "keypoint_cache.h"
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+
+#ifndef WINDOWS
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+#include "support/filesystem.h"
+
+using namespace cv;
+using namespace std;
+
+namespace alpr
+{
+
+  const char KEYPOINT_CACHE_MAGIC[8] = { 'O', 'A', 'L', 'P', 'R', 'K', 'P', '\0' };
+  // Bump whenever the layout below changes
+  const uint32_t KEYPOINT_CACHE_VERSION = 1;
+  const uint32_t KEYPOINT_CACHE_BYTE_ORDER = 0x01020304;
+  // Descriptor rows start on this boundary so the matcher's vector loads stay aligned
+  const size_t KEYPOINT_CACHE_ALIGNMENT = 16;
+
+  struct KeypointCacheHeader
+  {
+    char magic[8];
+    uint32_t version;
+    uint32_t byteOrder;
+    uint64_t settingsHash;
+    uint64_t imagesHash;
+    uint64_t fileSize;
+    uint32_t imageCount;
+    uint32_t keypointSize;
+  };
+
+  struct KeypointCacheEntry
+  {
+    char code[16];
+    uint64_t keypointOffset;
+    uint64_t descriptorOffset;
+    uint32_t keypointCount;
+    uint32_t descriptorRows;
+    uint32_t descriptorCols;
+    int32_t descriptorType;
+  };
+
+  struct CachedKeyPoint
+  {
+    float x;
+    float y;
+    float size;
+    float angle;
+    float response;
+    int32_t octave;
+    int32_t classId;
+  };
+
+  static size_t alignedSize(size_t size)
+  {
+    return (size + KEYPOINT_CACHE_ALIGNMENT - 1) / KEYPOINT_CACHE_ALIGNMENT * KEYPOINT_CACHE_ALIGNMENT;
+  }
+
+  KeypointCache::KeypointCache()
+  {
+    mapping = NULL;
+    mappingSize = 0;
+  }
+
+  KeypointCache::~KeypointCache()
+  {
+    release();
+  }
+
+  void KeypointCache::release()
+  {
+#ifndef WINDOWS
+    if (mapping != NULL)
+      munmap(mapping, mappingSize);
+#endif
+    mapping = NULL;
+    mappingSize = 0;
+    contents.clear();
+  }
+
+  bool KeypointCache::load(const string& path, uint64_t settingsHash, uint64_t imagesHash,
+                           vector<string>& codes, vector<vector<KeyPoint> >& keypoints, vector<Mat>& descriptors)
+  {
+    release();
+
+    const char* data = NULL;
+    size_t size = 0;
+#ifndef WINDOWS
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+      return false;
+
+    struct stat st;
+    if (fstat(fd, &st) == 0 && st.st_size >= (off_t) sizeof(KeypointCacheHeader))
+    {
+      void* mapped = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+      if (mapped != MAP_FAILED)
+      {
+        mapping = mapped;
+        mappingSize = st.st_size;
+        data = (const char*) mapped;
+        size = mappingSize;
+      }
+    }
+    close(fd);
+#else
+    ifstream infile(path.c_str(), ios::binary);
+    if (!infile)
+      return false;
+    contents.assign(istreambuf_iterator<char>(infile), istreambuf_iterator<char>());
+    data = contents.data();
+    size = contents.size();
+#endif
+
+    if (data == NULL || size < sizeof(KeypointCacheHeader))
+    {
+      release();
+      return false;
+    }
+
+    KeypointCacheHeader header;
+    memcpy(&header, data, sizeof(header));
+    if (memcmp(header.magic, KEYPOINT_CACHE_MAGIC, sizeof(header.magic)) != 0 ||
+        header.version != KEYPOINT_CACHE_VERSION || header.byteOrder != KEYPOINT_CACHE_BYTE_ORDER ||
+        header.keypointSize != sizeof(CachedKeyPoint) || header.fileSize != size ||
+        header.settingsHash != settingsHash || header.imagesHash != imagesHash ||
+        header.imageCount > (size - sizeof(header)) / sizeof(KeypointCacheEntry))
+    {
+      release();
+      return false;
+    }
+
+    vector<string> loadedCodes;
+    vector<vector<KeyPoint> > loadedKeypoints;
+    vector<Mat> loadedDescriptors;
+    for (uint32_t i = 0; i < header.imageCount; i++)
+    {
+      KeypointCacheEntry entry;
+      memcpy(&entry, data + sizeof(header) + i * sizeof(entry), sizeof(entry));
+
+      // Reject anything that would reach past the end of the file
+      uint64_t keypointBytes = (uint64_t) entry.keypointCount * sizeof(CachedKeyPoint);
+      uint64_t descriptorBytes = (uint64_t) entry.descriptorRows * entry.descriptorCols * CV_ELEM_SIZE(entry.descriptorType);
+      if (entry.code[sizeof(entry.code) - 1] != '\0' ||
+          entry.keypointOffset > size || keypointBytes > size - entry.keypointOffset ||
+          entry.descriptorOffset > size || descriptorBytes > size - entry.descriptorOffset ||
+          entry.descriptorOffset % KEYPOINT_CACHE_ALIGNMENT != 0)
+      {
+        release();
+        return false;
+      }
+
+      loadedCodes.push_back(entry.code);
+
+      loadedKeypoints.push_back(vector<KeyPoint>(entry.keypointCount));
+      vector<KeyPoint>& imageKeypoints = loadedKeypoints.back();
+      for (uint32_t k = 0; k < entry.keypointCount; k++)
+      {
+        CachedKeyPoint cached;
+        memcpy(&cached, data + entry.keypointOffset + k * sizeof(cached), sizeof(cached));
+        imageKeypoints[k] = KeyPoint(cached.x, cached.y, cached.size, cached.angle, cached.response,
+                                     cached.octave, cached.classId);
+      }
+
+      // No copy: the matcher reads the descriptors from the mapped pages
+      loadedDescriptors.push_back(Mat(entry.descriptorRows, entry.descriptorCols, entry.descriptorType,
+                                      (void*) (data + entry.descriptorOffset)));
+    }
+
+    codes.swap(loadedCodes);
+    keypoints.swap(loadedKeypoints);
+    descriptors.swap(loadedDescriptors);
+    return true;
+  }
+
+  bool KeypointCache::save(const string& path, uint64_t settingsHash, uint64_t imagesHash,
+                           const vector<string>& codes, const vector<vector<KeyPoint> >& keypoints,
+                           const vector<Mat>& descriptors)
+  {
+    if (codes.size() != keypoints.size() || codes.size() != descriptors.size())
+      return false;
+
+    KeypointCacheHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, KEYPOINT_CACHE_MAGIC, sizeof(header.magic));
+    header.version = KEYPOINT_CACHE_VERSION;
+    header.byteOrder = KEYPOINT_CACHE_BYTE_ORDER;
+    header.settingsHash = settingsHash;
+    header.imagesHash = imagesHash;
+    header.imageCount = codes.size();
+    header.keypointSize = sizeof(CachedKeyPoint);
+
+    // Lay out the keypoints and descriptors after the table
+    vector<KeypointCacheEntry> entries(codes.size());
+    size_t offset = sizeof(header) + entries.size() * sizeof(KeypointCacheEntry);
+    for (unsigned int i = 0; i < codes.size(); i++)
+    {
+      if (codes[i].size() >= sizeof(entries[i].code) || !descriptors[i].isContinuous())
+        return false;
+
+      memset(&entries[i], 0, sizeof(entries[i]));
+      memcpy(entries[i].code, codes[i].data(), codes[i].size());
+      entries[i].keypointCount = keypoints[i].size();
+      entries[i].descriptorRows = descriptors[i].rows;
+      entries[i].descriptorCols = descriptors[i].cols;
+      entries[i].descriptorType = descriptors[i].type();
+
+      entries[i].keypointOffset = offset;
+      offset = alignedSize(offset + keypoints[i].size() * sizeof(CachedKeyPoint));
+      entries[i].descriptorOffset = offset;
+      offset = alignedSize(offset + descriptors[i].total() * descriptors[i].elemSize());
+    }
+    header.fileSize = offset;
+
+    string out(offset, '\0');
+    memcpy(&out[0], &header, sizeof(header));
+    for (unsigned int i = 0; i < entries.size(); i++)
+    {
+      memcpy(&out[sizeof(header) + i * sizeof(KeypointCacheEntry)], &entries[i], sizeof(KeypointCacheEntry));
+
+      for (unsigned int k = 0; k < keypoints[i].size(); k++)
+      {
+        const KeyPoint& kp = keypoints[i][k];
+        CachedKeyPoint cached;
+        cached.x = kp.pt.x;
+        cached.y = kp.pt.y;
+        cached.size = kp.size;
+        cached.angle = kp.angle;
+        cached.response = kp.response;
+        cached.octave = kp.octave;
+        cached.classId = kp.class_id;
+        memcpy(&out[entries[i].keypointOffset + k * sizeof(cached)], &cached, sizeof(cached));
+      }
+
+      if (descriptors[i].total() > 0)
+        memcpy(&out[entries[i].descriptorOffset], descriptors[i].data, descriptors[i].total() * descriptors[i].elemSize());
+    }
+
+    string directory = get_directory_from_path(path);
+    if (directory.size() > 0 && !DirectoryExists(directory.c_str()))
+      makePath(directory.c_str(), 0755);
+
+    // Several engines in one process may save the same cache at once, so the temp
+    // name carries a per-process counter as well as the pid
+    static std::atomic<unsigned int> saveCounter(0);
+    std::ostringstream tmpPath;
+#ifndef WINDOWS
+    tmpPath << path << ".tmp." << getpid() << "." << saveCounter++;
+#else
+    tmpPath << path << ".tmp." << saveCounter++;
+#endif
+
+    {
+      ofstream outfile(tmpPath.str().c_str(), ios::binary | ios::trunc);
+      if (!outfile)
+        return false;
+      outfile.write(out.data(), out.size());
+      if (!outfile)
+      {
+        outfile.close();
+        remove(tmpPath.str().c_str());
+        return false;
+      }
+    }
+
+#ifdef WINDOWS
+    // rename() won't replace an existing file here
+    remove(path.c_str());
+#endif
+    if (rename(tmpPath.str().c_str(), path.c_str()) != 0)
+    {
+      remove(tmpPath.str().c_str());
+      return false;
+    }
+    return true;
+  }
+
+  vector<string> KeypointCache::candidatePaths(const string& runtimeDir, const string& country, uint64_t imagesHash)
+  {
+    vector<string> paths;
+    paths.push_back(runtimeDir + "/keypoints/" + country + ".cache");
+
+    string userPath = userCachePath(country, imagesHash);
+    if (userPath.size() > 0)
+      paths.push_back(userPath);
+
+    return paths;
+  }
+
+  string KeypointCache::userCachePath(const string& country, uint64_t imagesHash)
+  {
+    string cacheDir;
+#ifndef WINDOWS
+    const char* xdgCache = getenv("XDG_CACHE_HOME");
+    const char* home = getenv("HOME");
+    if (xdgCache != NULL && xdgCache[0] != '\0')
+      cacheDir = string(xdgCache) + "/openalpr";
+    else if (home != NULL && home[0] != '\0')
+      cacheDir = string(home) + "/.cache/openalpr";
+#else
+    const char* localAppData = getenv("LOCALAPPDATA");
+    if (localAppData != NULL && localAppData[0] != '\0')
+      cacheDir = string(localAppData) + "/openalpr";
+#endif
+
+    if (cacheDir.size() == 0)
+      return "";
+
+    // The name carries the images' fingerprint, so caches for different runtime_data
+    // trees don't keep replacing each other
+    char fingerprint[17];
+    snprintf(fingerprint, sizeof(fingerprint), "%016llx", (unsigned long long) imagesHash);
+    return cacheDir + "/keypoints-" + country + "-" + fingerprint + ".cache";
+  }
+
+  uint64_t KeypointCache::hash(const void* data, size_t length, uint64_t seed)
+  {
+    const unsigned char* bytes = (const unsigned char*) data;
+    uint64_t h = seed;
+    for (size_t i = 0; i < length; i++)
+    {
+      h ^= bytes[i];
+      h *= 1099511628211ULL;
+    }
+    return h;
+  }
+
+}
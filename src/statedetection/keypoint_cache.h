@@ -0,0 +1,87 @@
+/*
+ * Copyright (c) 2015 OpenALPR Technology, Inc.
+ * Open source Automated License Plate Recognition [http://www.openalpr.com]
+ *
+ * This file is part of OpenALPR.
+ *
+ * OpenALPR is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License
+ * version 3 as published by the Free Software Foundation
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef OPENALPR_KEYPOINTCACHE_H
+#define OPENALPR_KEYPOINTCACHE_H
+
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+#include "opencv2/core/core.hpp"
+#include "opencv2/features2d/features2d.hpp"
+
+namespace alpr
+{
+
+  // Keypoints and descriptors for a country's state training images, saved once so
+  // later runs don't have to decode the images and extract features again.
+  //
+  // The file starts with a header and a table of images, followed by each image's
+  // keypoints and descriptor matrix.  It carries a fingerprint of the extractor
+  // settings and one of the training images.  A file that doesn't match both is
+  // ignored, and so is one written on a platform with a different byte order.
+  // Descriptors are used straight out of a read-only mapping of the file, so
+  // processes that load the same cache share those pages.
+  class KeypointCache
+  {
+    public:
+      KeypointCache();
+      virtual ~KeypointCache();
+
+      // Maps the cache at path and fills in its images, if it was written for
+      // exactly these settings and training images.  The descriptor matrices point
+      // into the mapping; they are valid until this object is destroyed.
+      bool load(const std::string& path, uint64_t settingsHash, uint64_t imagesHash,
+                std::vector<std::string>& codes,
+                std::vector<std::vector<cv::KeyPoint> >& keypoints,
+                std::vector<cv::Mat>& descriptors);
+
+      // Writes a cache to a temporary file and renames it into place, so readers
+      // never see a partial one.  Returns false if path could not be written.
+      static bool save(const std::string& path, uint64_t settingsHash, uint64_t imagesHash,
+                       const std::vector<std::string>& codes,
+                       const std::vector<std::vector<cv::KeyPoint> >& keypoints,
+                       const std::vector<cv::Mat>& descriptors);
+
+      // Where a cache for these training images may be read from, in the order to try
+      // them: one prebuilt into runtime_data/keypoints, then the user's cache directory
+      static std::vector<std::string> candidatePaths(const std::string& runtimeDir, const std::string& country,
+                                                     uint64_t imagesHash);
+
+      // Where newly extracted features are saved, under $XDG_CACHE_HOME (or ~/.cache), so
+      // the library never writes into an installed runtime_data.  Empty if there is no
+      // such directory.
+      static std::string userCachePath(const std::string& country, uint64_t imagesHash);
+
+      // 64-bit FNV-1a; pass the previous result as seed to hash several pieces in turn
+      static uint64_t hash(const void* data, size_t length, uint64_t seed = 14695981039346656037ULL);
+
+    private:
+      void release();
+
+      void* mapping;
+      size_t mappingSize;
+      // Holds the file instead of a mapping where mmap isn't available
+      std::vector<char> contents;
+  };
+
+}
+
+#endif // OPENALPR_KEYPOINTCACHE_H
@@ -40,6 +40,10 @@ namespace alpr {
     impl->setTopN(topN);
   }
 
+  void StateDetector::setMatcher(const std::string& matcher, int shortlistSize) {
+    impl->setMatcher(matcher, shortlistSize);
+  }
+
   vector<StateCandidate> StateDetector::detect(vector<char> imageBytes) {
     return impl->detect(imageBytes);
   }
@@ -43,6 +43,9 @@ namespace alpr {
       // Maximum number of candidates to return
       void setTopN(int topN);
 
+      // "bruteforce", "lsh" or "auto"; see FeatureMatcher::setMatcher
+      void setMatcher(const std::string& matcher, int shortlistSize);
+
       // Given an image of a license plate, provide the likely state candidates
       std::vector<StateCandidate> detect(std::vector<char> imageBytes);
       std::vector<StateCandidate> detect(unsigned char* pixelData, int bytesPerPixel, int imgWidth, int imgHeight);
@@ -43,6 +43,10 @@ namespace alpr
   void StateDetectorImpl::setTopN(int topN) {
   }
 
+  void StateDetectorImpl::setMatcher(const std::string& matcher, int shortlistSize) {
+    featureMatcher.setMatcher(matcher, shortlistSize);
+  }
+
   std::vector<StateCandidate> StateDetectorImpl::detect(std::vector<char> imageBytes) {
     cv::Mat img = cv::imdecode(cv::Mat(imageBytes), 1);
 
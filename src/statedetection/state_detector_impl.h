@@ -37,6 +37,8 @@ namespace alpr {
       // Maximum number of candidates to return
       void setTopN(int topN);
 
+      void setMatcher(const std::string& matcher, int shortlistSize);
+
       std::vector<StateCandidate> detect(std::vector<char> imageBytes);
       std::vector<StateCandidate> detect(unsigned char* pixelData, int bytesPerPixel, int imgWidth, int imgHeight);
       std::vector<StateCandidate> detect(cv::Mat image);
@@ -93,3 +93,83 @@ TEST_CASE( "JSON Serialization/Deserialization", "[json]" ) {
   }
   
 }
+
+TEST_CASE( "Binary Serialization/Deserialization", "[binary]" ) {
+
+  AlprResults origResults;
+  origResults.epoch_time = getEpochTimeMs();
+  origResults.img_width = 640;
+  origResults.img_height = 480;
+  origResults.total_processing_time_ms = 100;
+  origResults.profile = "default";
+  origResults.regionsOfInterest.push_back(AlprRegionOfInterest(259,260,50,150));
+
+  AlprPlateResult apr;
+  for (int i = 0; i < 2; i++)
+  {
+    AlprPlate ap;
+    ap.characters = "abc";
+    ap.matches_template = i%2;
+    ap.overall_confidence = i * 10;
+
+    AlprChar ac;
+    ac.character = "a";
+    ac.confidence = 90;
+    for (int c = 0; c < 4; c++)
+    {
+      ac.corners[c].x = c;
+      ac.corners[c].y = c * 2;
+    }
+    ap.character_details.push_back(ac);
+    apr.topNPlates.push_back(ap);
+  }
+  apr.bestPlate = apr.topNPlates[1];
+  for (int i = 0; i < 4; i++)
+  {
+    apr.plate_points[i].x = i;
+    apr.plate_points[i].y = i + 1;
+  }
+  apr.country = "us";
+  apr.plate_index = 0;
+  apr.processing_time_ms = 30;
+  apr.requested_topn = 10;
+  apr.region = "mo";
+  apr.regionConfidence = 80;
+  apr.quality.score = 72.5;
+  apr.quality.sharpness = 310;
+  apr.quality.char_height = 24;
+  apr.quality.contrast = 41;
+  apr.quality.clipped = 0.02;
+
+  origResults.plates.push_back(apr);
+  origResults.ocr_quality_skipped = 3;
+
+  std::string encoded = Alpr::toBinary(origResults);
+  AlprResults roundTrip = Alpr::fromBinary(encoded);
+
+  REQUIRE( roundTrip.epoch_time == origResults.epoch_time );
+  REQUIRE( roundTrip.img_width == origResults.img_width );
+  REQUIRE( roundTrip.profile == origResults.profile );
+  REQUIRE( roundTrip.regionsOfInterest.size() == 1 );
+  REQUIRE( roundTrip.regionsOfInterest[0].x == 259 );
+  REQUIRE( roundTrip.regionsOfInterest[0].height == 150 );
+
+  REQUIRE( roundTrip.plates.size() == 1 );
+  REQUIRE( roundTrip.plates[0].country == "us" );
+  REQUIRE( roundTrip.plates[0].region == "mo" );
+  REQUIRE( roundTrip.plates[0].plate_points[3].y == 4 );
+  REQUIRE( roundTrip.plates[0].bestPlate.matches_template == true );
+  REQUIRE( roundTrip.plates[0].topNPlates.size() == 2 );
+  REQUIRE( roundTrip.plates[0].topNPlates[1].character_details.size() == 1 );
+  REQUIRE( roundTrip.plates[0].topNPlates[1].character_details[0].corners[2].y == 4 );
+  REQUIRE( roundTrip.ocr_quality_skipped == 3 );
+  REQUIRE( roundTrip.plates[0].quality.score == 72.5f );
+  REQUIRE( roundTrip.plates[0].quality.sharpness == 310 );
+  REQUIRE( roundTrip.plates[0].quality.char_height == 24 );
+  REQUIRE( roundTrip.plates[0].quality.contrast == 41 );
+  REQUIRE( roundTrip.plates[0].quality.clipped == 0.02f );
+
+  // Truncated data is rejected rather than half-parsed
+  AlprResults truncated = Alpr::fromBinary(encoded.substr(0, encoded.size() / 2));
+  REQUIRE( truncated.plates.size() == 0 );
+}
@@ -9,6 +9,7 @@
 #include "catch.hpp"
 #include "config.h"
 #include "alpr.h"
+#include "support/filesystem.h"
 
 using namespace std;
 using namespace alpr;
@@ -53,6 +54,28 @@ TEST_CASE( "Modifying Countries", "[Config]" )
   REQUIRE(config.ocrLanguage == "lus");
 }
 
+TEST_CASE( "Country snapshots are reused", "[Config]" )
+{
+  Config config("us,eu", OPENALPR_TESTING_CONFIG_PATH, OPENALPR_TESTING_RUNTIME_DIR);
+
+  const CountryConfig* us = config.getCountryConfig("us");
+  REQUIRE(us != NULL);
+  REQUIRE(us->ocrLanguage == "lus");
+  REQUIRE(config.getCountryConfig("kr") == NULL);
+
+  uint64_t lookups = getFilesystemLookupCount();
+
+  config.setCountry("eu");
+  REQUIRE(config.countryConfig->ocrLanguage == "leu");
+
+  config.setCountry("us");
+  REQUIRE(config.countryConfig == us);
+  REQUIRE(config.ocrLanguage == "lus");
+
+  // Switching between loaded countries must not hit the file system
+  REQUIRE(getFilesystemLookupCount() == lookups);
+}
+
 TEST_CASE( "Reloading Countries", "[Config]" )
 {
   Alpr alpr("us", OPENALPR_TESTING_CONFIG_PATH, OPENALPR_TESTING_RUNTIME_DIR);
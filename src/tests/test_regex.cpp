@@ -2,6 +2,7 @@
 #include "utility.h"
 #include "catch.hpp"
 #include "postprocess/regexrule.h"
+#include "postprocess/pattern_automaton.h"
 
 using namespace std;
 using namespace cv;
@@ -105,4 +106,38 @@ TEST_CASE( "Invalid tests", "[Regex]" ) {
   
   RegexRule rule2("us", "A####]", "\\pL", "\\pN");
   REQUIRE( rule2.match("A1234") == false);
-}
\ No newline at end of file
+}
+
+TEST_CASE( "Compiled patterns agree with the regexes", "[Regex]" ) {
+  vector<RegexRule*> rules;
+  rules.push_back(new RegexRule("us", "@@@####", "[A-Z]", "[0-9]"));
+  rules.push_back(new RegexRule("us", "[ABC]@@###", "[A-Z]", "[0-9]"));
+  rules.push_back(new RegexRule("us", "\\d\\d\\D\\D", "[A-Z]", "[0-9]"));
+  
+  PatternAutomaton automaton(rules);
+  REQUIRE( automaton.isValid() == true );
+  REQUIRE( automaton.getMaxLength() == 7 );
+  
+  const char* texts[] = { "ABC1234", "ZBC1234", "ABC123", "ZBC123", "11AA", "AA11", "AB\n1234", "ABC12345", "", "ABC-234" };
+  for (int i = 0; i < 10; i++)
+  {
+    bool expected = false;
+    for (int r = 0; r < rules.size(); r++)
+      expected = expected || rules[r]->match(texts[i]);
+    REQUIRE( automaton.matches(texts[i]) == expected );
+  }
+  
+  // A prefix that no pattern can finish is dead from its first character
+  REQUIRE( automaton.getAcceptMasks("-")[0] == 0 );
+  REQUIRE( automaton.getAcceptMasks("A")[0] == 3 );
+  
+  // Patterns that are not one class per character are left to the regexes
+  vector<RegexRule*> wildcard;
+  wildcard.push_back(new RegexRule("us", "@@@#*", "[A-Z]", "[0-9]"));
+  PatternAutomaton unsupported(wildcard);
+  REQUIRE( unsupported.isValid() == false );
+  
+  for (int r = 0; r < rules.size(); r++)
+    delete rules[r];
+  delete wildcard[0];
+}
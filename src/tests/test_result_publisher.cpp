@@ -0,0 +1,562 @@
+/*
+ * Tests for alprd's ResultPublisher and ResultUploader against minimal
+ * in-process stand-ins for beanstalkd and an HTTP endpoint.
+ */
+
+#include <cstdlib>
+#include <cstring>
+#include <csignal>
+#include <sstream>
+#include <deque>
+#include <map>
+#include <unistd.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+
+#include "daemon/result_publisher.h"
+#include "support/platform.h"
+#include "support/tinythread.h"
+#include "catch.hpp"
+
+using namespace std;
+
+namespace
+{
+
+  // Listens on an ephemeral localhost port and serves each connection on its own thread
+  class StandInServer
+  {
+    public:
+      StandInServer() : connections(0), listenFd(-1), stopping(false), acceptThread(NULL)
+      {
+        signal(SIGPIPE, SIG_IGN);
+
+        listenFd = socket(AF_INET, SOCK_STREAM, 0);
+        int yes = 1;
+        setsockopt(listenFd, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes));
+
+        sockaddr_in addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        addr.sin_port = 0;
+        bind(listenFd, (sockaddr*) &addr, sizeof(addr));
+        listen(listenFd, 8);
+
+        socklen_t len = sizeof(addr);
+        getsockname(listenFd, (sockaddr*) &addr, &len);
+        port = ntohs(addr.sin_port);
+      }
+
+      virtual ~StandInServer()
+      {
+        stop();
+      }
+
+      void start()
+      {
+        acceptThread = new tthread::thread(acceptLoop, (void*) this);
+      }
+
+      void stop()
+      {
+        if (acceptThread == NULL)
+          return;
+
+        mtx.lock();
+        stopping = true;
+        for (size_t i = 0; i < clientFds.size(); i++)
+          shutdown(clientFds[i], SHUT_RDWR);
+        mtx.unlock();
+
+        shutdown(listenFd, SHUT_RDWR);
+        close(listenFd);
+        acceptThread->join();
+        delete acceptThread;
+        acceptThread = NULL;
+
+        for (size_t i = 0; i < clientThreads.size(); i++)
+        {
+          clientThreads[i]->join();
+          delete clientThreads[i];
+        }
+        clientThreads.clear();
+      }
+
+      int port;
+      int connections;
+      tthread::mutex mtx;
+
+    protected:
+      // Serves one connection until it closes
+      virtual void serve(int fd) = 0;
+
+      // Reads up to and including the next CRLF into line (without the CRLF)
+      bool readLine(int fd, std::string& buffered, std::string& line)
+      {
+        while (true)
+        {
+          size_t pos = buffered.find("\r\n");
+          if (pos != std::string::npos)
+          {
+            line = buffered.substr(0, pos);
+            buffered.erase(0, pos + 2);
+            return true;
+          }
+          if (!fill(fd, buffered))
+            return false;
+        }
+      }
+
+      bool readBytes(int fd, std::string& buffered, size_t bytes, std::string& out)
+      {
+        while (buffered.size() < bytes)
+          if (!fill(fd, buffered))
+            return false;
+        out = buffered.substr(0, bytes);
+        buffered.erase(0, bytes);
+        return true;
+      }
+
+      void sendAll(int fd, const std::string& data)
+      {
+        send(fd, data.data(), data.size(), 0);
+      }
+
+    private:
+      struct ClientStart
+      {
+        StandInServer* server;
+        int fd;
+      };
+
+      int listenFd;
+      bool stopping;
+      tthread::thread* acceptThread;
+      std::vector<tthread::thread*> clientThreads;
+      std::vector<int> clientFds;
+
+      bool fill(int fd, std::string& buffered)
+      {
+        char buf[4096];
+        ssize_t got = recv(fd, buf, sizeof(buf), 0);
+        if (got <= 0)
+          return false;
+        buffered.append(buf, got);
+        return true;
+      }
+
+      static void acceptLoop(void* arg)
+      {
+        StandInServer* self = (StandInServer*) arg;
+        while (true)
+        {
+          int fd = accept(self->listenFd, NULL, NULL);
+          if (fd < 0)
+            return;
+
+          self->mtx.lock();
+          if (self->stopping)
+          {
+            self->mtx.unlock();
+            close(fd);
+            return;
+          }
+          self->connections++;
+          self->clientFds.push_back(fd);
+          ClientStart* start = new ClientStart();
+          start->server = self;
+          start->fd = fd;
+          self->clientThreads.push_back(new tthread::thread(clientLoop, (void*) start));
+          self->mtx.unlock();
+        }
+      }
+
+      static void clientLoop(void* arg)
+      {
+        ClientStart* start = (ClientStart*) arg;
+        start->server->serve(start->fd);
+        close(start->fd);
+        delete start;
+      }
+  };
+
+  // Enough of the beanstalkd protocol for a single tube
+  class StandInBeanstalkd : public StandInServer
+  {
+    public:
+      StandInBeanstalkd() : nextId(1), dropAfterPuts(-1), maxJobBytes(0) {}
+
+      std::vector<std::string> putBodies;
+      std::deque<std::pair<int, std::string> > ready;
+      std::map<int, std::string> reserved;
+      int nextId;
+      // Closes the connection right after acknowledging this many puts (once)
+      int dropAfterPuts;
+      // Answers JOB_TOO_BIG to puts over this many bytes (0 for no limit)
+      size_t maxJobBytes;
+
+      void addJob(const std::string& body)
+      {
+        mtx.lock();
+        ready.push_back(std::make_pair(nextId++, body));
+        mtx.unlock();
+      }
+
+      size_t putCount()
+      {
+        mtx.lock();
+        size_t count = putBodies.size();
+        mtx.unlock();
+        return count;
+      }
+
+      size_t waitingJobs()
+      {
+        mtx.lock();
+        size_t count = ready.size() + reserved.size();
+        mtx.unlock();
+        return count;
+      }
+
+    protected:
+      void serve(int fd)
+      {
+        std::string buffered, line;
+        while (readLine(fd, buffered, line))
+        {
+          std::istringstream cmd(line);
+          std::string verb;
+          cmd >> verb;
+
+          if (verb == "use" || verb == "watch")
+          {
+            std::string tube;
+            cmd >> tube;
+            sendAll(fd, verb == "use" ? "USING " + tube + "\r\n" : "WATCHING 1\r\n");
+          }
+          else if (verb == "put")
+          {
+            unsigned int pri, delay, ttr;
+            size_t bytes;
+            cmd >> pri >> delay >> ttr >> bytes;
+            std::string body, crlf;
+            if (!readBytes(fd, buffered, bytes, body) || !readBytes(fd, buffered, 2, crlf))
+              return;
+
+            if (maxJobBytes > 0 && body.size() > maxJobBytes)
+            {
+              sendAll(fd, "JOB_TOO_BIG\r\n");
+              continue;
+            }
+
+            mtx.lock();
+            int id = nextId++;
+            putBodies.push_back(body);
+            ready.push_back(std::make_pair(id, body));
+            bool drop = dropAfterPuts > 0 && (int) putBodies.size() == dropAfterPuts;
+            if (drop)
+              dropAfterPuts = -1;
+            mtx.unlock();
+
+            std::ostringstream reply;
+            reply << "INSERTED " << id << "\r\n";
+            sendAll(fd, reply.str());
+            if (drop)
+              return;
+          }
+          else if (verb == "reserve-with-timeout")
+          {
+            int timeoutSecs;
+            cmd >> timeoutSecs;
+            std::string reply = "TIMED_OUT\r\n";
+            for (int waited = 0; waited <= timeoutSecs * 1000; waited += 10)
+            {
+              mtx.lock();
+              if (!ready.empty())
+              {
+                std::pair<int, std::string> job = ready.front();
+                ready.pop_front();
+                reserved[job.first] = job.second;
+                std::ostringstream out;
+                out << "RESERVED " << job.first << " " << job.second.size() << "\r\n" << job.second << "\r\n";
+                reply = out.str();
+                mtx.unlock();
+                break;
+              }
+              mtx.unlock();
+              if (timeoutSecs == 0)
+                break;
+              alpr::sleep_ms(10);
+            }
+            sendAll(fd, reply);
+          }
+          else if (verb == "delete" || verb == "release")
+          {
+            int id;
+            cmd >> id;
+            mtx.lock();
+            if (verb == "release")
+              ready.push_back(std::make_pair(id, reserved[id]));
+            reserved.erase(id);
+            mtx.unlock();
+            sendAll(fd, verb == "delete" ? "DELETED\r\n" : "RELEASED\r\n");
+          }
+          else
+          {
+            sendAll(fd, "UNKNOWN_COMMAND\r\n");
+          }
+        }
+      }
+  };
+
+  // Accepts keep-alive POSTs and records their bodies
+  class StandInHttpServer : public StandInServer
+  {
+    public:
+      StandInHttpServer() : failFirst(0) {}
+
+      std::vector<std::string> bodies;
+      // Answers this many requests with a 500 before accepting any
+      int failFirst;
+
+      size_t postCount()
+      {
+        mtx.lock();
+        size_t count = bodies.size();
+        mtx.unlock();
+        return count;
+      }
+
+    protected:
+      void serve(int fd)
+      {
+        std::string buffered, line;
+        while (true)
+        {
+          size_t contentLength = 0;
+          if (!readLine(fd, buffered, line))
+            return;
+          while (readLine(fd, buffered, line) && !line.empty())
+          {
+            if (strncasecmp(line.c_str(), "Content-Length:", 15) == 0)
+              contentLength = strtoul(line.c_str() + 15, NULL, 10);
+          }
+
+          std::string body;
+          if (!readBytes(fd, buffered, contentLength, body))
+            return;
+
+          mtx.lock();
+          bool fail = failFirst > 0;
+          if (fail)
+            failFirst--;
+          else
+            bodies.push_back(body);
+          mtx.unlock();
+
+          sendAll(fd, fail ? "HTTP/1.1 500 Internal Server Error\r\nContent-Length: 0\r\n\r\n"
+                           : "HTTP/1.1 200 OK\r\nContent-Length: 0\r\n\r\n");
+        }
+      }
+  };
+
+  template <typename Predicate>
+  bool waitFor(Predicate done, int timeoutMs = 5000)
+  {
+    for (int waited = 0; waited < timeoutMs; waited += 10)
+    {
+      if (done())
+        return true;
+      alpr::sleep_ms(10);
+    }
+    return done();
+  }
+
+  std::string result(int i)
+  {
+    std::ostringstream ss;
+    ss << "{\"id\":" << i << "}";
+    return ss.str();
+  }
+
+}
+
+
+TEST_CASE( "Publisher keeps one connection and batches bursts", "[publisher]" ) {
+
+  StandInBeanstalkd queue;
+  queue.start();
+
+  ResultPublisherParams params;
+  params.port = queue.port;
+  params.batchSize = 8;
+
+  ResultPublisher publisher(params);
+  for (int i = 0; i < 20; i++)
+    publisher.publish(result(i));
+  publisher.start();
+
+  REQUIRE( waitFor([&]() { return publisher.stats().published == 20; }) );
+  publisher.stop();
+
+  // 20 results queued up front go out as 8 + 8 + 4, in order, over a single connection
+  REQUIRE( queue.connections == 1 );
+  REQUIRE( queue.putBodies.size() == 3 );
+  REQUIRE( queue.putBodies[0] == "[" + result(0) + "," + result(1) + "," + result(2) + "," + result(3) + ","
+                                     + result(4) + "," + result(5) + "," + result(6) + "," + result(7) + "]" );
+  REQUIRE( queue.putBodies[2] == "[" + result(16) + "," + result(17) + "," + result(18) + "," + result(19) + "]" );
+
+  queue.stop();
+}
+
+TEST_CASE( "Publisher reconnects and keeps results while beanstalkd is away", "[publisher]" ) {
+
+  StandInBeanstalkd queue;
+  queue.dropAfterPuts = 1;
+  queue.start();
+
+  ResultPublisherParams params;
+  params.port = queue.port;
+  params.initialBackoffMs = 10;
+
+  ResultPublisher publisher(params);
+  publisher.start();
+
+  publisher.publish(result(0));
+  REQUIRE( waitFor([&]() { return queue.putCount() == 1; }) );
+
+  // The stand-in has hung up; the next results must arrive over a new connection
+  for (int i = 1; i < 5; i++)
+    publisher.publish(result(i));
+  REQUIRE( waitFor([&]() { return queue.putCount() == 5; }) );
+  publisher.stop();
+
+  REQUIRE( queue.connections == 2 );
+  for (int i = 0; i < 5; i++)
+    REQUIRE( queue.putBodies[i] == result(i) );
+  REQUIRE( publisher.stats().dropped == 0 );
+
+  queue.stop();
+}
+
+TEST_CASE( "Publisher drops jobs beanstalkd rejects and keeps publishing", "[publisher]" ) {
+
+  StandInBeanstalkd queue;
+  queue.maxJobBytes = 40;
+  queue.start();
+
+  std::string oversized = "{\"plate\":\"" + std::string(100, 'X') + "\"}";
+
+  SECTION( "one result per job" ) {
+    ResultPublisherParams params;
+    params.port = queue.port;
+    params.initialBackoffMs = 10;
+
+    ResultPublisher publisher(params);
+    publisher.start();
+
+    publisher.publish(result(0));
+    publisher.publish(oversized);
+    publisher.publish(result(2));
+    REQUIRE( waitFor([&]() { return publisher.stats().published == 2; }) );
+    publisher.stop();
+
+    REQUIRE( publisher.stats().dropped == 1 );
+    REQUIRE( queue.connections == 1 );
+    REQUIRE( queue.putBodies.size() == 2 );
+    REQUIRE( queue.putBodies[0] == result(0) );
+    REQUIRE( queue.putBodies[1] == result(2) );
+  }
+
+  SECTION( "a rejected batch is retried one result per job" ) {
+    ResultPublisherParams params;
+    params.port = queue.port;
+    params.batchSize = 8;
+    params.initialBackoffMs = 10;
+
+    ResultPublisher publisher(params);
+    publisher.publish(result(0));
+    publisher.publish(result(1));
+    publisher.publish(oversized);
+    publisher.publish(result(3));
+    publisher.start();
+
+    REQUIRE( waitFor([&]() { return publisher.stats().published == 3; }) );
+
+    // Later results are not stuck behind the refused one
+    publisher.publish(result(4));
+    REQUIRE( waitFor([&]() { return publisher.stats().published == 4; }) );
+    publisher.stop();
+
+    REQUIRE( publisher.stats().dropped == 1 );
+    REQUIRE( queue.connections == 1 );
+    REQUIRE( queue.putBodies.size() == 4 );
+    REQUIRE( queue.putBodies[0] == "[" + result(0) + "]" );
+    REQUIRE( queue.putBodies[1] == "[" + result(1) + "]" );
+    REQUIRE( queue.putBodies[2] == "[" + result(3) + "]" );
+    REQUIRE( queue.putBodies[3] == "[" + result(4) + "]" );
+  }
+
+  queue.stop();
+}
+
+TEST_CASE( "Publisher bounds the results it holds", "[publisher]" ) {
+
+  ResultPublisherParams params;
+  params.maxPending = 3;
+
+  // Not started, so nothing drains and the oldest results give way
+  ResultPublisher publisher(params);
+  for (int i = 0; i < 5; i++)
+    publisher.publish(result(i));
+
+  REQUIRE( publisher.stats().dropped == 2 );
+}
+
+TEST_CASE( "Uploader merges queued jobs into one POST", "[publisher]" ) {
+
+  REQUIRE( ResultUploader::mergeBodies(std::vector<std::string>()) == "[]" );
+
+  std::vector<std::string> bodies;
+  bodies.push_back(result(0));
+  bodies.push_back(" [" + result(1) + "," + result(2) + "]\n");
+  bodies.push_back("[]");
+  REQUIRE( ResultUploader::mergeBodies(bodies) == "[" + result(0) + "," + result(1) + "," + result(2) + "]" );
+
+  StandInBeanstalkd queue;
+  for (int i = 0; i < 6; i++)
+    queue.addJob(result(i));
+  queue.start();
+
+  StandInHttpServer http;
+  http.failFirst = 1;
+  http.start();
+
+  std::ostringstream url;
+  url << "http://127.0.0.1:" << http.port << "/push/";
+
+  ResultUploaderParams params;
+  params.port = queue.port;
+  params.url = url.str();
+  params.batchSize = 4;
+  params.retryDelayMs = 10;
+
+  ResultUploader uploader(params);
+  uploader.start();
+
+  REQUIRE( waitFor([&]() { return queue.waitingJobs() == 0; }) );
+  uploader.stop();
+
+  // The failed first POST releases its jobs behind the two that were still waiting
+  REQUIRE( uploader.stats().failedPosts == 1 );
+  REQUIRE( uploader.stats().jobsUploaded == 6 );
+  REQUIRE( http.bodies.size() == 2 );
+  REQUIRE( http.bodies[0] == "[" + result(4) + "," + result(5) + "," + result(0) + "," + result(1) + "]" );
+  REQUIRE( http.bodies[1] == "[" + result(2) + "," + result(3) + "]" );
+  REQUIRE( http.connections == 1 );
+
+  http.stop();
+  queue.stop();
+}
@@ -6,7 +6,25 @@
  */
 
 #include <cstdlib>
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <unistd.h>
 #include "utility.h"
+#include "stage_stats.h"
+#include "reduced_decode.h"
+#include "plate_tracker.h"
+#include "crop_quality.h"
+#include "motiondetector.h"
+#include "detection/detection_tiling.h"
+#include "detection/detector.h"
+#include "prewarp.h"
+#include "ocr/ocr_pass_cache.h"
+#include "support/checkout_pool.h"
+#include "statedetection/descriptor_index.h"
+#include "statedetection/keypoint_cache.h"
 #include "catch.hpp"
 
 using namespace std;
@@ -63,4 +81,712 @@ TEST_CASE( "Test Levenshtein Distance", "[levenshtein]" ) {
   
   REQUIRE( levenshteinDistance("", "AAAA", 2) == 2 );
   REQUIRE( levenshteinDistance("BA", "AAAA", 2) == 2 );
-}
\ No newline at end of file
+}
+TEST_CASE( "Shared binarization matches per-window binarization", "[binarize]" ) {
+
+  vector<BinarizeWindow> windows(3);
+  windows[0].version = WOLFJOLION;
+  windows[0].winx = windows[0].winy = 18;
+  windows[0].k = 0.05;
+  windows[1].version = WOLFJOLION;
+  windows[1].winx = windows[1].winy = 22;
+  windows[1].k = 0.40;
+  windows[2].version = SAUVOLA;
+  windows[2].winx = windows[2].winy = 12;
+  windows[2].k = 0.18;
+
+  // Plate-sized crops plus sizes right at the window limits
+  Size sizes[] = { Size(120, 60), Size(200, 40), Size(100, 23), Size(23, 100) };
+
+  RNG rng(12345);
+  for (int s = 0; s < 4; s++)
+  {
+    Mat img(sizes[s], CV_8U);
+    rng.fill(img, RNG::UNIFORM, 0, 256);
+    GaussianBlur(img, img, Size(5, 5), 0);
+
+    vector<Mat> shared;
+    NiblackSauvolaWolfJolionInv(img, windows, shared);
+    REQUIRE( shared.size() == windows.size() );
+
+    for (unsigned int w = 0; w < windows.size(); w++)
+    {
+      Mat separate(img.size(), CV_8U);
+      NiblackSauvolaWolfJolion(img, separate, windows[w].version, windows[w].winx, windows[w].winy, windows[w].k);
+      bitwise_not(separate, separate);
+
+      Mat diff;
+      compare(separate, shared[w], diff, CMP_NE);
+      REQUIRE( countNonZero(diff) == 0 );
+    }
+  }
+}
+
+TEST_CASE( "Stage latency histogram buckets", "[stagestats]" ) {
+
+  // Exact for small values
+  for (uint64_t us = 0; us < 16; us++)
+    REQUIRE( LatencyHistogram::bucketUpperBound(LatencyHistogram::bucketFor(us)) == us );
+
+  // Buckets are ordered and every value lands within 1/16 of its bucket's bound
+  int lastBucket = 0;
+  for (uint64_t us = 1; us < 100000000; us = us * 5 / 4 + 1)
+  {
+    int bucket = LatencyHistogram::bucketFor(us);
+    REQUIRE( bucket >= lastBucket );
+    REQUIRE( bucket < LatencyHistogram::BUCKET_COUNT );
+
+    uint64_t upper = LatencyHistogram::bucketUpperBound(bucket);
+    REQUIRE( upper >= us );
+    REQUIRE( upper - us <= us / 16 + 1 );
+    lastBucket = bucket;
+  }
+
+  REQUIRE( LatencyHistogram::bucketFor(UINT64_MAX) == LatencyHistogram::BUCKET_COUNT - 1 );
+}
+
+TEST_CASE( "Stage latency stats", "[stagestats]" ) {
+
+  std::vector<AlprStageStats> before = collectStageStats();
+  for (int i = 0; i < 100; i++)
+    recordStageLatency(STAGE_POSTPROCESS, 1000);
+  recordStageLatency(STAGE_POSTPROCESS, 50000);
+
+  std::vector<AlprStageStats> after = collectStageStats();
+  REQUIRE( after.size() == before.size() );
+
+  AlprStageStats stats;
+  for (unsigned int i = 0; i < after.size(); i++)
+  {
+    if (after[i].stage == stageName(STAGE_POSTPROCESS))
+      stats = after[i];
+  }
+  REQUIRE( stats.count >= 101 );
+  REQUIRE( stats.max_ms >= 50 );
+  REQUIRE( stats.p50_ms <= stats.p99_ms );
+
+  std::string text = formatStageStatsPrometheus(after, "camera=\"1\"");
+  REQUIRE( text.find("openalpr_stage_latency_seconds_bucket{camera=\"1\",stage=\"postprocess\",le=\"+Inf\"}") != std::string::npos );
+}
+
+
+TEST_CASE( "Reduced decode helpers", "[reduceddecode]" ) {
+
+  // SOI, an APP0 segment, a DQT segment, then SOF0 for a 4000x3000 frame
+  const unsigned char jpeg[] = {
+    0xFF, 0xD8,
+    0xFF, 0xE0, 0x00, 0x06, 'J', 'F', 'I', 'F',
+    0xFF, 0xDB, 0x00, 0x03, 0x00,
+    0xFF, 0xC0, 0x00, 0x11, 0x08, 0x0B, 0xB8, 0x0F, 0xA0, 0x03
+  };
+  int width = 0;
+  int height = 0;
+  REQUIRE( readJpegSize(jpeg, sizeof(jpeg), width, height) );
+  REQUIRE( width == 4000 );
+  REQUIRE( height == 3000 );
+
+  // Cut off before the frame header, and not a JPEG at all
+  REQUIRE( readJpegSize(jpeg, 16, width, height) == false );
+  const unsigned char png[] = { 0x89, 'P', 'N', 'G', 0x0D, 0x0A, 0x1A, 0x0A };
+  REQUIRE( readJpegSize(png, sizeof(png), width, height) == false );
+
+  REQUIRE( chooseDecodeReduction(4000, 3000, 1280, 720) == 2 );
+  REQUIRE( chooseDecodeReduction(12000, 9000, 1280, 720) == 8 );
+  REQUIRE( chooseDecodeReduction(1920, 1080, 1280, 720) == 1 );
+
+  // Reduced rectangles cover the whole region, and scaling back up stays inside the frame
+  Rect down = scaleRectDown(Rect(101, 50, 203, 99), 4);
+  REQUIRE( down == Rect(25, 12, 51, 26) );
+  Rect up = scaleRectUp(down, 4, 300, 200);
+  REQUIRE( up == Rect(100, 48, 200, 104) );
+
+  // No EXIF is upright; an APP1 Exif segment (little-endian TIFF) with orientation 6 is rotated
+  REQUIRE( readJpegOrientation(jpeg, sizeof(jpeg)) == 1 );
+  const unsigned char exif[] = {
+    0xFF, 0xD8,
+    0xFF, 0xE1, 0x00, 0x22, 'E', 'x', 'i', 'f', 0x00, 0x00,
+    'I', 'I', 0x2A, 0x00, 0x08, 0x00, 0x00, 0x00,
+    0x01, 0x00, 0x12, 0x01, 0x03, 0x00, 0x01, 0x00, 0x00, 0x00, 0x06, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00,
+    0xFF, 0xC0, 0x00, 0x11, 0x08, 0x0B, 0xB8, 0x0F, 0xA0, 0x03
+  };
+  REQUIRE( readJpegOrientation(exif, sizeof(exif)) == 6 );
+  REQUIRE( readJpegSize(exif, sizeof(exif), width, height) );
+  REQUIRE( width == 4000 );
+
+  // Regions are padded by their height and merged; children count, and bands stop at the frame
+  vector<PlateRegion> regions(2);
+  regions[0].rect = Rect(10, 100, 80, 20);
+  regions[1].rect = Rect(10, 130, 80, 20);
+  PlateRegion child;
+  child.rect = Rect(0, 470, 5, 20);
+  regions[1].children.push_back(child);
+  vector<Range> bands = plateRowBands(regions, 480);
+  REQUIRE( bands.size() == 2 );
+  REQUIRE( bands[0].start == 80 );
+  REQUIRE( bands[0].end == 170 );
+  REQUIRE( bands[1].start == 450 );
+  REQUIRE( bands[1].end == 480 );
+}
+
+
+TEST_CASE( "Plate tracker matching helpers", "[platetracker]" ) {
+
+  REQUIRE( PlateTracker::iou(Rect(0, 0, 100, 40), Rect(0, 0, 100, 40)) == Approx(1.0) );
+  REQUIRE( PlateTracker::iou(Rect(0, 0, 100, 40), Rect(50, 0, 100, 40)) == Approx(1.0 / 3) );
+  REQUIRE( PlateTracker::iou(Rect(0, 0, 100, 40), Rect(200, 0, 100, 40)) == 0 );
+
+  Mat frame(120, 320, CV_8U);
+  randu(frame, 0, 200);
+  Rect plate(40, 30, 160, 50);
+
+  // The same crop under brighter light still looks the same; a different crop doesn't
+  Mat brighter;
+  frame.convertTo(brighter, -1, 1, 20);
+  Mat a = PlateTracker::appearance(frame, plate);
+  REQUIRE( PlateTracker::appearanceDiff(a, PlateTracker::appearance(brighter, plate)) < 1 );
+  REQUIRE( PlateTracker::appearanceDiff(a, PlateTracker::appearance(frame, Rect(150, 60, 160, 50))) > 12 );
+
+  // Regions outside the image have no appearance and never match
+  REQUIRE( PlateTracker::appearance(frame, Rect(400, 0, 50, 20)).empty() );
+  REQUIRE( PlateTracker::appearanceDiff(a, Mat()) > 1000 );
+}
+
+
+TEST_CASE( "Crop quality score", "[cropquality]" ) {
+
+  // Sharp, tall, contrasty and unclipped reads as fully usable
+  REQUIRE( combineCropQuality(800, 30, 60, 0) == Approx(100) );
+
+  // Each measurement below its reference lowers the score; blur alone is enough to rank a crop lower
+  float sharp = combineCropQuality(400, 20, 40, 0);
+  float blurred = combineCropQuality(50, 20, 40, 0);
+  REQUIRE( blurred < sharp );
+  REQUIRE( blurred == Approx(50) );
+  REQUIRE( combineCropQuality(400, 10, 40, 0) < sharp );
+  REQUIRE( combineCropQuality(400, 20, 40, 0.25) == Approx(50) );
+
+  // Half the crop blown out leaves nothing to read
+  REQUIRE( combineCropQuality(400, 20, 40, 0.5) == 0 );
+  REQUIRE( combineCropQuality(0, 20, 40, 0) == 0 );
+}
+
+
+TEST_CASE( "Motion regions are clustered, not unioned", "[motion]" ) {
+
+  // Two cars in opposite lanes stay separate; blobs of one car within the gap merge
+  std::vector<Rect> blobs;
+  blobs.push_back(Rect(10, 100, 40, 30));
+  blobs.push_back(Rect(52, 105, 20, 20));
+  blobs.push_back(Rect(250, 20, 50, 40));
+
+  std::vector<Rect> regions = MotionDetector::clusterRects(blobs, 5, 6);
+  REQUIRE( regions.size() == 2 );
+  REQUIRE( regions[0] == Rect(10, 100, 62, 30) );
+  REQUIRE( regions[1] == Rect(250, 20, 50, 40) );
+
+  // Capped at maxRegions by merging the pair that grows least
+  blobs.push_back(Rect(250, 200, 50, 40));
+  regions = MotionDetector::clusterRects(blobs, 5, 2);
+  REQUIRE( regions.size() == 2 );
+  REQUIRE( regions[0] == Rect(10, 100, 62, 30) );
+  REQUIRE( regions[1] == Rect(250, 20, 50, 220) );
+}
+
+TEST_CASE( "Motion restarts from the next frame", "[motion]" ) {
+
+  MotionDetector detector;
+  Mat background(120, 160, CV_8UC3, Scalar(40, 40, 40));
+  Mat other(120, 160, CV_8UC3, Scalar(200, 200, 200));
+
+  // The first frame of each video is searched whole, not compared with the last video
+  REQUIRE( detector.detect(background).size() == 1 );
+  detector.detect(background);
+
+  detector.restart();
+  std::vector<MotionRegion> regions = detector.detect(other);
+  REQUIRE( regions.size() == 1 );
+  REQUIRE( regions[0].rect == Rect(0, 0, 160, 120) );
+  REQUIRE( regions[0].activity == 1 );
+}
+
+
+TEST_CASE( "Descriptor index shortlist", "[stateindex]" ) {
+
+  RNG rng(1234);
+
+  // Whole 8-byte words and the byte tail after them count the same as OpenCV does
+  for (int bytes = 1; bytes <= 67; bytes += 11)
+  {
+    Mat a(1, bytes, CV_8U);
+    Mat b(1, bytes, CV_8U);
+    rng.fill(a, RNG::UNIFORM, 0, 256);
+    rng.fill(b, RNG::UNIFORM, 0, 256);
+    REQUIRE( DescriptorIndex::hammingDistance(a.ptr<unsigned char>(0), b.ptr<unsigned char>(0), bytes) == (int) norm(a, b, NORM_HAMMING) );
+  }
+
+  // Ten reference images of random 64-byte (BRISK-sized) descriptors
+  std::vector<Mat> references;
+  for (int i = 0; i < 10; i++)
+  {
+    Mat descriptors(50, 64, CV_8U);
+    rng.fill(descriptors, RNG::UNIFORM, 0, 256);
+    references.push_back(descriptors);
+  }
+
+  DescriptorIndex index;
+  REQUIRE( index.shortlist(references[0], 40, 3).empty() );
+  index.build(references);
+  REQUIRE( index.isBuilt() );
+
+  // An image's own descriptors rank it first
+  std::vector<int> shortlist = index.shortlist(references[6], 40, 3);
+  REQUIRE( shortlist.size() >= 1 );
+  REQUIRE( shortlist[0] == 6 );
+
+  // So do the same descriptors with one or two bits flipped
+  Mat perturbed = references[3].rowRange(0, 20).clone();
+  for (int r = 0; r < perturbed.rows; r++)
+  {
+    int bit = (r * 37) % 512;
+    perturbed.at<unsigned char>(r, bit / 8) ^= (unsigned char) (1 << (bit % 8));
+    if (r % 2 == 1)
+      perturbed.at<unsigned char>(r, (bit + 200) % 512 / 8) ^= (unsigned char) (1 << ((bit + 200) % 8));
+  }
+  shortlist = index.shortlist(perturbed, 40, 3);
+  REQUIRE( shortlist.size() >= 1 );
+  REQUIRE( shortlist[0] == 3 );
+
+  // Descriptors of another width can't be compared
+  REQUIRE( index.shortlist(references[3].colRange(0, 32).clone(), 40, 3).empty() );
+}
+
+
+TEST_CASE( "Detection tiles cover the frame and merge across seams", "[tiling]" ) {
+
+  // The last tile is pulled back to end at the frame edge
+  std::vector<int> starts = tileStarts(1000, 300, 100);
+  REQUIRE( starts.size() == 5 );
+  REQUIRE( starts.front() == 0 );
+  REQUIRE( starts.back() == 700 );
+  REQUIRE( tileStarts(500, 300, 100).size() == 2 );
+  REQUIRE( tileStarts(200, 300, 100) == std::vector<int>(1, 0) );
+
+  // A 4K-wide frame: every pixel is covered, no tile leaves the frame, and neighbouring
+  // tiles overlap by at least the largest plate
+  Size frame(3840, 1080);
+  Size max_plate(400, 130);
+  std::vector<Rect> tiles = detectionTiles(frame, Size(60, 20), max_plate, 3);
+  REQUIRE( tiles.size() > 1 );
+
+  Mat covered = Mat::zeros(frame, CV_8U);
+  std::vector<int> xs;
+  std::vector<int> ys;
+  for (unsigned int i = 0; i < tiles.size(); i++)
+  {
+    REQUIRE( tiles[i].size() == Size(1200, 390) );
+    REQUIRE( (tiles[i] & Rect(Point(0, 0), frame)) == tiles[i] );
+    covered(tiles[i]).setTo(1);
+    xs.push_back(tiles[i].x);
+    ys.push_back(tiles[i].y);
+  }
+  REQUIRE( countNonZero(covered) == frame.area() );
+
+  std::sort(xs.begin(), xs.end());
+  xs.erase(std::unique(xs.begin(), xs.end()), xs.end());
+  for (unsigned int i = 1; i < xs.size(); i++)
+    REQUIRE( xs[i - 1] + 1200 - xs[i] >= max_plate.width );
+  std::sort(ys.begin(), ys.end());
+  ys.erase(std::unique(ys.begin(), ys.end()), ys.end());
+  for (unsigned int i = 1; i < ys.size(); i++)
+    REQUIRE( ys[i - 1] + 390 - ys[i] >= max_plate.height );
+
+  // Tiles never outgrow a frame smaller than them
+  tiles = detectionTiles(Size(1000, 200), Size(60, 20), max_plate, 3);
+  REQUIRE( tiles.size() == 1 );
+  REQUIRE( tiles[0] == Rect(0, 0, 1000, 200) );
+
+  // A plate in the overlap of two tiles is reported once, from the tile where it sits
+  // farther from the seam.  Two boxes from one tile are both kept, as in a single pass.
+  Size wide(2000, 390);
+  tiles.clear();
+  tiles.push_back(Rect(0, 0, 1200, 390));
+  tiles.push_back(Rect(800, 0, 1200, 390));
+
+  std::vector<std::vector<Rect> > tile_plates(2);
+  tile_plates[0].push_back(Rect(900, 100, 200, 60));
+  tile_plates[0].push_back(Rect(100, 100, 200, 60));
+  tile_plates[0].push_back(Rect(110, 105, 180, 50));
+  tile_plates[1].push_back(Rect(102, 101, 198, 60));
+
+  std::vector<Rect> plates = mergeTileDetections(tiles, tile_plates, wide);
+  REQUIRE( plates.size() == 3 );
+  REQUIRE( std::count(plates.begin(), plates.end(), Rect(902, 101, 198, 60)) == 1 );
+  REQUIRE( std::count(plates.begin(), plates.end(), Rect(900, 100, 200, 60)) == 0 );
+  REQUIRE( std::count(plates.begin(), plates.end(), Rect(100, 100, 200, 60)) == 1 );
+  REQUIRE( std::count(plates.begin(), plates.end(), Rect(110, 105, 180, 50)) == 1 );
+}
+
+
+TEST_CASE( "Detection patches match whole-frame preparation", "[detector]" ) {
+
+  std::vector<Rect> rois;
+  // A chain whose ends only meet through the middle ROI, which comes last
+  rois.push_back(Rect(0, 0, 100, 50));
+  rois.push_back(Rect(180, 0, 100, 50));
+  rois.push_back(Rect(90, 0, 100, 50));
+  // Overlapping diagonally, and touching only at a corner
+  rois.push_back(Rect(400, 100, 50, 50));
+  rois.push_back(Rect(440, 140, 50, 50));
+  rois.push_back(Rect(600, 0, 50, 50));
+  rois.push_back(Rect(650, 50, 50, 50));
+  // Sharing an edge, and the same ROI twice
+  rois.push_back(Rect(0, 200, 100, 50));
+  rois.push_back(Rect(100, 200, 100, 50));
+  rois.push_back(Rect(300, 300, 80, 40));
+  rois.push_back(Rect(300, 300, 80, 40));
+
+  std::vector<Rect> patches = mergeOverlapping(rois);
+  REQUIRE( patches.size() == 7 );
+  REQUIRE( std::count(patches.begin(), patches.end(), Rect(0, 0, 280, 50)) == 1 );
+  REQUIRE( std::count(patches.begin(), patches.end(), Rect(400, 100, 90, 90)) == 1 );
+  REQUIRE( std::count(patches.begin(), patches.end(), Rect(300, 300, 80, 40)) == 1 );
+  for (unsigned int i = 0; i < rois.size(); i++)
+  {
+    int containing = 0;
+    for (unsigned int p = 0; p < patches.size(); p++)
+    {
+      if ((patches[p] & rois[i]) == rois[i])
+        containing++;
+    }
+    REQUIRE( containing == 1 );
+  }
+  for (unsigned int p = 0; p < patches.size(); p++)
+  {
+    for (unsigned int q = p + 1; q < patches.size(); q++)
+      REQUIRE( (patches[p] & patches[q]).area() == 0 );
+  }
+
+  // Each ROI cut from its converted, masked patch holds the same pixels as the same ROI
+  // cut from the whole frame converted and masked at once
+  Config config("us", OPENALPR_TESTING_CONFIG_PATH, OPENALPR_TESTING_RUNTIME_DIR);
+  PreWarp prewarp(&config);
+
+  Mat color(240, 320, CV_8UC3);
+  randu(color, 0, 256);
+  Mat gray;
+  cvtColor(color, gray, COLOR_BGR2GRAY);
+
+  // White on the left, so frame columns past 200 are masked out
+  Mat mask_image = Mat::zeros(120, 160, CV_8U);
+  mask_image(Rect(0, 0, 100, 120)).setTo(255);
+
+  std::vector<Rect> frame_rois;
+  frame_rois.push_back(Rect(10, 20, 120, 80));
+  frame_rois.push_back(Rect(100, 60, 150, 100));
+  frame_rois.push_back(Rect(200, 170, 100, 60));
+  frame_rois.push_back(Rect(260, 10, 50, 40));
+  std::vector<Rect> frame_patches = mergeOverlapping(frame_rois);
+  REQUIRE( frame_patches.size() == 3 );
+
+  for (int masked = 0; masked < 2; masked++)
+  {
+    DetectorMask mask(&config, &prewarp);
+    if (masked)
+      mask.setMask(mask_image);
+
+    Mat frames[] = { color, gray };
+    for (int f = 0; f < 2; f++)
+    {
+      Mat frame = frames[f];
+
+      Mat whole;
+      if (frame.channels() > 2)
+        cvtColor(frame, whole, COLOR_BGR2GRAY);
+      else
+        frame.copyTo(whole);
+      whole = mask.apply_mask(whole);
+      if (masked)
+        REQUIRE( countNonZero(whole(Rect(220, 0, 100, 240))) == 0 );
+
+      mask.prepare(frame.size());
+      for (unsigned int i = 0; i < frame_rois.size(); i++)
+      {
+        Rect roi = frame_rois[i];
+        unsigned int p = 0;
+        while ((frame_patches[p] & roi) != roi)
+          p++;
+
+        Mat crop = prepareDetectionPatch(frame, frame_patches[p], mask)(roi - frame_patches[p].tl());
+        REQUIRE( crop.size() == roi.size() );
+        REQUIRE( countNonZero(crop != whole(roi)) == 0 );
+      }
+    }
+  }
+}
+
+
+TEST_CASE( "Keypoint cache round trip and staleness", "[keypointcache]" ) {
+
+  std::ostringstream path;
+  path << "/tmp/openalpr-test-keypoints-" << getpid() << ".cache";
+
+  RNG rng(99);
+  std::vector<std::string> codes;
+  std::vector<std::vector<KeyPoint> > keypoints;
+  std::vector<Mat> descriptors;
+  for (int i = 0; i < 2; i++)
+  {
+    codes.push_back(i == 0 ? "ca" : "ny");
+    std::vector<KeyPoint> imageKeypoints;
+    for (int k = 0; k < 4 + i; k++)
+      imageKeypoints.push_back(KeyPoint(10.5f + k, 20.25f * i, 7.0f, 45.0f * k, 0.125f * k, k % 3, i));
+    keypoints.push_back(imageKeypoints);
+
+    Mat imageDescriptors(4 + i, 64, CV_8U);
+    rng.fill(imageDescriptors, RNG::UNIFORM, 0, 256);
+    descriptors.push_back(imageDescriptors);
+  }
+
+  std::string settings = "brisk";
+  uint64_t settingsHash = KeypointCache::hash(settings.data(), settings.size());
+  uint64_t imagesHash = KeypointCache::hash("images", 6);
+  REQUIRE( KeypointCache::save(path.str(), settingsHash, imagesHash, codes, keypoints, descriptors) );
+
+  // Everything comes back as it was saved
+  {
+    KeypointCache cache;
+    std::vector<std::string> loadedCodes;
+    std::vector<std::vector<KeyPoint> > loadedKeypoints;
+    std::vector<Mat> loadedDescriptors;
+    REQUIRE( cache.load(path.str(), settingsHash, imagesHash, loadedCodes, loadedKeypoints, loadedDescriptors) );
+
+    REQUIRE( loadedCodes == codes );
+    REQUIRE( loadedKeypoints.size() == keypoints.size() );
+    REQUIRE( loadedDescriptors.size() == descriptors.size() );
+    for (unsigned int i = 0; i < codes.size(); i++)
+    {
+      REQUIRE( loadedKeypoints[i].size() == keypoints[i].size() );
+      for (unsigned int k = 0; k < keypoints[i].size(); k++)
+      {
+        REQUIRE( loadedKeypoints[i][k].pt == keypoints[i][k].pt );
+        REQUIRE( loadedKeypoints[i][k].size == keypoints[i][k].size );
+        REQUIRE( loadedKeypoints[i][k].angle == keypoints[i][k].angle );
+        REQUIRE( loadedKeypoints[i][k].response == keypoints[i][k].response );
+        REQUIRE( loadedKeypoints[i][k].octave == keypoints[i][k].octave );
+        REQUIRE( loadedKeypoints[i][k].class_id == keypoints[i][k].class_id );
+      }
+
+      REQUIRE( loadedDescriptors[i].type() == descriptors[i].type() );
+      REQUIRE( loadedDescriptors[i].size() == descriptors[i].size() );
+      REQUIRE( countNonZero(loadedDescriptors[i] != descriptors[i]) == 0 );
+    }
+  }
+
+  // A cache for other training images or other extractor settings is stale
+  KeypointCache cache;
+  std::vector<std::string> loadedCodes;
+  std::vector<std::vector<KeyPoint> > loadedKeypoints;
+  std::vector<Mat> loadedDescriptors;
+  REQUIRE( cache.load(path.str(), settingsHash, imagesHash + 1, loadedCodes, loadedKeypoints, loadedDescriptors) == false );
+  std::string otherSettings = "brisk2";
+  REQUIRE( cache.load(path.str(), KeypointCache::hash(otherSettings.data(), otherSettings.size()), imagesHash,
+                      loadedCodes, loadedKeypoints, loadedDescriptors) == false );
+
+  // So is one cut short, whether in the descriptors or in the header
+  std::string contents;
+  {
+    std::ifstream infile(path.str().c_str(), std::ios::binary);
+    contents.assign(std::istreambuf_iterator<char>(infile), std::istreambuf_iterator<char>());
+  }
+  size_t cuts[] = { contents.size() - 10, 20 };
+  for (int c = 0; c < 2; c++)
+  {
+    {
+      std::ofstream outfile(path.str().c_str(), std::ios::binary | std::ios::trunc);
+      outfile.write(contents.data(), cuts[c]);
+    }
+    REQUIRE( cache.load(path.str(), settingsHash, imagesHash, loadedCodes, loadedKeypoints, loadedDescriptors) == false );
+  }
+
+  remove(path.str().c_str());
+}
+
+// Puts every input in one hash bucket so lookups depend on the pixel comparison alone
+class CollidingOcrPassCache : public OcrPassCache
+{
+  public:
+    CollidingOcrPassCache(int capacity) : OcrPassCache(capacity) {}
+
+  protected:
+    virtual uint64_t hashKey(const cv::Mat& image, const std::vector<cv::Rect>& charRegions) { return 42; }
+};
+
+static OcrPassResult ocrPass(const std::string& text, float confidence)
+{
+  OcrPassResult pass;
+  for (unsigned int i = 0; i < text.size(); i++)
+  {
+    OcrChar c;
+    c.letter = text.substr(i, 1);
+    c.char_index = i;
+    c.confidence = confidence;
+    pass.chars.push_back(c);
+  }
+  pass.score = confidence;
+  return pass;
+}
+
+TEST_CASE( "OCR pass cache", "[ocrcache]" ) {
+
+  Mat first(20, 60, CV_8U, Scalar(0));
+  rectangle(first, Rect(5, 5, 10, 10), Scalar(255), -1);
+  Mat second = first.clone();
+  second.at<uchar>(19, 59) = 7;
+
+  std::vector<Rect> boxes;
+  boxes.push_back(Rect(4, 4, 12, 12));
+  boxes.push_back(Rect(20, 4, 12, 12));
+
+  SECTION( "a repeated input returns its passes" )
+  {
+    OcrPassCache cache(4);
+    REQUIRE( cache.find(first, boxes) == NULL );
+
+    cache.add(first, boxes, 0, ocrPass("AB", 80));
+    cache.add(first, boxes, 1, ocrPass("A8", 70));
+
+    const std::vector<OcrPassResult>* passes = cache.find(first.clone(), boxes);
+    REQUIRE( passes != NULL );
+    REQUIRE( passes->size() == 2 );
+    REQUIRE( (*passes)[0].chars[1].letter == "B" );
+    REQUIRE( (*passes)[1].chars[1].letter == "8" );
+
+    // The same pixels segmented differently are another input
+    std::vector<Rect> otherBoxes(boxes.begin(), boxes.begin() + 1);
+    REQUIRE( cache.find(first, otherBoxes) == NULL );
+  }
+
+  SECTION( "a hash collision on different pixels is rejected" )
+  {
+    CollidingOcrPassCache cache(4);
+    cache.add(first, boxes, 0, ocrPass("AB", 80));
+
+    REQUIRE( cache.find(first, boxes) != NULL );
+    REQUIRE( cache.find(second, boxes) == NULL );
+
+    cache.add(second, boxes, 0, ocrPass("XY", 60));
+    REQUIRE( (*cache.find(first, boxes))[0].chars[0].letter == "A" );
+    REQUIRE( (*cache.find(second, boxes))[0].chars[0].letter == "X" );
+  }
+
+  SECTION( "the least recently used input is evicted" )
+  {
+    Mat third = first.clone();
+    third.at<uchar>(0, 0) = 9;
+
+    OcrPassCache cache(2);
+    cache.add(first, boxes, 0, ocrPass("AB", 80));
+    cache.add(second, boxes, 0, ocrPass("CD", 80));
+    REQUIRE( cache.find(first, boxes) != NULL );
+
+    cache.add(third, boxes, 0, ocrPass("EF", 80));
+    REQUIRE( cache.find(second, boxes) == NULL );
+    REQUIRE( cache.find(first, boxes) != NULL );
+    REQUIRE( cache.find(third, boxes) != NULL );
+  }
+
+  SECTION( "a zero capacity caches nothing" )
+  {
+    OcrPassCache cache(0);
+    cache.add(first, boxes, 0, ocrPass("AB", 80));
+    REQUIRE( cache.find(first, boxes) == NULL );
+  }
+}
+
+TEST_CASE( "OCR early exit decision", "[ocrcache]" ) {
+
+  OcrPassResult confident = ocrPass("ABC1234", 90);
+  // Lower choices for a position do not count against it
+  OcrChar alternative;
+  alternative.letter = "8";
+  alternative.char_index = 1;
+  alternative.confidence = 10;
+  confident.chars.push_back(alternative);
+
+  REQUIRE( ocrPassReachesEarlyExit(confident, 7, 1, 85, NULL) );
+  REQUIRE( ocrPassReachesEarlyExit(confident, 7, 1, 95, NULL) == false );
+
+  // Turned off
+  REQUIRE( ocrPassReachesEarlyExit(confident, 7, 1, 0, NULL) == false );
+
+  // Every character position needs a reading
+  REQUIRE( ocrPassReachesEarlyExit(confident, 8, 1, 85, NULL) == false );
+
+  // The mean decides, not the best character
+  OcrPassResult mixed = ocrPass("ABC1234", 95);
+  mixed.chars[3].confidence = 10;
+  REQUIRE( ocrPassReachesEarlyExit(mixed, 7, 1, 85, NULL) == false );
+
+  SECTION( "requiring a pattern" )
+  {
+    Config config("us", OPENALPR_TESTING_CONFIG_PATH, OPENALPR_TESTING_RUNTIME_DIR);
+    PostProcess patterns(&config);
+
+    REQUIRE( ocrPassReachesEarlyExit(confident, 7, 1, 85, &patterns) );
+
+    // A line of a multi-line plate is not a whole plate number
+    REQUIRE( ocrPassReachesEarlyExit(confident, 7, 2, 85, &patterns) == false );
+
+    OcrPassResult noMatch = ocrPass("A1", 99);
+    REQUIRE( ocrPassReachesEarlyExit(noMatch, 2, 1, 85, NULL) );
+    REQUIRE( ocrPassReachesEarlyExit(noMatch, 2, 1, 85, &patterns) == false );
+  }
+}
+
+static int* newPoolItem()
+{
+  return new int(0);
+}
+
+TEST_CASE( "Checkout pool", "[checkoutpool]" ) {
+
+  CheckoutPool<int> pool;
+  int* first = new int(1);
+  pool.add(first);
+
+  // The free object is handed out; while it is out, a second caller gets a new one
+  int* a = pool.checkOut(newPoolItem);
+  REQUIRE( a == first );
+  int* b = pool.checkOut(newPoolItem);
+  REQUIRE( b != first );
+  REQUIRE( pool.size() == 2 );
+
+  // Checked-in objects are reused rather than building more
+  pool.checkIn(b);
+  pool.checkIn(a);
+  {
+    PoolLease<int> lease(&pool, newPoolItem);
+    PoolLease<int> second(&pool, newPoolItem);
+    REQUIRE( lease.get() != second.get() );
+  }
+  REQUIRE( pool.size() == 2 );
+
+  // A lease returns its object even when the call using it throws
+  try
+  {
+    PoolLease<int> lease(&pool, newPoolItem);
+    PoolLease<int> second(&pool, newPoolItem);
+    throw std::runtime_error("failed");
+  }
+  catch (std::runtime_error&)
+  {
+  }
+  PoolLease<int> l1(&pool, newPoolItem);
+  PoolLease<int> l2(&pool, newPoolItem);
+  REQUIRE( pool.size() == 2 );
+
+  int visited = 0;
+  pool.forEach([&visited](int* item) { visited++; });
+  REQUIRE( visited == 2 );
+}
@@ -35,7 +35,7 @@ VideoBuffer::~VideoBuffer()
 {
   if (dispatcher != NULL)
   {
-    dispatcher->active = false;
+    dispatcher->stop();
   }
 }
 
@@ -81,12 +81,28 @@ int VideoBuffer::getLatestFrame(cv::Mat* frame, std::vector<cv::Rect>& regionsOf
   return dispatcher->getLatestFrame(frame, regionsOfInterest);
 }
 
+int VideoBuffer::waitForLatestFrame(cv::Mat* frame, std::vector<cv::Rect>& regionsOfInterest)
+{
+  if (dispatcher == NULL)
+    return -1;
+  
+  return dispatcher->waitForLatestFrame(frame, regionsOfInterest);
+}
+
+int64_t VideoBuffer::getDroppedFrameCount()
+{
+  if (dispatcher == NULL)
+    return 0;
+
+  return dispatcher->getDroppedFrameCount();
+}
+
 
 void VideoBuffer::disconnect()
 {
   if (dispatcher != NULL)
   {
-    dispatcher->active = false;
+    dispatcher->stop();
   }
   
   dispatcher = NULL;
@@ -177,10 +193,11 @@ void getALPRImages(cv::VideoCapture cap, VideoDispatcher* dispatcher)
       bool hasImage = false;
       try
       {
-        cv::Mat frame;
-	hasImage = cap.read(frame);
+        // Decode straight into a spare frame buffer; publishing it is a pointer swap
+        cv::Mat* frame = dispatcher->getWriteBuffer();
+	hasImage = cap.read(*frame);
 		  // Double check the image to make sure it's valid.
-	if (!frame.data || frame.empty())
+	if (!frame->data || frame->empty())
 	{
 	  std::stringstream ss;
 	  ss << "Stream " << dispatcher->mjpeg_url << " received invalid frame";
@@ -188,9 +205,7 @@ void getALPRImages(cv::VideoCapture cap, VideoDispatcher* dispatcher)
 	  return;
 	}
 	
-	dispatcher->mMutex.lock();
 	dispatcher->setLatestFrame(frame);
-	dispatcher->mMutex.unlock();
       }
       catch (const std::runtime_error& error)
       {
@@ -198,12 +213,8 @@ void getALPRImages(cv::VideoCapture cap, VideoDispatcher* dispatcher)
 	std::stringstream ss;
 	ss << "Exception happened " <<  error.what();
 	dispatcher->log_error(ss.str());
-	dispatcher->mMutex.unlock();
 	return;
       }
-
-      
-      dispatcher->mMutex.unlock();
       
       if (hasImage == false)
 	break;
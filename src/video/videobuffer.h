@@ -6,6 +6,7 @@
 #include <stdexcept>
 #include <sstream>
 #include <vector>
+#include <stdint.h>
 
 #include "opencv2/highgui/highgui.hpp"
 
@@ -15,6 +16,12 @@
 
 
 
+// Frames are handed from the capture thread to consumers without copying.  The
+// capture thread decodes into one of FRAME_SLOTS buffers that nobody else references,
+// then publishes it; consumers receive a cv::Mat sharing that buffer.  A published
+// buffer is never written again while any consumer still holds it, so the frames
+// handed out are effectively read-only snapshots.  mMutex only guards the O(1)
+// header swaps, never a pixel copy.
 class VideoDispatcher
 {
   public:
@@ -23,36 +30,84 @@ class VideoDispatcher
       this->active = true;
       this->latestFrameNumber = -1;
       this->lastFrameRead = -1;
+      this->latestSlot = -1;
+      this->droppedFrames = 0;
       this->fps = fps;
       this->mjpeg_url = mjpeg_url;
     }
     
     
+    // frame is set to share the latest frame's pixels.  Clone it before writing to it
+    // if other consumers may see the same frame.
     int getLatestFrame(cv::Mat* frame, std::vector<cv::Rect>& regionsOfInterest)
     {
       tthread::lock_guard<tthread::mutex> guard(mMutex);
       
-      if (latestFrameNumber == lastFrameRead)
-        return -1;
-      
-      frame->create(latestFrame.size(), latestFrame.type());
-      latestFrame.copyTo(*frame);
-      
-      this->lastFrameRead = this->latestFrameNumber;
-      
-      // Copy the regionsOfInterest array
-      for (int i = 0; i < this->latestRegionsOfInterest.size(); i++)
-          regionsOfInterest.push_back(this->latestRegionsOfInterest[i]);
-      
-      return this->lastFrameRead;
+      return takeLatestFrame(frame, regionsOfInterest);
     }
-    
-    void setLatestFrame(cv::Mat frame)
-    {      
-      frame.copyTo(this->latestFrame);
-      this->latestRegionsOfInterest = calculateRegionsOfInterest(&this->latestFrame);
+
+    // Like getLatestFrame, but blocks until a new frame is published or stop() is called
+    int waitForLatestFrame(cv::Mat* frame, std::vector<cv::Rect>& regionsOfInterest)
+    {
+      tthread::lock_guard<tthread::mutex> guard(mMutex);
+
+      while (active && latestFrameNumber == lastFrameRead)
+        frameReady.wait(mMutex);
+
+      return takeLatestFrame(frame, regionsOfInterest);
+    }
+
+    // Ends capture and wakes any consumer blocked in waitForLatestFrame
+    void stop()
+    {
+      tthread::lock_guard<tthread::mutex> guard(mMutex);
+      active = false;
+      frameReady.notify_all();
+    }
+
+    // Returns a buffer for the capture thread to decode the next frame into.  It is
+    // neither the published frame nor shared with any consumer.
+    cv::Mat* getWriteBuffer()
+    {
+      tthread::lock_guard<tthread::mutex> guard(mMutex);
+
+      int candidate = -1;
+      for (int i = 0; i < FRAME_SLOTS; i++)
+      {
+        if (i == latestSlot)
+          continue;
+        if (candidate == -1)
+          candidate = i;
+        if (!isShared(frameSlots[i]))
+          return &frameSlots[i];
+      }
+
+      // Every spare buffer is still held by a consumer.  Let them keep it and
+      // decode into a fresh allocation instead.
+      frameSlots[candidate].release();
+      return &frameSlots[candidate];
+    }
+
+    // Publishes a buffer obtained from getWriteBuffer()
+    void setLatestFrame(cv::Mat* buffer)
+    {
+      tthread::lock_guard<tthread::mutex> guard(mMutex);
+
+      if (latestFrameNumber != lastFrameRead)
+        droppedFrames++;
+
+      latestSlot = (int) (buffer - frameSlots);
+      this->latestRegionsOfInterest = calculateRegionsOfInterest(buffer);
       
       this->latestFrameNumber++;
+      frameReady.notify_all();
+    }
+
+    // Frames replaced by a newer one before any consumer picked them up
+    int64_t getDroppedFrameCount()
+    {
+      tthread::lock_guard<tthread::mutex> guard(mMutex);
+      return droppedFrames;
     }
     
     virtual void log_info(std::string message)
@@ -84,8 +139,42 @@ class VideoDispatcher
     tthread::mutex mMutex;
     
   private:
-    cv::Mat latestFrame;
+    // One being decoded into, one published, and one still held by a slow consumer
+    static const int FRAME_SLOTS = 3;
+
+    cv::Mat frameSlots[FRAME_SLOTS];
+    int latestSlot;
+    int64_t droppedFrames;
     std::vector<cv::Rect> latestRegionsOfInterest;
+    tthread::condition_variable frameReady;
+
+    // Called with mMutex held
+    int takeLatestFrame(cv::Mat* frame, std::vector<cv::Rect>& regionsOfInterest)
+    {
+      if (latestFrameNumber == lastFrameRead)
+        return -1;
+      
+      *frame = frameSlots[latestSlot];
+      
+      this->lastFrameRead = this->latestFrameNumber;
+      
+      // Copy the regionsOfInterest array
+      for (int i = 0; i < this->latestRegionsOfInterest.size(); i++)
+          regionsOfInterest.push_back(this->latestRegionsOfInterest[i]);
+      
+      return this->lastFrameRead;
+    }
+
+    // True if something besides this slot references the buffer.  Only called with
+    // mMutex held; new references are only handed out under it.
+    static bool isShared(const cv::Mat& buffer)
+    {
+#if OPENCV_MAJOR_VERSION == 2
+      return buffer.refcount != NULL && *buffer.refcount > 1;
+#else
+      return buffer.u != NULL && buffer.u->refcount > 1;
+#endif
+    }
 };
 
 class VideoBuffer
@@ -103,6 +192,13 @@ class VideoBuffer
     // regionsOfInterest is set to a list of good regions to check for license plates.  Default is one rectangle for the entire frame.
     int getLatestFrame(cv::Mat* frame, std::vector<cv::Rect>& regionsOfInterest);
 
+    // Blocks until a frame newer than the last one returned is available.  Returns -1
+    // once the buffer is disconnected.
+    int waitForLatestFrame(cv::Mat* frame, std::vector<cv::Rect>& regionsOfInterest);
+
+    // Number of captured frames that were superseded before getLatestFrame saw them
+    int64_t getDroppedFrameCount();
+
     void disconnect();
     
   protected: